@@ -0,0 +1,800 @@
+#include <fang/autograd.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <platform/thread.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Grows an array of `*cap` elements of `siz` bytes to hold `need`
+   elements. */
+static int _fang_tape_grow(int eid, void **arr, int *cap, int need,
+    size_t siz)
+{
+    int res = FANG_OK;
+
+    if(FANG_LIKELY(need <= *cap))
+        goto out;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    int ncap = *cap > 0 ? 2 * *cap : 64;
+    while(ncap < need)
+        ncap *= 2;
+
+    void *mem = env->realloc(*arr, ncap * siz);
+    if(FANG_UNLIKELY(mem == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+
+    *arr = mem;
+    *cap = ncap;
+
+out:
+    return res;
+}
+
+/* Whether two tensors are of same shape. */
+FANG_INLINE static inline bool _fang_tape_same_shape(const fang_ten_t *x,
+    const fang_ten_t *y)
+{
+    return x->ndims == y->ndims && (x->ndims == 0 ||
+        !memcmp(x->dims, y->dims, x->ndims * sizeof(*x->dims)));
+}
+
+/* Takes a buffer of same shape and data type as `like` from the pool, creating
+   one if none is free. Zeroed if `zero` is set. */
+static int _fang_tape_take(fang_tape_t *restrict tape, const fang_ten_t *like,
+    bool zero, fang_ten_t **ten)
+{
+    int res = FANG_OK;
+
+    _fang_tape_buf_t *buf = NULL;
+    for(int i = 0; i < tape->nbufs; i++) {
+        if(!tape->bufs[i]->used && tape->bufs[i]->ten.dtyp == like->dtyp &&
+            _fang_tape_same_shape(&tape->bufs[i]->ten, like))
+        {
+            buf = tape->bufs[i];
+            break;
+        }
+    }
+
+    /* Pool is only grown while warming up. */
+    if(FANG_UNLIKELY(buf == NULL)) {
+        fang_env_t *env;
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env,
+            tape->eid))))
+        {
+            goto out;
+        }
+
+        _fang_tape_buf_t **bufs = (_fang_tape_buf_t **) env->realloc(
+            tape->bufs, (tape->nbufs + 1) * sizeof(*bufs));
+        if(FANG_UNLIKELY(bufs == NULL)) {
+            res = -FANG_NOMEM;
+            goto out;
+        }
+        tape->bufs = bufs;
+
+        buf = FANG_CREATE(env->realloc, _fang_tape_buf_t, 1);
+        if(FANG_UNLIKELY(buf == NULL)) {
+            res = -FANG_NOMEM;
+            goto out;
+        }
+
+        /* Scalar tensors have no dimensions. */
+        if(like->dims == NULL) {
+            res = fang_ten_scalar(&buf->ten, tape->eid, like->dtyp,
+                FANG_F2G(0.0));
+        } else {
+            res = fang_ten_create(&buf->ten, tape->eid, like->dtyp,
+                (fang_ten_dim_t) { .dims = like->dims, .ndims = like->ndims },
+                NULL);
+        }
+        if(FANG_UNLIKELY(!FANG_ISOK(res))) {
+            FANG_RELEASE(env->realloc, buf);
+            goto out;
+        }
+
+        buf->owner = NULL;
+        tape->bufs[tape->nbufs++] = buf;
+    }
+
+    if(zero && FANG_UNLIKELY(!FANG_ISOK(res = fang_ten_fill(&buf->ten,
+        FANG_F2G(0.0)))))
+    {
+        goto out;
+    }
+
+    buf->used = true;
+    *ten = &buf->ten;
+
+out:
+    return res;
+}
+
+/* Gives a buffer taken by `_fang_tape_take()` back to the pool. */
+FANG_INLINE static inline void _fang_tape_give(fang_ten_t *ten) {
+    _fang_tape_buf_t *buf = (_fang_tape_buf_t *) ten;
+    buf->owner = NULL;
+    buf->used  = false;
+}
+
+/* Attaches a buffer as gradient of `ten`. */
+FANG_INLINE static inline void _fang_tape_attach(fang_ten_t *ten,
+    fang_ten_t *grad)
+{
+    ((_fang_tape_buf_t *) grad)->owner = ten;
+    ten->grad = grad;
+}
+
+/* Detaches every gradient of the pool from it's tensor and gives it back. */
+static void _fang_tape_detach(fang_tape_t *restrict tape) {
+    for(int i = 0; i < tape->nbufs; i++) {
+        _fang_tape_buf_t *buf = tape->bufs[i];
+
+        if(buf->owner != NULL && buf->owner->grad == &buf->ten)
+            buf->owner->grad = NULL;
+        _fang_tape_give(&buf->ten);
+    }
+}
+
+/* Index of the element of `acc` element `i` of `g` is broadcasted from. */
+FANG_HOT FANG_INLINE static inline size_t _fang_tape_reduce_idx(
+    const fang_ten_t *acc, const fang_ten_t *g, size_t i)
+{
+    size_t idx = 0;
+    int diff = g->ndims - acc->ndims;
+
+    for(int k = g->ndims - 1; k >= diff; k--) {
+        uint32_t coord = i % g->dims[k];
+        i /= g->dims[k];
+
+        if(acc->dims[k - diff] != 1)
+            idx += (size_t) coord * acc->strides[k - diff];
+    }
+
+    return idx;
+}
+
+/* Adds `g` into `acc` of broadcastable shape, summing over dimensions `acc`
+   is broadcasted along. Negated if `neg` is set. */
+static int _fang_tape_reduce(fang_ten_t *acc, fang_ten_t *g, bool neg) {
+    int res = FANG_OK;
+
+    /* Elements are accessed directly. */
+    if(FANG_UNLIKELY(!FANG_ISOK(res = fang_ten_wait(acc)) ||
+        !FANG_ISOK(res = fang_ten_wait(g))))
+    {
+        goto out;
+    }
+
+    size_t n = g->dims != NULL ? (size_t) g->strides[0] * g->dims[0] : 1;
+    switch(g->dtyp) {
+        case FANG_TEN_DTYPE_FLOAT32: {
+            float *a = (float *) acc->data.dense;
+            const float *d = (const float *) g->data.dense;
+
+            for(size_t i = 0; i < n; i++)
+                a[_fang_tape_reduce_idx(acc, g, i)] += neg ? -d[i] : d[i];
+            break;
+        }
+        case FANG_TEN_DTYPE_FLOAT64: {
+            double *a = (double *) acc->data.dense;
+            const double *d = (const double *) g->data.dense;
+
+            for(size_t i = 0; i < n; i++)
+                a[_fang_tape_reduce_idx(acc, g, i)] += neg ? -d[i] : d[i];
+            break;
+        }
+        default:
+            res = -FANG_UNSUPDTYP;
+    }
+
+out:
+    return res;
+}
+
+/* Accumulates gradient `g` flowing into `ten`. Negated if `neg` is set. */
+static int _fang_tape_accum(fang_tape_t *restrict tape, fang_ten_t *ten,
+    fang_ten_t *g, bool neg)
+{
+    int res = FANG_OK;
+
+    if(ten->grad == NULL) {
+        fang_ten_t *grad;
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_take(tape, ten, true,
+            &grad))))
+        {
+            goto out;
+        }
+        _fang_tape_attach(ten, grad);
+    }
+
+    if(FANG_LIKELY(_fang_tape_same_shape(ten, g))) {
+        res = neg ? fang_ten_diff(ten->grad, ten->grad, g) :
+            fang_ten_sum(ten->grad, ten->grad, g);
+    } else {
+        res = _fang_tape_reduce(ten->grad, g, neg);
+    }
+
+out:
+    return res;
+}
+
+/* Whether an operator uses a tensor. */
+FANG_INLINE static inline bool _fang_tape_uses(const _fang_tape_op_t *op,
+    const fang_ten_t *ten)
+{
+    return op->dest == ten || op->x == ten || op->y == ten;
+}
+
+/* Whether a tensor can be discarded by a segment; it has to be written by an
+   operator of the segment before being read, and unused before it. */
+static bool _fang_tape_discardable(const fang_tape_t *restrict tape,
+    const _fang_tape_seg_t *restrict seg, const fang_ten_t *ten)
+{
+    /* Only data owned by the Environment can be released. */
+    if(ten->typ != FANG_TEN_TYPE_DENSE || ten->deleter != NULL ||
+        ten->data.dense == NULL)
+    {
+        return false;
+    }
+
+    for(int i = 0; i < seg->first; i++) {
+        if(_fang_tape_uses(tape->ops + i, ten))
+            return false;
+    }
+
+    for(int i = seg->first; i <= seg->last; i++) {
+        const _fang_tape_op_t *op = tape->ops + i;
+        if(!_fang_tape_uses(op, ten))
+            continue;
+
+        if(op->dest != ten || op->x == ten || op->y == ten)
+            return false;
+        return op->kind != _FANG_TAPE_SCALE && (op->kind != _FANG_TAPE_GEMM ||
+            FANG_G2F(op->beta) == 0);
+    }
+
+    return false;
+}
+
+/* Discards data of tensors of a segment. */
+static int _fang_tape_discard(fang_tape_t *restrict tape,
+    const _fang_tape_seg_t *restrict seg)
+{
+    int res = FANG_OK;
+
+    for(int i = 0; i < seg->ntens; i++) {
+        fang_ten_t *ten = tape->ckpts[seg->off + i];
+        if(ten->data.dense != NULL &&
+            FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_evict(ten))))
+        {
+            break;
+        }
+    }
+
+    return res;
+}
+
+/* Allocates data of every discarded tensor again. */
+static int _fang_tape_restore(fang_tape_t *restrict tape) {
+    int res = FANG_OK;
+
+    for(int i = 0; i < tape->nckpts; i++) {
+        if(tape->ckpts[i]->data.dense == NULL &&
+            FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_restore(tape->ckpts[i]))))
+        {
+            break;
+        }
+    }
+
+    return res;
+}
+
+/* Runs a recorded operator again. */
+static int _fang_tape_redo(const _fang_tape_op_t *op) {
+    switch(op->kind) {
+        case _FANG_TAPE_SUM:
+            return fang_ten_sum(op->dest, op->x, op->y);
+        case _FANG_TAPE_DIFF:
+            return fang_ten_diff(op->dest, op->x, op->y);
+        case _FANG_TAPE_MUL:
+            return fang_ten_mul(op->dest, op->x, op->y);
+        case _FANG_TAPE_GEMM:
+            return fang_ten_gemm(op->transp_x, op->transp_y, op->beta,
+                op->dest, op->alpha, op->x, op->y);
+        case _FANG_TAPE_SCALE:
+            return fang_ten_scale(op->dest, op->alpha);
+        default: {
+            fang_env_t *env;
+            int res = _fang_env_retrieve(&env, op->dest->eid);
+            fang_ten_ops_arg_t arg = op->arg;
+            return FANG_ISOK(res) ?
+                _fang_ten_overwrite(op->dest, env, op->fn, &arg) : res;
+        }
+    }
+}
+
+/* Recomputes discarded tensors of a segment, by running operators of the
+   segment writing them. */
+static int _fang_tape_recompute(fang_tape_t *restrict tape,
+    const _fang_tape_seg_t *restrict seg)
+{
+    int res = FANG_OK;
+
+    fang_ten_t **tens = tape->ckpts + seg->off;
+    for(int i = 0; i < seg->ntens; i++) {
+        if(tens[i]->data.dense == NULL &&
+            FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_restore(tens[i]))))
+        {
+            goto out;
+        }
+    }
+
+    for(int i = seg->first; i <= seg->last; i++) {
+        for(int j = 0; j < seg->ntens; j++) {
+            if(tape->ops[i].dest != tens[j])
+                continue;
+
+            if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_redo(tape->ops + i))))
+                goto out;
+            break;
+        }
+    }
+
+out:
+    return res;
+}
+
+/* Backward of element-wise multiplication. */
+/* dx := gd * y, dy := gd * x */
+static int _fang_tape_mul_backward(fang_tape_t *restrict tape,
+    const _fang_tape_op_t *op, fang_ten_t *gd)
+{
+    int res = FANG_OK;
+
+    fang_ten_t *tmp;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_take(tape, op->dest, false,
+        &tmp))))
+    {
+        goto out;
+    }
+
+    if(FANG_LIKELY(FANG_ISOK(res = fang_ten_mul(tmp, gd, op->y)) &&
+        FANG_ISOK(res = _fang_tape_accum(tape, op->x, tmp, false)) &&
+        FANG_ISOK(res = fang_ten_mul(tmp, gd, op->x))))
+    {
+        res = _fang_tape_accum(tape, op->y, tmp, false);
+    }
+    _fang_tape_give(tmp);
+
+out:
+    return res;
+}
+
+/* Backward of GEMM for one of it's operands, `x` if `of_x` is set. */
+/* dest := alpha * op(x)op(y) + beta * dest
+ *      dx := alpha * gd op(y)^T, or alpha * op(y) gd^T if x is transposed
+ *      dy := alpha * op(x)^T gd, or alpha * gd^T op(x) if y is transposed
+ */
+static int _fang_tape_gemm_backward(fang_tape_t *restrict tape,
+    const _fang_tape_op_t *op, fang_ten_t *gd, bool of_x)
+{
+    int res = FANG_OK;
+
+    const fang_ten_gemm_transp_t N = FANG_TEN_GEMM_NO_TRANSPOSE;
+    const fang_ten_gemm_transp_t T = FANG_TEN_GEMM_TRANSPOSE;
+    bool tx = op->transp_x == T, ty = op->transp_y == T;
+
+    fang_ten_t *ten = of_x ? op->x : op->y;
+    fang_ten_t *a, *b;
+    fang_ten_gemm_transp_t ta, tb;
+    if(of_x && !tx) {
+        a = gd, ta = N;
+        b = op->y, tb = ty ? N : T;
+    } else if(of_x) {
+        a = op->y, ta = ty ? T : N;
+        b = gd, tb = T;
+    } else if(!ty) {
+        a = op->x, ta = tx ? N : T;
+        b = gd, tb = N;
+    } else {
+        a = gd, ta = T;
+        b = op->x, tb = tx ? T : N;
+    }
+
+    /* Operand batched alike destination; GEMM accumulates right into it's
+       gradient, or overwrites a fresh one. */
+    if(FANG_LIKELY(ten->ndims == gd->ndims && !memcmp(ten->dims, gd->dims,
+        (gd->ndims - 2) * sizeof(*gd->dims))))
+    {
+        fang_float_t beta = 1.0;
+        if(ten->grad == NULL) {
+            fang_ten_t *grad;
+            if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_take(tape, ten,
+                false, &grad))))
+            {
+                goto out;
+            }
+            _fang_tape_attach(ten, grad);
+            beta = 0.0;
+        }
+
+        res = fang_ten_gemm(ta, tb, FANG_F2G(beta), ten->grad, op->alpha, a,
+            b);
+    } else {
+        /* Operand broadcasted along batch dimensions; compute gradient of
+           every batch and sum them up. */
+        uint32_t dims[gd->ndims];
+        memcpy(dims, gd->dims, (gd->ndims - 2) * sizeof(*dims));
+        dims[gd->ndims - 2] = ten->dims[ten->ndims - 2];
+        dims[gd->ndims - 1] = ten->dims[ten->ndims - 1];
+
+        fang_ten_t like = *ten, *tmp;
+        like.dims  = dims;
+        like.ndims = gd->ndims;
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_take(tape, &like, false,
+            &tmp))))
+        {
+            goto out;
+        }
+
+        if(FANG_LIKELY(FANG_ISOK(res = fang_ten_gemm(ta, tb, FANG_F2G(0.0),
+            tmp, op->alpha, a, b))))
+        {
+            res = _fang_tape_accum(tape, ten, tmp, false);
+        }
+        _fang_tape_give(tmp);
+    }
+
+out:
+    return res;
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Creates an empty tape for an Environment. */
+int fang_tape_create(fang_tape_t *tape, int eid) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    memset(tape, 0, sizeof(fang_tape_t));
+    tape->eid = eid;
+
+out:
+    return res;
+}
+
+/* Starts recording operators of the Environment onto a tape. */
+int fang_tape_begin(fang_tape_t *tape) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, tape->eid))))
+        goto out;
+
+    /* Only a single tape is recorded at a time. */
+    fang_tape_t *none = NULL;
+    if(FANG_UNLIKELY(!_fang_atomic_cas(&env->tape, &none, tape))) {
+        res = -FANG_RECORDING;
+        goto out;
+    }
+
+    _fang_tape_detach(tape);
+
+    /* Operators of the new recording write discarded tensors again. */
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_restore(tape)))) {
+        _fang_atomic_store(&env->tape, NULL);
+        goto out;
+    }
+
+    tape->nops   = 0;
+    tape->nsegs  = 0;
+    tape->nckpts = 0;
+
+out:
+    return res;
+}
+
+/* Stops recording. */
+int fang_tape_end(fang_tape_t *tape) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, tape->eid))))
+        goto out;
+
+    if(FANG_UNLIKELY(!_fang_atomic_cas(&env->tape, &tape, NULL))) {
+        res = -FANG_NORECORD;
+        goto out;
+    }
+
+    /* Segment left open discards nothing. */
+    if(tape->nsegs > 0 && tape->segs[tape->nsegs - 1].last < 0)
+        tape->segs[tape->nsegs - 1].last = tape->nops - 1;
+
+out:
+    return res;
+}
+
+/* Computes gradients of elements of `loss` summed. */
+int fang_tape_backward(fang_tape_t *tape, fang_ten_t *loss) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, tape->eid))))
+        goto out;
+
+    /* Backward operators must not be recorded themselves. */
+    if(FANG_UNLIKELY(env->tape != NULL)) {
+        res = -FANG_RECORDING;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(loss->dtyp != FANG_TEN_DTYPE_FLOAT32 &&
+        loss->dtyp != FANG_TEN_DTYPE_FLOAT64))
+    {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    /* Derivative of the sum with respect to each element is one. */
+    if(loss->grad == NULL) {
+        fang_ten_t *grad;
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_take(tape, loss, false,
+            &grad))))
+        {
+            goto out;
+        }
+        _fang_tape_attach(loss, grad);
+    }
+    if(FANG_UNLIKELY(!FANG_ISOK(res = fang_ten_fill(loss->grad,
+        FANG_F2G(1.0)))))
+    {
+        goto out;
+    }
+
+    int s = tape->nsegs - 1;
+    for(int i = tape->nops - 1; i >= 0; i--) {
+        const _fang_tape_op_t *op = tape->ops + i;
+
+        /* Activations of a segment are discarded again once left, and
+           recomputed when entered from it's end. */
+        for(; s >= 0 && i < tape->segs[s].first; s--) {
+            if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_discard(tape,
+                tape->segs + s))))
+            {
+                goto out;
+            }
+        }
+        if(s >= 0 && i == tape->segs[s].last &&
+            FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_recompute(tape,
+            tape->segs + s))))
+        {
+            goto out;
+        }
+
+        /* Destination does not affect `loss`. */
+        fang_ten_t *gd = op->dest->grad;
+        if(gd == NULL)
+            continue;
+
+        /* Scaling is in place; gradient of the value before is scaled too. */
+        if(op->kind == _FANG_TAPE_SCALE) {
+            if(FANG_UNLIKELY(!FANG_ISOK(res = fang_ten_scale(gd, op->alpha))))
+                goto out;
+            continue;
+        }
+
+        /* Destination is overwritten by this operator, hence it's gradient
+           does not flow further back through the destination itself. */
+        op->dest->grad = NULL;
+        bool keep = false;
+
+        switch(op->kind) {
+            case _FANG_TAPE_SUM:
+            case _FANG_TAPE_DIFF:
+                if(FANG_LIKELY(FANG_ISOK(res = _fang_tape_accum(tape, op->x,
+                    gd, false))))
+                {
+                    res = _fang_tape_accum(tape, op->y, gd,
+                        op->kind == _FANG_TAPE_DIFF);
+                }
+                break;
+            case _FANG_TAPE_MUL:
+                res = _fang_tape_mul_backward(tape, op, gd);
+                break;
+            case _FANG_TAPE_GEMM:
+                if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_gemm_backward(
+                    tape, op, gd, true)) ||
+                    !FANG_ISOK(res = _fang_tape_gemm_backward(tape, op, gd,
+                    false))))
+                {
+                    break;
+                }
+
+                /* Destination is accumulated into if `beta` is non-zero. */
+                if(FANG_G2F(op->beta) != 0) {
+                    res = fang_ten_scale(gd, op->beta);
+                    op->dest->grad = gd;
+                    keep = true;
+                }
+                break;
+            default:
+                break;
+        }
+
+        if(FANG_LIKELY(!keep))
+            _fang_tape_give(gd);
+        if(FANG_UNLIKELY(!FANG_ISOK(res)))
+            goto out;
+    }
+
+    for(; s >= 0; s--) {
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_discard(tape,
+            tape->segs + s))))
+        {
+            goto out;
+        }
+    }
+
+out:
+    return res;
+}
+
+/* Starts a checkpointed segment of the tape being recorded. */
+int fang_tape_checkpoint_begin(fang_tape_t *tape) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, tape->eid))))
+        goto out;
+
+    if(FANG_UNLIKELY(env->tape != tape)) {
+        res = -FANG_NORECORD;
+        goto out;
+    }
+
+    /* Segments do not nest. */
+    if(FANG_UNLIKELY(tape->nsegs > 0 && tape->segs[tape->nsegs - 1].last < 0)) {
+        res = -FANG_NOCKPT;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_grow(tape->eid,
+        (void **) &tape->segs, &tape->segs_cap, tape->nsegs + 1,
+        sizeof(_fang_tape_seg_t)))))
+    {
+        goto out;
+    }
+
+    tape->segs[tape->nsegs++] = (_fang_tape_seg_t) {
+        .first = tape->nops,
+        .last  = -1,
+        .off   = tape->nckpts
+    };
+
+out:
+    return res;
+}
+
+/* Ends a checkpointed segment, discarding data of `tens`. */
+int fang_tape_checkpoint_end(fang_tape_t *tape, fang_ten_t **tens,
+    int ntens)
+{
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, tape->eid))))
+        goto out;
+
+    if(FANG_UNLIKELY(env->tape != tape)) {
+        res = -FANG_NORECORD;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(tape->nsegs == 0 ||
+        tape->segs[tape->nsegs - 1].last >= 0))
+    {
+        res = -FANG_NOCKPT;
+        goto out;
+    }
+
+    _fang_tape_seg_t *seg = tape->segs + tape->nsegs - 1;
+    seg->last = tape->nops - 1;
+
+    /* Nothing is discarded unless every tensor can be. */
+    for(int i = 0; i < ntens; i++) {
+        if(FANG_UNLIKELY(!_fang_tape_discardable(tape, seg, tens[i]))) {
+            res = -FANG_NOCKPT;
+            goto out;
+        }
+    }
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_grow(tape->eid,
+        (void **) &tape->ckpts, &tape->ckpts_cap, tape->nckpts + ntens,
+        sizeof(fang_ten_t *)))))
+    {
+        goto out;
+    }
+
+    memcpy(tape->ckpts + tape->nckpts, tens, ntens * sizeof(fang_ten_t *));
+    seg->ntens    = ntens;
+    tape->nckpts += ntens;
+
+    res = _fang_tape_discard(tape, seg);
+
+out:
+    return res;
+}
+
+/* Releases a tape. */
+int fang_tape_release(fang_tape_t *tape) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, tape->eid))))
+        goto out;
+
+    /* Stop recording if still active. */
+    fang_tape_t *active = tape;
+    _fang_atomic_cas(&env->tape, &active, NULL);
+
+    _fang_tape_detach(tape);
+    res = _fang_tape_restore(tape);
+    for(int i = 0; i < tape->nbufs; i++) {
+        fang_ten_release(&tape->bufs[i]->ten);
+        FANG_RELEASE(env->realloc, tape->bufs[i]);
+    }
+
+    if(tape->bufs != NULL)
+        FANG_RELEASE(env->realloc, tape->bufs);
+    if(tape->ops != NULL)
+        FANG_RELEASE(env->realloc, tape->ops);
+    if(tape->segs != NULL)
+        FANG_RELEASE(env->realloc, tape->segs);
+    if(tape->ckpts != NULL)
+        FANG_RELEASE(env->realloc, tape->ckpts);
+
+    int eid = tape->eid;
+    memset(tape, 0, sizeof(fang_tape_t));
+    tape->eid = eid;
+
+out:
+    return res;
+}
+
+/* Appends an operator to a tape being recorded. */
+int _fang_tape_record(fang_tape_t *restrict tape,
+    const _fang_tape_op_t *restrict op)
+{
+    int res = FANG_OK;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_tape_grow(tape->eid,
+        (void **) &tape->ops, &tape->cap, tape->nops + 1,
+        sizeof(_fang_tape_op_t)))))
+    {
+        goto out;
+    }
+
+    tape->ops[tape->nops++] = *op;
+
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
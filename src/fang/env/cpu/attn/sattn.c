@@ -0,0 +1,250 @@
+#include <env/cpu/attn.h>
+#include <env/cpu/gemm.h>
+#include <env/cpu/avxmath.h>
+#include <platform/memory.h>
+#include <fang/status.h>
+#include <tune.h>
+
+#include <string.h>
+#include <math.h>
+
+
+/* ================ PRIVATE HELPER MACROS ================ */
+
+#define _FANG_MAX(x, y)    ((x) > (y) ? (x) : (y))
+
+/* Rounds `n` up to a multiple of `m`. */
+#define _FANG_ROUND(n, m)  (((n) + (m) - 1) / (m) * (m))
+
+/* ================ PRIVATE HELPER MACROS END ================ */
+
+
+/* ================ PRIVATE DATA STRUCTURES ================ */
+
+/* Shared state of attention tasks. */
+typedef struct _fang_sattn_par {
+    const _fang_attn_t *attn;
+    float *dest;
+    const float *q;
+
+    /* Page tables of keys and values. */
+    const float *const *k;
+    const float *const *v;
+
+    /* Query blocks of a single head. */
+    int nqblk;
+
+    /* Packed operands and the score tile of every thread, see
+       `_fang_sattn_task`. */
+    float *scratch;
+    size_t scratch_siz;
+    size_t qp_siz, kp_siz, pp_siz;
+} _fang_sattn_par_t;
+
+/* ================ PRIVATE DATA STRUCTURES END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Instantiate the five outer loops. Only loop 2 is used here, over tiles small
+   enough to be packed whole. */
+_FANG_OUTER_LOOPS(float, sgemm, SGEMM)
+
+/* Largest of `n` scores, at least `init`. */
+FANG_HOT FANG_INLINE static inline float _fang_sattn_max(
+    const float *restrict row, int n, float init)
+{
+    int i = 0;
+    float res = init;
+#ifdef FANG_USE_AVX2
+    if(n >= 8) {
+        __m256 acc = _mm256_loadu_ps(row);
+        for(i = 8; i + 8 <= n; i += 8)
+            acc = _mm256_max_ps(acc, _mm256_loadu_ps(row + i));
+
+        __m128 half = _mm_max_ps(_mm256_castps256_ps128(acc),
+            _mm256_extractf128_ps(acc, 1));
+        half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_max_ss(half, _mm_movehdup_ps(half));
+        res = _FANG_MAX(res, _mm_cvtss_f32(half));
+    }
+#endif  // FANG_USE_AVX2
+    for(; i < n; i++)
+        res = _FANG_MAX(res, row[i]);
+    return res;
+}
+
+/* Turns `n` scores into exp(score - max) in place, returning their sum. */
+FANG_HOT FANG_INLINE static inline float _fang_sattn_exp(float *restrict row,
+    int n, float max)
+{
+    int i = 0;
+    float res = 0.0f;
+#ifdef FANG_USE_AVX2
+    __m256 vmax = _mm256_set1_ps(max), acc = _mm256_setzero_ps();
+    for(; i + 8 <= n; i += 8) {
+        __m256 e = _fang_expf32_ps256(_mm256_sub_ps(_mm256_loadu_ps(row + i),
+            vmax));
+        _mm256_storeu_ps(row + i, e);
+        acc = _mm256_add_ps(acc, e);
+    }
+
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc),
+        _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_movehdup_ps(half));
+    res = _mm_cvtss_f32(half);
+#endif  // FANG_USE_AVX2
+    for(; i < n; i++) {
+        row[i] = expf(row[i] - max);
+        res += row[i];
+    }
+    return res;
+}
+
+/* Task of attention, FANG_ATTN_QUERIES queries of a single head. */
+/* NOTE: Scratch memory of a thread holds, in order, the packed query block,
+ *   the packed key tile, the score tile, probabilities of it packed and the
+ *   packed value tile. Output rows accumulate in `dest` itself.
+ */
+FANG_HOT static void _fang_sattn_task(void *restrict arg, ptrdiff_t task,
+    int wid)
+{
+    _fang_sattn_par_t *par = (_fang_sattn_par_t *) arg;
+    const _fang_attn_t *attn = par->attn;
+    int mr = _sgemm_mr[FANG_SGEMM_KERNEL], nr = _sgemm_nr[FANG_SGEMM_KERNEL];
+    int d = attn->d, dv = attn->dv;
+
+    int h  = (int) (task / par->nqblk);
+    int i0 = (int) (task % par->nqblk) * FANG_ATTN_QUERIES;
+    int qb = _FANG_MIN(FANG_ATTN_QUERIES, attn->t - i0);
+    int off = attn->s - attn->t;
+
+    const float *q = par->q + ((size_t) h * attn->t + i0) * d;
+    float *dest = par->dest + ((size_t) h * attn->t + i0) * dv;
+
+    float *q_packed = par->scratch + wid * par->scratch_siz;
+    float *k_packed = q_packed + par->qp_siz;
+    float *score    = k_packed + par->kp_siz;
+    float *p_packed = score + FANG_ATTN_QUERIES * FANG_ATTN_KEYS;
+    float *v_packed = p_packed + par->pp_siz;
+
+    /* Running maximum and sum of exponentials of every query. */
+    float m[FANG_ATTN_QUERIES], l[FANG_ATTN_QUERIES];
+    for(int i = 0; i < qb; i++) {
+        m[i] = -INFINITY;
+        l[i] = 0.0f;
+    }
+    memset(dest, 0, (size_t) qb * dv * sizeof(float));
+
+    _fang_sgemm_pack(d, qb, mr, (float *) q, d, q_packed, true);
+
+    /* Keys past the last query of the block are masked for all of it. */
+    int s = attn->causal ? _FANG_MIN(attn->s, i0 + qb + off) : attn->s;
+    for(int j0 = 0, kb; j0 < s; j0 += kb) {
+        /* Tiles do not cross pages. */
+        int jp = j0 % attn->page;
+        kb = _FANG_MIN(FANG_ATTN_KEYS, _FANG_MIN(s - j0, attn->page - jp));
+
+        size_t row = (size_t) h * attn->page + jp;
+        const float *k = par->k[j0 / attn->page] + row * d;
+        const float *v = par->v[j0 / attn->page] + row * dv;
+
+        /* Scaled scores of the tile, S = scale * QK^T. */
+        _fang_sgemm_pack(d, kb, nr, (float *) k, d, k_packed, true);
+        _fang_sgemm_loop2(qb, kb, d, 0.0f, score, FANG_ATTN_KEYS, attn->scale,
+            q_packed, k_packed);
+
+        /* Online softmax, output so far is rescaled to the new maximum. */
+        for(int i = 0; i < qb; i++) {
+            float *srow = score + i * FANG_ATTN_KEYS;
+            int n = attn->causal ? _FANG_MIN(kb, i0 + i + off - j0 + 1) : kb;
+            n = _FANG_MAX(n, 0);
+
+            if(n > 0) {
+                float max = _fang_sattn_max(srow, n, m[i]);
+                float corr = expf(m[i] - max);
+                l[i] = l[i] * corr + _fang_sattn_exp(srow, n, max);
+                m[i] = max;
+
+                if(corr != 1.0f) {
+                    float *o = dest + (size_t) i * dv;
+                    for(int j = 0; j < dv; j++)
+                        o[j] *= corr;
+                }
+            }
+            for(int j = n; j < kb; j++)
+                srow[j] = 0.0f;
+        }
+
+        /* O += PV. */
+        _fang_sgemm_pack(kb, qb, mr, score, FANG_ATTN_KEYS, p_packed, true);
+        _fang_sgemm_pack(kb, dv, nr, (float *) v, dv, v_packed, false);
+        _fang_sgemm_loop2(qb, dv, kb, 1.0f, dest, dv, 1.0f, p_packed,
+            v_packed);
+    }
+
+    for(int i = 0; i < qb; i++) {
+        float *o = dest + (size_t) i * dv, inv = 1.0f / l[i];
+        for(int j = 0; j < dv; j++)
+            o[j] *= inv;
+    }
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Single-precision (float32) scaled dot-product attention. */
+/* NOTE: Scores are never materialized whole. Tasks take a block of
+ *   FANG_ATTN_QUERIES queries of a head and walk keys and values in tiles of
+ *   FANG_ATTN_KEYS within a page, computing the score tile with the SGEMM
+ *   micro-kernel, turning it into probabilities by online softmax and
+ *   accumulating their product with values into output, rescaled whenever
+ *   the running maximum of a query grows. With causal masking, tiles entirely
+ *   in the future of a block are skipped.
+ */
+int _fang_sattn(_fang_pool_t *restrict pool,
+    const _fang_attn_t *restrict attn, float *restrict dest,
+    const float *restrict q, const float *const *k, const float *const *v)
+{
+    int res = FANG_OK;
+
+    int mr = _sgemm_mr[FANG_SGEMM_KERNEL], nr = _sgemm_nr[FANG_SGEMM_KERNEL];
+    int qpad = _FANG_ROUND(FANG_ATTN_QUERIES, mr);
+
+    /* Every part of scratch memory is kept on it's own cache line. */
+    _fang_sattn_par_t par = {
+        .attn = attn, .dest = dest, .q = q, .k = k, .v = v,
+        .nqblk = (attn->t + FANG_ATTN_QUERIES - 1) / FANG_ATTN_QUERIES,
+        .qp_siz = _FANG_ROUND((size_t) qpad * attn->d, 16),
+        .kp_siz = _FANG_ROUND((size_t) _FANG_ROUND(FANG_ATTN_KEYS, nr) *
+            attn->d, 16),
+        .pp_siz = _FANG_ROUND((size_t) qpad * FANG_ATTN_KEYS, 16)
+    };
+    par.scratch_siz = par.qp_siz + par.kp_siz + par.pp_siz +
+        _FANG_ROUND(FANG_ATTN_QUERIES * FANG_ATTN_KEYS, 16) +
+        _FANG_ROUND((size_t) FANG_ATTN_KEYS * _FANG_ROUND(attn->dv, nr), 16);
+
+    int nthreads = pool == NULL ? 1 : pool->nthreads;
+    par.scratch = _fang_aligned_malloc((size_t) nthreads * par.scratch_siz *
+        sizeof(float), 64);
+    if(FANG_UNLIKELY(par.scratch == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+
+    ptrdiff_t ntask = (ptrdiff_t) attn->bh * par.nqblk;
+    if(pool == NULL) {
+        for(ptrdiff_t t = 0; t < ntask; t++)
+            _fang_sattn_task(&par, t, 0);
+    } else
+        _fang_pool_for(pool, ntask, _fang_sattn_task, &par);
+
+    free(par.scratch);
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
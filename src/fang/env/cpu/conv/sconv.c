@@ -0,0 +1,376 @@
+#include <env/cpu/conv.h>
+#include <env/cpu/gemm.h>
+#include <platform/memory.h>
+#include <fang/status.h>
+#include <tune.h>
+
+#include <string.h>
+#include <stdint.h>
+
+
+/* ================ PRIVATE DATA STRUCTURES ================ */
+
+/* Shared state of convolution tasks. */
+typedef struct _fang_sconv_par {
+    const _fang_conv2d_t *conv;
+    float *dest;
+    const float *x;
+    const float *w;
+
+    /* Weights packed in micro-panels, every group and KC block of it. Depthwise
+       convolution in NHWC layout keeps weights transposed to (kh, kw, k)
+       instead. */
+    float *w_packed;
+
+    /* Length of rows of weights, and output channels of a group rounded up
+       to register blocking. */
+    int kdim;
+    int kpad;
+
+    /* Tasks of a single image and group. */
+    int ntask;
+
+    /* Packed im2col block for every thread. */
+    float *tilde;
+    size_t tilde_siz;
+} _fang_sconv_par_t;
+
+/* ================ PRIVATE DATA STRUCTURES END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Instantiate the five outer loops. Only loop 2 is used here, over micro-panels
+   packed straight from the input. */
+_FANG_OUTER_LOOPS(float, sgemm, SGEMM)
+
+/* Runs `fn` for every task in [0, ntask), on `pool` if not NULL. */
+static void _fang_sconv_for(_fang_pool_t *restrict pool, ptrdiff_t ntask,
+    _fang_pool_fn fn, void *arg)
+{
+    if(pool == NULL) {
+        for(ptrdiff_t t = 0; t < ntask; t++)
+            fn(arg, t, 0);
+    } else
+        _fang_pool_for(pool, ntask, fn, arg);
+}
+
+/* Packs columns [j, j + jb) of rows [p, p + pb) of the im2col matrix of an
+ * image and group straight from the input, in micro-panels of `stride`
+ * output pixels. In NCHW layout, rows of the im2col matrix are ordered by
+ * (c, kh, kw), in NHWC by (kh, kw, c), following the weights. */
+FANG_HOT static void _fang_sconv_pack(const _fang_conv2d_t *restrict conv,
+    const float *restrict x, int p, int pb, int j, int jb, int stride,
+    float *restrict tilde)
+{
+    int cg = conv->c / conv->groups;
+
+    /* Input origin of every output pixel. */
+    int ihs[FANG_SCONV_PIXELS], iws[FANG_SCONV_PIXELS];
+    for(int i = 0; i < jb; i++) {
+        ihs[i] = (j + i) / conv->ow * conv->sh - conv->ph;
+        iws[i] = (j + i) % conv->ow * conv->sw - conv->pw;
+    }
+
+    for(int ir = 0; ir < jb; ir += stride) {
+        int irb = _FANG_MIN(stride, jb - ir);
+
+        for(int q = p; q < p + pb; q++) {
+            int c, kh, kw;
+            size_t step_h, step_w;
+            if(conv->nhwc) {
+                kh = q / (conv->kw * cg);
+                kw = q / cg % conv->kw;
+                c  = q % cg;
+                step_w = conv->c;
+                step_h = (size_t) conv->w * conv->c;
+            } else {
+                c  = q / (conv->kh * conv->kw);
+                kh = q / conv->kw % conv->kh;
+                kw = q % conv->kw;
+                step_w = 1;
+                step_h = conv->w;
+            }
+            const float *src = x + (conv->nhwc ? (size_t) c :
+                (size_t) c * conv->h * conv->w);
+            int dkh = kh * conv->dh, dkw = kw * conv->dw;
+
+            int i = 0;
+            for(; i < irb; i++) {
+                int ih = ihs[ir + i] + dkh, iw = iws[ir + i] + dkw;
+                *tilde++ = (unsigned) ih < (unsigned) conv->h &&
+                    (unsigned) iw < (unsigned) conv->w ?
+                    src[ih * step_h + iw * step_w] : 0.0f;
+            }
+
+            /* Fill remainders with 0. */
+            for(; i < stride; i++)
+                *tilde++ = 0.0f;
+        }
+    }
+}
+
+/* Task of implicit GEMM convolution, FANG_SCONV_PIXELS output pixels of an
+   image and group. */
+FANG_HOT static void _fang_sconv_task(void *restrict arg, ptrdiff_t task,
+    int wid)
+{
+    _fang_sconv_par_t *par = (_fang_sconv_par_t *) arg;
+    const _fang_conv2d_t *conv = par->conv;
+    int mr = _sgemm_mr[FANG_SGEMM_KERNEL], nr = _sgemm_nr[FANG_SGEMM_KERNEL];
+
+    int b  = (int) (task / par->ntask / conv->groups);
+    int g  = (int) (task / par->ntask % conv->groups);
+    int j  = (int) (task % par->ntask) * FANG_SCONV_PIXELS;
+    int np = conv->oh * conv->ow;
+    int jb = _FANG_MIN(FANG_SCONV_PIXELS, np - j);
+    int kg = conv->k / conv->groups, cg = conv->c / conv->groups;
+
+    float *tilde = par->tilde + wid * par->tilde_siz;
+    const float *w_packed = par->w_packed + (size_t) g * par->kpad *
+        par->kdim;
+
+    if(conv->nhwc) {
+        const float *x = par->x + (size_t) b * conv->h * conv->w * conv->c +
+            (size_t) g * cg;
+        float *dest = par->dest + ((size_t) b * np + j) * conv->k +
+            (size_t) g * kg;
+
+        for(int p = 0; p < par->kdim; p += FANG_SGEMM_KC) {
+            int pb = _FANG_MIN(FANG_SGEMM_KC, par->kdim - p);
+
+            /* Output pixels are rows of the product here. */
+            _fang_sconv_pack(conv, x, p, pb, j, jb, mr, tilde);
+            _fang_sgemm_loop2(jb, kg, pb, p == 0 ? 0.0f : 1.0f, dest,
+                conv->k, 1.0f, tilde, (float *) w_packed +
+                (size_t) par->kpad * p);
+        }
+    } else {
+        const float *x = par->x + ((size_t) b * conv->c + (size_t) g * cg) *
+            conv->h * conv->w;
+        float *dest = par->dest + ((size_t) b * conv->k + (size_t) g * kg) *
+            np + j;
+
+        for(int p = 0; p < par->kdim; p += FANG_SGEMM_KC) {
+            int pb = _FANG_MIN(FANG_SGEMM_KC, par->kdim - p);
+
+            _fang_sconv_pack(conv, x, p, pb, j, jb, nr, tilde);
+            _fang_sgemm_loop2(kg, jb, pb, p == 0 ? 0.0f : 1.0f, dest, np,
+                1.0f, (float *) w_packed + (size_t) par->kpad * p, tilde);
+        }
+    }
+}
+
+/* Range [lo, hi) of output positions of a row or column reading input
+   within [0, n) through kernel offset `off`. */
+FANG_INLINE static inline void _fang_sconv_valid(int off, int stride, int n,
+    int nout, int *restrict lo, int *restrict hi)
+{
+    *lo = off < 0 ? (-off + stride - 1) / stride : 0;
+    *hi = off + (nout - 1) * stride < n ? nout :
+        (n - 1 - off < 0 ? 0 : (n - 1 - off) / stride + 1);
+    if(*hi < *lo)
+        *hi = *lo;
+}
+
+/* Task of depthwise convolution in NCHW layout, a single output plane. */
+FANG_HOT static void _fang_sconv_dw_nchw_task(void *restrict arg,
+    ptrdiff_t task, FANG_UNUSED int wid)
+{
+    _fang_sconv_par_t *par = (_fang_sconv_par_t *) arg;
+    const _fang_conv2d_t *conv = par->conv;
+
+    int b = (int) (task / conv->k), k = (int) (task % conv->k);
+    int mult = conv->k / conv->groups;
+    const float *x = par->x + ((size_t) b * conv->c + k / mult) * conv->h *
+        conv->w;
+    const float *w = par->w + (size_t) k * conv->kh * conv->kw;
+    float *dest = par->dest + ((size_t) b * conv->k + k) * conv->oh *
+        conv->ow;
+
+    memset(dest, 0, (size_t) conv->oh * conv->ow * sizeof(float));
+
+    for(int kw = 0; kw < conv->kw; kw++) {
+        int off = kw * conv->dw - conv->pw, lo, hi;
+        _fang_sconv_valid(off, conv->sw, conv->w, conv->ow, &lo, &hi);
+
+        for(int oh = 0; oh < conv->oh; oh++) {
+            float *restrict out = dest + (size_t) oh * conv->ow;
+
+            for(int kh = 0; kh < conv->kh; kh++) {
+                int ih = oh * conv->sh - conv->ph + kh * conv->dh;
+                if((unsigned) ih >= (unsigned) conv->h)
+                    continue;
+
+                float wv = w[kh * conv->kw + kw];
+                const float *restrict in = x + (size_t) ih * conv->w;
+                if(conv->sw == 1) {
+                    for(int ow = lo; ow < hi; ow++)
+                        out[ow] += wv * in[ow + off];
+                } else {
+                    for(int ow = lo; ow < hi; ow++)
+                        out[ow] += wv * in[ow * conv->sw + off];
+                }
+            }
+        }
+    }
+}
+
+/* Task of depthwise convolution in NHWC layout, a single output row. */
+FANG_HOT static void _fang_sconv_dw_nhwc_task(void *restrict arg,
+    ptrdiff_t task, FANG_UNUSED int wid)
+{
+    _fang_sconv_par_t *par = (_fang_sconv_par_t *) arg;
+    const _fang_conv2d_t *conv = par->conv;
+
+    int b = (int) (task / conv->oh), oh = (int) (task % conv->oh);
+    int mult = conv->k / conv->groups, nk = conv->k;
+    const float *x = par->x + (size_t) b * conv->h * conv->w * conv->c;
+    float *dest = par->dest + ((size_t) b * conv->oh + oh) * conv->ow * nk;
+
+    memset(dest, 0, (size_t) conv->ow * nk * sizeof(float));
+
+    for(int kh = 0; kh < conv->kh; kh++) {
+        int ih = oh * conv->sh - conv->ph + kh * conv->dh;
+        if((unsigned) ih >= (unsigned) conv->h)
+            continue;
+
+        for(int kw = 0; kw < conv->kw; kw++) {
+            int off = kw * conv->dw - conv->pw, lo, hi;
+            _fang_sconv_valid(off, conv->sw, conv->w, conv->ow, &lo, &hi);
+
+            /* Weights are transposed to (kh, kw, k). */
+            const float *restrict wv = par->w_packed +
+                ((size_t) kh * conv->kw + kw) * nk;
+
+            for(int ow = lo; ow < hi; ow++) {
+                float *restrict out = dest + (size_t) ow * nk;
+                const float *restrict in = x + ((size_t) ih * conv->w +
+                    ow * conv->sw + off) * conv->c;
+
+                if(mult == 1) {
+                    for(int k = 0; k < nk; k++)
+                        out[k] += wv[k] * in[k];
+                } else {
+                    for(int k = 0; k < nk; k++)
+                        out[k] += wv[k] * in[k / mult];
+                }
+            }
+        }
+    }
+}
+
+/* Depthwise convolution, a single input channel per group. Weights are
+   applied straight to the input, as im2col would only copy it. */
+static int _fang_sconv2d_depthwise(_fang_pool_t *restrict pool,
+    _fang_sconv_par_t *restrict par)
+{
+    int res = FANG_OK;
+    const _fang_conv2d_t *conv = par->conv;
+
+    if(!conv->nhwc) {
+        _fang_sconv_for(pool, (ptrdiff_t) conv->n * conv->k,
+            _fang_sconv_dw_nchw_task, par);
+        goto out;
+    }
+
+    int ksiz = conv->kh * conv->kw;
+    par->w_packed = _fang_aligned_malloc((size_t) ksiz * conv->k *
+        sizeof(float), 64);
+    if(FANG_UNLIKELY(par->w_packed == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    for(int k = 0; k < conv->k; k++) {
+        for(int i = 0; i < ksiz; i++)
+            par->w_packed[(size_t) i * conv->k + k] = par->w[(size_t) k *
+                ksiz + i];
+    }
+
+    _fang_sconv_for(pool, (ptrdiff_t) conv->n * conv->oh,
+        _fang_sconv_dw_nhwc_task, par);
+    free(par->w_packed);
+
+out:
+    return res;
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Single-precision (float32) 2D convolution, overwriting `dest`. */
+/* NOTE: Convolution is lowered to GEMM of weights and the im2col matrix of
+ *   the input, whose columns are receptive fields of output pixels. The
+ *   im2col matrix is never materialized; tasks pack KCxFANG_SCONV_PIXELS
+ *   blocks of it straight from the input, in the micro-panel layout the
+ *   SGEMM micro-kernel expects, and run loop 2 of SGEMM against weights
+ *   packed once beforehand.
+ */
+int _fang_sconv2d(_fang_pool_t *restrict pool,
+    const _fang_conv2d_t *restrict conv, float *restrict dest,
+    const float *restrict x, const float *restrict w)
+{
+    int res = FANG_OK;
+
+    int mr = _sgemm_mr[FANG_SGEMM_KERNEL], nr = _sgemm_nr[FANG_SGEMM_KERNEL];
+    int cg = conv->c / conv->groups, kg = conv->k / conv->groups;
+    int np = conv->oh * conv->ow;
+
+    _fang_sconv_par_t par = {
+        .conv = conv, .dest = dest, .x = x, .w = w,
+        .kdim = cg * conv->kh * conv->kw,
+        .ntask = (np + FANG_SCONV_PIXELS - 1) / FANG_SCONV_PIXELS
+    };
+
+    /* 3x3 kernels of stride 1 over enough channels take less arithmetic as
+       Winograd transforms. */
+    if(_fang_sconv2d_winograd_fits(conv)) {
+        res = _fang_sconv2d_winograd(pool, conv, dest, x, w);
+        goto out;
+    }
+
+    if(cg == 1) {
+        res = _fang_sconv2d_depthwise(pool, &par);
+        goto out;
+    }
+
+    /* Weights are the left operand in NCHW layout, the right one in NHWC. */
+    int stride = conv->nhwc ? nr : mr;
+    par.kpad = (kg + stride - 1) / stride * stride;
+    par.w_packed = _fang_aligned_malloc((size_t) conv->groups * par.kpad *
+        par.kdim * sizeof(float), 64);
+
+    int nthreads = pool == NULL ? 1 : pool->nthreads;
+    par.tilde_siz = (size_t) FANG_SGEMM_KC * (FANG_SCONV_PIXELS + mr + nr);
+    par.tilde = _fang_aligned_malloc((size_t) nthreads * par.tilde_siz *
+        sizeof(float), 64);
+
+    if(FANG_UNLIKELY(par.w_packed == NULL || par.tilde == NULL)) {
+        res = -FANG_NOMEM;
+        goto out_free;
+    }
+
+    for(int g = 0; g < conv->groups; g++) {
+        float *w_packed = par.w_packed + (size_t) g * par.kpad * par.kdim;
+        float *w_group = (float *) w + (size_t) g * kg * par.kdim;
+
+        for(int p = 0; p < par.kdim; p += FANG_SGEMM_KC) {
+            int pb = _FANG_MIN(FANG_SGEMM_KC, par.kdim - p);
+            _fang_sgemm_pack(pb, kg, stride, w_group + p, par.kdim,
+                w_packed + (size_t) par.kpad * p, true);
+        }
+    }
+
+    _fang_sconv_for(pool, (ptrdiff_t) conv->n * conv->groups * par.ntask,
+        _fang_sconv_task, &par);
+
+out_free:
+    free(par.w_packed);
+    free(par.tilde);
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
@@ -0,0 +1,279 @@
+#include <env/cpu/conv.h>
+#include <fang/status.h>
+#include <tune.h>
+
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(FANG_USE_AVX512) || defined(FANG_USE_AVX2)
+#include <immintrin.h>
+#endif  // FANG_USE_AVX512 or FANG_USE_AVX2
+
+
+/* ================ PRIVATE HELPER MACROS ================ */
+
+#define _FANG_MIN(x, y)    ((x) < (y) ? (x) : (y))
+#define _FANG_MAX(x, y)    ((x) > (y) ? (x) : (y))
+
+/* Defines `_fang_spool_span_<name>()`, folding `n` elements of `x` into
+   `acc`. */
+#if defined(FANG_USE_AVX512)
+#define _FANG_SPOOL_SPAN(name, op512, op256, op)                                \
+    FANG_HOT FANG_INLINE static inline void _fang_spool_span_##name(            \
+        float *restrict acc, const float *restrict x, int n)                    \
+    {                                                                           \
+        int i = 0;                                                              \
+        for(; i + 16 <= n; i += 16)                                             \
+            _mm512_storeu_ps(acc + i, op512(_mm512_loadu_ps(acc + i),           \
+                _mm512_loadu_ps(x + i)));                                       \
+        for(; i + 8 <= n; i += 8)                                               \
+            _mm256_storeu_ps(acc + i, op256(_mm256_loadu_ps(acc + i),           \
+                _mm256_loadu_ps(x + i)));                                       \
+        for(; i < n; i++)                                                       \
+            acc[i] = op(acc[i], x[i]);                                          \
+    }
+#elif defined(FANG_USE_AVX2)
+#define _FANG_SPOOL_SPAN(name, op512, op256, op)                                \
+    FANG_HOT FANG_INLINE static inline void _fang_spool_span_##name(            \
+        float *restrict acc, const float *restrict x, int n)                    \
+    {                                                                           \
+        int i = 0;                                                              \
+        for(; i + 8 <= n; i += 8)                                               \
+            _mm256_storeu_ps(acc + i, op256(_mm256_loadu_ps(acc + i),           \
+                _mm256_loadu_ps(x + i)));                                       \
+        for(; i < n; i++)                                                       \
+            acc[i] = op(acc[i], x[i]);                                          \
+    }
+#else
+#define _FANG_SPOOL_SPAN(name, op512, op256, op)                                \
+    FANG_HOT FANG_INLINE static inline void _fang_spool_span_##name(            \
+        float *restrict acc, const float *restrict x, int n)                    \
+    {                                                                           \
+        for(int i = 0; i < n; i++)                                              \
+            acc[i] = op(acc[i], x[i]);                                          \
+    }
+#endif  // FANG_USE_AVX512, FANG_USE_AVX2
+
+/* Scalar reductions of pooling. */
+#define _fang_spool_max(a, b)    ((b) > (a) ? (b) : (a))
+#define _fang_spool_sum(a, b)    ((a) + (b))
+
+/* ================ PRIVATE HELPER MACROS END ================ */
+
+
+/* ================ PRIVATE DATA STRUCTURES ================ */
+
+/* Shared state of pooling tasks. */
+typedef struct _fang_spool_par {
+    const _fang_conv2d_t *conv;
+    float *dest;
+    const float *x;
+    bool max;
+
+    /* Channel blocks of an output row in NHWC layout. */
+    int ncblk;
+} _fang_spool_par_t;
+
+/* ================ PRIVATE DATA STRUCTURES END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+_FANG_SPOOL_SPAN(max, _mm512_max_ps, _mm256_max_ps, _fang_spool_max)
+_FANG_SPOOL_SPAN(sum, _mm512_add_ps, _mm256_add_ps, _fang_spool_sum)
+
+/* Folds `n` elements of `x` into `acc`, by max or sum. */
+FANG_HOT FANG_INLINE static inline void _fang_spool_span(bool max,
+    float *restrict acc, const float *restrict x, int n)
+{
+    if(max)
+        _fang_spool_span_max(acc, x, n);
+    else
+        _fang_spool_span_sum(acc, x, n);
+}
+
+/* Reduces `n` contiguous elements, by max or sum. `n` is at least 1. */
+FANG_HOT static float _fang_spool_reduce(bool max, const float *restrict x,
+    int n)
+{
+    float res = x[0];
+    int i = 1;
+
+    /* Lanes are folded into a vector of partial results first. */
+    if(n >= 16) {
+        float part[16];
+        memcpy(part, x, sizeof(part));
+        for(i = 16; i + 16 <= n; i += 16)
+            _fang_spool_span(max, part, x + i, 16);
+
+        res = part[0];
+        for(int j = 1; j < 16; j++)
+            res = max ? _fang_spool_max(res, part[j]) : res + part[j];
+    }
+
+    for(; i < n; i++)
+        res = max ? _fang_spool_max(res, x[i]) : res + x[i];
+    return res;
+}
+
+/* Rows [lo, hi) of input a window starting at `start` of length `len` covers,
+   out of `size` rows. */
+FANG_INLINE static inline void _fang_spool_clip(int start, int len, int size,
+    int *restrict lo, int *restrict hi)
+{
+    *lo = _FANG_MAX(start, 0);
+    *hi = _FANG_MIN(start + len, size);
+}
+
+/* Pools a single (image, channel) plane in NCHW layout. */
+FANG_HOT static void _fang_spool_nchw_task(void *restrict arg, ptrdiff_t task,
+    FANG_UNUSED int wid)
+{
+    _fang_spool_par_t *par = (_fang_spool_par_t *) arg;
+    const _fang_conv2d_t *conv = par->conv;
+    bool max = par->max;
+
+    const float *x = par->x + task * conv->h * conv->w;
+    float *dest = par->dest + task * conv->oh * conv->ow;
+
+    /* Global pooling reduces the contiguous plane. */
+    if(conv->oh == 1 && conv->ow == 1 && conv->kh == conv->h &&
+        conv->kw == conv->w)
+    {
+        dest[0] = _fang_spool_reduce(max, x, conv->h * conv->w);
+        if(!max)
+            dest[0] /= (float) (conv->h * conv->w);
+        return;
+    }
+
+    for(int oy = 0; oy < conv->oh; oy++) {
+        float *row = dest + oy * conv->ow;
+        int ylo, yhi;
+        _fang_spool_clip(oy * conv->sh - conv->ph, conv->kh, conv->h, &ylo,
+            &yhi);
+
+        for(int ox = 0; ox < conv->ow; ox++)
+            row[ox] = max ? -INFINITY : 0.0f;
+
+        /* Every column of the window is a run of output pixels reading
+           input columns `sw` apart, contiguous when `sw` is 1. */
+        for(int y = ylo; y < yhi; y++) {
+            const float *xr = x + y * conv->w;
+            for(int j = 0; j < conv->kw; j++) {
+                int off = j - conv->pw;
+                if(conv->w - 1 - off < 0)
+                    break;
+
+                int lo = off < 0 ? (-off + conv->sw - 1) / conv->sw : 0;
+                int hi = _FANG_MIN(conv->ow, (conv->w - 1 - off) / conv->sw +
+                    1);
+                if(conv->sw == 1) {
+                    if(hi > lo)
+                        _fang_spool_span(max, row + lo, xr + lo + off, hi - lo);
+                    continue;
+                }
+
+                for(int ox = lo; ox < hi; ox++) {
+                    float v = xr[ox * conv->sw + off];
+                    row[ox] = max ? _fang_spool_max(row[ox], v) : row[ox] + v;
+                }
+            }
+        }
+
+        if(max)
+            continue;
+        for(int ox = 0; ox < conv->ow; ox++) {
+            int xlo, xhi;
+            _fang_spool_clip(ox * conv->sw - conv->pw, conv->kw, conv->w, &xlo,
+                &xhi);
+            row[ox] /= (float) ((yhi - ylo) * (xhi - xlo));
+        }
+    }
+}
+
+/* Pools a block of channels of a single output row in NHWC layout. */
+FANG_HOT static void _fang_spool_nhwc_task(void *restrict arg, ptrdiff_t task,
+    FANG_UNUSED int wid)
+{
+    _fang_spool_par_t *par = (_fang_spool_par_t *) arg;
+    const _fang_conv2d_t *conv = par->conv;
+    bool max = par->max;
+
+    int cb = (int) (task % par->ncblk);
+    int oy = (int) (task / par->ncblk % conv->oh);
+    int b  = (int) (task / par->ncblk / conv->oh);
+    int c0 = cb * FANG_SPOOL_CHANNELS;
+    int cn = _FANG_MIN(FANG_SPOOL_CHANNELS, conv->c - c0);
+
+    const float *x = par->x + (size_t) b * conv->h * conv->w * conv->c + c0;
+    float *dest = par->dest + ((size_t) b * conv->oh + oy) * conv->ow *
+        conv->c + c0;
+
+    int ylo, yhi;
+    _fang_spool_clip(oy * conv->sh - conv->ph, conv->kh, conv->h, &ylo, &yhi);
+
+    /* Channels are contiguous, every input pixel of the window is folded in
+       as a vector. */
+    for(int ox = 0; ox < conv->ow; ox++) {
+        float *acc = dest + (size_t) ox * conv->c;
+        int xlo, xhi;
+        _fang_spool_clip(ox * conv->sw - conv->pw, conv->kw, conv->w, &xlo,
+            &xhi);
+
+        const float *first = x + ((size_t) ylo * conv->w + xlo) * conv->c;
+        for(int i = 0; i < cn; i++)
+            acc[i] = first[i];
+
+        for(int y = ylo; y < yhi; y++) {
+            for(int z = y == ylo ? xlo + 1 : xlo; z < xhi; z++)
+                _fang_spool_span(max, acc, x + ((size_t) y * conv->w + z) *
+                    conv->c, cn);
+        }
+
+        if(max)
+            continue;
+        float scale = 1.0f / (float) ((yhi - ylo) * (xhi - xlo));
+        for(int i = 0; i < cn; i++)
+            acc[i] *= scale;
+    }
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Single-precision 2D max or average pooling. */
+/* NOTE: In NCHW layout, tasks pool whole planes; every column of the window
+ *   folds a contiguous run of input into a run of output, vectorized across
+ *   output pixels when stride of width is 1. In NHWC layout, tasks pool
+ *   blocks of FANG_SPOOL_CHANNELS channels of an output row, vectorized
+ *   across channels.
+ */
+int _fang_spool2d(_fang_pool_t *restrict pool,
+    const _fang_conv2d_t *restrict conv, bool max, float *restrict dest,
+    const float *restrict x)
+{
+    _fang_spool_par_t par = {
+        .conv = conv, .dest = dest, .x = x, .max = max,
+        .ncblk = (conv->c + FANG_SPOOL_CHANNELS - 1) / FANG_SPOOL_CHANNELS
+    };
+
+    _fang_pool_fn fn = _fang_spool_nchw_task;
+    ptrdiff_t ntask = (ptrdiff_t) conv->n * conv->c;
+    if(conv->nhwc) {
+        fn = _fang_spool_nhwc_task;
+        ntask = (ptrdiff_t) conv->n * conv->oh * par.ncblk;
+    }
+
+    if(pool == NULL) {
+        for(ptrdiff_t t = 0; t < ntask; t++)
+            fn(&par, t, 0);
+    } else
+        _fang_pool_for(pool, ntask, fn, &par);
+
+    return FANG_OK;
+}
+
+/* ================ DEFINITIONS END ================ */
@@ -0,0 +1,320 @@
+#include <env/cpu/conv.h>
+#include <env/cpu/gemm.h>
+#include <platform/memory.h>
+#include <fang/status.h>
+#include <tune.h>
+
+#include <string.h>
+#include <stdint.h>
+
+
+/* ================ PRIVATE HELPER MACROS ================ */
+
+/* Output tile, input tile and kernel sizes of F(4x4, 3x3). */
+#define _WINO_M    4
+#define _WINO_T    6
+#define _WINO_R    3
+
+/* Positions of a transformed tile, each making a GEMM of it's own. */
+#define _WINO_NPOS    (_WINO_T * _WINO_T)
+
+/* ================ PRIVATE HELPER MACROS END ================ */
+
+
+/* ================ PRIVATE DATA STRUCTURES ================ */
+
+/* Shared state of Winograd convolution tasks. */
+/* NOTE: For every position `e` of a transformed tile, transformed weights
+ *   U[e] are (k, c), transformed input tiles V[e] are (c, tiles) and their
+ *   product M[e] is (k, tiles), all row-major.
+ */
+typedef struct _fang_wino_par {
+    const _fang_conv2d_t *conv;
+    float *dest;
+    const float *x;
+    const float *w;
+
+    float *u;
+    float *v;
+    float *m;
+
+    /* Tiles along height and width of an image, first tile of current block
+       and tiles in it. */
+    int th, tw;
+    int t0, nt;
+} _fang_wino_par_t;
+
+/* ================ PRIVATE DATA STRUCTURES END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Runs `fn` for every task in [0, ntask), on `pool` if not NULL. */
+static void _fang_wino_for(_fang_pool_t *restrict pool, ptrdiff_t ntask,
+    _fang_pool_fn fn, void *arg)
+{
+    if(pool == NULL) {
+        for(ptrdiff_t t = 0; t < ntask; t++)
+            fn(arg, t, 0);
+    } else
+        _fang_pool_for(pool, ntask, fn, arg);
+}
+
+/* Kernel transform G g of a column, G being:
+ *     [  1/4,     0,    0 ]
+ *     [ -1/6,  -1/6, -1/6 ]
+ *     [ -1/6,   1/6, -1/6 ]
+ *     [ 1/24,  1/12,  1/6 ]
+ *     [ 1/24, -1/12,  1/6 ]
+ *     [    0,     0,    1 ]
+ */
+FANG_INLINE static inline void _fang_wino_g(const float *restrict g, int sg,
+    float *restrict out, int so)
+{
+    float g0 = g[0], g1 = g[sg], g2 = g[2 * sg];
+
+    out[0]      = g0 / 4;
+    out[so]     = -(g0 + g1 + g2) / 6;
+    out[2 * so] = -(g0 - g1 + g2) / 6;
+    out[3 * so] = g0 / 24 + g1 / 12 + g2 / 6;
+    out[4 * so] = g0 / 24 - g1 / 12 + g2 / 6;
+    out[5 * so] = g2;
+}
+
+/* Input transform B^T d of a column, B^T being:
+ *     [ 4,  0, -5,  0, 1, 0 ]
+ *     [ 0, -4, -4,  1, 1, 0 ]
+ *     [ 0,  4, -4, -1, 1, 0 ]
+ *     [ 0, -2, -1,  2, 1, 0 ]
+ *     [ 0,  2, -1, -2, 1, 0 ]
+ *     [ 0,  4,  0, -5, 0, 1 ]
+ */
+FANG_INLINE static inline void _fang_wino_b(const float *restrict d, int sd,
+    float *restrict out, int so)
+{
+    float d0 = d[0], d1 = d[sd], d2 = d[2 * sd], d3 = d[3 * sd];
+    float d4 = d[4 * sd], d5 = d[5 * sd];
+
+    out[0]      = 4 * d0 - 5 * d2 + d4;
+    out[so]     = -4 * (d1 + d2) + d3 + d4;
+    out[2 * so] = 4 * (d1 - d2) - d3 + d4;
+    out[3 * so] = 2 * (d3 - d1) - d2 + d4;
+    out[4 * so] = 2 * (d1 - d3) - d2 + d4;
+    out[5 * so] = 4 * d1 - 5 * d3 + d5;
+}
+
+/* Output transform A^T m of a column, A^T being:
+ *     [ 1, 1,  1, 1,  1, 0 ]
+ *     [ 0, 1, -1, 2, -2, 0 ]
+ *     [ 0, 1,  1, 4,  4, 0 ]
+ *     [ 0, 1, -1, 8, -8, 1 ]
+ */
+FANG_INLINE static inline void _fang_wino_a(const float *restrict m, int sm,
+    float *restrict out, int so)
+{
+    float m0 = m[0], m1 = m[sm], m2 = m[2 * sm], m3 = m[3 * sm];
+    float m4 = m[4 * sm], m5 = m[5 * sm];
+    float a = m1 + m2, b = m1 - m2, c = m3 + m4, d = m3 - m4;
+
+    out[0]      = m0 + a + c;
+    out[so]     = b + 2 * d;
+    out[2 * so] = a + 4 * c;
+    out[3 * so] = b + 8 * d + m5;
+}
+
+/* Transforms weights of an output channel, U = G g G^T. */
+FANG_HOT static void _fang_wino_weight_task(void *restrict arg, ptrdiff_t task,
+    FANG_UNUSED int wid)
+{
+    _fang_wino_par_t *par = (_fang_wino_par_t *) arg;
+    const _fang_conv2d_t *conv = par->conv;
+    int k = (int) task;
+    size_t plane = (size_t) conv->k * conv->c;
+
+    for(int c = 0; c < conv->c; c++) {
+        /* Kernel element (i, j) and stride between rows and columns. */
+        const float *g;
+        int si, sj;
+        if(conv->nhwc) {
+            g  = par->w + (size_t) k * 9 * conv->c + c;
+            sj = conv->c;
+            si = 3 * conv->c;
+        } else {
+            g  = par->w + ((size_t) k * conv->c + c) * 9;
+            sj = 1;
+            si = 3;
+        }
+
+        float t[_WINO_T][_WINO_R], u[_WINO_T][_WINO_T];
+        for(int j = 0; j < _WINO_R; j++)
+            _fang_wino_g(g + j * sj, si, &t[0][j], _WINO_R);
+        for(int i = 0; i < _WINO_T; i++)
+            _fang_wino_g(t[i], 1, u[i], 1);
+
+        float *out = par->u + (size_t) k * conv->c + c;
+        for(int e = 0; e < _WINO_NPOS; e++)
+            out[e * plane] = u[e / _WINO_T][e % _WINO_T];
+    }
+}
+
+/* Transforms input tiles, V = B^T d B, of a single tile of current block. */
+FANG_HOT static void _fang_wino_input_task(void *restrict arg, ptrdiff_t task,
+    FANG_UNUSED int wid)
+{
+    _fang_wino_par_t *par = (_fang_wino_par_t *) arg;
+    const _fang_conv2d_t *conv = par->conv;
+
+    int t  = par->t0 + (int) task;
+    int b  = t / (par->th * par->tw);
+    int ih = t / par->tw % par->th * _WINO_M - conv->ph;
+    int iw = t % par->tw * _WINO_M - conv->pw;
+    size_t plane = (size_t) conv->c * par->nt;
+
+    const float *x = par->x + (size_t) b * conv->c * conv->h * conv->w;
+    size_t sc = conv->nhwc ? 1 : (size_t) conv->h * conv->w;
+    size_t sw = conv->nhwc ? (size_t) conv->c : 1;
+    size_t sh = sw * conv->w;
+
+    for(int c = 0; c < conv->c; c++) {
+        /* Gather the tile, zero outside of the input. */
+        float d[_WINO_T][_WINO_T];
+        for(int i = 0; i < _WINO_T; i++) {
+            for(int j = 0; j < _WINO_T; j++) {
+                int y = ih + i, z = iw + j;
+                d[i][j] = (unsigned) y < (unsigned) conv->h &&
+                    (unsigned) z < (unsigned) conv->w ?
+                    x[c * sc + y * sh + z * sw] : 0.0f;
+            }
+        }
+
+        float s[_WINO_T][_WINO_T], v[_WINO_T][_WINO_T];
+        for(int j = 0; j < _WINO_T; j++)
+            _fang_wino_b(&d[0][j], _WINO_T, &s[0][j], _WINO_T);
+        for(int i = 0; i < _WINO_T; i++)
+            _fang_wino_b(s[i], 1, v[i], 1);
+
+        float *out = par->v + (size_t) c * par->nt + task;
+        for(int e = 0; e < _WINO_NPOS; e++)
+            out[e * plane] = v[e / _WINO_T][e % _WINO_T];
+    }
+}
+
+/* Multiplies transformed weights and tiles of a single position. */
+FANG_HOT static void _fang_wino_gemm_task(void *restrict arg, ptrdiff_t task,
+    FANG_UNUSED int wid)
+{
+    _fang_wino_par_t *par = (_fang_wino_par_t *) arg;
+    const _fang_conv2d_t *conv = par->conv;
+    int nt = par->nt;
+
+    _fang_sgemm(NULL, false, false, conv->k, nt, conv->c, 0.0f,
+        par->m + task * conv->k * nt, nt, 1.0f,
+        par->u + task * conv->k * conv->c, conv->c,
+        par->v + task * conv->c * nt, nt);
+}
+
+/* Transforms products back to output, Y = A^T M A, of a single tile of
+   current block. */
+FANG_HOT static void _fang_wino_output_task(void *restrict arg, ptrdiff_t task,
+    FANG_UNUSED int wid)
+{
+    _fang_wino_par_t *par = (_fang_wino_par_t *) arg;
+    const _fang_conv2d_t *conv = par->conv;
+
+    int t  = par->t0 + (int) task;
+    int b  = t / (par->th * par->tw);
+    int oh = t / par->tw % par->th * _WINO_M;
+    int ow = t % par->tw * _WINO_M;
+    int mh = _FANG_MIN(_WINO_M, conv->oh - oh);
+    int mw = _FANG_MIN(_WINO_M, conv->ow - ow);
+    size_t plane = (size_t) conv->k * par->nt;
+
+    float *dest = par->dest + (size_t) b * conv->k * conv->oh * conv->ow;
+    size_t sk = conv->nhwc ? 1 : (size_t) conv->oh * conv->ow;
+    size_t sw = conv->nhwc ? (size_t) conv->k : 1;
+    size_t sh = sw * conv->ow;
+
+    for(int k = 0; k < conv->k; k++) {
+        const float *in = par->m + (size_t) k * par->nt + task;
+        float m[_WINO_T][_WINO_T];
+        for(int e = 0; e < _WINO_NPOS; e++)
+            m[e / _WINO_T][e % _WINO_T] = in[e * plane];
+
+        float s[_WINO_M][_WINO_T], y[_WINO_M][_WINO_M];
+        for(int j = 0; j < _WINO_T; j++)
+            _fang_wino_a(&m[0][j], _WINO_T, &s[0][j], _WINO_T);
+        for(int i = 0; i < _WINO_M; i++)
+            _fang_wino_a(s[i], 1, y[i], 1);
+
+        /* Edge tiles are cut to the output. */
+        for(int i = 0; i < mh; i++) {
+            for(int j = 0; j < mw; j++)
+                dest[k * sk + (oh + i) * sh + (ow + j) * sw] = y[i][j];
+        }
+    }
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Whether a convolution is run by Winograd F(4x4, 3x3). */
+bool _fang_sconv2d_winograd_fits(const _fang_conv2d_t *restrict conv) {
+    return conv->kh == _WINO_R && conv->kw == _WINO_R && conv->sh == 1 &&
+        conv->sw == 1 && conv->dh == 1 && conv->dw == 1 &&
+        conv->groups == 1 && conv->c >= FANG_SCONV_WINO_MINCH &&
+        conv->k >= FANG_SCONV_WINO_MINCH;
+}
+
+/* Single-precision 3x3 convolution of stride 1 by Winograd F(4x4, 3x3). */
+/* NOTE: Every 4x4 output tile is computed from a 6x6 input tile with 36
+ *   multiplications per input channel instead of 144. Weights and input tiles
+ *   are transformed, multiplied element-wise and summed over input channels,
+ *   which for every one of 36 positions of a transformed tile is a GEMM of
+ *   transformed weights and tiles, run by SGEMM. Tiles are processed in
+ *   blocks of FANG_SCONV_WINO_TILES, across images of the batch.
+ */
+int _fang_sconv2d_winograd(_fang_pool_t *restrict pool,
+    const _fang_conv2d_t *restrict conv, float *restrict dest,
+    const float *restrict x, const float *restrict w)
+{
+    int res = FANG_OK;
+
+    _fang_wino_par_t par = {
+        .conv = conv, .dest = dest, .x = x, .w = w,
+        .th = (conv->oh + _WINO_M - 1) / _WINO_M,
+        .tw = (conv->ow + _WINO_M - 1) / _WINO_M
+    };
+    int ntiles = conv->n * par.th * par.tw;
+    int nblk = _FANG_MIN(FANG_SCONV_WINO_TILES, ntiles);
+
+    par.u = _fang_aligned_malloc((size_t) _WINO_NPOS * conv->k * conv->c *
+        sizeof(float), 64);
+    par.v = _fang_aligned_malloc((size_t) _WINO_NPOS * conv->c * nblk *
+        sizeof(float), 64);
+    par.m = _fang_aligned_malloc((size_t) _WINO_NPOS * conv->k * nblk *
+        sizeof(float), 64);
+    if(FANG_UNLIKELY(par.u == NULL || par.v == NULL || par.m == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+
+    _fang_wino_for(pool, conv->k, _fang_wino_weight_task, &par);
+
+    for(par.t0 = 0; par.t0 < ntiles; par.t0 += nblk) {
+        par.nt = _FANG_MIN(nblk, ntiles - par.t0);
+
+        _fang_wino_for(pool, par.nt, _fang_wino_input_task, &par);
+        _fang_wino_for(pool, _WINO_NPOS, _fang_wino_gemm_task, &par);
+        _fang_wino_for(pool, par.nt, _fang_wino_output_task, &par);
+    }
+
+out:
+    free(par.u);
+    free(par.v);
+    free(par.m);
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
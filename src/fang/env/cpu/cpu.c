@@ -1,14 +1,21 @@
-#include <fang/util/buffer.h>
 #include <fang/status.h>
 #include <fang/tensor.h>
+#include <fang/optim.h>
+#include <fang/kvcache.h>
 #include <env/cpu/float.h>
+#include <env/cpu/conv.h>
+#include <env/cpu/attn.h>
 #include <env/cpu/gemm.h>
+#include <env/cpu/random.h>
+#include <env/stream.h>
 #include <platform/env/cpu.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdalign.h>
-#include <omp.h>
+#include <stdio.h>
+#include <math.h>
+#include <tune.h>
 
 /* ================ PRIVATE DATA STRUCTURES ================ */
 
@@ -22,6 +29,9 @@ typedef struct _fang_cpu_accel_arg {
     fang_gen_t z;
     fang_gen_t alpha;
     fang_gen_t beta;
+
+    /* Threads of the Environment to run on. */
+    _fang_pool_t *pool;
 } _fang_cpu_accel_arg_t;
 
 /* Forward declaration of kernel. */
@@ -29,9 +39,13 @@ typedef void (*_fang_cpu_accel_t)(_fang_cpu_accel_arg_t *restrict arg);
 
 /* ================ PRIVATE DATA STRUCTURES END ================ */
 
+
 /* Include dense tensor operation accelerators. */
 #include "dense.c.inc"
 
+/* Include sparse tensor operation accelerators. */
+#include "sparse.c.inc"
+
 /* Dummy accelerator for padding. */
 static void _dummy_accel(FANG_UNUSED _fang_cpu_accel_arg_t *restrict arg) {}
 
@@ -45,12 +59,21 @@ FANG_HOT FANG_FLATTEN static int _fang_env_cpu_dense_ops_##operator(       \
 /* Creates and initializes dense tensor data. */
 _FANG_ENV_CPU_DENSE_OPS_DECL(create)
 
-/* Prints a dense tensor to a buffer. */
+/* Prints a dense tensor to a file. */
 _FANG_ENV_CPU_DENSE_OPS_DECL(print)
 
 /* Fills a tensor with random numbers. */
 _FANG_ENV_CPU_DENSE_OPS_DECL(rand)
 
+/* Fills a tensor with normally distributed random numbers. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(randn)
+
+/* Fills a tensor with truncated normally distributed random numbers. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(trunc_randn)
+
+/* Fills a tensor with Bernoulli distributed mask. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(bernoulli)
+
 /* Adds two tensors. */
 _FANG_ENV_CPU_DENSE_OPS_DECL(sum)
 
@@ -63,15 +86,74 @@ _FANG_ENV_CPU_DENSE_OPS_DECL(mul)
 /* Performs GEMM operation between two tensors (this sounds so cool!). */
 _FANG_ENV_CPU_DENSE_OPS_DECL(gemm)
 
+/* Performs 2D convolution of images with weights. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(conv2d)
+
+/* Performs 2D pooling of images. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(pool2d)
+
+/* Normalizes rows of a tensor. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(norm)
+
+/* Computes gradients of normalization. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(norm_backward)
+
+/* Applies batch normalization of inference. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(batchnorm)
+
+/* Folds batch normalization into weights and bias of a layer. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(batchnorm_fold)
+
+/* Performs scaled dot-product attention. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(attention)
+
+/* Appends keys and values to a KV cache. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(kvcache_append)
+
+/* Performs attention of queries over a KV cache. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(kvcache_attention)
+
+/* Gathers rows of a tensor by indices. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(gather)
+
+/* Adds rows of a tensor into rows picked by indices. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(scatter_add)
+
 /* Scales a tensor. */
 _FANG_ENV_CPU_DENSE_OPS_DECL(scale)
 
 /* Fills a tensor with value. */
 _FANG_ENV_CPU_DENSE_OPS_DECL(fill)
 
+/* Takes a step of an optimizer. */
+_FANG_ENV_CPU_DENSE_OPS_DECL(optim)
+
 /* Releases a dense tensor. */
 _FANG_ENV_CPU_DENSE_OPS_DECL(release)
 
+/* CPU sparse operation declarations. */
+#define _FANG_ENV_CPU_SPARSE_OPS_DECL(operator)                            \
+FANG_HOT FANG_FLATTEN static int _fang_env_cpu_sparse_ops_##operator(      \
+    fang_ten_ops_arg_t *restrict arg);
+
+/* Creates sparse tensor data in COO encoding. */
+_FANG_ENV_CPU_SPARSE_OPS_DECL(create)
+
+/* Prints elements of a sparse tensor to a file. */
+_FANG_ENV_CPU_SPARSE_OPS_DECL(print)
+
+/* Multiplies a sparse matrix with a dense matrix. */
+_FANG_ENV_CPU_SPARSE_OPS_DECL(gemm)
+
+/* Scatters a sparse tensor into a dense tensor. */
+_FANG_ENV_CPU_SPARSE_OPS_DECL(densify)
+
+/* Converts a COO sparse matrix into a compressed encoding. */
+_FANG_ENV_CPU_SPARSE_OPS_DECL(convert)
+
+/* Releases a sparse tensor. */
+_FANG_ENV_CPU_SPARSE_OPS_DECL(release)
+
 /* ================ FORWARD DECLARATIONS END ================ */
 
 
@@ -82,31 +164,75 @@ static fang_ten_ops_t _dense = {
     .create = _fang_env_cpu_dense_ops_create,
     .print = _fang_env_cpu_dense_ops_print,
     .rand = _fang_env_cpu_dense_ops_rand,
+    .randn = _fang_env_cpu_dense_ops_randn,
+    .trunc_randn = _fang_env_cpu_dense_ops_trunc_randn,
+    .bernoulli = _fang_env_cpu_dense_ops_bernoulli,
     .sum = _fang_env_cpu_dense_ops_sum,
     .diff = _fang_env_cpu_dense_ops_diff,
     .mul = _fang_env_cpu_dense_ops_mul,
     .gemm = _fang_env_cpu_dense_ops_gemm,
+    .conv2d = _fang_env_cpu_dense_ops_conv2d,
+    .pool2d = _fang_env_cpu_dense_ops_pool2d,
+    .norm = _fang_env_cpu_dense_ops_norm,
+    .norm_backward = _fang_env_cpu_dense_ops_norm_backward,
+    .batchnorm = _fang_env_cpu_dense_ops_batchnorm,
+    .batchnorm_fold = _fang_env_cpu_dense_ops_batchnorm_fold,
+    .attention = _fang_env_cpu_dense_ops_attention,
+    .kvcache_append = _fang_env_cpu_dense_ops_kvcache_append,
+    .kvcache_attention = _fang_env_cpu_dense_ops_kvcache_attention,
+    .gather = _fang_env_cpu_dense_ops_gather,
+    .scatter_add = _fang_env_cpu_dense_ops_scatter_add,
     .scale = _fang_env_cpu_dense_ops_scale,
     .fill = _fang_env_cpu_dense_ops_fill,
+    .optim = _fang_env_cpu_dense_ops_optim,
     .release = _fang_env_cpu_dense_ops_release
 };
 
+/* Sparse tensor operators. */
+static fang_ten_ops_t _sparse = {
+    .create = _fang_env_cpu_sparse_ops_create,
+    .print = _fang_env_cpu_sparse_ops_print,
+    .gemm = _fang_env_cpu_sparse_ops_gemm,
+    .densify = _fang_env_cpu_sparse_ops_densify,
+    .convert = _fang_env_cpu_sparse_ops_convert,
+    .release = _fang_env_cpu_sparse_ops_release
+};
+
 /* Tensor operators for CPU Environment. */
 static fang_env_ops_t _cpu_ops = {
     .dense  = &_dense,
-    .sparse = NULL
+    .sparse = &_sparse
 };
 
-/* Single element data size of each tensor data type. */
-/* NOTE: This array conforms to `fang_ten_dtype_t` enum, any changes made to
- *   that enum should reflect here.
- */
-static const int dsiz[] = { 1, 2, 4, 8, 1, 2, 4, 8, 1, 2, 2, 4, 8 };
-
 /* NOTE: Array order conforms to `fang_ten_dtype_t` enum. */
 _fang_cpu_accel_t _dense_rand[] = {
     _ACCEL_DENSE(rand)
 };
+_fang_cpu_accel_t _dense_randn[] = {
+    /* Fill dummy accelerators as padding. */
+    _dummy_accel, _dummy_accel, _dummy_accel, _dummy_accel,
+    _dummy_accel, _dummy_accel, _dummy_accel, _dummy_accel,
+
+    _fang_dense_accel_randnf8,
+    _fang_dense_accel_randnf16,
+    _fang_dense_accel_randnbf16,
+    _fang_dense_accel_randnf32,
+    _fang_dense_accel_randnf64
+};
+_fang_cpu_accel_t _dense_trunc_randn[] = {
+    /* Fill dummy accelerators as padding. */
+    _dummy_accel, _dummy_accel, _dummy_accel, _dummy_accel,
+    _dummy_accel, _dummy_accel, _dummy_accel, _dummy_accel,
+
+    _fang_dense_accel_trunc_randnf8,
+    _fang_dense_accel_trunc_randnf16,
+    _fang_dense_accel_trunc_randnbf16,
+    _fang_dense_accel_trunc_randnf32,
+    _fang_dense_accel_trunc_randnf64
+};
+_fang_cpu_accel_t _dense_bernoulli[] = {
+    _ACCEL_DENSE(bernoulli)
+};
 _fang_cpu_accel_t _dense_scale[] = {
     _ACCEL_DENSE(scale)
 };
@@ -131,6 +257,28 @@ _fang_cpu_accel_t _dense_gemm[] = {
     // TODO: Add more types
     _fang_dense_accel_gemmf32
 };
+_fang_cpu_accel_t _dense_norm[] = {
+    /* Fill dummy accelerators as padding. */
+    _dummy_accel, _dummy_accel, _dummy_accel, _dummy_accel,
+    _dummy_accel, _dummy_accel, _dummy_accel, _dummy_accel,
+    _dummy_accel,
+
+    _fang_dense_accel_normf16,
+    _fang_dense_accel_normbf16,
+    _fang_dense_accel_normf32,
+    _dummy_accel
+};
+_fang_cpu_accel_t _dense_norm_backward[] = {
+    /* Fill dummy accelerators as padding. */
+    _dummy_accel, _dummy_accel, _dummy_accel, _dummy_accel,
+    _dummy_accel, _dummy_accel, _dummy_accel, _dummy_accel,
+    _dummy_accel,
+
+    _fang_dense_accel_norm_backwardf16,
+    _fang_dense_accel_norm_backwardbf16,
+    _fang_dense_accel_norm_backwardf32,
+    _dummy_accel
+};
 
 /* To check difference in tensor randomizer. `_of_ma` = overflow max. Used in
    `_fang_env_cpu_dense_ops_rand`. */
@@ -149,9 +297,40 @@ static void _fang_env_cpu_release(void *restrict private,
     fang_reallocator_t realloc)
 {
     _fang_env_cpu_t *cpu_env = (_fang_env_cpu_t *) private;
+    _fang_pool_release(&cpu_env->pool);
+    FANG_RELEASE(realloc, cpu_env->procs);
     FANG_RELEASE(realloc, cpu_env);
 }
 
+/* Retrieves a CPU Environment and it's private structure. */
+static int _fang_env_cpu_retrieve(fang_env_t **restrict env,
+    _fang_env_cpu_t **restrict cpu_env, int eid)
+{
+    int res = FANG_OK;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(env, eid))))
+        goto out;
+
+    if(FANG_UNLIKELY((*env)->type != FANG_ENV_TYPE_CPU)) {
+        res = -FANG_INVENVTYP;
+        goto out;
+    }
+
+    *cpu_env = (_fang_env_cpu_t *) (*env)->private;
+
+out:
+    return res;
+}
+
+/* Thread pool of the CPU Environment a tensor belongs to. */
+FANG_HOT FANG_INLINE static inline _fang_pool_t *_fang_env_cpu_pool(
+    fang_ten_t *restrict ten)
+{
+    fang_env_t *env;
+    _fang_env_retrieve(&env, ten->eid);
+    return &((_fang_env_cpu_t *) env->private)->pool;
+}
+
 /* ================ PRIVATE DEFINITIONS END ================ */
 
 
@@ -164,174 +343,441 @@ int _fang_env_cpu_create(fang_env_private_t **restrict private,
     int res = FANG_OK;
 
     _fang_env_cpu_t *cpu_private = FANG_CREATE(realloc, _fang_env_cpu_t, 1);
-    cpu_private->private.release = _fang_env_cpu_release;
-
-    if(!FANG_ISOK(res = _fang_env_cpu_getinfo(&cpu_private->nproc)))
-    {
+    if(FANG_UNLIKELY(cpu_private == NULL)) {
+        res = -FANG_NOMEM;
         goto out;
     }
+    cpu_private->private.release = _fang_env_cpu_release;
+
+    if(!FANG_ISOK(res = _fang_env_cpu_getinfo(cpu_private, realloc)))
+        goto out_free;
 
     /* All processors are active at first. */
     cpu_private->nact = cpu_private->nproc;
 
+    if(!FANG_ISOK(res = _fang_pool_create(&cpu_private->pool,
+        cpu_private->nact, NULL, realloc)))
+    {
+        goto out_procs;
+    }
+
     *private = (fang_env_private_t *) cpu_private;
     *ops = &_cpu_ops;
 
-    omp_set_num_threads(cpu_private->nact);
+    goto out;
 
+out_procs:
+    FANG_RELEASE(realloc, cpu_private->procs);
+out_free:
+    FANG_RELEASE(realloc, cpu_private);
 out:
     return res;
 }
 
-/* ================ DEFINITIONS END ================ */
+/* Runs operators of a CPU Environment on `nthreads` threads. */
+int fang_env_cpu_set_threads(int eid, int nthreads, const int *restrict cpus)
+{
+    int res = FANG_OK;
 
+    fang_env_t *env;
+    _fang_env_cpu_t *cpu_env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_cpu_retrieve(&env, &cpu_env,
+        eid))))
+    {
+        goto out;
+    }
 
-/* ================ PRIVATE DEFINITIONS ================ */
+    if(FANG_UNLIKELY(nthreads < 1 || nthreads > cpu_env->nproc)) {
+        res = -FANG_INVPCOUNT;
+        goto out;
+    }
 
-/* Temporary buffer size. */
-#define _CBUFSIZ           128
-/* Render text to temporary character buffer. */
-#define _RENDER(f, ...)    snprintf(cbuf, _CBUFSIZ, f, __VA_ARGS__)
-/* Flush character buffer. */
-#define _FLUSH(v)          fang_buffer_concat(buff, v)
+    /* Processors should be ones the process may run on. */
+    for(int i = 0; cpus != NULL && i < nthreads; i++) {
+        int j = 0;
+        while(j < cpu_env->nproc && cpu_env->procs[j].id != cpus[i])
+            j++;
+        if(FANG_UNLIKELY(j == cpu_env->nproc)) {
+            res = -FANG_INVPCPU;
+            goto out;
+        }
+    }
 
-/* Prints an element to buffer. */
-FANG_HOT FANG_INLINE static inline void
-    _fang_print_elem_to_buff(fang_buffer_t *buff, int typ, void *data, int idx)
-{
-    char cbuf[_CBUFSIZ] = { 0 };
+    /* Pending operators may be running on the pool. */
+    if(env->stream != NULL)
+        _fang_env_stream_drain(env->stream);
 
-    switch(typ) {
-        case FANG_TEN_DTYPE_INT8:
-            _RENDER("%4hhd", ((int8_t *) data)[idx]);
-            break;
+    /* Workers refer to the pool by address, hence it's rebuilt in place. */
+    _fang_pool_release(&cpu_env->pool);
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_pool_create(&cpu_env->pool,
+        nthreads, cpus, env->realloc))))
+    {
+        /* Fall back to the calling thread alone. */
+        cpu_env->nact = 1;
+        _fang_pool_create(&cpu_env->pool, 1, NULL, env->realloc);
+        goto out;
+    }
 
-        case FANG_TEN_DTYPE_INT16:
-            _RENDER("%6hd", ((int16_t *) data)[idx]);
-            break;
+    cpu_env->nact = nthreads;
 
-        case FANG_TEN_DTYPE_INT32:
-            _RENDER("%11d", ((int32_t *) data)[idx]);
-            break;
+out:
+    return res;
+}
 
-        case FANG_TEN_DTYPE_INT64:
-            _RENDER("%11ld", ((int64_t *) data)[idx]);
-            break;
+/* Gets the topology of the machine a CPU Environment runs on. */
+int fang_env_cpu_topology(int eid, fang_env_cpu_topo_t *topo) {
+    int res = FANG_OK;
 
-        case FANG_TEN_DTYPE_UINT8:
-            _RENDER("%3hhu", ((uint8_t *) data)[idx]);
-            break;
+    fang_env_t *env;
+    _fang_env_cpu_t *cpu_env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_cpu_retrieve(&env, &cpu_env,
+        eid))))
+    {
+        goto out;
+    }
 
-        case FANG_TEN_DTYPE_UINT16:
-            _RENDER("%5hu", ((uint16_t *) data)[idx]);
-            break;
+    topo->nproc    = cpu_env->nproc;
+    topo->ncores   = cpu_env->ncores;
+    topo->nsockets = cpu_env->nsockets;
+    topo->nllcs    = cpu_env->nllcs;
 
-        case FANG_TEN_DTYPE_UINT32:
-            _RENDER("%10u", ((uint32_t *) data)[idx]);
+out:
+    return res;
+}
+
+/* Pins threads of a CPU Environment by policy. */
+int fang_env_cpu_bind(int eid, fang_env_cpu_bind_t bind, int socket) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    _fang_env_cpu_t *cpu_env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_cpu_retrieve(&env, &cpu_env,
+        eid))))
+    {
+        goto out;
+    }
+
+    switch(bind) {
+        case FANG_ENV_CPU_BIND_NONE:
+            res = fang_env_cpu_set_threads(eid, cpu_env->nproc, NULL);
+            goto out;
+
+        case FANG_ENV_CPU_BIND_SOCKET:
+            if(FANG_UNLIKELY(socket < 0 || socket >= cpu_env->nsockets)) {
+                res = -FANG_INVPCPU;
+                goto out;
+            }
             break;
 
-        case FANG_TEN_DTYPE_UINT64:
-            _RENDER("%10lu", ((uint64_t *) data)[idx]);
+        case FANG_ENV_CPU_BIND_CORES:
             break;
 
-        case FANG_TEN_DTYPE_FLOAT8: {
-            _RENDER("%10.3f",
-                _FANG_Q2S(((_fang_float8_t *) data)[idx]));
-        } break;
+        default:
+            res = -FANG_INVBIND;
+            goto out;
+    }
+
+    int *cpus = FANG_CREATE(env->realloc, int, cpu_env->nproc);
+    if(FANG_UNLIKELY(cpus == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
 
-        case FANG_TEN_DTYPE_FLOAT16: {
-            _RENDER("%11.3f",
-                _FANG_H2S(((_fang_float16_t *) data)[idx]));
-        } break;
+    /* First hardware thread of every chosen physical core. */
+    int ncpus = 0;
+    for(int i = 0; i < cpu_env->nproc; i++) {
+        _fang_env_cpu_proc_t *proc = cpu_env->procs + i;
 
-        case FANG_TEN_DTYPE_BFLOAT16: {
-            _RENDER("%11.3f",
-                _FANG_BH2S(((_fang_bfloat16_t *) data)[idx]));
-        } break;
+        if(proc->smt == 0 && (bind == FANG_ENV_CPU_BIND_CORES ||
+            proc->socket == socket))
+        {
+            cpus[ncpus++] = proc->id;
+        }
+    }
 
-        case FANG_TEN_DTYPE_FLOAT32:
-            _RENDER("%13.3f", ((float *) data)[idx]);
-            break;
+    res = fang_env_cpu_set_threads(eid, ncpus, cpus);
+    FANG_RELEASE(env->realloc, cpus);
 
-        case FANG_TEN_DTYPE_FLOAT64:
-            _RENDER("%16.4lf", ((double *) data)[idx]);
-            break;
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* ======== PRINT ======== */
+
+/* Output state of a tensor being printed. */
+typedef struct _fang_print_out {
+    /* Destination file. */
+    FILE *file;
+
+    /* Column width of every element. */
+    int width;
+
+    /* Only measure `width` without producing any output. */
+    bool measure;
+
+    /* Print only `FANG_PRINT_EDGEITEMS` at the edges of each dimension. */
+    bool summarize;
+
+    /* Characters pending in `buff`. */
+    size_t len;
+    char buff[FANG_PRINT_BUFSIZ];
+} _fang_print_out_t;
+
+/* Longest text a single element may take. */
+#define _ELEM_MAXLEN    48
 
-        default: break;
+/* Two digit lookup for integer to string conversion. */
+static const char _digits[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "74757677787980818283848586878889909192939495969798990";
+
+/* Writes pending characters to the file. */
+FANG_INLINE static inline void _fang_print_flush(_fang_print_out_t *out) {
+    fwrite(out->buff, 1, out->len, out->file);
+    out->len = 0;
+}
+
+/* Appends `n` characters to the output. */
+FANG_HOT FANG_INLINE static inline void _fang_print_put(_fang_print_out_t *out,
+    const char *restrict str, size_t n)
+{
+    if(FANG_UNLIKELY(out->len + n > FANG_PRINT_BUFSIZ))
+        _fang_print_flush(out);
+    memcpy(out->buff + out->len, str, n);
+    out->len += n;
+}
+
+/* Appends `n` copies of character `c` to the output. */
+FANG_HOT static void _fang_print_fill(_fang_print_out_t *out, char c, int n) {
+    while(n > 0) {
+        if(FANG_UNLIKELY(out->len == FANG_PRINT_BUFSIZ))
+            _fang_print_flush(out);
+
+        int room  = (int) (FANG_PRINT_BUFSIZ - out->len);
+        int chunk = n < room ? n : room;
+        memset(out->buff + out->len, c, chunk);
+        out->len += chunk;
+        n -= chunk;
     }
+}
 
-    /* Push to buffer. */
-    _FLUSH(cbuf);
+/* Converts unsigned integer to string, returns the length. */
+FANG_HOT static int _fang_print_utoa(char *restrict str, uint64_t value) {
+    char tmp[20];
+    int pos = sizeof(tmp);
+
+    /* Two digits at a time, from the least significant one. */
+    while(value >= 100) {
+        int i = (int) (value % 100) * 2;
+        value /= 100;
+        tmp[--pos] = _digits[i + 1];
+        tmp[--pos] = _digits[i];
+    }
+    if(value >= 10) {
+        tmp[--pos] = _digits[value * 2 + 1];
+        tmp[--pos] = _digits[value * 2];
+    } else
+        tmp[--pos] = (char) ('0' + value);
+
+    int len = (int) sizeof(tmp) - pos;
+    memcpy(str, tmp + pos, len);
+    return len;
 }
 
-/* Recursive solution for tensor printing. */
-FANG_HOT static void _fang_ten_print_recurse(fang_buffer_t *restrict buff,
-    fang_ten_dtype_t typ, void *restrict data, uint32_t level, uint32_t
-    *dims, uint32_t *strides, uint16_t ndims, uint32_t *restrict indicies,
-    int padding)
+/* Converts signed integer to string, returns the length. */
+FANG_HOT FANG_INLINE static inline int _fang_print_itoa(char *restrict str,
+    int64_t value)
 {
-    /* Temporary char buffer for immediate print before pushing to buffer. */
-    char cbuf[_CBUFSIZ] = { 0 };
+    if(value >= 0)
+        return _fang_print_utoa(str, (uint64_t) value);
+
+    /* Negation in unsigned domain to handle `INT64_MIN`. */
+    *str = '-';
+    return _fang_print_utoa(str + 1, (uint64_t) 0 - (uint64_t) value) + 1;
+}
+
+/* Converts floating point value to string with `prec` fractional digits,
+   returns the length. */
+FANG_HOT static int _fang_print_ftoa(char *restrict str, double value,
+    int prec)
+{
+    static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4 };
+    int len = 0;
+
+    if(FANG_UNLIKELY(value != value)) {
+        memcpy(str, "nan", 3);
+        return 3;
+    }
+    if(signbit(value)) {
+        str[len++] = '-';
+        value = -value;
+    }
+    if(FANG_UNLIKELY(value == HUGE_VAL)) {
+        memcpy(str + len, "inf", 3);
+        return len + 3;
+    }
+
+    /* Fixed-point rounding as long as it fits an integer, scientific
+       notation otherwise (rare enough not to matter). */
+    double scaled = value * pow10[prec] + 0.5;
+    if(FANG_UNLIKELY(scaled >= 9e18))
+        return len + snprintf(str + len, _ELEM_MAXLEN - len, "%.*e", prec,
+            value);
+
+    uint64_t fixed = (uint64_t) scaled;
+    uint64_t div = (uint64_t) pow10[prec];
+
+    len += _fang_print_utoa(str + len, fixed / div);
+    if(prec > 0) {
+        str[len++] = '.';
+
+        /* Fractional digits with leading zeroes. */
+        uint64_t frac = fixed % div;
+        for(int i = prec - 1; i >= 0; i--) {
+            str[len + i] = (char) ('0' + frac % 10);
+            frac /= 10;
+        }
+        len += prec;
+    }
+
+    return len;
+}
 
-    /* At the last dimension; print individual values. */
-    if(level == ndims) {
-        /* Calculate stride. */
-        uint32_t stride = 0;
-        for(uint16_t i = 0; i < level; i++)
-            stride += indicies[i] * strides[i];
+/* Converts an element to string, returns the length. */
+FANG_HOT FANG_INLINE static inline int _fang_print_elem(char *restrict str,
+    int typ, const void *restrict data, size_t idx)
+{
+    switch(typ) {
+        case FANG_TEN_DTYPE_INT8:
+            return _fang_print_itoa(str, ((int8_t *) data)[idx]);
+        case FANG_TEN_DTYPE_INT16:
+            return _fang_print_itoa(str, ((int16_t *) data)[idx]);
+        case FANG_TEN_DTYPE_INT32:
+            return _fang_print_itoa(str, ((int32_t *) data)[idx]);
+        case FANG_TEN_DTYPE_INT64:
+            return _fang_print_itoa(str, ((int64_t *) data)[idx]);
+        case FANG_TEN_DTYPE_UINT8:
+            return _fang_print_utoa(str, ((uint8_t *) data)[idx]);
+        case FANG_TEN_DTYPE_UINT16:
+            return _fang_print_utoa(str, ((uint16_t *) data)[idx]);
+        case FANG_TEN_DTYPE_UINT32:
+            return _fang_print_utoa(str, ((uint32_t *) data)[idx]);
+        case FANG_TEN_DTYPE_UINT64:
+            return _fang_print_utoa(str, ((uint64_t *) data)[idx]);
+        case FANG_TEN_DTYPE_FLOAT8:
+            return _fang_print_ftoa(str,
+                _FANG_Q2S(((_fang_float8_t *) data)[idx]), 3);
+        case FANG_TEN_DTYPE_FLOAT16:
+            return _fang_print_ftoa(str,
+                _FANG_H2S(((_fang_float16_t *) data)[idx]), 3);
+        case FANG_TEN_DTYPE_BFLOAT16:
+            return _fang_print_ftoa(str,
+                _FANG_BH2S(((_fang_bfloat16_t *) data)[idx]), 3);
+        case FANG_TEN_DTYPE_FLOAT32:
+            return _fang_print_ftoa(str, ((float *) data)[idx], 3);
+        case FANG_TEN_DTYPE_FLOAT64:
+            return _fang_print_ftoa(str, ((double *) data)[idx], 4);
+        default: return 0;
+    }
+}
 
-        _FLUSH(" ");
-        _fang_print_elem_to_buff(buff, (int) typ, data, stride);
+/* Prints an element right-aligned to column width, or only measures it. */
+FANG_HOT FANG_INLINE static inline void _fang_print_col(
+    _fang_print_out_t *out, int typ, const void *restrict data, size_t idx)
+{
+    char str[_ELEM_MAXLEN];
+    int len = _fang_print_elem(str, typ, data, idx);
 
+    if(out->measure) {
+        out->width = len > out->width ? len : out->width;
         return;
     }
 
-    /* Spacing. */
-    if(level == 0)
-        _RENDER("%*s", padding, "");
-    /* Add level count to compensate for extra brace ('[') for each level. */
-    else if(indicies[level - 1] != 0)
-        _RENDER("%*s", level + padding, "");
+    _fang_print_fill(out, ' ', out->width - len);
+    _fang_print_put(out, str, len);
+}
+
+/* Recursive solution for tensor printing. */
+FANG_HOT static void _fang_ten_print_recurse(_fang_print_out_t *out,
+    int typ, const void *restrict data, size_t offset, uint32_t level,
+    const uint32_t *dims, const uint32_t *strides, uint16_t ndims,
+    uint32_t *restrict indicies, int padding)
+{
+    const bool measure = out->measure;
+
+    /* Skip the middle of dimensions too large to be printed completely. */
+    const bool skip = out->summarize && dims[level] > 2 * FANG_PRINT_EDGEITEMS;
+
+    /* Spacing. Add level count to compensate for extra brace ('[') for each
+       level. */
+    if(!measure) {
+        if(level == 0)
+            _fang_print_fill(out, ' ', padding);
+        else if(indicies[level - 1] != 0)
+            _fang_print_fill(out, ' ', level + padding);
+        _fang_print_put(out, "[", 1);
+    }
 
-    /* Push to buffer. */
-    _FLUSH(cbuf);
-    _FLUSH("[");
+    for(indicies[level] = 0; indicies[level] < dims[level]; indicies[level]++)
+    {
+        size_t idx = offset + (size_t) indicies[level] * strides[level];
+
+        if(FANG_UNLIKELY(skip && indicies[level] == FANG_PRINT_EDGEITEMS)) {
+            indicies[level] = dims[level] - FANG_PRINT_EDGEITEMS;
+            idx = offset + (size_t) indicies[level] * strides[level];
+
+            if(measure)
+                ;
+            /* Elision within a row. */
+            else if(level + 1 == ndims)
+                _fang_print_put(out, " ...", 4);
+            /* Elision of whole sub-tensors, aligned with their braces. */
+            else {
+                _fang_print_fill(out, ' ', level + 1 + padding);
+                _fang_print_put(out, "...", 3);
+                _fang_print_fill(out, '\n', ndims - level - 1);
+            }
+        }
 
-    /* Recursively print rest of the dimensions/levels. */
-    for(indicies[level] = 0; indicies[level] < dims[level]; indicies[level]++) {
-        _fang_ten_print_recurse(buff, typ, data, level + 1, dims, strides,
-            ndims, indicies, padding);
+        /* At the last dimension; print individual values. */
+        if(level + 1 == ndims) {
+            if(!measure)
+                _fang_print_put(out, " ", 1);
+            _fang_print_col(out, typ, data, idx);
+        } else {
+            _fang_ten_print_recurse(out, typ, data, idx, level + 1, dims,
+                strides, ndims, indicies, padding);
+        }
     }
 
+    if(measure)
+        return;
+
     /* At the final dimension, printed individual values. Print an extra space
      * to make it look good. */
     if(level + 1 == ndims)
-        _FLUSH(" ");
-    _FLUSH("]");
+        _fang_print_put(out, " ", 1);
+    _fang_print_put(out, "]", 1);
 
     /* Print extra newlines if end of previous dimension. */
-    if(FANG_LIKELY(level > 0 && indicies[level - 1] + 1 != dims[level - 1])) {
-        int count = ndims - level, printed = 0;
-        while(count--)
-            printed += snprintf(cbuf + printed, _CBUFSIZ - printed, "\n");
-
-        _FLUSH(cbuf);
-    }
+    if(FANG_LIKELY(level > 0 && indicies[level - 1] + 1 != dims[level - 1]))
+        _fang_print_fill(out, '\n', ndims - level);
 }
-#undef _CBUFSIZ
-#undef _RENDER
-#undef _FLUSH
+#undef _ELEM_MAXLEN
+
+/* ======== PRINT END ======== */
 
 /* ================ PRIVATE DEFINITIONS END ================ */
 
 
 /* ================ CPU DENSE OPERATORS ================ */
 
-/* Private macro of `_fang_env_cpu_ops_create`. */
-#define _DATACPY(ltype, rtype)                                         \
-for(size_t i = 0; i < elems; i++)                                      \
-    ((ltype *) ten->data.dense)[i] = (ltype) ((rtype *) arg->y)[i];
-
 /* Creates and initializes dense tensor data. */
 int _fang_env_cpu_dense_ops_create(fang_ten_ops_arg_t *restrict arg) {
     int res = FANG_OK;
@@ -343,7 +789,7 @@ int _fang_env_cpu_dense_ops_create(fang_ten_ops_arg_t *restrict arg) {
     /* Calculate size in bytes based on tensor data type. */
     uint32_t elems = (ten->dims != NULL ? (size_t) FANG_G2U(arg->x) :
         1 /* Scalar tensor. */);
-    size_t size = elems * dsiz[(int) ten->dtyp];
+    size_t size = elems * _fang_ten_dsiz[(int) ten->dtyp];
 
     /* Allocate memory to store tensor data. */
     ten->data.dense = FANG_CREATE(env->realloc, char, size);
@@ -353,100 +799,65 @@ int _fang_env_cpu_dense_ops_create(fang_ten_ops_arg_t *restrict arg) {
         goto out;
     }
 
-    /* Fill out the data. */
-    if(FANG_LIKELY(arg->y == NULL)) {
+    /* Fill out the data. Input data is in `alpha` data type, which is the
+       tensor's own data type when no conversion is needed. */
+    if(FANG_LIKELY(arg->y == NULL))
         memset(ten->data.dense, 0, size);
-    } else {
-        switch(ten->dtyp) {
-            case FANG_TEN_DTYPE_INT8: {
-                _DATACPY(int8_t, fang_int_t);
-            } break;
-
-            case FANG_TEN_DTYPE_INT16: {
-                _DATACPY(int16_t, fang_int_t);
-            } break;
-
-            case FANG_TEN_DTYPE_INT32: {
-                _DATACPY(int32_t, fang_int_t);
-            } break;
-
-            case FANG_TEN_DTYPE_INT64: {
-                _DATACPY(int64_t, fang_int_t);
-            } break;
-
-            case FANG_TEN_DTYPE_UINT8: {
-                _DATACPY(uint8_t, fang_uint_t);
-            } break;
-
-            case FANG_TEN_DTYPE_UINT16: {
-                _DATACPY(uint16_t, fang_uint_t);
-            } break;
-
-            case FANG_TEN_DTYPE_UINT32: {
-                _DATACPY(uint32_t, fang_uint_t);
-            } break;
-
-            case FANG_TEN_DTYPE_UINT64: {
-                _DATACPY(uint64_t, fang_uint_t);
-            } break;
-
-            case FANG_TEN_DTYPE_FLOAT8: {
-                for(size_t i = 0; i < elems; i++) {
-                    ((_fang_float8_t *) ten->data.dense)[i] =
-                        _FANG_S2Q((float) ((fang_float_t *) arg->y)[i]);
-                }
-            } break;
-
-            case FANG_TEN_DTYPE_FLOAT16: {
-                for(size_t i = 0; i < elems; i++) {
-                    ((_fang_float16_t *) ten->data.dense)[i] =
-                        _FANG_S2H((float) ((fang_float_t *) arg->y)[i]);
-                }
-            } break;
-
-            case FANG_TEN_DTYPE_BFLOAT16: {
-                for(size_t i = 0; i < elems; i++) {
-                    ((_fang_bfloat16_t *) ten->data.dense)[i] =
-                        _FANG_S2BH((float) ((fang_float_t *) arg->y)[i]);
-                }
-            } break;
-
-            case FANG_TEN_DTYPE_FLOAT32: {
-                _DATACPY(float, fang_float_t);
-            } break;
-
-            case FANG_TEN_DTYPE_FLOAT64: {
-                _DATACPY(double, fang_float_t);
-            } break;
-
-            default: break;
-        }
+    else {
+        _fang_dense_cast(ten->data.dense, (int) ten->dtyp, arg->y,
+            (int) FANG_G2I(arg->alpha), elems);
     }
 
 out:
     return res;
 }
 
-/* Prints a dense tensor to a buffer. */
+/* Prints a dense tensor to a file. */
 int _fang_env_cpu_dense_ops_print(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
     fang_ten_t *ten = (fang_ten_t *) arg->dest;
     int padding = (int) FANG_G2I(arg->x);
-    fang_buffer_t *buff = (fang_buffer_t *) arg->y;
+    fang_env_t *env = (fang_env_t *) arg->z;
+
+    /* Output is staged in a single buffer and written in large chunks. */
+    _fang_print_out_t *out = FANG_CREATE(env->realloc, _fang_print_out_t, 1);
+    if(FANG_UNLIKELY(out == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    out->file = (FILE *) arg->y;
+    out->len  = 0;
 
     if(FANG_LIKELY(ten->dims != NULL)) {
         /* Progress indicies. */
         uint32_t indicies[ten->ndims];
 
-        _fang_ten_print_recurse(buff, ten->dtyp, ten->data.dense, 0, ten->dims,
-            ten->strides, ten->ndims, indicies, padding);
-    } else  // Handle scalar tensor
-        _fang_print_elem_to_buff(buff, (int) ten->dtyp, ten->data.dense, 0);
+        out->summarize = (size_t) ten->dims[0] * ten->strides[0] >
+            FANG_PRINT_THRESHOLD;
+
+        /* First pass finds the widest element to align columns with. */
+        out->width   = 0;
+        out->measure = true;
+        _fang_ten_print_recurse(out, (int) ten->dtyp, ten->data.dense, 0, 0,
+            ten->dims, ten->strides, ten->ndims, indicies, padding);
+
+        out->measure = false;
+        _fang_ten_print_recurse(out, (int) ten->dtyp, ten->data.dense, 0, 0,
+            ten->dims, ten->strides, ten->ndims, indicies, padding);
+    } else {  // Handle scalar tensor
+        out->width   = 0;
+        out->measure = false;
+        _fang_print_col(out, (int) ten->dtyp, ten->data.dense, 0);
+    }
 
-    /* Push termination character. */
-    char term = '\0';
-    fang_buffer_add(buff, &term);
+    _fang_print_put(out, "\n", 1);
+    _fang_print_flush(out);
 
-    return FANG_OK;
+    FANG_RELEASE(env->realloc, out);
+
+out:
+    return res;
 }
 
 /* Fills a tensor with random numbers. */
@@ -494,7 +905,8 @@ int _fang_env_cpu_dense_ops_rand(fang_ten_ops_arg_t *restrict arg) {
         .dest = (fang_gen_t) ten,
         .x = diff,
         .y = low,
-        .z = arg->z  // seed
+        .z = arg->z,  // seed
+        .pool = _fang_env_cpu_pool(ten)
     };
     _dense_rand[(int) ten->dtyp](&accel_arg);
 
@@ -502,6 +914,70 @@ out:
     return res;
 }
 
+/* Fills a tensor with normally distributed random numbers. */
+int _fang_env_cpu_dense_ops_randn(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *ten = (fang_ten_t *) arg->dest;
+    if(FANG_UNLIKELY(ten->dtyp < FANG_TEN_DTYPE_FLOAT8)) {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = (fang_gen_t) ten,
+        .x = arg->y,  // std
+        .y = arg->x,  // mean
+        .z = arg->z,  // seed
+        .pool = _fang_env_cpu_pool(ten)
+    };
+    _dense_randn[(int) ten->dtyp](&accel_arg);
+
+out:
+    return res;
+}
+
+/* Fills a tensor with truncated normally distributed random numbers. */
+int _fang_env_cpu_dense_ops_trunc_randn(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *ten = (fang_ten_t *) arg->dest;
+    if(FANG_UNLIKELY(ten->dtyp < FANG_TEN_DTYPE_FLOAT8)) {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = (fang_gen_t) ten,
+        .x = arg->y,          // std
+        .y = arg->x,          // mean
+        .z = arg->z,          // seed
+        .alpha = arg->alpha,  // low
+        .beta = arg->beta,    // high
+        .pool = _fang_env_cpu_pool(ten)
+    };
+    _dense_trunc_randn[(int) ten->dtyp](&accel_arg);
+
+out:
+    return res;
+}
+
+/* Fills a tensor with Bernoulli distributed mask. */
+int _fang_env_cpu_dense_ops_bernoulli(fang_ten_ops_arg_t *restrict arg) {
+    fang_ten_t *ten = (fang_ten_t *) arg->dest;
+
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = (fang_gen_t) ten,
+        .x = arg->x,  // p
+        .y = arg->y,  // value
+        .z = arg->z,  // seed
+        .pool = _fang_env_cpu_pool(ten)
+    };
+    _dense_bernoulli[(int) ten->dtyp](&accel_arg);
+
+    return FANG_OK;
+}
+
 /* Scales a tensor. */
 int _fang_env_cpu_dense_ops_scale(fang_ten_ops_arg_t *restrict arg) {
     int res = FANG_OK;
@@ -511,6 +987,7 @@ int _fang_env_cpu_dense_ops_scale(fang_ten_ops_arg_t *restrict arg) {
     _fang_cpu_accel_arg_t accel_arg = {
         .dest = arg->dest,
         .x = arg->x,
+        .pool = _fang_env_cpu_pool(ten)
     };
     _dense_scale[(int) ten->dtyp](&accel_arg);
 
@@ -527,6 +1004,7 @@ int _fang_env_cpu_dense_ops_fill(fang_ten_ops_arg_t *restrict arg) {
     _fang_cpu_accel_arg_t accel_arg = {
         .dest = arg->dest,
         .x = arg->x,
+        .pool = _fang_env_cpu_pool(ten)
     };
     _dense_fill[(int) ten->dtyp](&accel_arg);
 
@@ -534,6 +1012,46 @@ int _fang_env_cpu_dense_ops_fill(fang_ten_ops_arg_t *restrict arg) {
 
 }
 
+/* Takes a step of an optimizer, over all of it's parameters at once. */
+int _fang_env_cpu_dense_ops_optim(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_optim_t *opt = (fang_optim_t *) arg->dest;
+    fang_optim_hparam_t *hp = &opt->hparam;
+    opt->nsteps++;
+
+    /* Order of coefficients is told by optimizer accelerators. */
+    double coef[9] = {
+        hp->lr, hp->momentum, 0, 0, 0, hp->weight_decay, 1, 1, 0
+    };
+    if(opt->type != FANG_OPTIM_SGD) {
+        coef[0] = hp->lr / (1 - pow(hp->beta1, (double) opt->nsteps));
+        coef[1] = hp->beta1;
+        coef[2] = 1 - hp->beta1;
+        coef[3] = hp->beta2;
+        coef[4] = 1 - hp->beta2;
+        coef[7] = 1 / sqrt(1 - pow(hp->beta2, (double) opt->nsteps));
+        coef[8] = hp->eps;
+
+        /* Decoupled weight decay shrinks parameters instead. */
+        if(opt->type == FANG_OPTIM_ADAMW) {
+            coef[5] = 0;
+            coef[6] = 1 - hp->lr * hp->weight_decay;
+        }
+    }
+
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = arg->dest,
+        .x = arg->x,
+        .y = (fang_gen_t) coef,
+        .pool = _fang_env_cpu_pool(opt->params[0])
+    };
+    _fang_pool_for(accel_arg.pool, (ptrdiff_t) opt->tasks[opt->nparams],
+        _fang_optim_task, &accel_arg);
+
+    return res;
+}
+
 /* Macro to abstract away redundant tensor arithmatic operations. */
 #define _FANG_ENV_CPU_DENSE_OPS_ARITH_DEF(operator)                           \
 int _fang_env_cpu_dense_ops_##operator(fang_ten_ops_arg_t *restrict arg) {    \
@@ -544,7 +1062,8 @@ int _fang_env_cpu_dense_ops_##operator(fang_ten_ops_arg_t *restrict arg) {    \
         .dest = arg->dest,                                                    \
         .x = arg->x,                                                          \
         .y = arg->y,                                                          \
-        .z = arg->z                                                           \
+        .z = arg->z,                                                          \
+        .pool = _fang_env_cpu_pool(dest)                                      \
     };                                                                        \
     _dense_##operator[(int) dest->dtyp](&accel_arg);                          \
                                                                               \
@@ -572,24 +1091,644 @@ int _fang_env_cpu_dense_ops_gemm(fang_ten_ops_arg_t *restrict arg) {
         .y = arg->y,
         .z = arg->z,
         .alpha = arg->alpha,
-        .beta = arg->beta
+        .beta = arg->beta,
+        .pool = _fang_env_cpu_pool(dest)
     };
     _dense_gemm[(int) dest->dtyp](&accel_arg);
 
     return res;
 }
 
+/* Performs 2D convolution of images with weights. */
+int _fang_env_cpu_dense_ops_conv2d(fang_ten_ops_arg_t *restrict arg) {
+    fang_ten_t *dest = (fang_ten_t *) arg->dest;
+    fang_ten_t *x    = (fang_ten_t *) arg->x;
+    fang_ten_t *w    = (fang_ten_t *) arg->y;
+    fang_uint_t alpha = FANG_G2U(arg->alpha), beta = FANG_G2U(arg->beta);
+    bool nhwc = FANG_G2I(arg->z) == FANG_TEN_CONV_NHWC;
+
+    /* Unpack parameters, see `fang_ten_conv2d`. */
+    _fang_conv2d_t conv = {
+        .nhwc = nhwc,
+        .n = (int) x->dims[0],
+        .c = (int) x->dims[nhwc ? 3 : 1],
+        .h = (int) x->dims[nhwc ? 1 : 2],
+        .w = (int) x->dims[nhwc ? 2 : 3],
+        .k = (int) w->dims[0],
+        .kh = (int) w->dims[nhwc ? 1 : 2],
+        .kw = (int) w->dims[nhwc ? 2 : 3],
+        .oh = (int) dest->dims[nhwc ? 1 : 2],
+        .ow = (int) dest->dims[nhwc ? 2 : 3],
+        .sh = (int) (alpha & 0xFFFF),
+        .sw = (int) (alpha >> 16 & 0xFFFF),
+        .dh = (int) (alpha >> 32 & 0xFFFF),
+        .dw = (int) (alpha >> 48 & 0xFFFF),
+        .ph = (int) (beta & 0xFFFF),
+        .pw = (int) (beta >> 16 & 0xFFFF),
+        .groups = (int) (beta >> 32)
+    };
+
+    return _fang_sconv2d(_fang_env_cpu_pool(dest), &conv,
+        (float *) dest->data.dense, (const float *) x->data.dense,
+        (const float *) w->data.dense);
+}
+
+/* Performs 2D pooling of images. */
+int _fang_env_cpu_dense_ops_pool2d(fang_ten_ops_arg_t *restrict arg) {
+    fang_ten_t *dest = (fang_ten_t *) arg->dest;
+    fang_ten_t *x    = (fang_ten_t *) arg->x;
+    fang_uint_t z = FANG_G2U(arg->z);
+    fang_uint_t alpha = FANG_G2U(arg->alpha), beta = FANG_G2U(arg->beta);
+    bool nhwc = (z & 0xFF) == FANG_TEN_CONV_NHWC;
+
+    /* Unpack parameters, see `fang_ten_pool2d`. Every channel is a group of
+       it's own. */
+    _fang_conv2d_t conv = {
+        .nhwc = nhwc,
+        .n = (int) x->dims[0],
+        .c = (int) x->dims[nhwc ? 3 : 1],
+        .h = (int) x->dims[nhwc ? 1 : 2],
+        .w = (int) x->dims[nhwc ? 2 : 3],
+        .k = (int) x->dims[nhwc ? 3 : 1],
+        .kh = (int) (alpha & 0xFFFF),
+        .kw = (int) (alpha >> 16 & 0xFFFF),
+        .oh = (int) dest->dims[nhwc ? 1 : 2],
+        .ow = (int) dest->dims[nhwc ? 2 : 3],
+        .sh = (int) (alpha >> 32 & 0xFFFF),
+        .sw = (int) (alpha >> 48 & 0xFFFF),
+        .ph = (int) (beta & 0xFFFF),
+        .pw = (int) (beta >> 16 & 0xFFFF),
+        .dh = 1,
+        .dw = 1,
+        .groups = (int) x->dims[nhwc ? 3 : 1]
+    };
+
+    return _fang_spool2d(_fang_env_cpu_pool(dest), &conv,
+        (z >> 8) == FANG_TEN_POOL_MAX, (float *) dest->data.dense,
+        (const float *) x->data.dense);
+}
+
+/* Normalizes rows of a tensor. */
+int _fang_env_cpu_dense_ops_norm(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *x = (fang_ten_t *) arg->x;
+
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = arg->dest,
+        .x = arg->x,
+        .y = arg->y,
+        .z = arg->z,
+        .alpha = arg->alpha,
+        .beta = arg->beta,
+        .pool = _fang_env_cpu_pool(x)
+    };
+    _dense_norm[(int) x->dtyp](&accel_arg);
+
+    return res;
+}
+
+/* Computes gradients of normalization. */
+int _fang_env_cpu_dense_ops_norm_backward(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *x = (fang_ten_t *) arg->y;
+
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = arg->dest,
+        .x = arg->x,
+        .y = arg->y,
+        .z = arg->z,
+        .alpha = arg->alpha,
+        .beta = arg->beta,
+        .pool = _fang_env_cpu_pool(x)
+    };
+    _dense_norm_backward[(int) x->dtyp](&accel_arg);
+
+    return res;
+}
+
+/* Applies batch normalization of inference. */
+int _fang_env_cpu_dense_ops_batchnorm(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *dest = (fang_ten_t *) arg->dest;
+    fang_ten_t *x    = (fang_ten_t *) arg->x;
+    fang_uint_t param = FANG_G2U(arg->beta);
+    bool nhwc = (param >> 32) == FANG_TEN_CONV_NHWC;
+
+    /* Channels, and elements of a channel contiguous in memory. */
+    int c = (int) x->dims[nhwc ? x->ndims - 1 : 1], inner = 1;
+    for(int i = 2; !nhwc && i < x->ndims; i++)
+        inner *= (int) x->dims[i];
+
+    float eps;
+    uint32_t eps_bits = (uint32_t) param;
+    memcpy(&eps, &eps_bits, sizeof(float));
+
+    float *coef = (float *) malloc(2 * (size_t) c * sizeof(float));
+    if(FANG_UNLIKELY(coef == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    _fang_batchnorm_coef(coef, coef + c, c, (fang_ten_t *) arg->y,
+        (fang_ten_t *) arg->z, (fang_ten_t *) arg->alpha, eps);
+
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .y = (fang_gen_t) coef,
+        .z = (fang_gen_t) (coef + c),
+        .alpha = FANG_I2G(c),
+        .beta = FANG_I2G(inner),
+        .pool = _fang_env_cpu_pool(x)
+    };
+    _fang_batchnorm_run(&accel_arg);
+
+    free(coef);
+out:
+    return res;
+}
+
+/* Folds batch normalization into weights and bias of a layer. */
+int _fang_env_cpu_dense_ops_batchnorm_fold(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *w = (fang_ten_t *) arg->dest;
+    fang_ten_t *b = (fang_ten_t *) arg->x;
+    fang_uint_t param = FANG_G2U(arg->beta);
+    bool first = (param >> 32) == FANG_TEN_FOLD_FIRST;
+
+    /* Output channels, and weights of a channel contiguous in memory. */
+    int c = (int) b->dims[0], inner = 1;
+    for(int i = 1; first && i < w->ndims; i++)
+        inner *= (int) w->dims[i];
+
+    float eps;
+    uint32_t eps_bits = (uint32_t) param;
+    memcpy(&eps, &eps_bits, sizeof(float));
+
+    float *coef = (float *) malloc(2 * (size_t) c * sizeof(float));
+    if(FANG_UNLIKELY(coef == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    _fang_batchnorm_coef(coef, coef + c, c, (fang_ten_t *) arg->y,
+        (fang_ten_t *) arg->z, (fang_ten_t *) arg->alpha, eps);
+
+    /* Weights are only scaled, bias takes the shift. */
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = (fang_gen_t) w,
+        .x = (fang_gen_t) w,
+        .y = (fang_gen_t) coef,
+        .z = (fang_gen_t) NULL,
+        .alpha = FANG_I2G(c),
+        .beta = FANG_I2G(inner),
+        .pool = _fang_env_cpu_pool(w)
+    };
+    _fang_batchnorm_run(&accel_arg);
+
+    float *data_b = (float *) b->data.dense;
+    for(int ch = 0; ch < c; ch++)
+        data_b[ch] = data_b[ch] * coef[ch] + coef[c + ch];
+
+    free(coef);
+out:
+    return res;
+}
+
+/* Performs scaled dot-product attention. */
+int _fang_env_cpu_dense_ops_attention(fang_ten_ops_arg_t *restrict arg) {
+    fang_ten_t *dest = (fang_ten_t *) arg->dest;
+    fang_ten_t *q    = (fang_ten_t *) arg->x;
+    fang_ten_t *k    = (fang_ten_t *) arg->y;
+    fang_ten_t *v    = (fang_ten_t *) arg->z;
+    fang_uint_t alpha = FANG_G2U(arg->alpha);
+    int nd = q->ndims;
+
+    /* Unpack parameters, see `fang_ten_attention`. */
+    _fang_attn_t attn = {
+        .bh = 1,
+        .t = (int) q->dims[nd - 2],
+        .s = (int) k->dims[nd - 2],
+        .d = (int) q->dims[nd - 1],
+        .dv = (int) v->dims[nd - 1],
+        .causal = (alpha >> 32) != 0
+    };
+    for(int i = 0; i < nd - 2; i++)
+        attn.bh *= (int) q->dims[i];
+    attn.page = attn.s;
+
+    uint32_t scale_bits = (uint32_t) alpha;
+    memcpy(&attn.scale, &scale_bits, sizeof(float));
+
+    /* Keys and values are a single page. */
+    const float *k_page = (const float *) k->data.dense;
+    const float *v_page = (const float *) v->data.dense;
+    return _fang_sattn(_fang_env_cpu_pool(dest), &attn,
+        (float *) dest->data.dense, (const float *) q->data.dense, &k_page,
+        &v_page);
+}
+
+/* Copies `n` tokens of every head of `src` (heads, n, d) into pages of a KV
+   cache from position `pos`, a run within a page at a time. */
+static void _fang_kvcache_copy(float **pages, uint32_t page, uint32_t heads,
+    uint32_t d, const float *src, uint32_t n, uint32_t pos)
+{
+    for(uint32_t h = 0; h < heads; h++) {
+        for(uint32_t i = 0, run; i < n; i += run) {
+            uint32_t off = (pos + i) % page;
+            run = _FANG_MIN(n - i, page - off);
+
+            float *dst = pages[(pos + i) / page] + ((size_t) h * page + off) *
+                d;
+            memcpy(dst, src + ((size_t) h * n + i) * d,
+                (size_t) run * d * sizeof(float));
+        }
+    }
+}
+
+/* Appends keys and values to a KV cache. */
+int _fang_env_cpu_dense_ops_kvcache_append(fang_ten_ops_arg_t *restrict arg) {
+    fang_kvcache_t *cache = (fang_kvcache_t *) arg->dest;
+    fang_ten_t *k = (fang_ten_t *) arg->x;
+    fang_ten_t *v = (fang_ten_t *) arg->y;
+    uint32_t pos = (uint32_t) FANG_G2U(arg->alpha);
+    uint32_t n = k->dims[k->ndims - 2];
+
+    _fang_kvcache_copy(cache->k, cache->page, cache->heads, cache->dk,
+        (const float *) k->data.dense, n, pos);
+    _fang_kvcache_copy(cache->v, cache->page, cache->heads, cache->dv,
+        (const float *) v->data.dense, n, pos);
+
+    return FANG_OK;
+}
+
+/* Performs attention of queries over a KV cache. */
+int _fang_env_cpu_dense_ops_kvcache_attention(
+    fang_ten_ops_arg_t *restrict arg)
+{
+    fang_ten_t *dest = (fang_ten_t *) arg->dest;
+    fang_ten_t *q    = (fang_ten_t *) arg->x;
+    fang_kvcache_t *cache = (fang_kvcache_t *) arg->y;
+    fang_uint_t alpha = FANG_G2U(arg->alpha);
+
+    /* Unpack parameters, see `fang_kvcache_attention`. Tokens are as many as
+       when submitted. */
+    _fang_attn_t attn = {
+        .bh = (int) cache->heads,
+        .t = (int) q->dims[q->ndims - 2],
+        .s = (int) FANG_G2U(arg->beta),
+        .d = (int) cache->dk,
+        .dv = (int) cache->dv,
+        .page = (int) cache->page,
+        .causal = (alpha >> 32) != 0
+    };
+
+    uint32_t scale_bits = (uint32_t) alpha;
+    memcpy(&attn.scale, &scale_bits, sizeof(float));
+
+    return _fang_sattn(_fang_env_cpu_pool(dest), &attn,
+        (float *) dest->data.dense, (const float *) q->data.dense,
+        (const float *const *) cache->k, (const float *const *) cache->v);
+}
+
+/* Gathers rows of a tensor by indices. */
+int _fang_env_cpu_dense_ops_gather(fang_ten_ops_arg_t *restrict arg) {
+    fang_ten_t *dest = (fang_ten_t *) arg->dest;
+    fang_ten_t *x    = (fang_ten_t *) arg->x;
+    fang_ten_t *idx  = (fang_ten_t *) arg->y;
+
+    /* Indices are checked before anything is written. */
+    size_t m = idx->ndims == 0 ? 1 : (size_t) idx->strides[0] * idx->dims[0];
+    if(FANG_UNLIKELY(!_fang_index_valid(idx, m, x->dims[0])))
+        return -FANG_INVIDX;
+
+    size_t row = x->ndims == 1 ? 1 : (size_t) x->strides[0];
+    size_t rpt = _fang_index_rows(row);
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .y = (fang_gen_t) idx,
+        .alpha = FANG_U2G(row),
+        .pool = _fang_env_cpu_pool(dest)
+    };
+    _fang_pool_for(accel_arg.pool, (ptrdiff_t) ((m + rpt - 1) / rpt),
+        _fang_gather_task, &accel_arg);
+
+    return FANG_OK;
+}
+
+/* Adds rows of a tensor into rows picked by indices. */
+int _fang_env_cpu_dense_ops_scatter_add(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *dest = (fang_ten_t *) arg->dest;
+    fang_ten_t *x    = (fang_ten_t *) arg->x;
+    fang_ten_t *idx  = (fang_ten_t *) arg->y;
+
+    /* Indices are checked before anything is written. */
+    size_t m = idx->ndims == 0 ? 1 : (size_t) idx->strides[0] * idx->dims[0];
+    size_t n = dest->dims[0];
+    if(FANG_UNLIKELY(!_fang_index_valid(idx, m, (int64_t) n))) {
+        res = -FANG_INVIDX;
+        goto out;
+    }
+
+    size_t *start = (size_t *) malloc((n + 2 + m) * sizeof(size_t));
+    if(FANG_UNLIKELY(start == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    _fang_scatter_bucket(idx, m, n, start, start + n + 2);
+
+    size_t row = dest->ndims == 1 ? 1 : (size_t) dest->strides[0];
+    size_t rpt = _fang_index_rows(row);
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .y = (fang_gen_t) idx,
+        .z = (fang_gen_t) start,
+        .alpha = FANG_U2G(row),
+        .beta = (fang_gen_t) (start + n + 2),
+        .pool = _fang_env_cpu_pool(dest)
+    };
+    _fang_pool_for(accel_arg.pool, (ptrdiff_t) ((n + rpt - 1) / rpt),
+        dest->dtyp == FANG_TEN_DTYPE_FLOAT32 ? _fang_scatter_add_taskf32 :
+        _fang_scatter_add_taskf64, &accel_arg);
+
+    free(start);
+out:
+    return res;
+}
+
 /* Releases a dense tensor. */
 int _fang_env_cpu_dense_ops_release(fang_ten_ops_arg_t *restrict arg) {
     /* The tensor to work with. */
     fang_ten_t *ten = (fang_ten_t *) arg->dest;
     fang_env_t *env = (fang_env_t *) arg->z;
 
-    /* Release tensor data. */
-    FANG_RELEASE(env->realloc, ten->data.dense);
+    /* Release tensor data. Adopted data goes back to it's owner. */
+    if(FANG_UNLIKELY(ten->deleter != NULL))
+        ten->deleter(ten->data.dense);
+    else
+        FANG_RELEASE(env->realloc, ten->data.dense);
 
     return FANG_OK;
 }
 
 /* ================ CPU DENSE OPERATORS END ================ */
 
+
+/* ================ CPU SPARSE OPERATORS ================ */
+
+/* Creates sparse tensor data in COO encoding. */
+int _fang_env_cpu_sparse_ops_create(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *ten = (fang_ten_t *) arg->dest;
+    fang_env_t *env = (fang_env_t *) arg->z;
+    int nnz = (int) FANG_G2I(arg->x);
+    size_t ncoords = (size_t) nnz * ten->ndims;
+
+    fang_ten_sparse_t *sp = FANG_CREATE(env->realloc, fang_ten_sparse_t, 1);
+    if(FANG_UNLIKELY(sp == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    sp->fmt   = FANG_TEN_SPARSE_COO;
+    sp->nnz   = nnz;
+    sp->block = 1;
+    sp->ptr   = NULL;
+    sp->idx   = NULL;
+    sp->data  = NULL;
+    ten->data.sparse = sp;
+    if(nnz == 0)
+        goto out;
+
+    sp->idx  = FANG_CREATE(env->realloc, uint32_t, ncoords);
+    sp->data = FANG_CREATE(env->realloc, char,
+        (size_t) nnz * _fang_ten_dsiz[(int) ten->dtyp]);
+    if(FANG_UNLIKELY(sp->idx == NULL || sp->data == NULL)) {
+        FANG_RELEASE(env->realloc, sp->idx);
+        FANG_RELEASE(env->realloc, sp->data);
+        FANG_RELEASE(env->realloc, sp);
+        res = -FANG_NOMEM;
+        goto out;
+    }
+
+    memcpy(sp->idx, (const uint32_t *) arg->beta, ncoords * sizeof(uint32_t));
+    _fang_dense_cast(sp->data, (int) ten->dtyp, arg->y,
+        (int) FANG_G2I(arg->alpha), (size_t) nnz);
+
+out:
+    return res;
+}
+
+/* Prints elements of a sparse tensor to a file, a line each. */
+int _fang_env_cpu_sparse_ops_print(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *ten = (fang_ten_t *) arg->dest;
+    int padding = (int) FANG_G2I(arg->x);
+    fang_env_t *env = (fang_env_t *) arg->z;
+    fang_ten_sparse_t *sp = ten->data.sparse;
+
+    /* Compressed encodings keep coordinates implicitly. */
+    uint32_t *coords = sp->idx;
+    if(sp->fmt != FANG_TEN_SPARSE_COO) {
+        coords = (uint32_t *) malloc(2 * (size_t) sp->nnz * sizeof(uint32_t));
+        if(FANG_UNLIKELY(coords == NULL && sp->nnz > 0)) {
+            res = -FANG_NOMEM;
+            goto out;
+        }
+        _fang_sparse_expand(sp, ten->dims[0], ten->dims[1], coords);
+    }
+
+    _fang_print_out_t *out = FANG_CREATE(env->realloc, _fang_print_out_t, 1);
+    if(FANG_UNLIKELY(out == NULL)) {
+        res = -FANG_NOMEM;
+        goto out_free;
+    }
+    out->file = (FILE *) arg->y;
+    out->len  = 0;
+
+    /* First pass finds the widest value to align them with. */
+    out->width   = 0;
+    out->measure = true;
+    for(int i = 0; i < sp->nnz; i++)
+        _fang_print_col(out, (int) ten->dtyp, sp->data, i);
+    out->measure = false;
+
+    char str[20];
+    for(int i = 0; i < sp->nnz; i++) {
+        _fang_print_fill(out, ' ', padding);
+        _fang_print_put(out, "(", 1);
+        for(int d = 0; d < ten->ndims; d++) {
+            if(d > 0)
+                _fang_print_put(out, ", ", 2);
+            _fang_print_put(out, str, _fang_print_utoa(str,
+                coords[(size_t) i * ten->ndims + d]));
+        }
+        _fang_print_put(out, ") ", 2);
+        _fang_print_col(out, (int) ten->dtyp, sp->data, i);
+        _fang_print_put(out, "\n", 1);
+    }
+    _fang_print_flush(out);
+
+    FANG_RELEASE(env->realloc, out);
+out_free:
+    if(coords != sp->idx)
+        free(coords);
+out:
+    return res;
+}
+
+/* Multiplies a sparse matrix with a dense matrix. */
+int _fang_env_cpu_sparse_ops_gemm(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *dest = (fang_ten_t *) arg->dest;
+    fang_ten_t *x    = (fang_ten_t *) arg->x;
+    fang_ten_t *y    = (fang_ten_t *) arg->y;
+    fang_ten_sparse_t *sp = x->data.sparse, csr;
+    bool f32 = dest->dtyp == FANG_TEN_DTYPE_FLOAT32;
+    size_t n = dest->dims[1];
+
+    _fang_cpu_accel_arg_t accel_arg = {
+        .dest = (fang_gen_t) dest,
+        .y = (fang_gen_t) y,
+        .z = (fang_gen_t) sp,
+        .alpha = arg->alpha,
+        .beta = arg->beta,
+        .pool = _fang_env_cpu_pool(dest)
+    };
+
+    /* Blocked GEMM skipping dropped elements. */
+    if(sp->fmt == FANG_TEN_SPARSE_2_4) {
+        res = _fang_sgemm24(accel_arg.pool, (int) dest->dims[0], (int) n,
+            (int) x->dims[1], FANG_G2F(arg->beta),
+            (float *) dest->data.dense, (int) n, FANG_G2F(arg->alpha),
+            (const float *) sp->data, sp->idx,
+            (const float *) y->data.dense, (int) n);
+        goto out;
+    }
+
+    /* Tasks own columns of destination. */
+    if(sp->fmt == FANG_TEN_SPARSE_CSC) {
+        accel_arg.x = FANG_U2G(FANG_SPMM_COLS);
+        _fang_pool_for(accel_arg.pool,
+            (ptrdiff_t) ((n + FANG_SPMM_COLS - 1) / FANG_SPMM_COLS),
+            f32 ? _fang_spmm_csc_taskf32 : _fang_spmm_csc_taskf64,
+            &accel_arg);
+        goto out;
+    }
+
+    /* Elements are sorted into rows for this multiplication only. */
+    if(sp->fmt == FANG_TEN_SPARSE_COO) {
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_sparse_csr(&csr, sp,
+            x->dims[0], (int) x->dtyp))))
+        {
+            goto out;
+        }
+        accel_arg.z = (fang_gen_t) &csr;
+    }
+
+    /* Tasks own block rows of destination. */
+    const fang_ten_sparse_t *rows = (const fang_ten_sparse_t *) accel_arg.z;
+    size_t b = rows->block, nmaj = dest->dims[0] / b;
+    size_t rpt = _fang_spmm_rows((size_t) rows->nnz / (b * b), nmaj, b, n);
+    accel_arg.x = FANG_U2G(rpt);
+    _fang_pool_for(accel_arg.pool, (ptrdiff_t) ((nmaj + rpt - 1) / rpt),
+        f32 ? _fang_spmm_taskf32 : _fang_spmm_taskf64, &accel_arg);
+
+    if(sp->fmt == FANG_TEN_SPARSE_COO)
+        free(csr.ptr);
+out:
+    return res;
+}
+
+/* Scatters a sparse tensor into a dense tensor. */
+int _fang_env_cpu_sparse_ops_densify(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *dest = (fang_ten_t *) arg->dest;
+    fang_ten_t *x    = (fang_ten_t *) arg->x;
+    fang_ten_sparse_t *sp = x->data.sparse;
+    int dtyp = (int) dest->dtyp;
+
+    /* Compressed encodings keep coordinates implicitly. */
+    uint32_t *coords = sp->idx;
+    if(sp->fmt != FANG_TEN_SPARSE_COO) {
+        coords = (uint32_t *) malloc(2 * (size_t) sp->nnz * sizeof(uint32_t));
+        if(FANG_UNLIKELY(coords == NULL && sp->nnz > 0)) {
+            res = -FANG_NOMEM;
+            goto out;
+        }
+        _fang_sparse_expand(sp, x->dims[0], x->dims[1], coords);
+    }
+
+    memset(dest->data.dense, 0, (size_t) dest->dims[0] * dest->strides[0] *
+        _fang_ten_dsiz[dtyp]);
+    for(int i = 0; i < sp->nnz; i++) {
+        size_t o = 0;
+        for(int d = 0; d < x->ndims; d++)
+            o += (size_t) coords[(size_t) i * x->ndims + d] * dest->strides[d];
+        _fang_sparse_add(dest->data.dense, o, sp->data, i, dtyp);
+    }
+
+    if(coords != sp->idx)
+        free(coords);
+out:
+    return res;
+}
+
+/* Converts a COO sparse matrix (dense one for 2:4) into a compressed
+   encoding. */
+int _fang_env_cpu_sparse_ops_convert(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_ten_t *ten = (fang_ten_t *) arg->dest;
+    fang_ten_t *x   = (fang_ten_t *) arg->x;
+    fang_env_t *env = (fang_env_t *) arg->z;
+
+    fang_ten_sparse_t *sp = FANG_CREATE(env->realloc, fang_ten_sparse_t, 1);
+    if(FANG_UNLIKELY(sp == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    sp->fmt   = (fang_ten_sparse_fmt_t) FANG_G2I(arg->alpha);
+    sp->block = (uint32_t) FANG_G2U(arg->beta);
+
+    if(sp->fmt == FANG_TEN_SPARSE_2_4)
+        res = _fang_sparse_compress24(sp, x->data.dense, x->dims[0],
+            x->dims[1], (int) x->dtyp, env->realloc);
+    else
+        res = _fang_sparse_compress(sp, x->data.sparse, x->dims[0],
+            x->dims[1], (int) x->dtyp, env->realloc);
+    if(FANG_UNLIKELY(!FANG_ISOK(res))) {
+        FANG_RELEASE(env->realloc, sp);
+        goto out;
+    }
+    ten->data.sparse = sp;
+
+out:
+    return res;
+}
+
+/* Releases a sparse tensor. */
+int _fang_env_cpu_sparse_ops_release(fang_ten_ops_arg_t *restrict arg) {
+    fang_ten_t *ten = (fang_ten_t *) arg->dest;
+    fang_env_t *env = (fang_env_t *) arg->z;
+    fang_ten_sparse_t *sp = ten->data.sparse;
+
+    FANG_RELEASE(env->realloc, sp->idx);
+    FANG_RELEASE(env->realloc, sp->ptr);
+    FANG_RELEASE(env->realloc, sp->data);
+    FANG_RELEASE(env->realloc, sp);
+
+    return FANG_OK;
+}
+
+/* ================ CPU SPARSE OPERATORS END ================ */
+
@@ -1,5 +1,7 @@
 #include <fang/status.h>
 #include <env/cpu/cpu.h>
+#include <env/stream.h>
+#include <platform/thread.h>
 #include <string.h>
 
 /* ================ PRIVATE ================ */
@@ -7,6 +9,10 @@
 /* Store all the environment created. */
 static fang_env_t _s_envs[FANG_MAX_ENV];
 
+/* Whether a slot of `_s_envs` is taken. A slot is claimed before it's
+   Environment is initialized, and published by storing it's type. */
+static int _s_taken[FANG_MAX_ENV];
+
 /* ================ PRIVATE END ================ */
 
 
@@ -24,9 +30,13 @@ int fang_env_create(fang_env_type_t type, fang_reallocator_t realloc) {
     if(realloc == NULL)
         realloc = _fang_default_reallocator;
 
-    /* Probe and see if there is any room for new Environment. */
+    /* Probe and see if there is any room for new Environment. Several threads
+       may be probing at once, hence slots are claimed atomically. */
     for(int i = 0; i < FANG_MAX_ENV; i++) {
-        if(_s_envs[i].type == FANG_ENV_TYPE_INVALID) {
+        int taken = 0;
+        if(_fang_atomic_load(&_s_taken[i]) == 0 &&
+            _fang_atomic_cas(&_s_taken[i], &taken, 1))
+        {
             /* Gotcha. */
             res = i;
             break;
@@ -40,7 +50,6 @@ int fang_env_create(fang_env_type_t type, fang_reallocator_t realloc) {
     fang_env_t *env = _s_envs + res;
     memset(env, 0, sizeof(fang_env_t));
 
-    env->type = type;
     env->realloc = realloc;
 
     switch(type) {
@@ -49,6 +58,7 @@ int fang_env_create(fang_env_type_t type, fang_reallocator_t realloc) {
             if(!FANG_ISOK(code =
                 _fang_env_cpu_create(&env->private, &env->ops, realloc)))
             {
+                _fang_atomic_store(&_s_taken[res], 0);
                 res = code;
                 goto out;
             }
@@ -60,6 +70,9 @@ int fang_env_create(fang_env_type_t type, fang_reallocator_t realloc) {
         default: res = -FANG_INVENVTYP;
     }
 
+    /* Environment is visible to other threads from now on. */
+    _fang_atomic_store(&env->type, type);
+
 out:
     return res;
 }
@@ -74,18 +87,92 @@ int fang_env_release(int eid) {
         goto out;
 
     /* Environments cannot be released if tensors using it. */
-    if(env->ntens != 0) {
+    if(_fang_atomic_load(&env->ntens) != 0) {
         res = -FANG_NTENS;
         goto out;
     }
 
+    /* Only one of concurrent releases gets through. */
+    fang_env_type_t type = env->type;
+    if(FANG_UNLIKELY(type == FANG_ENV_TYPE_INVALID ||
+        !_fang_atomic_cas(&env->type, &type, FANG_ENV_TYPE_INVALID)))
+    {
+        res = -FANG_NOENV;
+        goto out;
+    }
+
+    /* Finish pending operators, by the release that got through only. */
+    if(env->stream != NULL) {
+        _fang_env_stream_release(env->stream);
+        env->stream = NULL;
+    }
+
     env->private->release(env->private, env->realloc);
-    env->type = FANG_ENV_TYPE_INVALID;  // Marking the slot free
+    _fang_atomic_store(&_s_taken[eid], 0);  // Marking the slot free
+
+out:
+    return res;
+}
+
+/* Switches an Environment to asynchronous mode, or back. */
+int fang_env_async(int eid, bool async) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    if(async && env->stream == NULL) {
+        res = _fang_env_stream_create(&env->stream, env->realloc);
+    } else if(!async && env->stream != NULL) {
+        res = _fang_env_stream_wait(env->stream, env->stream->submitted);
+        _fang_env_stream_release(env->stream);
+        env->stream = NULL;
+    }
+
+out:
+    return res;
+}
+
+/* Gets a fence for the operators submitted so far. */
+int fang_env_fence(int eid, fang_env_fence_t *fence) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    /* Synchronous operators have always completed. */
+    *fence = env->stream != NULL ?
+        _fang_atomic_load(&env->stream->submitted) : 0;
 
 out:
     return res;
 }
 
+/* Waits until operators up to a fence complete. */
+int fang_env_wait(int eid, fang_env_fence_t fence) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    if(env->stream != NULL)
+        res = _fang_env_stream_wait(env->stream, fence);
+
+out:
+    return res;
+}
+
+/* Waits until every submitted operator completes. */
+int fang_env_sync(int eid) {
+    fang_env_fence_t fence;
+    int res = fang_env_fence(eid, &fence);
+
+    return FANG_ISOK(res) ? fang_env_wait(eid, fence) : res;
+}
+
 /* ================ DEFINITIONS END ================ */
 
 
@@ -96,13 +183,15 @@ out:
 int _fang_env_retrieve(fang_env_t **restrict env, int eid) {
     int res = FANG_OK;
 
-    if(FANG_UNLIKELY(eid >= FANG_MAX_ENV)) {
+    if(FANG_UNLIKELY(eid < 0 || eid >= FANG_MAX_ENV)) {
         res = -FANG_INVID;
         goto out;
     }
 
     /* Such environment exists? */
-    if(FANG_UNLIKELY(_s_envs[eid].type == FANG_ENV_TYPE_INVALID)) {
+    if(FANG_UNLIKELY(_fang_atomic_load(&_s_envs[eid].type) ==
+        FANG_ENV_TYPE_INVALID))
+    {
         res = -FANG_NOENV;
         goto out;
     }
@@ -18,10 +18,10 @@
 /* Instantiate the five outer loops. */
 _FANG_OUTER_LOOPS(float, sgemm, SGEMM)
 
-/* Single-precision (float32) GEMM. */
-int _fang_sgemm(bool transp_x, bool transp_y, int m, int n, int k,
-    float beta, float *restrict dest, int ld_dest, float alpha,
-    float *restrict x, int ld_x, float *restrict y, int ld_y)
+/* Single-precision (float32) GEMM. Runs on `pool` if not NULL. */
+int _fang_sgemm(_fang_pool_t *restrict pool, bool transp_x, bool transp_y,
+    int m, int n, int k, float beta, float *restrict dest, int ld_dest,
+    float alpha, float *restrict x, int ld_x, float *restrict y, int ld_y)
 {
     int res = FANG_OK;
 
@@ -41,8 +41,8 @@ int _fang_sgemm(bool transp_x, bool transp_y, int m, int n, int k,
     }
 
     /* Dispatch to five outer loops. */
-    _fang_sgemm_loop5(transp_x, transp_y, m, n, k, beta, dest, ld_dest, alpha,
-        x, ld_x, y, ld_y);
+    _fang_sgemm_loop5(pool, transp_x, transp_y, m, n, k, beta, dest, ld_dest,
+        alpha, x, ld_x, y, ld_y);
 
 out:
     return res;
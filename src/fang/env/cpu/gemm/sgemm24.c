@@ -0,0 +1,252 @@
+#include <env/cpu/gemm.h>
+#include <fang/status.h>
+#include <tune.h>
+
+#include <string.h>
+
+
+/* ================ PRIVATE HELPER MACROS ================ */
+
+/* Words of metadata of a row of `x` of `k` columns. */
+#define _FANG_META_LD(k)        (((k) / 4 + 7) / 8)
+
+/* Column within it's group of kept element `s` of a row. */
+#define _FANG_META_AT(meta, s)  (((meta)[(s) / 16] >> ((s) % 16 * 2)) & 3)
+
+/* Vectors the micro-kernel works on, `_FANG_VR` of them a kept element of
+   groups, half of the registers as accumulators. */
+#if defined(FANG_USE_AVX512)
+#define _FANG_VW                16
+#define _FANG_VR                8
+#define _fang_v_t               __m512
+#define _fang_v_zero()          _mm512_setzero_ps()
+#define _fang_v_set1(x)         _mm512_set1_ps(x)
+#define _fang_v_load(x)         _mm512_load_ps(x)
+#define _fang_v_loadu(x)        _mm512_loadu_ps(x)
+#define _fang_v_store(x, v)     _mm512_store_ps(x, v)
+#define _fang_v_storeu(x, v)    _mm512_storeu_ps(x, v)
+#define _fang_v_add(a, b)       _mm512_add_ps(a, b)
+#define _fang_v_mul(a, b)       _mm512_mul_ps(a, b)
+#define _fang_v_fma(a, b, c)    _mm512_fmadd_ps(a, b, c)
+#elif defined(FANG_USE_AVX2)
+#define _FANG_VW                8
+#define _FANG_VR                4
+#define _fang_v_t               __m256
+#define _fang_v_zero()          _mm256_setzero_ps()
+#define _fang_v_set1(x)         _mm256_set1_ps(x)
+#define _fang_v_load(x)         _mm256_load_ps(x)
+#define _fang_v_loadu(x)        _mm256_loadu_ps(x)
+#define _fang_v_store(x, v)     _mm256_store_ps(x, v)
+#define _fang_v_storeu(x, v)    _mm256_storeu_ps(x, v)
+#define _fang_v_add(a, b)       _mm256_add_ps(a, b)
+#define _fang_v_mul(a, b)       _mm256_mul_ps(a, b)
+#define _fang_v_fma(a, b, c)    _mm256_fmadd_ps(a, b, c)
+#endif  // FANG_USE_AVX512, FANG_USE_AVX2
+
+/* ================ PRIVATE HELPER MACROS END ================ */
+
+
+/* ================ PRIVATE DATA STRUCTURES ================ */
+
+/* Shared state of 2:4 GEMM tasks. */
+typedef struct _fang_sgemm24_par {
+    int m, n, k;
+    float beta;
+    float *dest;
+    int ld_dest;
+    float alpha;
+    const float *x_val;
+    const uint32_t *x_meta;
+    const float *y;
+    int ld_y;
+
+    /* NC blocks of columns of `dest`. */
+    int nblk;
+
+    /* One KCxNC block of `y` per thread. */
+    float *y_tilde;
+} _fang_sgemm24_par_t;
+
+/* ================ PRIVATE DATA STRUCTURES END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Micro-kernel, `nb` (at most NR) columns of a single row of `dest` over
+ * groups [g0, g1) of the row of `x`. `y_tilde` is a packed KCxNR micro-panel
+ * of `y` starting at row `4 * g0`. Every group adds the 2 rows of `y` it's
+ * kept elements pick, rows of dropped ones are never loaded. Hence, a group
+ * costs 2 multiply-adds per column instead of 4. Sums stay in registers over
+ * the whole KC block, `_FANG_VR` vectors at a time; first and second kept
+ * elements of groups sum apart, keeping two independent chains of
+ * multiply-adds. */
+FANG_HOT FANG_INLINE static inline void _fang_sgemm24_ukernel(int g0, int g1,
+    int nb, float beta, float *restrict dest, float alpha,
+    const float *restrict val, const uint32_t *restrict meta,
+    const float *restrict y_tilde)
+{
+    float res[FANG_SGEMM24_NR] FANG_ALIGNAS(64);
+    const float *y = y_tilde - (size_t) 4 * g0 * FANG_SGEMM24_NR;
+
+#ifdef _FANG_VW
+    _fang_v_t va = _fang_v_set1(alpha), vb = _fang_v_set1(beta);
+    for(int c = 0; c < FANG_SGEMM24_NR; c += _FANG_VR * _FANG_VW) {
+        _fang_v_t acc0[_FANG_VR], acc1[_FANG_VR];
+        for(int r = 0; r < _FANG_VR; r++) {
+            acc0[r] = _fang_v_zero();
+            acc1[r] = _fang_v_zero();
+        }
+
+        for(int g = g0; g < g1; g++) {
+            int s = 2 * g;
+            const float *y0 = y + (4 * g + _FANG_META_AT(meta, s)) *
+                FANG_SGEMM24_NR + c;
+            const float *y1 = y + (4 * g + _FANG_META_AT(meta, s + 1)) *
+                FANG_SGEMM24_NR + c;
+            _fang_v_t a0 = _fang_v_set1(val[s]);
+            _fang_v_t a1 = _fang_v_set1(val[s + 1]);
+
+            for(int r = 0; r < _FANG_VR; r++) {
+                acc0[r] = _fang_v_fma(a0, _fang_v_load(y0 + _FANG_VW * r),
+                    acc0[r]);
+                acc1[r] = _fang_v_fma(a1, _fang_v_load(y1 + _FANG_VW * r),
+                    acc1[r]);
+            }
+        }
+
+        for(int r = 0; r < _FANG_VR; r++) {
+            float *at = dest + c + _FANG_VW * r;
+            _fang_v_t sum = _fang_v_mul(va, _fang_v_add(acc0[r], acc1[r]));
+            if(FANG_LIKELY(nb == FANG_SGEMM24_NR)) {
+                if(beta != 0)
+                    sum = _fang_v_fma(vb, _fang_v_loadu(at), sum);
+                _fang_v_storeu(at, sum);
+            } else
+                _fang_v_store(res + c + _FANG_VW * r, sum);
+        }
+    }
+    if(FANG_LIKELY(nb == FANG_SGEMM24_NR))
+        return;
+#else
+    for(int j = 0; j < FANG_SGEMM24_NR; j++)
+        res[j] = 0;
+    for(int g = g0; g < g1; g++) {
+        int s = 2 * g;
+        const float *y0 = y + (4 * g + _FANG_META_AT(meta, s)) *
+            FANG_SGEMM24_NR;
+        const float *y1 = y + (4 * g + _FANG_META_AT(meta, s + 1)) *
+            FANG_SGEMM24_NR;
+        for(int j = 0; j < FANG_SGEMM24_NR; j++)
+            res[j] += val[s] * y0[j] + val[s + 1] * y1[j];
+    }
+    for(int j = 0; j < FANG_SGEMM24_NR; j++)
+        res[j] *= alpha;
+#endif  // _FANG_VW
+
+    /* Sums of `beta` being 0 overwrite, not to carry NaNs of `dest`. */
+    for(int j = 0; j < nb; j++)
+        dest[j] = res[j] + (beta != 0 ? beta * dest[j] : 0);
+}
+
+/* Task of a MCxNC block of `dest`, packing KCxNC blocks of `y` in scratch
+   memory of the thread. */
+/* NOTE: Loop 4 walks KC columns of `x`. Loop 1 slices the packed block of `y`
+ *   into KCxNR micro-panels, every one kept in L1 cache over all rows of the
+ *   block (loop 2). Unpacked, rows of `y` picked by groups are a whole row of
+ *   `y` apart and alias in cache.
+ */
+FANG_HOT static void _fang_sgemm24_task(void *restrict arg, ptrdiff_t task,
+    int wid)
+{
+    _fang_sgemm24_par_t *par = (_fang_sgemm24_par_t *) arg;
+    int i0 = (int) (task / par->nblk) * FANG_SGEMM24_MC;
+    int j0 = (int) (task % par->nblk) * FANG_SGEMM24_NC;
+    int ib = _FANG_MIN(FANG_SGEMM24_MC, par->m - i0);
+    int jb = _FANG_MIN(FANG_SGEMM24_NC, par->n - j0);
+    int ld_dest = par->ld_dest, ld_y = par->ld_y;
+    int ld_meta = _FANG_META_LD(par->k);
+    float *dest = par->dest, *y = (float *) par->y;
+    float *y_tilde = par->y_tilde + (size_t) wid * FANG_SGEMM24_KC *
+        FANG_SGEMM24_NC;
+
+    /* Loop 4. */
+    for(int p = 0; p < par->k; p += FANG_SGEMM24_KC) {
+        int pb = _FANG_MIN(FANG_SGEMM24_KC, par->k - p);
+        /* Beta needs to be applied only once. */
+        float _bet = p == 0 ? par->beta : 1;
+
+        _fang_sgemm_pack(pb, jb, FANG_SGEMM24_NR, &_beta(p, j0), ld_y,
+            y_tilde, false);
+
+        /* Loop 1. */
+        for(int j = 0; j < jb; j += FANG_SGEMM24_NR) {
+            /* Loop 2. */
+            for(int i = i0; i < i0 + ib; i++) {
+                _fang_sgemm24_ukernel(p / 4, (p + pb) / 4,
+                    _FANG_MIN(FANG_SGEMM24_NR, jb - j), _bet,
+                    &_gamma(i, j0 + j), par->alpha,
+                    par->x_val + (size_t) i * (par->k / 2),
+                    par->x_meta + (size_t) i * ld_meta, &y_tilde[pb * j]);
+            }
+        }
+    }
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Single-precision (float32) GEMM of a 2:4 structured sparse matrix. Runs on
+   `pool` if not NULL. */
+int _fang_sgemm24(_fang_pool_t *restrict pool, int m, int n, int k,
+    float beta, float *restrict dest, int ld_dest, float alpha,
+    const float *restrict x_val, const uint32_t *restrict x_meta,
+    const float *restrict y, int ld_y)
+{
+    int res = FANG_OK;
+
+    /* When `alpha` is 0, scale `dest` and return. */
+    if(FANG_UNLIKELY(alpha == 0)) {
+        for(int i = 0; i < m; i++) {
+            if(beta == 0)
+                memset(&_gamma(i, 0), 0, n * sizeof(float));
+            else {
+                for(int j = 0; j < n; j++)
+                    _gamma(i, j) *= beta;
+            }
+        }
+        goto out;
+    }
+
+    /* Loop 3 and 5 are parallel, every task owning a MCxNC block. */
+    _fang_sgemm24_par_t par = {
+        .m = m, .n = n, .k = k, .beta = beta, .dest = dest,
+        .ld_dest = ld_dest, .alpha = alpha, .x_val = x_val, .x_meta = x_meta,
+        .y = y, .ld_y = ld_y,
+        .nblk = (n + FANG_SGEMM24_NC - 1) / FANG_SGEMM24_NC
+    };
+    ptrdiff_t ntask = (ptrdiff_t) ((m + FANG_SGEMM24_MC - 1) /
+        FANG_SGEMM24_MC) * par.nblk;
+
+    int nthreads = pool == NULL ? 1 : pool->nthreads;
+    par.y_tilde = _fang_aligned_malloc((size_t) nthreads * FANG_SGEMM24_KC *
+        FANG_SGEMM24_NC * sizeof(float), 64);
+    if(FANG_UNLIKELY(par.y_tilde == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+
+    if(pool == NULL) {
+        for(ptrdiff_t t = 0; t < ntask; t++)
+            _fang_sgemm24_task(&par, t, 0);
+    } else
+        _fang_pool_for(pool, ntask, _fang_sgemm24_task, &par);
+
+    free(par.y_tilde);
+
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
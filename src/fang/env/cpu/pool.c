@@ -0,0 +1,293 @@
+#include <env/cpu/pool.h>
+#include <fang/status.h>
+#include <tune.h>
+#include <string.h>
+
+/* ================ PRIVATE MACROS ================ */
+
+/* Packs and unpacks task ranges of a slot. */
+#define _RANGE(begin, end)    ((uint64_t) (uint32_t) (end) << 32 |             \
+    (uint32_t) (begin))
+#define _BEGIN(range)         ((uint32_t) (range))
+#define _END(range)           ((uint32_t) ((range) >> 32))
+
+/* ================ PRIVATE MACROS END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Takes the front task of own slot. Returns -1 if the slot is empty. */
+FANG_HOT FANG_INLINE static inline ptrdiff_t _fang_pool_take(
+    _fang_pool_slot_t *restrict slot)
+{
+    uint64_t range = _fang_atomic_load(&slot->range);
+
+    while(_BEGIN(range) < _END(range)) {
+        if(_fang_atomic_cas(&slot->range, &range,
+            _RANGE(_BEGIN(range) + 1, _END(range))))
+        {
+            return (ptrdiff_t) _BEGIN(range);
+        }
+    }
+
+    return -1;
+}
+
+/* Steals back half of the tasks of another slot, starting from the slot next
+ * to `wid`. First stolen task is returned to be executed right away, the rest
+ * is moved to the slot of `wid`. Returns -1 if every slot is empty. */
+static ptrdiff_t _fang_pool_steal(_fang_pool_t *restrict pool, int wid) {
+    for(int i = 1; i < pool->nthreads; i++) {
+        _fang_pool_slot_t *victim = pool->slots + (wid + i) % pool->nthreads;
+        uint64_t range = _fang_atomic_load(&victim->range);
+
+        while(_BEGIN(range) < _END(range)) {
+            uint32_t begin = _BEGIN(range), end = _END(range);
+            uint32_t mid = begin + (end - begin) / 2;
+
+            if(_fang_atomic_cas(&victim->range, &range, _RANGE(begin, mid))) {
+                /* Own slot is empty, hence nobody else touches it. */
+                _fang_atomic_store(&pool->slots[wid].range,
+                    _RANGE(mid + 1, end));
+                return (ptrdiff_t) mid;
+            }
+        }
+    }
+
+    return -1;
+}
+
+/* Slot index of the calling thread; -1 if it's neither a worker nor the
+   participating submitter. */
+static int _fang_pool_wid(_fang_pool_t *restrict pool) {
+    for(int i = 0; i < pool->nworkers; i++) {
+        if(_fang_thread_is_self(pool->workers[i].thread))
+            return pool->workers[i].wid;
+    }
+    return pool->caller ? 0 : -1;
+}
+
+/* Executes tasks of current parallel loop until none is left. */
+FANG_HOT static void _fang_pool_run(_fang_pool_t *restrict pool, int wid) {
+    _fang_pool_slot_t *slot = pool->slots + wid;
+    _fang_pool_fn fn = pool->fn;
+    void *arg = pool->arg;
+
+    for(;;) {
+        ptrdiff_t task = _fang_pool_take(slot);
+        if(FANG_UNLIKELY(task < 0 && (task = _fang_pool_steal(pool, wid)) < 0))
+            break;
+
+        fn(arg, task, wid);
+    }
+}
+
+/* Main routine of pool workers. */
+static void *_fang_pool_worker_main(void *arg) {
+    _fang_pool_worker_t *worker = (_fang_pool_worker_t *) arg;
+    _fang_pool_t *pool = worker->pool;
+    uint64_t seen = 0;
+
+    for(;;) {
+        /* Parallel loops usually come in quick succession; spin a while
+           before going to sleep. */
+        for(int i = 0; i < FANG_POOL_SPIN &&
+            _fang_atomic_load(&pool->gen) == seen &&
+            !_fang_atomic_load(&pool->quit); i++)
+        {
+            _fang_thread_yield();
+        }
+
+        _fang_mutex_lock(&pool->lock);
+        while(_fang_atomic_load(&pool->gen) == seen &&
+            !_fang_atomic_load(&pool->quit))
+        {
+            _fang_cond_wait(&pool->wake, &pool->lock);
+        }
+        _fang_mutex_unlock(&pool->lock);
+
+        if(FANG_UNLIKELY(_fang_atomic_load(&pool->quit)))
+            break;
+
+        seen = _fang_atomic_load(&pool->gen);
+        _fang_pool_run(pool, worker->wid);
+
+        /* Last one out tells the submitting thread. */
+        if(_fang_atomic_fetch_add(&pool->active, -1) == 1) {
+            _fang_mutex_lock(&pool->lock);
+            _fang_cond_broadcast(&pool->done);
+            _fang_mutex_unlock(&pool->lock);
+        }
+    }
+
+    return NULL;
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Creates a pool of `nthreads` threads. If `cpus` is not NULL, thread `i` is
+   pinned to logical processor `cpus[i]`. */
+int _fang_pool_create(_fang_pool_t *restrict pool, int nthreads,
+    const int *restrict cpus, fang_reallocator_t realloc)
+{
+    int res = FANG_OK;
+
+    memset(pool, 0, sizeof(_fang_pool_t));
+    pool->realloc  = realloc;
+    pool->nthreads = nthreads;
+    pool->caller   = cpus == NULL;
+    pool->nworkers = pool->caller ? nthreads - 1 : nthreads;
+
+    pool->slots = FANG_CREATE(realloc, _fang_pool_slot_t, nthreads);
+    pool->workers = FANG_CREATE(realloc, _fang_pool_worker_t,
+        pool->nworkers > 0 ? pool->nworkers : 1);
+    if(FANG_UNLIKELY(pool->slots == NULL || pool->workers == NULL)) {
+        res = -FANG_NOMEM;
+        goto out_free;
+    }
+    memset(pool->slots, 0, nthreads * sizeof(_fang_pool_slot_t));
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_mutex_init(&pool->lock))))
+        goto out_free;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_mutex_init(&pool->submit))))
+        goto out_lock;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_cond_init(&pool->wake))))
+        goto out_submit;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_cond_init(&pool->done))))
+        goto out_wake;
+
+    /* Spawn workers; slot 0 belongs to the submitting thread if it
+       participates. */
+    int nspawned = 0;
+    for(; nspawned < pool->nworkers; nspawned++) {
+        _fang_pool_worker_t *worker = pool->workers + nspawned;
+        worker->pool = pool;
+        worker->wid  = nspawned + (pool->caller ? 1 : 0);
+
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_thread_create(&worker->thread,
+            _fang_pool_worker_main, worker))))
+        {
+            goto out_threads;
+        }
+
+        if(cpus != NULL) {
+            if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_thread_pin(worker->thread,
+                cpus[nspawned]))))
+            {
+                nspawned++;
+                goto out_threads;
+            }
+        }
+    }
+
+    return res;
+
+out_threads:
+    _fang_atomic_store(&pool->quit, true);
+    _fang_mutex_lock(&pool->lock);
+    _fang_cond_broadcast(&pool->wake);
+    _fang_mutex_unlock(&pool->lock);
+    for(int i = 0; i < nspawned; i++)
+        _fang_thread_join(pool->workers[i].thread);
+
+    _fang_cond_release(&pool->done);
+out_wake:
+    _fang_cond_release(&pool->wake);
+out_submit:
+    _fang_mutex_release(&pool->submit);
+out_lock:
+    _fang_mutex_release(&pool->lock);
+out_free:
+    FANG_RELEASE(realloc, pool->slots);
+    FANG_RELEASE(realloc, pool->workers);
+    pool->slots   = NULL;
+    pool->workers = NULL;
+    return res;
+}
+
+/* Runs `fn` for every task in [0, ntask) and waits for all of them. `ntask`
+   should fit in 32 bits. */
+void _fang_pool_for(_fang_pool_t *restrict pool, ptrdiff_t ntask,
+    _fang_pool_fn fn, void *arg)
+{
+    if(FANG_UNLIKELY(ntask <= 0))
+        return;
+
+    /* Nothing to share, or pool is busy with another parallel loop, e.g. a
+       nested one; run serially with the slot index of the calling thread.
+       Threads outside a pinned pool wait their turn instead, not to run
+       operators outside the given processors. */
+    if((pool->caller && (pool->nthreads == 1 || ntask == 1)) ||
+        !_fang_mutex_trylock(&pool->submit))
+    {
+        int wid = _fang_pool_wid(pool);
+        if(FANG_LIKELY(wid >= 0)) {
+            for(ptrdiff_t t = 0; t < ntask; t++)
+                fn(arg, t, wid);
+            return;
+        }
+        _fang_mutex_lock(&pool->submit);
+    }
+
+    /* Split tasks evenly. */
+    for(int i = 0; i < pool->nthreads; i++) {
+        ptrdiff_t begin = ntask * i / pool->nthreads;
+        ptrdiff_t end   = ntask * (i + 1) / pool->nthreads;
+        _fang_atomic_store(&pool->slots[i].range, _RANGE(begin, end));
+    }
+
+    pool->fn  = fn;
+    pool->arg = arg;
+    _fang_atomic_store(&pool->active, pool->nworkers);
+
+    _fang_mutex_lock(&pool->lock);
+    _fang_atomic_fetch_add(&pool->gen, 1);
+    _fang_cond_broadcast(&pool->wake);
+    _fang_mutex_unlock(&pool->lock);
+
+    if(pool->caller)
+        _fang_pool_run(pool, 0);
+
+    /* Wait for the workers. */
+    for(int i = 0; i < FANG_POOL_SPIN && _fang_atomic_load(&pool->active);
+        i++)
+    {
+        _fang_thread_yield();
+    }
+
+    _fang_mutex_lock(&pool->lock);
+    while(_fang_atomic_load(&pool->active))
+        _fang_cond_wait(&pool->done, &pool->lock);
+    _fang_mutex_unlock(&pool->lock);
+
+    _fang_mutex_unlock(&pool->submit);
+}
+
+/* Stops and joins all threads of a pool. */
+void _fang_pool_release(_fang_pool_t *restrict pool) {
+    if(FANG_UNLIKELY(pool->slots == NULL))
+        return;
+
+    _fang_mutex_lock(&pool->lock);
+    _fang_atomic_store(&pool->quit, true);
+    _fang_cond_broadcast(&pool->wake);
+    _fang_mutex_unlock(&pool->lock);
+
+    for(int i = 0; i < pool->nworkers; i++)
+        _fang_thread_join(pool->workers[i].thread);
+
+    _fang_cond_release(&pool->done);
+    _fang_cond_release(&pool->wake);
+    _fang_mutex_release(&pool->submit);
+    _fang_mutex_release(&pool->lock);
+
+    FANG_RELEASE(pool->realloc, pool->slots);
+    FANG_RELEASE(pool->realloc, pool->workers);
+    pool->slots   = NULL;
+    pool->workers = NULL;
+}
+
+/* ================ DEFINITIONS END ================ */
@@ -0,0 +1,661 @@
+#include <env/cpu/random.h>
+#include <env/cpu/avxmath.h>
+#include <compiler.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+/* ================ PRIVATE MACROS ================ */
+
+/* Scales to map random integers to [0, 1). */
+#define _TWO_M24    5.9604644775390625e-08f   // 2^-24
+#define _TWO_M53    1.1102230246251565e-16    // 2^-53
+
+/* 2 * pi, sqrt(2 * pi) and 1 / sqrt(2). */
+#define _TWO_PI     6.283185307179586
+#define _SQRT_2PI   2.5066282746310002
+#define _SQRT1_2    0.7071067811865476
+
+/* Below this probability mass of the truncation interval, truncated normal
+   switches from rejection to inverse CDF sampling. */
+#define _TRUNC_REJECT_MASS    0.25
+
+/* ================ PRIVATE MACROS END ================ */
+
+
+/* ================ PRIVATE DATA STRUCTURES ================ */
+
+/* Parameters of a generator. */
+typedef struct _fang_rand_param {
+    uint64_t key;
+
+    /* Distribution parameters, e.g. low and scale or mean and standard
+       deviation. Narrowed as needed. */
+    double a;
+    double b;
+
+    /* Truncation interval of standard normal. In inverse CDF sampling, holds
+       the CDF of the (mirrored) interval instead. */
+    double c;
+    double d;
+
+    /* Whether the interval was mirrored to the lower tail. */
+    bool mirror;
+
+    /* Range of bounded integers. */
+    uint64_t range;
+} _fang_rand_param_t;
+
+/* Fills a whole group `g` worth of elements. */
+typedef void (*_fang_rand_group_fn)(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param);
+
+/* ================ PRIVATE DATA STRUCTURES END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Encrypts single block `blk` of stream `ctr2` and returns word `w`. Used to
+   draw replacement words for rejection sampling. */
+FANG_INLINE static inline uint32_t _fang_philox_word(uint64_t blk,
+    uint32_t ctr2, int w, uint64_t key)
+{
+    uint32_t ctr[4] = { (uint32_t) blk, (uint32_t) (blk >> 32), ctr2, 0 };
+    _fang_philox4x32(ctr, (uint32_t) key, (uint32_t) (key >> 32));
+    return ctr[w];
+}
+
+#ifdef FANG_USE_AVX2
+
+/* Lane-wise 32x32 => 64-bit multiplication split in high and low words. */
+FANG_HOT FANG_INLINE static inline void _fang_mulhilo_epi32(__m256i a,
+    __m256i m, __m256i *restrict hi, __m256i *restrict lo)
+{
+    /* `_mm256_mul_epu32` only multiplies even lanes; odd lanes are shifted
+       down to be multiplied separately. */
+    __m256i pe = _mm256_mul_epu32(a, m);
+    __m256i po = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+
+    *lo = _mm256_blend_epi32(pe, _mm256_slli_epi64(po, 32), 0xAA);
+    *hi = _mm256_blend_epi32(_mm256_srli_epi64(pe, 32), po, 0xAA);
+}
+
+/* Encrypts all 8 blocks of group `g` at once. `r[w]` holds word `w` of each
+   block. */
+FANG_HOT FANG_INLINE static inline void _fang_philox_group256(__m256i r[4],
+    uint64_t g, uint64_t key)
+{
+    /* Group's first block is a multiple of 8; lower word never carries. */
+    uint64_t blk = g * 8;
+    __m256i c0 = _mm256_add_epi32(_mm256_set1_epi32((int) (uint32_t) blk),
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i c1 = _mm256_set1_epi32((int) (uint32_t) (blk >> 32));
+    __m256i c2 = _mm256_setzero_si256();
+    __m256i c3 = _mm256_setzero_si256();
+
+    __m256i m0 = _mm256_set1_epi32((int) _philox_m0);
+    __m256i m1 = _mm256_set1_epi32((int) _philox_m1);
+    __m256i k0 = _mm256_set1_epi32((int) (uint32_t) key);
+    __m256i k1 = _mm256_set1_epi32((int) (uint32_t) (key >> 32));
+
+    for(int i = 0; i < _philox_rounds; i++) {
+        __m256i hi0, lo0, hi1, lo1;
+        _fang_mulhilo_epi32(c0, m0, &hi0, &lo0);
+        _fang_mulhilo_epi32(c2, m1, &hi1, &lo1);
+
+        c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+        c1 = lo1;
+        c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+        c3 = lo0;
+
+        k0 = _mm256_add_epi32(k0, _mm256_set1_epi32((int) _philox_w0));
+        k1 = _mm256_add_epi32(k1, _mm256_set1_epi32((int) _philox_w1));
+    }
+
+    r[0] = c0; r[1] = c1; r[2] = c2; r[3] = c3;
+}
+
+#endif  // FANG_USE_AVX2
+
+/* Generates words of group `g` in word-major layout. */
+FANG_HOT FANG_INLINE static inline void _fang_philox_group(
+    uint32_t *restrict w, uint64_t g, uint64_t key)
+{
+#ifdef FANG_USE_AVX2
+    __m256i r[4];
+    _fang_philox_group256(r, g, key);
+    for(int i = 0; i < 4; i++)
+        _mm256_storeu_si256((__m256i *) (w + 8 * i), r[i]);
+#else
+    for(int b = 0; b < 8; b++) {
+        uint64_t blk = g * 8 + b;
+        uint32_t ctr[4] = { (uint32_t) blk, (uint32_t) (blk >> 32), 0, 0 };
+        _fang_philox4x32(ctr, (uint32_t) key, (uint32_t) (key >> 32));
+        for(int i = 0; i < 4; i++)
+            w[8 * i + b] = ctr[i];
+    }
+#endif  // FANG_USE_AVX2
+}
+
+/* 64-bit word `p` of block `b` within a group. */
+FANG_INLINE static inline uint64_t _fang_group_u64(const uint32_t *restrict w,
+    int p, int b)
+{
+    return (uint64_t) w[16 * p + b] << 32 | w[16 * p + 8 + b];
+}
+
+/* 53-bit uniform in [0, 1) from a 64-bit word. */
+FANG_INLINE static inline double _fang_u64_to_unit(uint64_t x) {
+    return (double) (x >> 11) * _TWO_M53;
+}
+
+/* 64 x 64 => 128-bit multiplication, returns high word. */
+FANG_INLINE static inline uint64_t _fang_mul64(uint64_t a, uint64_t b,
+    uint64_t *restrict lo)
+{
+    uint64_t a_lo = (uint32_t) a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t) b, b_hi = b >> 32;
+
+    uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi;
+    uint64_t hl = a_hi * b_lo, hh = a_hi * b_hi;
+    uint64_t mid = (ll >> 32) + (uint32_t) lh + (uint32_t) hl;
+
+    *lo = (mid << 32) | (uint32_t) ll;
+    return hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+}
+
+/* Standard normal CDF. Accurate in the lower tail. */
+FANG_INLINE static inline double _fang_ndtr(double x) {
+    return 0.5 * erfc(-x * _SQRT1_2);
+}
+
+/* Inverse of standard normal CDF, for `p` in (0, 1). Acklam's rational
+   approximation refined with one step of Halley's method. */
+static double _fang_ndtri(double p) {
+    static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02,
+        -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01,
+        2.506628277459239e+00 };
+    static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02,
+        -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01 };
+    static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01,
+        -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00,
+        2.938163982698783e+00 };
+    static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01,
+        2.445134137142996e+00, 3.754408661907416e+00 };
+
+    double x, q, r;
+    if(p < 0.02425) {
+        q = sqrt(-2.0 * log(p));
+        x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q +
+            c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    } else if(p <= 1.0 - 0.02425) {
+        q = p - 0.5;
+        r = q * q;
+        x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r +
+            a[5]) * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r +
+            b[4]) * r + 1.0);
+    } else {
+        q = sqrt(-2.0 * log1p(-p));
+        x = -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q +
+            c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+    }
+
+    /* Halley. */
+    double e = _fang_ndtr(x) - p;
+    double u = e * _SQRT_2PI * exp(0.5 * x * x);
+    return x - u / (1.0 + 0.5 * x * u);
+}
+
+/* ======== GROUP GENERATORS ======== */
+
+/* Uniform 32-bit words. */
+static void _fang_rand_group_u32(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param)
+{
+    _fang_philox_group((uint32_t *) out, g, param->key);
+}
+
+/* Bounded 32-bit integers. */
+static void _fang_rand_group_bounded_u32(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param)
+{
+    uint32_t *o = (uint32_t *) out;
+    uint32_t range = (uint32_t) param->range;
+
+    _fang_philox_group(o, g, param->key);
+    if(FANG_UNLIKELY(range == 0))
+        return;
+
+    /* Lemire: high word of `x * range` is uniform in [0, range) as long as
+       low word is not below `2^32 mod range`. */
+    uint32_t thres = (uint32_t) -range % range;
+
+#ifdef FANG_USE_AVX2
+    __m256i r = _mm256_set1_epi32((int) range);
+    __m256i t = _mm256_set1_epi32((int) (thres ^ 0x80000000u));
+    __m256i flip = _mm256_set1_epi32((int) 0x80000000u);
+    int reject[4];
+
+    for(int i = 0; i < 4; i++) {
+        __m256i hi, lo;
+        _fang_mulhilo_epi32(_mm256_loadu_si256((__m256i *) (o + 8 * i)), r,
+            &hi, &lo);
+        _mm256_storeu_si256((__m256i *) (o + 8 * i), hi);
+
+        /* Unsigned `lo < thres`. */
+        reject[i] = _mm256_movemask_ps(_mm256_castsi256_ps(
+            _mm256_cmpgt_epi32(t, _mm256_xor_si256(lo, flip))));
+    }
+
+    /* Redraw rejected lanes, rare enough to do it one by one. */
+    for(int i = 0; i < 4; i++) {
+        for(int b = 0; FANG_UNLIKELY(reject[i]) && b < 8; b++) {
+            if(!(reject[i] & (1 << b)))
+                continue;
+
+            uint64_t m;
+            uint32_t retry = 0;
+            do {
+                m = (uint64_t) _fang_philox_word(g * 8 + b, ++retry, i,
+                    param->key) * range;
+            } while((uint32_t) m < thres);
+            o[8 * i + b] = (uint32_t) (m >> 32);
+        }
+    }
+#else
+    for(int j = 0; j < _FANG_RAND_GROUP; j++) {
+        uint64_t m = (uint64_t) o[j] * range;
+        uint32_t retry = 0;
+        while(FANG_UNLIKELY((uint32_t) m < thres)) {
+            m = (uint64_t) _fang_philox_word(g * 8 + j % 8, ++retry, j / 8,
+                param->key) * range;
+        }
+        o[j] = (uint32_t) (m >> 32);
+    }
+#endif  // FANG_USE_AVX2
+}
+
+/* Bounded 64-bit integers. */
+static void _fang_rand_group_bounded_u64(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param)
+{
+    uint64_t *o = (uint64_t *) out;
+    uint64_t range = param->range;
+    uint64_t thres = range ? (uint64_t) -range % range : 0;
+    uint32_t w[_FANG_RAND_GROUP];
+
+    _fang_philox_group(w, g, param->key);
+
+    for(int j = 0; j < _FANG_RAND_GROUP / 2; j++) {
+        int p = j / 8, b = j % 8;
+        uint64_t x = _fang_group_u64(w, p, b);
+
+        if(FANG_UNLIKELY(range == 0)) {
+            o[j] = x;
+            continue;
+        }
+
+        uint64_t lo, hi = _fang_mul64(x, range, &lo);
+        uint32_t retry = 0;
+        while(FANG_UNLIKELY(lo < thres)) {
+            ++retry;
+            x = (uint64_t) _fang_philox_word(g * 8 + b, retry, 2 * p,
+                param->key) << 32 | _fang_philox_word(g * 8 + b, retry,
+                2 * p + 1, param->key);
+            hi = _fang_mul64(x, range, &lo);
+        }
+        o[j] = hi;
+    }
+}
+
+/* Uniform single-precision floats. */
+static void _fang_rand_group_uniform_f32(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param)
+{
+    float *o = (float *) out;
+    float low = (float) param->a, scale = (float) param->b;
+
+#ifdef FANG_USE_AVX2
+    __m256i r[4];
+    _fang_philox_group256(r, g, param->key);
+
+    __m256 vlow = _mm256_set1_ps(low);
+    __m256 vscale = _mm256_set1_ps(scale * _TWO_M24);
+    for(int i = 0; i < 4; i++) {
+        /* Top 24 bits are exactly representable. */
+        __m256 u = _mm256_cvtepi32_ps(_mm256_srli_epi32(r[i], 8));
+        _mm256_storeu_ps(o + 8 * i, _mm256_fmadd_ps(u, vscale, vlow));
+    }
+#else
+    uint32_t w[_FANG_RAND_GROUP];
+    _fang_philox_group(w, g, param->key);
+
+    float s = scale * _TWO_M24;
+    for(int j = 0; j < _FANG_RAND_GROUP; j++)
+        o[j] = fmaf((float) (w[j] >> 8), s, low);
+#endif  // FANG_USE_AVX2
+}
+
+/* Uniform double-precision floats. */
+static void _fang_rand_group_uniform_f64(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param)
+{
+    double *o = (double *) out;
+    uint32_t w[_FANG_RAND_GROUP];
+
+    _fang_philox_group(w, g, param->key);
+
+    for(int j = 0; j < _FANG_RAND_GROUP / 2; j++) {
+        o[j] = fma(_fang_u64_to_unit(_fang_group_u64(w, j / 8, j % 8)),
+            param->b, param->a);
+    }
+}
+
+/* Normally distributed single-precision floats. */
+static void _fang_rand_group_normal_f32(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param)
+{
+    float *o = (float *) out;
+    float mean = (float) param->a, std = (float) param->b;
+
+    /* Box-Muller: words `2p` and `2p + 1` of a block make a pair of uniforms
+       `u1` in (0, 1] and `u2` in [0, 1), which produce two independent
+       normals:
+         => z0 = sqrt(-2 * ln(u1)) * cos(2 * pi * u2)
+         => z1 = sqrt(-2 * ln(u1)) * sin(2 * pi * u2) */
+    /* NOTE: Unlike other generators, implementations differ in the last bits:
+     *   the vectorized one uses approximations of `avxmath.h`, the scalar one
+     *   libm. Partial groups go through the same one, hence a seed gives the
+     *   same normals for any split of a tensor, on builds of same instruction
+     *   set only.
+     */
+
+#ifdef FANG_USE_AVX2
+    __m256i r[4];
+    _fang_philox_group256(r, g, param->key);
+
+    __m256 vmean = _mm256_set1_ps(mean);
+    __m256 vstd = _mm256_set1_ps(std);
+    __m256 unit = _mm256_set1_ps(_TWO_M24);
+    for(int p = 0; p < 2; p++) {
+        __m256 u1 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(
+            _mm256_srli_epi32(r[2 * p], 8), _mm256_set1_epi32(1))), unit);
+        __m256 u2 = _mm256_mul_ps(_mm256_cvtepi32_ps(
+            _mm256_srli_epi32(r[2 * p + 1], 8)),
+            _mm256_set1_ps((float) _TWO_PI * _TWO_M24));
+
+        __m256 rad = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f),
+            _fang_logf32_ps256(u1)));
+        __m256 s, c;
+        _fang_sincosf32_ps256(u2, &s, &c);
+
+        _mm256_storeu_ps(o + 16 * p, _mm256_fmadd_ps(_mm256_mul_ps(rad, c),
+            vstd, vmean));
+        _mm256_storeu_ps(o + 16 * p + 8, _mm256_fmadd_ps(_mm256_mul_ps(rad,
+            s), vstd, vmean));
+    }
+#else
+    uint32_t w[_FANG_RAND_GROUP];
+    _fang_philox_group(w, g, param->key);
+
+    for(int p = 0; p < 2; p++) {
+        for(int b = 0; b < 8; b++) {
+            float u1 = (float) ((w[16 * p + b] >> 8) + 1) * _TWO_M24;
+            float u2 = (float) (w[16 * p + 8 + b] >> 8) *
+                ((float) _TWO_PI * _TWO_M24);
+            float rad = sqrtf(-2.0f * logf(u1));
+
+            o[16 * p + b] = fmaf(rad * cosf(u2), std, mean);
+            o[16 * p + 8 + b] = fmaf(rad * sinf(u2), std, mean);
+        }
+    }
+#endif  // FANG_USE_AVX2
+}
+
+/* Normally distributed double-precision floats. */
+static void _fang_rand_group_normal_f64(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param)
+{
+    double *o = (double *) out;
+    uint32_t w[_FANG_RAND_GROUP];
+
+    _fang_philox_group(w, g, param->key);
+
+    /* Same as single-precision, with 64-bit words `0` and `1` of a block. */
+    for(int b = 0; b < 8; b++) {
+        double u1 = _fang_u64_to_unit(_fang_group_u64(w, 0, b)) + _TWO_M53;
+        double u2 = _fang_u64_to_unit(_fang_group_u64(w, 1, b)) * _TWO_PI;
+        double rad = sqrt(-2.0 * log(u1));
+
+        o[b] = fma(rad * cos(u2), param->b, param->a);
+        o[8 + b] = fma(rad * sin(u2), param->b, param->a);
+    }
+}
+
+/* Truncated normal floats by rejection. Rejected elements are redrawn from the
+ * same position of the group in successive sub-streams (upper word of the
+ * key), hence the result stays independent of how a tensor is split. */
+#define _FANG_RAND_GROUP_TRUNC_REJECT(dt, type, per_group)                     \
+static void _fang_rand_group_trunc_reject_##dt(void *restrict out,             \
+    uint64_t g, const _fang_rand_param_t *restrict param)                      \
+{                                                                              \
+    type *o = (type *) out;                                                    \
+    type lo = (type) param->c, hi = (type) param->d;                           \
+    type z[per_group] FANG_ALIGNAS(32);                                        \
+    uint32_t reject = 0;                                                       \
+                                                                               \
+    _fang_rand_param_t std = { .key = param->key, .a = 0.0, .b = 1.0 };        \
+    _fang_rand_group_normal_##dt(o, g, &std);                                  \
+    for(int j = 0; j < per_group; j++)                                         \
+        reject |= (uint32_t) !(o[j] >= lo && o[j] <= hi) << j;                 \
+                                                                               \
+    for(uint64_t retry = 1; FANG_UNLIKELY(reject); retry++) {                  \
+        std.key = param->key + (retry << 32);                                  \
+        _fang_rand_group_normal_##dt(z, g, &std);                              \
+        for(int j = 0; j < per_group; j++) {                                   \
+            if((reject & (1u << j)) && z[j] >= lo && z[j] <= hi) {             \
+                o[j] = z[j];                                                   \
+                reject &= ~(1u << j);                                          \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    for(int j = 0; j < per_group; j++)                                         \
+        o[j] = (type) param->a + o[j] * (type) param->b;                       \
+}
+
+_FANG_RAND_GROUP_TRUNC_REJECT(f32, float, _FANG_RAND_GROUP)
+_FANG_RAND_GROUP_TRUNC_REJECT(f64, double, _FANG_RAND_GROUP / 2)
+
+#undef _FANG_RAND_GROUP_TRUNC_REJECT
+
+/* Truncated normal single-precision floats by inverse CDF. */
+static void _fang_rand_group_trunc_icdf_f32(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param)
+{
+    float *o = (float *) out;
+    uint32_t w[_FANG_RAND_GROUP];
+    double sign = param->mirror ? -1.0 : 1.0;
+
+    _fang_philox_group(w, g, param->key);
+
+    for(int j = 0; j < _FANG_RAND_GROUP; j++) {
+        /* Uniform in (0, 1), never hitting the interval ends. */
+        double u = ((double) (w[j] >> 8) + 0.5) * _TWO_M24;
+        o[j] = (float) (param->a + sign * param->b *
+            _fang_ndtri(param->c + u * (param->d - param->c)));
+    }
+}
+
+/* Truncated normal double-precision floats by inverse CDF. */
+static void _fang_rand_group_trunc_icdf_f64(void *restrict out, uint64_t g,
+    const _fang_rand_param_t *restrict param)
+{
+    double *o = (double *) out;
+    uint32_t w[_FANG_RAND_GROUP];
+    double sign = param->mirror ? -1.0 : 1.0;
+
+    _fang_philox_group(w, g, param->key);
+
+    for(int j = 0; j < _FANG_RAND_GROUP / 2; j++) {
+        double u = _fang_u64_to_unit(_fang_group_u64(w, j / 8, j % 8)) +
+            0.5 * _TWO_M53;
+        o[j] = param->a + sign * param->b *
+            _fang_ndtri(param->c + u * (param->d - param->c));
+    }
+}
+
+/* ======== GROUP GENERATORS END ======== */
+
+/* Fills `n` elements of `siz` bytes, `per_group` elements at a time. */
+FANG_HOT static void _fang_rand_drive(void *restrict out, size_t n,
+    uint64_t off, size_t siz, size_t per_group, _fang_rand_group_fn fn,
+    const _fang_rand_param_t *restrict param)
+{
+    uint64_t g = off / per_group;
+    size_t i = 0;
+
+    for(; i + per_group <= n; i += per_group, g++)
+        fn((char *) out + i * siz, g, param);
+
+    /* Partial group; generate whole and keep the front. */
+    if(FANG_UNLIKELY(i < n)) {
+        uint64_t tmp[_FANG_RAND_GROUP] FANG_ALIGNAS(32);
+        fn(tmp, g, param);
+        memcpy((char *) out + i * siz, tmp, (n - i) * siz);
+    }
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Uniform 32-bit words. */
+void _fang_rand_u32(uint32_t *restrict out, size_t n, uint64_t off,
+    uint64_t key)
+{
+    _fang_rand_param_t param = { .key = key };
+    _fang_rand_drive(out, n, off, sizeof(*out), _FANG_RAND_GROUP,
+        _fang_rand_group_u32, &param);
+}
+
+/* Unbiased uniform integers in [0, range), using Lemire's multiply-shift
+   rejection method. Whole 32-bit range if `range` is 0. */
+void _fang_rand_bounded_u32(uint32_t *restrict out, size_t n, uint64_t off,
+    uint64_t key, uint32_t range)
+{
+    _fang_rand_param_t param = { .key = key, .range = range };
+    _fang_rand_drive(out, n, off, sizeof(*out), _FANG_RAND_GROUP,
+        _fang_rand_group_bounded_u32, &param);
+}
+
+/* Unbiased uniform integers in [0, range). Whole 64-bit range if `range` is
+   0. Each element consumes two words. */
+void _fang_rand_bounded_u64(uint64_t *restrict out, size_t n, uint64_t off,
+    uint64_t key, uint64_t range)
+{
+    _fang_rand_param_t param = { .key = key, .range = range };
+    _fang_rand_drive(out, n, off, sizeof(*out), _FANG_RAND_GROUP / 2,
+        _fang_rand_group_bounded_u64, &param);
+}
+
+/* Uniform single-precision floats in [low, low + scale). */
+void _fang_rand_uniform_f32(float *restrict out, size_t n, uint64_t off,
+    uint64_t key, float low, float scale)
+{
+    _fang_rand_param_t param = { .key = key, .a = low, .b = scale };
+    _fang_rand_drive(out, n, off, sizeof(*out), _FANG_RAND_GROUP,
+        _fang_rand_group_uniform_f32, &param);
+}
+
+/* Uniform double-precision floats in [low, low + scale). Each element
+   consumes two words for full 53-bit precision. */
+void _fang_rand_uniform_f64(double *restrict out, size_t n, uint64_t off,
+    uint64_t key, double low, double scale)
+{
+    _fang_rand_param_t param = { .key = key, .a = low, .b = scale };
+    _fang_rand_drive(out, n, off, sizeof(*out), _FANG_RAND_GROUP / 2,
+        _fang_rand_group_uniform_f64, &param);
+}
+
+/* Normally distributed single-precision floats using Box-Muller
+   transformation. */
+void _fang_rand_normal_f32(float *restrict out, size_t n, uint64_t off,
+    uint64_t key, float mean, float std)
+{
+    _fang_rand_param_t param = { .key = key, .a = mean, .b = std };
+    _fang_rand_drive(out, n, off, sizeof(*out), _FANG_RAND_GROUP,
+        _fang_rand_group_normal_f32, &param);
+}
+
+/* Normally distributed double-precision floats using Box-Muller
+   transformation. */
+void _fang_rand_normal_f64(double *restrict out, size_t n, uint64_t off,
+    uint64_t key, double mean, double std)
+{
+    _fang_rand_param_t param = { .key = key, .a = mean, .b = std };
+    _fang_rand_drive(out, n, off, sizeof(*out), _FANG_RAND_GROUP / 2,
+        _fang_rand_group_normal_f64, &param);
+}
+
+/* Prepares truncated normal generation of [low, high] and chooses the
+   sampling method. */
+static _fang_rand_group_fn _fang_rand_trunc_prepare(
+    _fang_rand_param_t *restrict param, _fang_rand_group_fn reject,
+    _fang_rand_group_fn icdf)
+{
+    /* Standardize. */
+    double lo = (param->c - param->a) / param->b;
+    double hi = (param->d - param->a) / param->b;
+    double mass = _fang_ndtr(hi) - _fang_ndtr(lo);
+
+    param->c = lo;
+    param->d = hi;
+    if(mass >= _TRUNC_REJECT_MASS)
+        return reject;
+
+    /* Mirror upper tail intervals to the lower tail, where CDF has full
+       relative precision. */
+    if(lo > 0.0) {
+        param->mirror = true;
+        param->c = -hi;
+        param->d = -lo;
+    }
+
+    param->c = _fang_ndtr(param->c);
+    param->d = _fang_ndtr(param->d);
+    return icdf;
+}
+
+/* Normally distributed single-precision floats truncated to [low, high]. */
+void _fang_rand_trunc_normal_f32(float *restrict out, size_t n, uint64_t off,
+    uint64_t key, float mean, float std, float low, float high)
+{
+    _fang_rand_param_t param = { .key = key, .a = mean, .b = std, .c = low,
+        .d = high };
+    _fang_rand_group_fn fn = _fang_rand_trunc_prepare(&param,
+        _fang_rand_group_trunc_reject_f32, _fang_rand_group_trunc_icdf_f32);
+    _fang_rand_drive(out, n, off, sizeof(*out), _FANG_RAND_GROUP, fn, &param);
+
+    /* Guard against rounding at the interval ends. */
+    for(size_t i = 0; i < n; i++)
+        out[i] = out[i] < low ? low : out[i] > high ? high : out[i];
+}
+
+/* Normally distributed double-precision floats truncated to [low, high]. */
+void _fang_rand_trunc_normal_f64(double *restrict out, size_t n, uint64_t off,
+    uint64_t key, double mean, double std, double low, double high)
+{
+    _fang_rand_param_t param = { .key = key, .a = mean, .b = std, .c = low,
+        .d = high };
+    _fang_rand_group_fn fn = _fang_rand_trunc_prepare(&param,
+        _fang_rand_group_trunc_reject_f64, _fang_rand_group_trunc_icdf_f64);
+    _fang_rand_drive(out, n, off, sizeof(*out), _FANG_RAND_GROUP / 2, fn,
+        &param);
+
+    for(size_t i = 0; i < n; i++)
+        out[i] = out[i] < low ? low : out[i] > high ? high : out[i];
+}
+
+/* ================ DEFINITIONS END ================ */
@@ -0,0 +1,308 @@
+#include <env/stream.h>
+#include <fang/graph.h>
+#include <fang/status.h>
+#include <string.h>
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Number of dimensions and strides stored for a tensor; scalars carry a
+   single one. */
+FANG_INLINE static inline int _fang_env_op_ndims(const fang_ten_t *ten) {
+    return ten->ndims > 0 ? ten->ndims : 1;
+}
+
+/* Whether an operator uses data at `data`. Operators without tensors (e.g.
+   graph replays) are assumed to use any. */
+FANG_INLINE static inline bool _fang_env_op_uses(const _fang_env_op_t *op,
+    const void *data)
+{
+    if(op->ntens == 0)
+        return true;
+
+    for(int i = 0; i < op->ntens; i++) {
+        if(op->tens[i].data.dense == data)
+            return true;
+    }
+
+    return false;
+}
+
+/* Main routine of the stream thread. Executes operators in order. */
+static void *_fang_env_stream_main(void *arg) {
+    _fang_env_stream_t *stream = (_fang_env_stream_t *) arg;
+
+    _fang_mutex_lock(&stream->lock);
+    for(;;) {
+        while(stream->head == NULL && !stream->quit)
+            _fang_cond_wait(&stream->work, &stream->lock);
+
+        /* Quits only once drained. */
+        if(FANG_UNLIKELY(stream->head == NULL))
+            break;
+
+        _fang_env_op_t *op = stream->head;
+        stream->head = op->next;
+        if(stream->head == NULL)
+            stream->tail = NULL;
+        stream->running = op;
+        _fang_mutex_unlock(&stream->lock);
+
+        int res = op->fn(&op->arg);
+
+        _fang_mutex_lock(&stream->lock);
+        if(FANG_UNLIKELY(!FANG_ISOK(res) && FANG_ISOK(stream->error)))
+            stream->error = res;
+        stream->completed = op->seq;
+        stream->running   = NULL;
+        _fang_cond_broadcast(&stream->done);
+
+        FANG_RELEASE(stream->realloc, op);
+    }
+    _fang_mutex_unlock(&stream->lock);
+
+    return NULL;
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Creates a stream and it's executing thread. */
+int _fang_env_stream_create(_fang_env_stream_t **restrict stream,
+    fang_reallocator_t realloc)
+{
+    int res = FANG_OK;
+
+    _fang_env_stream_t *new = FANG_CREATE(realloc, _fang_env_stream_t, 1);
+    if(FANG_UNLIKELY(new == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    memset(new, 0, sizeof(_fang_env_stream_t));
+    new->realloc = realloc;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_mutex_init(&new->lock))))
+        goto out_free;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_cond_init(&new->work))))
+        goto out_lock;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_cond_init(&new->done))))
+        goto out_work;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_thread_create(&new->thread,
+        _fang_env_stream_main, new))))
+    {
+        goto out_done;
+    }
+
+    *stream = new;
+    goto out;
+
+out_done:
+    _fang_cond_release(&new->done);
+out_work:
+    _fang_cond_release(&new->work);
+out_lock:
+    _fang_mutex_release(&new->lock);
+out_free:
+    FANG_RELEASE(realloc, new);
+out:
+    return res;
+}
+
+/* Creates an operator node, deep copying tensors of `arg` pointed by
+   `mask`, and array of `x` if `_FANG_SUBMIT_XARRAY` is set. */
+int _fang_env_op_create(_fang_env_op_t **restrict op, fang_env_t *restrict env,
+    fang_ten_operator_fn fn, fang_ten_ops_arg_t *restrict arg, int mask)
+{
+    int res = FANG_OK;
+
+    /* Tensor fields, in the order their copies are stored. */
+    fang_gen_t fields[] = { arg->dest, arg->x, arg->y, arg->z, arg->alpha,
+        arg->beta };
+
+    size_t nmeta = 0;
+    for(int i = 0; i < _FANG_SUBMIT_NFIELDS; i++) {
+        if(mask & (1 << i))
+            nmeta += 2 * _fang_env_op_ndims((fang_ten_t *) fields[i]);
+    }
+
+    /* Array is stored after the metadata, aligned for pointers. */
+    size_t size = sizeof(_fang_env_op_t) + nmeta * sizeof(uint32_t), narr = 0;
+    if(mask & _FANG_SUBMIT_XARRAY) {
+        size = (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+        narr = (size_t) FANG_G2I(arg->z);
+    }
+
+    _fang_env_op_t *new = (_fang_env_op_t *) env->realloc(NULL,
+        size + narr * sizeof(void *));
+    if(FANG_UNLIKELY(new == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+
+    new->next  = NULL;
+    new->seq   = 0;
+    new->fn    = fn;
+    new->arg   = *arg;
+    new->ntens = 0;
+    new->overwrite = (mask & _FANG_SUBMIT_OVERWRITE) != 0;
+
+    /* Deep copy tensors, pointing the argument at the copies. */
+    fang_gen_t *new_fields[] = { &new->arg.dest, &new->arg.x, &new->arg.y,
+        &new->arg.z, &new->arg.alpha, &new->arg.beta };
+    uint32_t *meta = new->meta;
+    for(int i = 0; i < _FANG_SUBMIT_NFIELDS; i++) {
+        if(!(mask & (1 << i)))
+            continue;
+
+        fang_ten_t *src = (fang_ten_t *) fields[i];
+        fang_ten_t *dst = new->tens + new->ntens++;
+        int ndims = _fang_env_op_ndims(src);
+
+        /* Scalars have neither dimensions nor strides, nor do their
+           copies. */
+        *dst = *src;
+        if(src->dims != NULL) {
+            memcpy(meta, src->dims, ndims * sizeof(uint32_t));
+            dst->dims = meta;
+        }
+        if(src->strides != NULL) {
+            memcpy(meta + ndims, src->strides, ndims * sizeof(uint32_t));
+            dst->strides = meta + ndims;
+        }
+        meta += 2 * ndims;
+
+        *new_fields[i] = (fang_gen_t) dst;
+    }
+
+    if(mask & _FANG_SUBMIT_XARRAY) {
+        void **arr = (void **) ((char *) new + size);
+        memcpy(arr, (void *) arg->x, narr * sizeof(void *));
+        new->arg.x = (fang_gen_t) arr;
+    }
+
+    *op = new;
+
+out:
+    return res;
+}
+
+/* Runs an operator right away if the Environment is synchronous, records it
+   if a graph is being captured, otherwise enqueues it. `mask` tells which
+   fields of `arg` hold tensors. */
+int _fang_env_submit(fang_env_t *restrict env, fang_ten_operator_fn fn,
+    fang_ten_ops_arg_t *restrict arg, int mask)
+{
+    int res = FANG_OK;
+
+    _fang_env_stream_t *stream = env->stream;
+    fang_graph_t *graph = env->graph;
+    if(FANG_LIKELY(stream == NULL && graph == NULL)) {
+        res = fn(arg);
+        goto out;
+    }
+
+    _fang_env_op_t *op;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_op_create(&op, env, fn, arg,
+        mask))))
+    {
+        goto out;
+    }
+
+    /* Captured operators run on replay only. */
+    if(graph != NULL) {
+        _fang_graph_append(graph, op);
+        goto out;
+    }
+
+    _fang_mutex_lock(&stream->lock);
+    op->seq = _fang_atomic_fetch_add(&stream->submitted, 1) + 1;
+    if(stream->tail != NULL)
+        stream->tail->next = op;
+    else
+        stream->head = op;
+    stream->tail = op;
+    _fang_cond_broadcast(&stream->work);
+    _fang_mutex_unlock(&stream->lock);
+
+out:
+    return res;
+}
+
+/* Waits until operator `seq` has completed. Returns first error raised by an
+   operator since last wait. */
+int _fang_env_stream_wait(_fang_env_stream_t *restrict stream, uint64_t seq) {
+    _fang_mutex_lock(&stream->lock);
+
+    /* Such operator would never complete. */
+    if(FANG_UNLIKELY(seq > stream->submitted)) {
+        _fang_mutex_unlock(&stream->lock);
+        return -FANG_INVFENCE;
+    }
+
+    while(stream->completed < seq)
+        _fang_cond_wait(&stream->done, &stream->lock);
+
+    int res = stream->error;
+    stream->error = FANG_OK;
+
+    _fang_mutex_unlock(&stream->lock);
+
+    return res;
+}
+
+/* Gets first error raised by an operator since last wait, keeping it for the
+   next wait. */
+int _fang_env_stream_error(_fang_env_stream_t *restrict stream) {
+    _fang_mutex_lock(&stream->lock);
+    int res = stream->error;
+    _fang_mutex_unlock(&stream->lock);
+
+    return res;
+}
+
+/* Waits for every pending operator using data at `data`. Errors are kept for
+   the next wait. */
+void _fang_env_stream_wait_data(_fang_env_stream_t *restrict stream,
+    const void *data)
+{
+    uint64_t seq = 0;
+
+    /* Queue is in order, the last user decides. */
+    _fang_mutex_lock(&stream->lock);
+    if(stream->running != NULL && _fang_env_op_uses(stream->running, data))
+        seq = stream->running->seq;
+    for(_fang_env_op_t *op = stream->head; op != NULL; op = op->next) {
+        if(_fang_env_op_uses(op, data))
+            seq = op->seq;
+    }
+
+    while(stream->completed < seq)
+        _fang_cond_wait(&stream->done, &stream->lock);
+    _fang_mutex_unlock(&stream->lock);
+}
+
+/* Waits for every submitted operator. Errors are kept for the next wait. */
+void _fang_env_stream_drain(_fang_env_stream_t *restrict stream) {
+    _fang_mutex_lock(&stream->lock);
+    while(stream->completed < stream->submitted)
+        _fang_cond_wait(&stream->done, &stream->lock);
+    _fang_mutex_unlock(&stream->lock);
+}
+
+/* Drains and releases a stream. */
+void _fang_env_stream_release(_fang_env_stream_t *restrict stream) {
+    _fang_mutex_lock(&stream->lock);
+    stream->quit = true;
+    _fang_cond_broadcast(&stream->work);
+    _fang_mutex_unlock(&stream->lock);
+
+    _fang_thread_join(stream->thread);
+
+    _fang_cond_release(&stream->done);
+    _fang_cond_release(&stream->work);
+    _fang_mutex_release(&stream->lock);
+    FANG_RELEASE(stream->realloc, stream);
+}
+
+/* ================ DEFINITIONS END ================ */
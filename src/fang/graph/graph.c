@@ -0,0 +1,332 @@
+#include <fang/graph.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <env/stream.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Operator running every operator of a graph passed as `dest`. Stops at the
+   first failing one. */
+FANG_HOT static int _fang_graph_run(fang_ten_ops_arg_t *restrict arg) {
+    int res = FANG_OK;
+
+    fang_graph_t *graph = (fang_graph_t *) arg->dest;
+    for(_fang_env_op_t *op = graph->head; op != NULL; op = op->next) {
+        if(FANG_UNLIKELY(!FANG_ISOK(res = op->fn(&op->arg))))
+            break;
+    }
+
+    return res;
+}
+
+/* Data of planned tensors lives in the slab of the graph. */
+static void _fang_graph_slab_deleter(FANG_UNUSED void *data) {}
+
+/* Lifetime and placement of a planned tensor. */
+typedef struct _fang_graph_live {
+    void *data;
+    int first;  // First operator using it, -1 if unused
+    int last;   // Last operator using it
+    size_t siz;
+    size_t off;
+} _fang_graph_live_t;
+
+/* Assigns slab offsets greedily, largest tensor first, each to the lowest
+ * offset not overlapping any placed tensor of overlapping lifetime. Returns
+ * the slab size. */
+static size_t _fang_graph_place(_fang_graph_live_t *live, int nlive) {
+    size_t slab = 0;
+
+    for(int n = 0; n < nlive; n++) {
+        /* Largest unplaced tensor. */
+        int pick = -1;
+        for(int i = 0; i < nlive; i++) {
+            if(live[i].off == SIZE_MAX && live[i].first >= 0 &&
+                (pick < 0 || live[i].siz > live[pick].siz))
+            {
+                pick = i;
+            }
+        }
+        if(pick < 0)
+            break;
+
+        /* Move past conflicts until there are none. */
+        size_t off = 0;
+        for(int i = 0; i < nlive; i++) {
+            _fang_graph_live_t *other = live + i;
+
+            if(other->off == SIZE_MAX || other->first < 0 ||
+                other->last < live[pick].first ||
+                other->first > live[pick].last ||
+                other->off >= off + live[pick].siz ||
+                other->off + other->siz <= off)
+            {
+                continue;
+            }
+
+            off = other->off + other->siz;
+            i = -1;  // Recheck everything at new offset
+        }
+
+        live[pick].off = off;
+        slab = slab > off + live[pick].siz ? slab : off + live[pick].siz;
+    }
+
+    return slab;
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Starts capturing operators of an Environment into a graph. */
+int fang_graph_begin(fang_graph_t *graph, int eid) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    /* Only a single graph is captured at a time. `graph` is reset only by
+       the thread winning the capture, not to wipe one in progress when
+       several threads begin on it; operators are appended by the capturing
+       thread alone, hence none lands in `graph` before it's reset. */
+    fang_graph_t *none = NULL;
+    fang_graph_t reset = { .eid = eid };
+    if(FANG_UNLIKELY(!_fang_atomic_cas(&env->graph, &none, graph))) {
+        res = -FANG_CAPTURING;
+        goto out;
+    }
+
+    *graph = reset;
+
+out:
+    return res;
+}
+
+/* Ends capturing a graph. */
+int fang_graph_end(fang_graph_t *graph) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, graph->eid))))
+        goto out;
+
+    if(FANG_UNLIKELY(!_fang_atomic_cas(&env->graph, &graph, NULL))) {
+        res = -FANG_NOCAPTURE;
+        goto out;
+    }
+
+out:
+    return res;
+}
+
+/* Replays a graph. */
+int fang_graph_replay(fang_graph_t *graph) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, graph->eid))))
+        goto out;
+
+    /* A graph can not replay into itself. */
+    if(FANG_UNLIKELY(env->graph == graph)) {
+        res = -FANG_CAPTURING;
+        goto out;
+    }
+
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) graph
+    };
+    res = _fang_env_submit(env, _fang_graph_run, &arg, 0);
+
+out:
+    return res;
+}
+
+/* Plans memory of intermediate tensors of a captured graph. */
+int fang_graph_plan(fang_graph_t *graph, fang_ten_t **tens, int ntens) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, graph->eid))))
+        goto out;
+
+    if(FANG_UNLIKELY(env->graph == graph)) {
+        res = -FANG_CAPTURING;
+        goto out;
+    }
+
+    /* Planned only once, and only tensors the Environment owns data of. */
+    if(FANG_UNLIKELY(graph->slab != NULL || ntens < 1)) {
+        res = -FANG_NOPLAN;
+        goto out;
+    }
+    for(int i = 0; i < ntens; i++) {
+        if(FANG_UNLIKELY(tens[i]->typ != FANG_TEN_TYPE_DENSE ||
+            tens[i]->eid != graph->eid || tens[i]->deleter != NULL))
+        {
+            res = -FANG_NOPLAN;
+            goto out;
+        }
+
+        for(int j = 0; j < i; j++) {
+            if(FANG_UNLIKELY(tens[j]->data.dense == tens[i]->data.dense)) {
+                res = -FANG_NOPLAN;
+                goto out;
+            }
+        }
+    }
+
+    /* Data of planned tensors is about to move. */
+    if(env->stream != NULL)
+        _fang_env_stream_drain(env->stream);
+
+    _fang_graph_live_t *live = FANG_CREATE(env->realloc, _fang_graph_live_t,
+        ntens);
+    if(FANG_UNLIKELY(live == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+
+    for(int i = 0; i < ntens; i++) {
+        size_t nelem = 1;
+        for(int d = 0; d < tens[i]->ndims; d++)
+            nelem *= tens[i]->dims[d];
+
+        /* Keep every tensor aligned. */
+        size_t siz = nelem * _fang_ten_dsiz[(int) tens[i]->dtyp];
+        live[i] = (_fang_graph_live_t) {
+            .data = tens[i]->data.dense,
+            .first = -1,
+            .last = -1,
+            .siz = (siz + FANG_MEMALIGN - 1) & ~((size_t) FANG_MEMALIGN - 1),
+            .off = SIZE_MAX
+        };
+    }
+
+    /* Lifetimes, in terms of operator indices. */
+    int idx = 0;
+    for(_fang_env_op_t *op = graph->head; op != NULL; op = op->next, idx++) {
+        /* Contents of other graphs are unknown. */
+        if(FANG_UNLIKELY(op->ntens == 0)) {
+            res = -FANG_NOPLAN;
+            goto out_live;
+        }
+
+        for(int t = 0; t < op->ntens; t++) {
+            for(int i = 0; i < ntens; i++) {
+                if(op->tens[t].data.dense != live[i].data)
+                    continue;
+
+                /* Life starts by being overwritten, otherwise data from
+                   before the graph would be needed. */
+                if(live[i].first < 0) {
+                    bool written = op->overwrite &&
+                        op->arg.dest == (fang_gen_t) &op->tens[t];
+
+                    /* Not read by the very same operator either. */
+                    for(int u = t + 1; u < op->ntens; u++)
+                        written &= op->tens[u].data.dense != live[i].data;
+
+                    if(FANG_UNLIKELY(!written)) {
+                        res = -FANG_NOPLAN;
+                        goto out_live;
+                    }
+
+                    live[i].first = idx;
+                }
+                live[i].last = idx;
+            }
+        }
+    }
+
+    graph->slab_siz = _fang_graph_place(live, ntens);
+    graph->slab = graph->slab_siz > 0 ?
+        env->realloc(NULL, graph->slab_siz) : NULL;
+    if(FANG_UNLIKELY(graph->slab_siz > 0 && graph->slab == NULL)) {
+        res = -FANG_NOMEM;
+        goto out_live;
+    }
+
+    /* Move operators and tensors into the slab. */
+    for(_fang_env_op_t *op = graph->head; op != NULL; op = op->next) {
+        for(int t = 0; t < op->ntens; t++) {
+            for(int i = 0; i < ntens; i++) {
+                if(live[i].first >= 0 && op->tens[t].data.dense ==
+                    live[i].data)
+                {
+                    op->tens[t].data.dense = (char *) graph->slab +
+                        live[i].off;
+                }
+            }
+        }
+    }
+    for(int i = 0; i < ntens; i++) {
+        if(live[i].first < 0)
+            continue;
+
+        FANG_RELEASE(env->realloc, tens[i]->data.dense);
+        tens[i]->data.dense = (char *) graph->slab + live[i].off;
+        tens[i]->deleter    = _fang_graph_slab_deleter;
+    }
+
+out_live:
+    FANG_RELEASE(env->realloc, live);
+out:
+    return res;
+}
+
+/* Releases a graph, ending the capture if still active. */
+int fang_graph_release(fang_graph_t *graph) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, graph->eid))))
+        goto out;
+
+    /* Not capturing is fine. */
+    fang_graph_end(graph);
+
+    /* Graph may still be queued for replay. */
+    if(env->stream != NULL)
+        _fang_env_stream_drain(env->stream);
+
+    for(_fang_env_op_t *op = graph->head, *next; op != NULL; op = next) {
+        next = op->next;
+        FANG_RELEASE(env->realloc, op);
+    }
+
+    FANG_RELEASE(env->realloc, graph->slab);
+
+    graph->head = graph->tail = NULL;
+    graph->slab = NULL;
+    graph->nops = 0;
+    graph->slab_siz = 0;
+
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Appends an operator to a graph being captured. */
+void _fang_graph_append(fang_graph_t *restrict graph,
+    _fang_env_op_t *restrict op)
+{
+    if(graph->tail != NULL)
+        graph->tail->next = op;
+    else
+        graph->head = op;
+
+    graph->tail = op;
+    graph->nops++;
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
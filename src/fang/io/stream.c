@@ -0,0 +1,496 @@
+#include <fang/io.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <platform/file.h>
+#include <platform/thread.h>
+#include <compiler.h>
+#include <string.h>
+
+/* ================ PRIVATE MACROS ================ */
+
+/* Offset of the first sample in the file. */
+#define _FANG_IO_DATA_OFFSET    sizeof(fang_io_header_t)
+
+/* States of a batch slot. */
+#define _FANG_IO_SLOT_EMPTY      0  // Free to be filled by prefetch thread
+#define _FANG_IO_SLOT_FILLING    1  // Being filled by prefetch thread
+#define _FANG_IO_SLOT_READY      2  // Filled, waiting for/held by consumer
+
+/* ================ PRIVATE MACROS END ================ */
+
+
+/* ================ PRIVATE DATA STRUCTURES ================ */
+
+/* A pre-allocated batch tensor. */
+typedef struct _fang_io_slot {
+    fang_ten_t ten;
+
+    /* One of `_FANG_IO_SLOT_*`. */
+    int state;
+
+    /* Samples read into the slot, 0 at end of file, negative on error. */
+    int64_t nsamples;
+} _fang_io_slot_t;
+
+/* Double buffered state shared between consumer and prefetch thread. */
+struct fang_io_stream {
+    /* Batch tensors, consumed and filled in turns. */
+    _fang_io_slot_t slot[2];
+
+    /* File descriptor. */
+    int fd;
+
+    /* Size of a single sample in bytes. */
+    uint64_t sample_siz;
+
+    /* Total samples and samples per batch. */
+    uint64_t count;
+    uint32_t batch;
+
+    /* Next sample to be read by prefetch thread. */
+    uint64_t pos;
+
+    /* Slot to be filled next, slot to be consumed next and slot currently
+       held by the consumer (-1 if none). */
+    int fill;
+    int read;
+    int held;
+
+    /* Whether end of file has been posted. */
+    int done;
+
+    /* Whether prefetch thread should exit. */
+    int stop;
+
+    /* Bumped on rewind, so in-flight reads of older pass get discarded. */
+    uint64_t gen;
+
+    _fang_thread_t thread;
+    _fang_mutex_t lock;
+    _fang_cond_t cond;
+
+    /* Reallocator used to allocate this structure. */
+    fang_reallocator_t realloc;
+};
+
+/* ================ PRIVATE DATA STRUCTURES END ================ */
+
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Size of a single sample described by header. */
+static uint64_t _fang_io_sample_siz(const fang_io_header_t *restrict header) {
+    uint64_t siz = _fang_ten_dsiz[header->dtyp];
+    for(uint32_t i = 0; i < header->ndims; i++)
+        siz *= header->dims[i];
+
+    return siz;
+}
+
+/* Validates header read from a file. */
+static int _fang_io_check_header(const fang_io_header_t *restrict header) {
+    if(FANG_UNLIKELY(memcmp(header->magic, FANG_IO_MAGIC,
+        sizeof(header->magic)) || header->version != FANG_IO_VERSION ||
+        header->dtyp < FANG_TEN_DTYPE_INT8 ||
+        header->dtyp > FANG_TEN_DTYPE_FLOAT64 ||
+        header->ndims > FANG_IO_MAX_DIMS))
+    {
+        return -FANG_INVFILE;
+    }
+
+    for(uint32_t i = 0; i < header->ndims; i++) {
+        if(FANG_UNLIKELY(header->dims[i] == 0))
+            return -FANG_INVFILE;
+    }
+
+    return FANG_OK;
+}
+
+/* Background thread, keeps filling empty slots in turns ahead of the
+   consumer. */
+static void *_fang_io_prefetch(void *arg) {
+    fang_io_stream_t *stream = (fang_io_stream_t *) arg;
+
+    _fang_mutex_lock(&stream->lock);
+    for(;;) {
+        /* Wait until the next slot is handed back, or for rewind if end of
+           file was already posted. */
+        while(!stream->stop && (stream->done ||
+            stream->slot[stream->fill].state != _FANG_IO_SLOT_EMPTY))
+        {
+            _fang_cond_wait(&stream->cond, &stream->lock);
+        }
+        if(FANG_UNLIKELY(stream->stop))
+            break;
+
+        /* Claim the slot. */
+        _fang_io_slot_t *slot = &stream->slot[stream->fill];
+        uint64_t gen  = stream->gen;
+        uint64_t pos  = stream->pos;
+        uint64_t nsmp = stream->count - pos < stream->batch ?
+            stream->count - pos : stream->batch;
+
+        slot->state = _FANG_IO_SLOT_FILLING;
+        stream->pos += nsmp;
+        stream->fill ^= 1;
+        if(nsmp == 0)
+            stream->done = 1;
+
+        /* Read without holding the lock, consumer may proceed meanwhile. */
+        _fang_mutex_unlock(&stream->lock);
+
+        int64_t res = 0;
+        if(FANG_LIKELY(nsmp > 0)) {
+            uint64_t siz = nsmp * stream->sample_siz;
+            res = _fang_file_pread(stream->fd, slot->ten.data.dense, siz,
+                _FANG_IO_DATA_OFFSET + pos * stream->sample_siz);
+
+            /* Truncated file. */
+            if(FANG_LIKELY(res >= 0))
+                res = (uint64_t) res == siz ? (int64_t) nsmp : -FANG_INVFILE;
+        }
+
+        _fang_mutex_lock(&stream->lock);
+
+        /* Stale read from before a rewind. */
+        if(FANG_UNLIKELY(gen != stream->gen)) {
+            slot->state = _FANG_IO_SLOT_EMPTY;
+        } else {
+            /* Shrink leading dimension for the last batch. */
+            if(FANG_LIKELY(res > 0))
+                slot->ten.dims[0] = (uint32_t) res;
+
+            slot->nsamples = res;
+            slot->state = _FANG_IO_SLOT_READY;
+        }
+        _fang_cond_broadcast(&stream->cond);
+    }
+    _fang_mutex_unlock(&stream->lock);
+
+    return NULL;
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Creates a chunked tensor file holding samples of shape `sample`. */
+int fang_io_writer_create(fang_io_writer_t *restrict writer,
+    const char *restrict path, fang_ten_dtype_t dtyp, fang_ten_dim_t sample)
+{
+    int res = FANG_OK;
+
+    /* Validate sample shape and data type. */
+    if(FANG_UNLIKELY(dtyp < FANG_TEN_DTYPE_INT8 ||
+        dtyp > FANG_TEN_DTYPE_FLOAT64))
+    {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+    if(FANG_UNLIKELY(sample.ndims < 0 || sample.ndims > FANG_IO_MAX_DIMS ||
+        (sample.ndims > 0 && sample.dims == NULL)))
+    {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    memset(&writer->header, 0, sizeof(writer->header));
+    memcpy(writer->header.magic, FANG_IO_MAGIC, sizeof(writer->header.magic));
+    writer->header.version = FANG_IO_VERSION;
+    writer->header.dtyp    = (int32_t) dtyp;
+    writer->header.ndims   = (uint32_t) sample.ndims;
+    for(int i = 0; i < sample.ndims; i++) {
+        if(FANG_UNLIKELY(sample.dims[i] == 0)) {
+            res = -FANG_INVDIM;
+            goto out;
+        }
+        writer->header.dims[i] = sample.dims[i];
+    }
+    writer->sample_siz = _fang_io_sample_siz(&writer->header);
+
+    /* Create the file and write an empty header, finalized on release. */
+    res = _fang_file_open(path, 1);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out;
+    writer->fd = res;
+
+    res = _fang_file_pwrite(writer->fd, &writer->header,
+        sizeof(writer->header), 0);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        _fang_file_close(writer->fd);
+
+out:
+    return res;
+}
+
+/* Appends samples of a dense tensor to the file. Tensor is either a single
+   sample or a batch of samples with leading batch dimension. */
+int fang_io_writer_write(fang_io_writer_t *restrict writer,
+    fang_ten_t *restrict ten)
+{
+    int res = FANG_OK;
+    fang_env_t *env;
+
+    res = _fang_env_retrieve(&env, ten->eid);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out;
+
+    /* Data is written directly from tensor memory. */
+    if(FANG_UNLIKELY(env->type != FANG_ENV_TYPE_CPU)) {
+        res = -FANG_INVENVTYP;
+        goto out;
+    }
+    if(FANG_UNLIKELY(ten->typ != FANG_TEN_TYPE_DENSE)) {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+    if(FANG_UNLIKELY((int32_t) ten->dtyp != writer->header.dtyp)) {
+        res = -FANG_IONOMATCH;
+        goto out;
+    }
+
+    /* Single sample, or batch of samples? */
+    uint32_t lead = ten->ndims - writer->header.ndims;
+    if(FANG_UNLIKELY(lead > 1)) {
+        res = -FANG_IONOMATCH;
+        goto out;
+    }
+    for(uint32_t i = 0; i < writer->header.ndims; i++) {
+        if(FANG_UNLIKELY(ten->dims[lead + i] != writer->header.dims[i])) {
+            res = -FANG_IONOMATCH;
+            goto out;
+        }
+    }
+    uint64_t nsmp = lead ? ten->dims[0] : 1;
+
+    /* Data may still be being computed. */
+    if(FANG_UNLIKELY(!FANG_ISOK(res = fang_ten_wait(ten))))
+        goto out;
+
+    res = _fang_file_pwrite(writer->fd, ten->data.dense,
+        nsmp * writer->sample_siz, _FANG_IO_DATA_OFFSET +
+        writer->header.count * writer->sample_siz);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out;
+
+    writer->header.count += nsmp;
+
+out:
+    return res;
+}
+
+/* Finalizes the header and closes the file. */
+int fang_io_writer_release(fang_io_writer_t *restrict writer) {
+    int res = _fang_file_pwrite(writer->fd, &writer->header,
+        sizeof(writer->header), 0);
+    _fang_file_close(writer->fd);
+
+    return res;
+}
+
+/* Opens a chunked tensor file for streaming `batch` samples at a time into
+   tensors of Environment `eid`. */
+int fang_io_reader_create(fang_io_reader_t *restrict reader, int eid,
+    const char *restrict path, uint32_t batch)
+{
+    int res = FANG_OK;
+    int nslot = 0;
+    fang_env_t *env;
+    fang_io_stream_t *stream = NULL;
+    fang_io_header_t header;
+
+    res = _fang_env_retrieve(&env, eid);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out;
+
+    /* Samples are read directly into tensor memory. */
+    if(FANG_UNLIKELY(env->type != FANG_ENV_TYPE_CPU)) {
+        res = -FANG_INVENVTYP;
+        goto out;
+    }
+    if(FANG_UNLIKELY(batch == 0)) {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    stream = FANG_CREATE(env->realloc, fang_io_stream_t, 1);
+    if(FANG_UNLIKELY(stream == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    memset(stream, 0, sizeof(*stream));
+    stream->realloc = env->realloc;
+
+    /* Open and validate the file. */
+    res = _fang_file_open(path, 0);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out_free;
+    stream->fd = res;
+
+    res = (int) _fang_file_pread(stream->fd, &header, sizeof(header), 0);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out_close;
+    if(FANG_UNLIKELY((size_t) res != sizeof(header))) {
+        res = -FANG_INVFILE;
+        goto out_close;
+    }
+    res = _fang_io_check_header(&header);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out_close;
+
+    _fang_file_advise_sequential(stream->fd);
+
+    stream->sample_siz = _fang_io_sample_siz(&header);
+    stream->count = header.count;
+    stream->batch = batch;
+    stream->held  = -1;
+
+    /* Pre-allocate both batch tensors of shape (batch, sample...). */
+    uint32_t dims[FANG_IO_MAX_DIMS + 1];
+    dims[0] = batch;
+    memcpy(dims + 1, header.dims, header.ndims * sizeof(*dims));
+
+    for(; nslot < 2; nslot++) {
+        res = fang_ten_create(&stream->slot[nslot].ten, eid,
+            (fang_ten_dtype_t) header.dtyp, (fang_ten_dim_t) {
+                .dims = dims, .ndims = header.ndims + 1
+            }, NULL);
+        if(FANG_UNLIKELY(!FANG_ISOK(res)))
+            goto out_release;
+    }
+
+    res = _fang_mutex_init(&stream->lock);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out_release;
+    res = _fang_cond_init(&stream->cond);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out_mutex;
+
+    /* Start prefetching right away. */
+    res = _fang_thread_create(&stream->thread, _fang_io_prefetch, stream);
+    if(FANG_UNLIKELY(!FANG_ISOK(res)))
+        goto out_cond;
+
+    reader->dtyp   = (fang_ten_dtype_t) header.dtyp;
+    reader->count  = header.count;
+    reader->batch  = batch;
+    reader->stream = stream;
+    goto out;
+
+out_cond:
+    _fang_cond_release(&stream->cond);
+out_mutex:
+    _fang_mutex_release(&stream->lock);
+out_release:
+    while(nslot-- > 0)
+        fang_ten_release(&stream->slot[nslot].ten);
+out_close:
+    _fang_file_close(stream->fd);
+out_free:
+    FANG_RELEASE(env->realloc, stream);
+out:
+    return res;
+}
+
+/* Retrieves the next batch. Returns number of samples in the batch, 0 at the
+   end of file or negative status on error. */
+int64_t fang_io_reader_next(fang_io_reader_t *restrict reader,
+    fang_ten_t **ten)
+{
+    fang_io_stream_t *stream = reader->stream;
+
+    /* Operators may still be reading the previous batch. */
+    if(FANG_LIKELY(stream->held >= 0)) {
+        int res = fang_ten_wait(&stream->slot[stream->held].ten);
+        if(FANG_UNLIKELY(!FANG_ISOK(res)))
+            return res;
+    }
+
+    _fang_mutex_lock(&stream->lock);
+
+    /* Hand the previous batch back to the prefetch thread. */
+    if(FANG_LIKELY(stream->held >= 0)) {
+        stream->slot[stream->held].state = _FANG_IO_SLOT_EMPTY;
+        stream->held = -1;
+        _fang_cond_broadcast(&stream->cond);
+    }
+
+    /* Only blocks if disk could not keep up. */
+    _fang_io_slot_t *slot = &stream->slot[stream->read];
+    while(FANG_UNLIKELY(slot->state != _FANG_IO_SLOT_READY))
+        _fang_cond_wait(&stream->cond, &stream->lock);
+
+    /* End of file and errors are sticky until rewind. */
+    int64_t res = slot->nsamples;
+    if(FANG_LIKELY(res > 0)) {
+        stream->held = stream->read;
+        stream->read ^= 1;
+        *ten = &slot->ten;
+    } else {
+        *ten = NULL;
+    }
+
+    _fang_mutex_unlock(&stream->lock);
+
+    return res;
+}
+
+/* Restarts streaming from the first sample, e.g. for next epoch. */
+int fang_io_reader_rewind(fang_io_reader_t *restrict reader) {
+    fang_io_stream_t *stream = reader->stream;
+
+    _fang_mutex_lock(&stream->lock);
+
+    stream->gen++;
+    stream->pos  = 0;
+    stream->fill = 0;
+    stream->read = 0;
+    stream->held = -1;
+    stream->done = 0;
+
+    /* Slot being filled is discarded by prefetch thread itself. */
+    for(int i = 0; i < 2; i++) {
+        if(stream->slot[i].state != _FANG_IO_SLOT_FILLING)
+            stream->slot[i].state = _FANG_IO_SLOT_EMPTY;
+    }
+
+    _fang_cond_broadcast(&stream->cond);
+    _fang_mutex_unlock(&stream->lock);
+
+    return FANG_OK;
+}
+
+/* Stops prefetching, releases the batch tensors and closes the file. */
+int fang_io_reader_release(fang_io_reader_t *restrict reader) {
+    int res = FANG_OK;
+    fang_io_stream_t *stream = reader->stream;
+
+    if(FANG_UNLIKELY(stream == NULL))
+        goto out;
+
+    _fang_mutex_lock(&stream->lock);
+    stream->stop = 1;
+    _fang_cond_broadcast(&stream->cond);
+    _fang_mutex_unlock(&stream->lock);
+
+    res = _fang_thread_join(stream->thread);
+
+    _fang_cond_release(&stream->cond);
+    _fang_mutex_release(&stream->lock);
+    _fang_file_close(stream->fd);
+
+    /* Restore full leading dimension before release. */
+    for(int i = 0; i < 2; i++) {
+        stream->slot[i].ten.dims[0] = stream->batch;
+        fang_ten_release(&stream->slot[i].ten);
+    }
+
+    FANG_RELEASE(stream->realloc, stream);
+    reader->stream = NULL;
+
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
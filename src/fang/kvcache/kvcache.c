@@ -0,0 +1,334 @@
+#include <fang/kvcache.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <env/stream.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Heads of a tensor of (..., n, d) matrices. */
+FANG_INLINE static inline uint64_t _fang_kvcache_heads(const fang_ten_t *ten) {
+    uint64_t res = 1;
+    for(int i = 0; i < ten->ndims - 2; i++)
+        res *= ten->dims[i];
+    return res;
+}
+
+/* Checks `ten` is a single-precision (..., n, d) tensor of the cache. */
+static int _fang_kvcache_check(const fang_kvcache_t *cache,
+    const fang_ten_t *ten, uint32_t d)
+{
+    if(FANG_UNLIKELY(ten->typ != FANG_TEN_TYPE_DENSE))
+        return -FANG_INVTENTYP;
+    if(FANG_UNLIKELY(ten->eid != cache->eid))
+        return -FANG_ENVNOMATCH;
+    if(FANG_UNLIKELY(ten->dtyp != FANG_TEN_DTYPE_FLOAT32))
+        return -FANG_UNSUPDTYP;
+    if(FANG_UNLIKELY(ten->ndims < 2 || ten->dims[ten->ndims - 1] != d ||
+        _fang_kvcache_heads(ten) != cache->heads))
+    {
+        return -FANG_INVDIM;
+    }
+
+    return FANG_OK;
+}
+
+/* Allocates pages until `len` tokens fit. Page tables grow by doubling. */
+static int _fang_kvcache_grow(fang_kvcache_t *cache, fang_env_t *env,
+    uint64_t len)
+{
+    uint64_t need = (len + cache->page - 1) / cache->page;
+    if(need <= cache->npages)
+        return FANG_OK;
+
+    if(need > cache->cap) {
+        uint64_t cap = cache->cap > 0 ? cache->cap : 1;
+        while(cap < need)
+            cap *= 2;
+        if(FANG_UNLIKELY(cap > UINT32_MAX))
+            return -FANG_INVKVC;
+
+        /* Pending operators read the tables. */
+        if(env->stream != NULL)
+            _fang_env_stream_drain(env->stream);
+
+        float **k = env->realloc(cache->k, cap * sizeof(float *));
+        if(FANG_UNLIKELY(k == NULL))
+            return -FANG_NOMEM;
+        cache->k = k;
+
+        float **v = env->realloc(cache->v, cap * sizeof(float *));
+        if(FANG_UNLIKELY(v == NULL))
+            return -FANG_NOMEM;
+        cache->v = v;
+        cache->cap = (uint32_t) cap;
+    }
+
+    size_t k_siz = (size_t) cache->heads * cache->page * cache->dk;
+    size_t v_siz = (size_t) cache->heads * cache->page * cache->dv;
+    while(cache->npages < need) {
+        float *k = FANG_CREATE(env->realloc, float, k_siz);
+        float *v = FANG_CREATE(env->realloc, float, v_siz);
+        if(FANG_UNLIKELY(k == NULL || v == NULL)) {
+            if(k != NULL)
+                FANG_RELEASE(env->realloc, k);
+            if(v != NULL)
+                FANG_RELEASE(env->realloc, v);
+            return -FANG_NOMEM;
+        }
+
+        cache->k[cache->npages] = k;
+        cache->v[cache->npages] = v;
+        cache->npages++;
+    }
+
+    return FANG_OK;
+}
+
+/* Releases pages and page tables. */
+static void _fang_kvcache_free(fang_kvcache_t *cache, fang_env_t *env) {
+    for(uint32_t i = 0; i < cache->npages; i++) {
+        FANG_RELEASE(env->realloc, cache->k[i]);
+        FANG_RELEASE(env->realloc, cache->v[i]);
+    }
+    if(cache->k != NULL)
+        FANG_RELEASE(env->realloc, cache->k);
+    if(cache->v != NULL)
+        FANG_RELEASE(env->realloc, cache->v);
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Creates a KV cache. */
+int fang_kvcache_create(fang_kvcache_t *cache, int eid, uint32_t heads,
+    uint32_t dk, uint32_t dv, uint32_t page, uint32_t capacity)
+{
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    /* Attention indexes pages and heads in `int`. */
+    if(FANG_UNLIKELY(heads == 0 || dk == 0 || dv == 0 || page == 0 ||
+        heads > INT32_MAX || dk > INT32_MAX || dv > INT32_MAX ||
+        page > INT32_MAX || (uint64_t) heads * page > INT32_MAX))
+    {
+        res = -FANG_INVKVC;
+        goto out;
+    }
+
+    memset(cache, 0, sizeof(fang_kvcache_t));
+    cache->eid   = eid;
+    cache->heads = heads;
+    cache->dk    = dk;
+    cache->dv    = dv;
+    cache->page  = page;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_kvcache_grow(cache, env,
+        capacity))))
+    {
+        _fang_kvcache_free(cache, env);
+        memset(cache, 0, sizeof(fang_kvcache_t));
+    }
+
+out:
+    return res;
+}
+
+/* Appends keys and values of new tokens. */
+int fang_kvcache_append(fang_kvcache_t *cache, fang_ten_t *k, fang_ten_t *v) {
+    int res = FANG_OK;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_kvcache_check(cache, k,
+        cache->dk)) || !FANG_ISOK(res = _fang_kvcache_check(cache, v,
+        cache->dv))))
+    {
+        goto out;
+    }
+
+    uint32_t n = k->dims[k->ndims - 2];
+    if(FANG_UNLIKELY(v->dims[v->ndims - 2] != n)) {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+    if(FANG_UNLIKELY((uint64_t) cache->len + n > INT32_MAX)) {
+        res = -FANG_INVKVC;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, cache->eid))))
+        goto out;
+
+    /* Replays would append at positions of capture. */
+    if(FANG_UNLIKELY(env->graph != NULL)) {
+        res = -FANG_CAPTURING;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_kvcache_grow(cache, env,
+        (uint64_t) cache->len + n))))
+    {
+        goto out;
+    }
+
+    /* Tokens are written from position `alpha`. */
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) cache,
+        .x = (fang_gen_t) k,
+        .y = (fang_gen_t) v,
+        .alpha = FANG_U2G(cache->len)
+    };
+    res = _fang_env_submit(env, env->ops->dense->kvcache_append, &arg,
+        _FANG_SUBMIT_X | _FANG_SUBMIT_Y);
+    if(FANG_ISOK(res))
+        cache->len += n;
+
+out:
+    return res;
+}
+
+/* Performs attention of queries over the cache. */
+int fang_kvcache_attention(fang_ten_t *dest, fang_ten_t *q,
+    fang_kvcache_t *cache, const fang_ten_attention_t *attn)
+{
+    int res = FANG_OK;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_kvcache_check(cache, q,
+        cache->dk))))
+    {
+        goto out;
+    }
+
+    uint32_t t = q->dims[q->ndims - 2];
+    if(FANG_UNLIKELY(cache->len == 0 || (attn->causal && cache->len < t))) {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    /* Check if destination tensor is valid to store result. */
+    if(FANG_UNLIKELY(dest->typ != FANG_TEN_TYPE_DENSE ||
+        dest->dtyp != FANG_TEN_DTYPE_FLOAT32 || dest->ndims != q->ndims ||
+        memcmp(dest->dims, q->dims, (q->ndims - 1) * sizeof(uint32_t)) ||
+        dest->dims[q->ndims - 1] != cache->dv))
+    {
+        res = -FANG_DESTINVDIM;
+        goto out;
+    }
+    if(FANG_UNLIKELY(dest->eid != q->eid)) {
+        res = -FANG_ENVNOMATCH;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, cache->eid))))
+        goto out;
+
+    /* Replays would attend to tokens of capture. */
+    if(FANG_UNLIKELY(env->graph != NULL)) {
+        res = -FANG_CAPTURING;
+        goto out;
+    }
+
+    /* Parameters are packed as:
+     *     alpha: | causal | scale (single-precision bits) |
+     *     beta:  tokens of the cache
+     */
+    float scale = attn->scale != 0 ? (float) attn->scale :
+        1.0f / sqrtf((float) cache->dk);
+    uint32_t scale_bits;
+    memcpy(&scale_bits, &scale, sizeof(float));
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) q,
+        .y = (fang_gen_t) cache,
+        .alpha = FANG_U2G((fang_uint_t) scale_bits |
+            (fang_uint_t) (attn->causal ? 1 : 0) << 32),
+        .beta = FANG_U2G(cache->len)
+    };
+    res = _fang_env_submit(env, env->ops->dense->kvcache_attention, &arg,
+        _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_OVERWRITE);
+
+out:
+    return res;
+}
+
+/* Views a page as tensors. */
+int fang_kvcache_view(fang_kvcache_t *cache, uint32_t idx, fang_ten_t *k,
+    fang_ten_t *v)
+{
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, cache->eid))))
+        goto out;
+
+    if(FANG_UNLIKELY(idx >= cache->npages)) {
+        res = -FANG_INVKVC;
+        goto out;
+    }
+
+    /* Appends do not track pages. */
+    if(env->stream != NULL)
+        _fang_env_stream_drain(env->stream);
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = fang_ten_adopt(k, cache->eid,
+        FANG_TEN_DTYPE_FLOAT32, FANG_DIM(cache->heads, cache->page, cache->dk),
+        cache->k[idx], NULL))))
+    {
+        goto out;
+    }
+    if(FANG_UNLIKELY(!FANG_ISOK(res = fang_ten_adopt(v, cache->eid,
+        FANG_TEN_DTYPE_FLOAT32, FANG_DIM(cache->heads, cache->page, cache->dv),
+        cache->v[idx], NULL))))
+    {
+        fang_ten_release(k);
+    }
+
+out:
+    return res;
+}
+
+/* Empties a cache. */
+int fang_kvcache_reset(fang_kvcache_t *cache) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, cache->eid))))
+        goto out;
+
+    /* Pending operators keep lengths of their submission. */
+    cache->len = 0;
+
+out:
+    return res;
+}
+
+/* Releases a cache and it's pages. */
+int fang_kvcache_release(fang_kvcache_t *cache) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, cache->eid))))
+        goto out;
+
+    /* Pending operators still use the pages. */
+    if(env->stream != NULL)
+        _fang_env_stream_drain(env->stream);
+
+    _fang_kvcache_free(cache, env);
+    memset(cache, 0, sizeof(fang_kvcache_t));
+
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
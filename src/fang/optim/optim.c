@@ -0,0 +1,244 @@
+#include <fang/optim.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <env/stream.h>
+#include <tune.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Number of elements of a tensor. */
+FANG_INLINE static inline uint64_t _fang_optim_size(const fang_ten_t *ten) {
+    return ten->dims == NULL ? 1 : (uint64_t) ten->strides[0] * ten->dims[0];
+}
+
+/* Whether `grad` can be the gradient of `param`. */
+FANG_INLINE static inline bool _fang_optim_matches(const fang_ten_t *param,
+    const fang_ten_t *grad)
+{
+    return grad->typ == FANG_TEN_TYPE_DENSE && grad->dtyp == param->dtyp &&
+        grad->eid == param->eid &&
+        _fang_optim_size(grad) == _fang_optim_size(param);
+}
+
+/* Creates zeroed moments in shape of the parameters. */
+static int _fang_optim_moments(fang_optim_t *restrict opt, fang_env_t *env,
+    fang_ten_t **moments)
+{
+    int res = FANG_OK;
+
+    fang_ten_t *tens = FANG_CREATE(env->realloc, fang_ten_t, opt->nparams);
+    if(FANG_UNLIKELY(tens == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+
+    int i = 0;
+    for(; i < opt->nparams; i++) {
+        fang_ten_t *param = opt->params[i];
+
+        /* Moments are only ever walked flat, scalars get a single element. */
+        fang_ten_dim_t dim = param->ndims > 0 ? (fang_ten_dim_t) {
+            .dims = param->dims, .ndims = param->ndims } : FANG_DIM(1);
+        if(FANG_UNLIKELY(!FANG_ISOK(res = fang_ten_create(tens + i, opt->eid,
+            param->dtyp, dim, NULL))))
+        {
+            goto out_release;
+        }
+    }
+
+    *moments = tens;
+    return res;
+
+out_release:
+    while(i-- > 0)
+        fang_ten_release(tens + i);
+    FANG_RELEASE(env->realloc, tens);
+out:
+    return res;
+}
+
+/* Releases moments of all parameters. */
+static void _fang_optim_release_moments(fang_optim_t *restrict opt,
+    fang_env_t *env, fang_ten_t *moments)
+{
+    if(moments == NULL)
+        return;
+
+    for(int i = 0; i < opt->nparams; i++)
+        fang_ten_release(moments + i);
+    FANG_RELEASE(env->realloc, moments);
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Creates an optimizer of `nparams` parameter tensors. */
+int fang_optim_create(fang_optim_t *opt, int eid, fang_optim_type_t type,
+    const fang_optim_hparam_t *hparam, fang_ten_t **params, int nparams)
+{
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    if(FANG_UNLIKELY(nparams < 1 || type < FANG_OPTIM_SGD ||
+        type > FANG_OPTIM_ADAMW || !(hparam->lr > 0) ||
+        hparam->weight_decay < 0 || (type == FANG_OPTIM_SGD &&
+        (hparam->momentum < 0 || hparam->momentum >= 1)) ||
+        (type != FANG_OPTIM_SGD && (hparam->beta1 < 0 ||
+        hparam->beta1 >= 1 || hparam->beta2 < 0 || hparam->beta2 >= 1 ||
+        !(hparam->eps > 0)))))
+    {
+        res = -FANG_INVOPTIM;
+        goto out;
+    }
+
+    for(int i = 0; i < nparams; i++) {
+        if(FANG_UNLIKELY(params[i]->typ != FANG_TEN_TYPE_DENSE)) {
+            res = -FANG_INVTENTYP;
+            goto out;
+        }
+        if(FANG_UNLIKELY(params[i]->dtyp != FANG_TEN_DTYPE_FLOAT32 &&
+            params[i]->dtyp != FANG_TEN_DTYPE_FLOAT64))
+        {
+            res = -FANG_UNSUPDTYP;
+            goto out;
+        }
+        if(FANG_UNLIKELY(params[i]->eid != eid)) {
+            res = -FANG_ENVNOMATCH;
+            goto out;
+        }
+    }
+
+    memset(opt, 0, sizeof(fang_optim_t));
+    opt->eid     = eid;
+    opt->type    = type;
+    opt->hparam  = *hparam;
+    opt->nparams = nparams;
+
+    opt->params = FANG_CREATE(env->realloc, fang_ten_t *, nparams);
+    opt->tasks  = FANG_CREATE(env->realloc, uint32_t, nparams + 1);
+    if(FANG_UNLIKELY(opt->params == NULL || opt->tasks == NULL)) {
+        res = -FANG_NOMEM;
+        goto out_free;
+    }
+    memcpy(opt->params, params, nparams * sizeof(fang_ten_t *));
+
+    /* Every parameter is split in tasks of `FANG_POOL_GRAIN` elements, all
+       of them run by a single parallel loop. */
+    uint64_t ntasks = 0;
+    for(int i = 0; i < nparams; i++) {
+        opt->tasks[i] = (uint32_t) ntasks;
+        ntasks += (_fang_optim_size(params[i]) + FANG_POOL_GRAIN - 1) /
+            FANG_POOL_GRAIN;
+    }
+    if(FANG_UNLIKELY(ntasks > UINT32_MAX)) {
+        res = -FANG_INVOPTIM;
+        goto out_free;
+    }
+    opt->tasks[nparams] = (uint32_t) ntasks;
+
+    /* Plain SGD keeps no state. */
+    if(type != FANG_OPTIM_SGD || hparam->momentum != 0) {
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_optim_moments(opt, env,
+            &opt->m))))
+        {
+            goto out_free;
+        }
+    }
+    if(type != FANG_OPTIM_SGD) {
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_optim_moments(opt, env,
+            &opt->v))))
+        {
+            goto out_moments;
+        }
+    }
+
+    return res;
+
+out_moments:
+    _fang_optim_release_moments(opt, env, opt->m);
+out_free:
+    FANG_RELEASE(env->realloc, opt->params);
+    FANG_RELEASE(env->realloc, opt->tasks);
+    opt->params = NULL;
+    opt->tasks  = NULL;
+out:
+    return res;
+}
+
+/* Takes a step. */
+int fang_optim_step(fang_optim_t *opt, fang_ten_t **grads) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, opt->eid))))
+        goto out;
+
+    for(int i = 0; i < opt->nparams; i++) {
+        fang_ten_t *grad = grads != NULL ? grads[i] : opt->params[i]->grad;
+        if(FANG_UNLIKELY(grad != NULL &&
+            !_fang_optim_matches(opt->params[i], grad)))
+        {
+            res = -FANG_INVDIM;
+            goto out;
+        }
+    }
+
+    /* Gradients are resolved now, the operator may run after `grads` is out
+       of scope or the tape detached them. */
+    fang_ten_t **resolved = FANG_CREATE(env->realloc, fang_ten_t *,
+        opt->nparams);
+    if(FANG_UNLIKELY(resolved == NULL)) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    for(int i = 0; i < opt->nparams; i++)
+        resolved[i] = grads != NULL ? grads[i] : opt->params[i]->grad;
+
+    /* Moments are read and written by every step, hence the operator waits
+       for, and is waited by, every other operator. */
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) opt,
+        .x = (fang_gen_t) resolved,
+        .z = FANG_I2G(opt->nparams)
+    };
+    res = _fang_env_submit(env, env->ops->dense->optim, &arg,
+        _FANG_SUBMIT_XARRAY);
+
+    FANG_RELEASE(env->realloc, resolved);
+
+out:
+    return res;
+}
+
+/* Releases an optimizer and it's moments. */
+int fang_optim_release(fang_optim_t *opt) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, opt->eid))))
+        goto out;
+
+    /* Pending steps still use the optimizer. */
+    if(env->stream != NULL)
+        _fang_env_stream_wait_data(env->stream, NULL);
+
+    _fang_optim_release_moments(opt, env, opt->m);
+    _fang_optim_release_moments(opt, env, opt->v);
+    FANG_RELEASE(env->realloc, opt->params);
+    FANG_RELEASE(env->realloc, opt->tasks);
+    memset(opt, 0, sizeof(fang_optim_t));
+
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
@@ -1,15 +1,158 @@
+#define _GNU_SOURCE
 #include <fang/status.h>
 #include <platform/env/cpu.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <cpuid.h>
 
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Reads the leading integer of a sysfs file. Returns -1 if the file does not
+   exist or holds no integer (e.g. an empty CPU list). */
+static int _fang_sysfs_int(int cpu, const char *restrict node) {
+    char path[128];
+    int val = -1;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", cpu,
+        node);
+
+    FILE *file = fopen(path, "r");
+    if(FANG_UNLIKELY(file == NULL))
+        return -1;
+
+    if(fscanf(file, "%d", &val) != 1)
+        val = -1;
+    fclose(file);
+
+    return val;
+}
+
+/* ID of the last level (L3) cache a logical processor uses. Returns -1 if
+   there is no L3 cache. */
+static int _fang_sysfs_l3(int cpu) {
+    char node[64];
+
+    for(int i = 0; ; i++) {
+        snprintf(node, sizeof(node), "cache/index%d/level", i);
+
+        int level = _fang_sysfs_int(cpu, node);
+        if(level < 0)
+            break;
+        if(level != 3)
+            continue;
+
+        /* Older kernels have no cache IDs, first processor sharing the cache
+           identifies it just as well. */
+        snprintf(node, sizeof(node), "cache/index%d/id", i);
+        int id = _fang_sysfs_int(cpu, node);
+        if(id >= 0)
+            return id;
+
+        snprintf(node, sizeof(node), "cache/index%d/shared_cpu_list", i);
+        return _fang_sysfs_int(cpu, node);
+    }
+
+    return -1;
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
 /* ================ DEFINITIONS ================ */
 
-/* Gets CPU information (how many cores, start index etc.) in Linux. */
-int _fang_env_cpu_getinfo(int *restrict nproc) {
-    /* Get number of proccessors. */
-    *nproc = sysconf(_SC_NPROCESSORS_ONLN);
-    return FANG_OK;
+/* Gets CPU information (processors and their topology) in Linux. */
+int _fang_env_cpu_getinfo(_fang_env_cpu_t *restrict cpu,
+    fang_reallocator_t realloc)
+{
+    int res = FANG_OK;
+
+    /* Processors the process may run on. IDs of online processors are not
+       necessarily contiguous (e.g. some taken offline or excluded by
+       affinity), hence they are enumerated. */
+    cpu_set_t set;
+    bool affinity = sched_getaffinity(0, sizeof(set), &set) == 0;
+    if(affinity)
+        cpu->nproc = CPU_COUNT(&set);
+    else
+        cpu->nproc = sysconf(_SC_NPROCESSORS_ONLN);
+    if(FANG_UNLIKELY(cpu->nproc < 1)) {
+        cpu->nproc = 1;
+        affinity = false;
+    }
+
+    /* Raw socket, core and L3 IDs reported by the kernel. */
+    int *raw = FANG_CREATE(realloc, int, 3 * cpu->nproc);
+    cpu->procs = FANG_CREATE(realloc, _fang_env_cpu_proc_t, cpu->nproc);
+    if(FANG_UNLIKELY(raw == NULL || cpu->procs == NULL)) {
+        FANG_RELEASE(realloc, raw);
+        FANG_RELEASE(realloc, cpu->procs);
+        cpu->procs = NULL;
+        res = -FANG_NOMEM;
+        goto out;
+    }
+
+    for(int i = 0, id = 0; i < cpu->nproc; id++) {
+        if(!affinity || CPU_ISSET(id, &set))
+            cpu->procs[i++].id = id;
+    }
+
+    /* Without sysfs, every processor is a core of it's own in a single
+       socket. */
+    for(int i = 0; i < cpu->nproc; i++) {
+        int os = cpu->procs[i].id, *id = raw + 3 * i;
+
+        id[0] = _fang_sysfs_int(os, "topology/physical_package_id");
+        id[1] = _fang_sysfs_int(os, "topology/core_id");
+        id[2] = _fang_sysfs_l3(os);
+
+        if(id[0] < 0)
+            id[0] = 0;
+        if(id[1] < 0)
+            id[1] = os;
+        if(id[2] < 0)
+            id[2] = id[0];
+    }
+
+    /* Raw IDs may be sparse; turn them into dense indices in order of first
+       appearance. Core IDs are only unique within a socket. */
+    cpu->nsockets = cpu->ncores = cpu->nllcs = 0;
+    for(int i = 0; i < cpu->nproc; i++) {
+        _fang_env_cpu_proc_t *proc = cpu->procs + i;
+        int *id = raw + 3 * i;
+
+        proc->socket = proc->core = proc->llc = -1;
+        proc->smt = 0;
+
+        for(int j = 0; j < i; j++) {
+            int *prev = raw + 3 * j;
+
+            if(prev[0] == id[0]) {
+                proc->socket = cpu->procs[j].socket;
+
+                if(prev[1] == id[1]) {
+                    proc->core = cpu->procs[j].core;
+                    proc->smt++;
+                }
+            }
+            if(prev[2] == id[2])
+                proc->llc = cpu->procs[j].llc;
+        }
+
+        if(proc->socket < 0)
+            proc->socket = cpu->nsockets++;
+        if(proc->core < 0)
+            proc->core = cpu->ncores++;
+        if(proc->llc < 0)
+            proc->llc = cpu->nllcs++;
+    }
+
+    FANG_RELEASE(realloc, raw);
+
+out:
+    return res;
 }
 
 /* ================ DEFINITIONS END ================ */
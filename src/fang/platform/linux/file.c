@@ -0,0 +1,78 @@
+#include <fang/status.h>
+#include <platform/file.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* ================ DEFINITIONS ================ */
+
+/* Opens a file for positional I/O and returns the descriptor. Creates (and
+   truncates) the file if `write` is non-zero. */
+int _fang_file_open(const char *restrict path, int write) {
+    int fd = write ? open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)
+        : open(path, O_RDONLY | O_CLOEXEC);
+
+    return FANG_UNLIKELY(fd < 0) ? -FANG_NOFILE : fd;
+}
+
+/* Hints the kernel that the file is going to be read sequentially. */
+void _fang_file_advise_sequential(int fd) {
+    /* Doubles the readahead window, failure is harmless. */
+    (void) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+/* Reads exactly `size` bytes at `offset`. Returns bytes read, which is only
+   less than `size` at end of file. */
+int64_t _fang_file_pread(int fd, void *buff, size_t size, uint64_t offset) {
+    size_t done = 0;
+
+    /* `pread` may return early for large requests or on signals. */
+    while(done < size) {
+        ssize_t n = pread(fd, (char *) buff + done, size - done,
+            (off_t) (offset + done));
+
+        if(FANG_UNLIKELY(n < 0)) {
+            if(errno == EINTR)
+                continue;
+            return -FANG_IOERR;
+        }
+
+        /* End of file. */
+        if(FANG_UNLIKELY(n == 0))
+            break;
+
+        done += (size_t) n;
+    }
+
+    return (int64_t) done;
+}
+
+/* Writes exactly `size` bytes at `offset`. */
+int _fang_file_pwrite(int fd, const void *buff, size_t size, uint64_t offset) {
+    size_t done = 0;
+
+    if(FANG_UNLIKELY(size == 0))
+        return FANG_OK;
+
+    while(done < size) {
+        ssize_t n = pwrite(fd, (const char *) buff + done, size - done,
+            (off_t) (offset + done));
+
+        if(FANG_UNLIKELY(n < 0)) {
+            if(errno == EINTR)
+                continue;
+            return -FANG_IOERR;
+        }
+
+        done += (size_t) n;
+    }
+
+    return FANG_OK;
+}
+
+/* Closes a file descriptor. */
+void _fang_file_close(int fd) {
+    close(fd);
+}
+
+/* ================ DEFINITIONS END ================ */
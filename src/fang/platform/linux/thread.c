@@ -0,0 +1,101 @@
+#define _GNU_SOURCE
+#include <fang/status.h>
+#include <platform/thread.h>
+#include <sched.h>
+
+/* ================ DEFINITIONS ================ */
+
+/* Spawns a new thread executing `fn` with `arg`. */
+int _fang_thread_create(_fang_thread_t *restrict thread, _fang_thread_fn fn,
+    void *arg)
+{
+    if(FANG_UNLIKELY(pthread_create(thread, NULL, fn, arg)))
+        return -FANG_NOTHREAD;
+
+    return FANG_OK;
+}
+
+/* Waits for a thread to finish. */
+int _fang_thread_join(_fang_thread_t thread) {
+    if(FANG_UNLIKELY(pthread_join(thread, NULL)))
+        return -FANG_NOTHREAD;
+
+    return FANG_OK;
+}
+
+/* Pins a thread to logical processor `cpu`. */
+int _fang_thread_pin(_fang_thread_t thread, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    if(FANG_UNLIKELY(pthread_setaffinity_np(thread, sizeof(set), &set)))
+        return -FANG_INVPCPU;
+
+    return FANG_OK;
+}
+
+/* Gives up the processor for other threads. */
+void _fang_thread_yield(void) {
+    sched_yield();
+}
+
+/* Whether `thread` is the calling thread. */
+bool _fang_thread_is_self(_fang_thread_t thread) {
+    return pthread_equal(thread, pthread_self()) != 0;
+}
+
+/* Initializes a mutex. */
+int _fang_mutex_init(_fang_mutex_t *restrict mutex) {
+    if(FANG_UNLIKELY(pthread_mutex_init(mutex, NULL)))
+        return -FANG_NOMEM;
+
+    return FANG_OK;
+}
+
+/* Locks a mutex. */
+void _fang_mutex_lock(_fang_mutex_t *restrict mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+/* Locks a mutex if not locked already. Returns whether it was locked. */
+bool _fang_mutex_trylock(_fang_mutex_t *restrict mutex) {
+    return pthread_mutex_trylock(mutex) == 0;
+}
+
+/* Unlocks a mutex. */
+void _fang_mutex_unlock(_fang_mutex_t *restrict mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+/* Destroys a mutex. */
+void _fang_mutex_release(_fang_mutex_t *restrict mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+/* Initializes a condition variable. */
+int _fang_cond_init(_fang_cond_t *restrict cond) {
+    if(FANG_UNLIKELY(pthread_cond_init(cond, NULL)))
+        return -FANG_NOMEM;
+
+    return FANG_OK;
+}
+
+/* Atomically unlocks `mutex` and waits for `cond` to be signaled. */
+void _fang_cond_wait(_fang_cond_t *restrict cond,
+    _fang_mutex_t *restrict mutex)
+{
+    pthread_cond_wait(cond, mutex);
+}
+
+/* Wakes up all threads waiting on `cond`. */
+void _fang_cond_broadcast(_fang_cond_t *restrict cond) {
+    pthread_cond_broadcast(cond);
+}
+
+/* Destroys a condition variable. */
+void _fang_cond_release(_fang_cond_t *restrict cond) {
+    pthread_cond_destroy(cond);
+}
+
+/* ================ DEFINITIONS END ================ */
@@ -1,10 +1,14 @@
-#include <fang/util/buffer.h>
 #include <fang/tensor.h>
 #include <fang/env.h>
 #include <fang/status.h>
+#include <fang/autograd.h>
+#include <env/stream.h>
+#include <platform/thread.h>
 #include <compiler.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <math.h>
 
 /* ================ HELPER MACROS ================ */
 
@@ -12,9 +16,37 @@
 #define _FANG_MAX(x, y)         (x > y ? x : y)
 #define _FANG_MIN(x, y)         (x < y ? x : y)
 
+/* Standard deviations past which the normal CDF underflows in
+   double-precision, truncated normal can't be sampled wholly beyond it. */
+#define _FANG_TRUNC_MAX_TAIL    37.0
+
+/* Arithmatic operators read `x` and `y`, and overwrite `dest`. */
+#define _FANG_ARITH_SUBMIT      (_FANG_SUBMIT_DEST | _FANG_SUBMIT_X |        \
+    _FANG_SUBMIT_Y | _FANG_SUBMIT_OVERWRITE)
+
+/* Records a submitted operator onto the tape of the Environment, if it's
+   recording one. */
+#define _FANG_TAPE_RECORD(env, res, ...)    do {                             \
+    if(FANG_ISOK(res) && (env)->tape != NULL) {                              \
+        res = _fang_tape_record((env)->tape,                                 \
+            &(_fang_tape_op_t) { __VA_ARGS__ });                             \
+    }                                                                        \
+} while(0)
+
 /* ================ HELPER MACROS ================ */
 
 
+/* ================ PRIVATE GLOBALS ================ */
+
+/* Single element data size of each tensor data type. */
+/* NOTE: This array conforms to `fang_ten_dtype_t` enum, any changes made to
+ *   that enum should reflect here.
+ */
+const int _fang_ten_dsiz[] = { 1, 2, 4, 8, 1, 2, 4, 8, 1, 2, 2, 4, 8 };
+
+/* ================ PRIVATE GLOBALS END ================ */
+
+
 /* ================ PRIVATE DEFINITIONS ================ */
 
 /* Calculates strides. */
@@ -26,6 +58,62 @@ FANG_HOT FANG_INLINE static inline void
         strides[i] = dims[i + 1] * strides[i + 1];
 }
 
+/* Validates dimensions and stores them alongside strides in tensor. */
+int _fang_ten_init_dims(fang_ten_t *ten, fang_env_t *env,
+    fang_ten_dim_t dim)
+{
+    int res = FANG_OK;
+
+    /* Is passed dimension valid? */
+    if(FANG_UNLIKELY(dim.ndims == 0 || dim.dims == NULL)) {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+    for(int i = 0; i < dim.ndims; i++) {
+        if(FANG_UNLIKELY(dim.dims[i] == 0)) {
+            res = -FANG_INVDIM;
+            goto out;
+        }
+    }
+
+    /* Store dimensions. */
+    ten->ndims = dim.ndims;
+    ten->dims = FANG_CREATE(env->realloc, *ten->dims, dim.ndims);
+    if(ten->dims == NULL) {
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    memmove(ten->dims, dim.dims, dim.ndims * sizeof(*ten->dims));
+
+    /* Calculate and store strides. */
+    ten->strides = FANG_CREATE(env->realloc, *ten->strides, dim.ndims);
+    if(ten->strides == NULL) {
+        FANG_RELEASE(env->realloc, ten->dims);
+        res = -FANG_NOMEM;
+        goto out;
+    }
+    _fang_ten_calc_strides(ten->strides, dim.dims, dim.ndims);
+
+out:
+    return res;
+}
+
+/* Largest data type of same kind as `dtyp`, in which external data is
+   provided through `fang_ten_create()` and `fang_ten_scalar()`. */
+FANG_INLINE static inline fang_ten_dtype_t
+    _fang_ten_generic_dtype(fang_ten_dtype_t dtyp)
+{
+    if(dtyp <= FANG_TEN_DTYPE_INT64)
+        return FANG_TEN_DTYPE_INT64;
+    else if(dtyp <= FANG_TEN_DTYPE_UINT64)
+        return FANG_TEN_DTYPE_UINT64;
+
+    return FANG_TEN_DTYPE_FLOAT64;
+}
+
+/* Deleter for borrowed data, which is never released by Fang. */
+static void _fang_ten_borrowed(FANG_UNUSED void *data) {}
+
 /* Returns whether specific broadcasting type being used (fast-route). Check out
  * `tensor.h` for more info. */
 FANG_HOT FANG_INLINE static inline int _fang_ten_get_broadcast_pattern(
@@ -188,6 +276,82 @@ FANG_HOT FANG_INLINE static inline int _fang_ten_gemm_get_broadcast_pattern(
     return pattern;
 }
 
+/* Waits for pending asynchronous operators using the data of a tensor. */
+FANG_INLINE static inline void _fang_ten_wait_data(fang_ten_t *ten,
+    fang_env_t *env)
+{
+    if(FANG_UNLIKELY(env->stream != NULL))
+        _fang_env_stream_wait_data(env->stream, ten->data.dense);
+}
+
+/* Runs operator `fn` of `env` overwriting `ten` (e.g. random number
+   generation or fill). `arg` is expected to be filled except destination
+   tensor. */
+int _fang_ten_overwrite(fang_ten_t *ten, fang_env_t *env,
+    fang_ten_operator_fn fn, fang_ten_ops_arg_t *arg)
+{
+    int res = FANG_OK;
+
+    /* Tensor has to be dense tensor. */
+    if(FANG_UNLIKELY(ten->typ != FANG_TEN_TYPE_DENSE)) {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+
+    /* Handle scalar tensor. */
+    fang_ten_t input = *ten;
+    input.dims    = input.dims == NULL ? (uint32_t []) { 1 } : input.dims;
+    input.strides = input.strides == NULL ? (uint32_t []) { 1 } : input.strides;
+
+    arg->dest = (fang_gen_t) &input;
+    res = _fang_env_submit(env, fn, arg,
+        _FANG_SUBMIT_DEST | _FANG_SUBMIT_OVERWRITE);
+    _FANG_TAPE_RECORD(env, res, .kind = _FANG_TAPE_OVERWRITE, .dest = ten,
+        .fn = fn, .arg = *arg);
+
+out:
+    return res;
+}
+
+/* Computes fans of a weight tensor for initialization. */
+static int _fang_ten_init_fans(const fang_ten_t *ten, fang_float_t *fan_in,
+    fang_float_t *fan_out)
+{
+    if(FANG_UNLIKELY(ten->ndims == 0))
+        return -FANG_INVDIM;
+    if(FANG_UNLIKELY(ten->dtyp < FANG_TEN_DTYPE_FLOAT8))
+        return -FANG_UNSUPDTYP;
+
+    /* Vectors (e.g. bias) have equal fans. */
+    if(ten->ndims == 1) {
+        *fan_in = *fan_out = (fang_float_t) ten->dims[0];
+        return FANG_OK;
+    }
+
+    fang_float_t receptive = 1.0;
+    for(int i = 2; i < ten->ndims; i++)
+        receptive *= ten->dims[i];
+
+    *fan_in  = ten->dims[1] * receptive;
+    *fan_out = ten->dims[0] * receptive;
+    return FANG_OK;
+}
+
+/* Fills weight tensor with zero mean distribution of standard deviation
+   `std`. */
+static int _fang_ten_init(fang_ten_t *ten, fang_ten_init_dist_t dist,
+    fang_float_t std, uint32_t seed)
+{
+    if(dist == FANG_TEN_INIT_NORMAL)
+        return fang_ten_randn(ten, 0.0, std, seed);
+    if(FANG_UNLIKELY(dist != FANG_TEN_INIT_UNIFORM))
+        return -FANG_INVDIST;
+
+    /* Uniform U(-a, a) has standard deviation a / sqrt(3). */
+    fang_float_t bound = sqrt(3.0) * std;
+    return fang_ten_rand(ten, FANG_F2G(-bound), FANG_F2G(bound), seed);
+}
+
 /* ================ PRIVATE DEFINITIONS END ================ */
 
 
@@ -197,54 +361,40 @@ FANG_HOT FANG_INLINE static inline int _fang_ten_gemm_get_broadcast_pattern(
 int fang_ten_create(fang_ten_t *ten, int eid, fang_ten_dtype_t dtyp,
     fang_ten_dim_t dim, void *restrict data)
 {
-    int res = FANG_OK;
+    /* Input data is widened to largest type of it's kind, see `type.h`. */
+    return fang_ten_create_from(ten, eid, dtyp, dim,
+        _fang_ten_generic_dtype(dtyp), data);
+}
 
-    /* Is passed dimension valid? */
-    if(FANG_UNLIKELY(dim.ndims == 0 || dim.dims == NULL)) {
-        res = -FANG_INVDIM;
-        goto out;
-    }
+/* Creates a new dense tensor from data of any data type. */
+int fang_ten_create_from(fang_ten_t *ten, int eid, fang_ten_dtype_t dtyp,
+    fang_ten_dim_t dim, fang_ten_dtype_t src_dtyp, const void *restrict data)
+{
+    int res = FANG_OK;
 
-    /* Is tensor data type valid? */
-    if(FANG_UNLIKELY(dtyp < FANG_TEN_DTYPE_INT8 &&
-        dtyp > FANG_TEN_DTYPE_FLOAT64))
+    /* Is tensor data type and input data type valid? */
+    if(FANG_UNLIKELY(dtyp < FANG_TEN_DTYPE_INT8 ||
+        dtyp > FANG_TEN_DTYPE_FLOAT64 || (data != NULL &&
+        (src_dtyp < FANG_TEN_DTYPE_INT8 || src_dtyp > FANG_TEN_DTYPE_FLOAT64))))
     {
         res = -FANG_INVDTYP;
         goto out;
     }
 
     /* Tensor type and data type. */
-    ten->typ  = FANG_TEN_TYPE_DENSE;
-    ten->dtyp = dtyp;
+    ten->typ     = FANG_TEN_TYPE_DENSE;
+    ten->dtyp    = dtyp;
+    ten->deleter = NULL;
+    ten->grad    = NULL;
 
     /* Retrieve Environment structure. */
     fang_env_t *env;
     if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
         goto out;
 
-    /* Validate dimensions. */
-    for(int i = 0; i < dim.ndims; i++) {
-        if(FANG_UNLIKELY(dim.dims[i] == 0)) {
-            res = -FANG_INVDIM;
-            goto out;
-        }
-    }
-    /* Store dimensions. */
-    ten->ndims = dim.ndims;
-    ten->dims = FANG_CREATE(env->realloc, *ten->dims, dim.ndims);
-    if(ten->dims == NULL) {
-        res = -FANG_NOMEM;
-        goto out;
-    }
-    memmove(ten->dims, dim.dims, dim.ndims * sizeof(*ten->dims));
-
-    /* Calculate and store strides. */
-    ten->strides = FANG_CREATE(env->realloc, *ten->strides, dim.ndims);
-    if(ten->strides == NULL) {
-        res = -FANG_NOMEM;
+    /* Validate and store dimensions and strides. */
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_init_dims(ten, env, dim))))
         goto out;
-    }
-    _fang_ten_calc_strides(ten->strides, dim.dims, dim.ndims);
 
     /* Call operator. */
     fang_ten_ops_arg_t arg = {
@@ -253,14 +403,69 @@ int fang_ten_create(fang_ten_t *ten, int eid, fang_ten_dtype_t dtyp,
         /* Number of elements. */
         .x = FANG_U2G((fang_uint_t) ten->strides[0] * dim.dims[0]),
         .y = (fang_gen_t) data,
-        .z = (fang_gen_t) env
+        .z = (fang_gen_t) env,
+
+        /* Input data type. */
+        .alpha = FANG_I2G(src_dtyp)
     };
-    if(FANG_UNLIKELY(!FANG_ISOK(res = env->ops->dense->create(&arg))))
+    if(FANG_UNLIKELY(!FANG_ISOK(res = env->ops->dense->create(&arg)))) {
+        FANG_RELEASE(env->realloc, ten->dims);
+        FANG_RELEASE(env->realloc, ten->strides);
+        goto out;
+    }
+
+    /* Tensor creation successful. */
+    ten->eid = eid;
+    _fang_atomic_fetch_add(&env->ntens, 1);
+
+out:
+    return res;
+}
+
+/* Creates a new dense tensor adopting `data` without copying. */
+int fang_ten_adopt(fang_ten_t *ten, int eid, fang_ten_dtype_t dtyp,
+    fang_ten_dim_t dim, void *data, fang_ten_deleter_t deleter)
+{
+    int res = FANG_OK;
+
+    /* Is tensor data type valid? */
+    if(FANG_UNLIKELY(dtyp < FANG_TEN_DTYPE_INT8 ||
+        dtyp > FANG_TEN_DTYPE_FLOAT64))
+    {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+
+    /* Accelerators assume aligned data. */
+    if(FANG_UNLIKELY(data == NULL ||
+        (uintptr_t) data % FANG_MEMALIGN != 0))
+    {
+        res = -FANG_MISALIGN;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    /* Only CPU Environment can work with host memory directly. */
+    if(FANG_UNLIKELY(env->type != FANG_ENV_TYPE_CPU)) {
+        res = -FANG_INVENVTYP;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_init_dims(ten, env, dim))))
         goto out;
 
+    ten->typ        = FANG_TEN_TYPE_DENSE;
+    ten->dtyp       = dtyp;
+    ten->data.dense = data;
+    ten->deleter    = deleter != NULL ? deleter : _fang_ten_borrowed;
+    ten->grad       = NULL;
+
     /* Tensor creation successful. */
     ten->eid = eid;
-    env->ntens++;
+    _fang_atomic_fetch_add(&env->ntens, 1);
 
 out:
     return res;
@@ -291,6 +496,8 @@ int fang_ten_scalar(fang_ten_t *ten, int eid, fang_ten_dtype_t dtyp,
     ten->dims    = NULL;
     ten->strides = NULL;
     ten->ndims   = 0;
+    ten->deleter = NULL;
+    ten->grad    = NULL;
 
     /* Scalar tensors act like single element 1-dimensional tensor. */
     /* `fang_gen_t` is bitcasted form data types like `fang_float_t` or `fang_int_t`.
@@ -300,14 +507,15 @@ int fang_ten_scalar(fang_ten_t *ten, int eid, fang_ten_dtype_t dtyp,
     fang_ten_ops_arg_t arg = {
         .dest = (fang_gen_t) ten,
         .y = (fang_gen_t) data,
-        .z = (fang_gen_t) env
+        .z = (fang_gen_t) env,
+        .alpha = FANG_I2G(_fang_ten_generic_dtype(dtyp))
     };
     if(FANG_UNLIKELY(!FANG_ISOK(res = env->ops->dense->create(&arg))))
         goto out;
 
     /* Tensor creation successful. */
     ten->eid = eid;
-    env->ntens++;
+    _fang_atomic_fetch_add(&env->ntens, 1);
 
 out:
     return res;
@@ -319,7 +527,7 @@ int fang_ten_fprint(fang_ten_t *ten, const char *name, int padding,
 {
     int res = FANG_OK;
 
-    if(FANG_UNLIKELY(ten->dtyp < FANG_TEN_DTYPE_INT8 &&
+    if(FANG_UNLIKELY(ten->dtyp < FANG_TEN_DTYPE_INT8 ||
         ten->dtyp > FANG_TEN_DTYPE_FLOAT64))
     {
         res = -FANG_INVDTYP;
@@ -330,6 +538,8 @@ int fang_ten_fprint(fang_ten_t *ten, const char *name, int padding,
     if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
         goto out;
 
+    _fang_ten_wait_data(ten, env);
+
     /* Print tensor details. */
     /* Padding is useful when printing nn-like structures. */
     fprintf(file, "%*s[%s] = ", padding, "", name);
@@ -338,69 +548,161 @@ int fang_ten_fprint(fang_ten_t *ten, const char *name, int padding,
     if(FANG_LIKELY(ten->ndims != 1 && ten->dims != NULL))
         fprintf(file, "\n");
 
-    /* Buffer to push strings to. */
-    fang_buffer_t buff;
-    if(FANG_UNLIKELY(!FANG_ISOK(res =
-        FANG_BUFFER_CREATE(&buff, env->realloc, char))))
-    {
-        goto out;
-    }
-
     fang_ten_ops_arg_t arg = {
         .dest = (fang_gen_t) ten,
         .x = FANG_I2G(padding),
-        .y = (fang_gen_t) &buff
+        .y = (fang_gen_t) file,
+        .z = (fang_gen_t) env
     };
-    if(FANG_LIKELY(ten->typ == FANG_TEN_TYPE_DENSE)) {
-        if(FANG_UNLIKELY(!FANG_ISOK(res = env->ops->dense->print(&arg))))
-            goto release;
-    }
-    else if(FANG_LIKELY(ten->typ == FANG_TEN_TYPE_SPARSE)) {
-        if(FANG_UNLIKELY(!FANG_ISOK(res = env->ops->sparse->print(&arg))))
-            goto release;
-    } else {
+    if(FANG_LIKELY(ten->typ == FANG_TEN_TYPE_DENSE))
+        res = env->ops->dense->print(&arg);
+    else if(FANG_LIKELY(ten->typ == FANG_TEN_TYPE_SPARSE))
+        res = env->ops->sparse->print(&arg);
+    else
         res = -FANG_INVTENTYP;
-        goto release;
+
+out:
+    return res;
+}
+
+/* Fill dense tensor with random numbers. */
+int fang_ten_rand(fang_ten_t *ten, fang_gen_t low, fang_gen_t high, uint32_t seed) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
+        goto out;
+
+    fang_ten_ops_arg_t arg = {
+        .x = low,
+        .y = high,
+        .z = FANG_U2G(seed)
+    };
+    res = _fang_ten_overwrite(ten, env, env->ops->dense->rand, &arg);
+
+out:
+    return res;
+}
+
+/* Fill dense tensor with normally distributed random numbers. */
+int fang_ten_randn(fang_ten_t *ten, fang_float_t mean, fang_float_t std,
+    uint32_t seed)
+{
+    int res = FANG_OK;
+
+    if(FANG_UNLIKELY(!(std > 0.0))) {
+        res = -FANG_INVDIST;
+        goto out;
     }
 
-    /* Print contents. */
-    fprintf(file, "%s\n", (char *) fang_buffer_retrieve(&buff, NULL));
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
+        goto out;
 
-release:
-    /* Release the buffer. */
-    fang_buffer_release(&buff);
+    fang_ten_ops_arg_t arg = {
+        .x = FANG_F2G(mean),
+        .y = FANG_F2G(std),
+        .z = FANG_U2G(seed)
+    };
+    res = _fang_ten_overwrite(ten, env, env->ops->dense->randn, &arg);
 
 out:
     return res;
 }
 
-/* Fill dense tensor with random numbers. */
-int fang_ten_rand(fang_ten_t *ten, fang_gen_t low, fang_gen_t high, uint32_t seed) {
+/* Fill dense tensor with normally distributed random numbers, truncated to
+   [low, high]. */
+int fang_ten_trunc_randn(fang_ten_t *ten, fang_float_t mean, fang_float_t std,
+    fang_float_t low, fang_float_t high, uint32_t seed)
+{
     int res = FANG_OK;
 
-    /* Tensor has to be dense tensor. */
-    if(FANG_UNLIKELY(ten->typ != FANG_TEN_TYPE_DENSE)) {
-        res = -FANG_INVTENTYP;
+    if(FANG_UNLIKELY(!(std > 0.0) || !(low < high) ||
+        (low - mean) / std > _FANG_TRUNC_MAX_TAIL ||
+        (high - mean) / std < -_FANG_TRUNC_MAX_TAIL)) {
+        res = -FANG_INVDIST;
         goto out;
     }
 
-    /* Handle scalar tensor. */
-    fang_ten_t input = *ten;
-    input.dims    = input.dims == NULL ? (uint32_t []) { 1 } : input.dims;
-    input.strides = input.strides == NULL ? (uint32_t []) { 1 } : input.strides;
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
+        goto out;
+
+    fang_ten_ops_arg_t arg = {
+        .x = FANG_F2G(mean),
+        .y = FANG_F2G(std),
+        .z = FANG_U2G(seed),
+        .alpha = FANG_F2G(low),
+        .beta = FANG_F2G(high)
+    };
+    res = _fang_ten_overwrite(ten, env, env->ops->dense->trunc_randn, &arg);
+
+out:
+    return res;
+}
+
+/* Fill dense tensor with a Bernoulli mask. */
+int fang_ten_bernoulli(fang_ten_t *ten, fang_float_t p, fang_gen_t value,
+    uint32_t seed)
+{
+    int res = FANG_OK;
+
+    if(FANG_UNLIKELY(!(p >= 0.0 && p <= 1.0))) {
+        res = -FANG_INVDIST;
+        goto out;
+    }
 
-    /* Get Environment. */
     fang_env_t *env;
     if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
         goto out;
 
     fang_ten_ops_arg_t arg = {
-        .dest = (fang_gen_t) &input,
-        .x = low,
-        .y = high,
+        .x = FANG_F2G(p),
+        .y = value,
         .z = FANG_U2G(seed)
     };
-    res = env->ops->dense->rand(&arg);
+    res = _fang_ten_overwrite(ten, env, env->ops->dense->bernoulli, &arg);
+
+out:
+    return res;
+}
+
+/* Xavier (Glorot) initialization. */
+int fang_ten_xavier(fang_ten_t *ten, fang_ten_init_dist_t dist,
+    fang_float_t gain, uint32_t seed)
+{
+    int res = FANG_OK;
+
+    fang_float_t fan_in, fan_out;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_init_fans(ten, &fan_in,
+        &fan_out))))
+    {
+        goto out;
+    }
+
+    fang_float_t std = gain * sqrt(2.0 / (fan_in + fan_out));
+    res = _fang_ten_init(ten, dist, std, seed);
+
+out:
+    return res;
+}
+
+/* Kaiming (He) initialization. */
+int fang_ten_kaiming(fang_ten_t *ten, fang_ten_init_dist_t dist,
+    fang_ten_init_fan_t fan, fang_float_t gain, uint32_t seed)
+{
+    int res = FANG_OK;
+
+    fang_float_t fan_in, fan_out;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_init_fans(ten, &fan_in,
+        &fan_out))))
+    {
+        goto out;
+    }
+
+    fang_float_t std = gain / sqrt(fan == FANG_TEN_INIT_FAN_IN ? fan_in :
+        fan_out);
+    res = _fang_ten_init(ten, dist, std, seed);
 
 out:
     return res;
@@ -408,7 +710,7 @@ out:
 
 /* Tensor arithmatic macro. Use this macro to instantiate any arithmatic related
    tensor operation routine. */
-#define FANG_TENSOR_ARITH(operator)                                             \
+#define FANG_TENSOR_ARITH(operator, tape_kind)                                  \
 int fang_ten_##operator(fang_ten_t *dest, fang_ten_t *x, fang_ten_t *y) {       \
     int res = FANG_OK;                                                          \
                                                                                 \
@@ -474,7 +776,8 @@ int fang_ten_##operator(fang_ten_t *dest, fang_ten_t *x, fang_ten_t *y) {
                                                                                 \
             /* No need for broadcasting. */                                     \
             arg.z = FANG_I2G(FANG_NO_BCAST);                                    \
-            res = env->ops->dense->operator(&arg);                              \
+            res = _fang_env_submit(env, env->ops->dense->operator, &arg,        \
+                _FANG_ARITH_SUBMIT);                                            \
         } else {                                                                \
             /* Check if tensors are broadcastable, if not batched. */           \
             for(int i = 0; i < x->ndims; i++) {                                 \
@@ -526,7 +829,8 @@ int fang_ten_##operator(fang_ten_t *dest, fang_ten_t *x, fang_ten_t *y) {
             }                                                                   \
                                                                                 \
             arg.z = FANG_I2G((swapped << 0x08) | (uint8_t) pattern);            \
-            res = env->ops->dense->operator(&arg);                              \
+            res = _fang_env_submit(env, env->ops->dense->operator, &arg,        \
+                _FANG_ARITH_SUBMIT);                                            \
         }                                                                       \
     } else {                                                                    \
         /* Classify tensors based on max/min dimension count. */                \
@@ -595,21 +899,25 @@ int fang_ten_##operator(fang_ten_t *dest, fang_ten_t *x, fang_ten_t *y) {
         }                                                                       \
                                                                                 \
         arg.z = FANG_I2G((swapped << 0x08) | (uint8_t) pattern);                \
-        res = env->ops->dense->operator(&arg);                                  \
+        res = _fang_env_submit(env, env->ops->dense->operator, &arg,            \
+            _FANG_ARITH_SUBMIT);                                                \
     }                                                                           \
                                                                                 \
+    _FANG_TAPE_RECORD(env, res, .kind = tape_kind, .dest = dest, .x = x,       \
+        .y = y);                                                                \
+                                                                                \
 out:                                                                            \
     return res;                                                                 \
 }
 
 /* Adds two tensor. */
-FANG_TENSOR_ARITH(sum)
+FANG_TENSOR_ARITH(sum, _FANG_TAPE_SUM)
 
 /* Subtracts two tensor. */
-FANG_TENSOR_ARITH(diff)
+FANG_TENSOR_ARITH(diff, _FANG_TAPE_DIFF)
 
 /* Multiplies two tensor. */
-FANG_TENSOR_ARITH(mul)
+FANG_TENSOR_ARITH(mul, _FANG_TAPE_MUL)
 
 /* Performs General Matrix-Matrix Multiply (GEMM) operation on two trailing
    dimension. */
@@ -620,6 +928,24 @@ int fang_ten_gemm(fang_ten_gemm_transp_t transp_x,
 {
     int res = FANG_OK;
 
+    /* Sparse matrices are multiplied as they are. Having no gradient, they
+       are refused while a tape records, rather than silently skipped. */
+    if(x->typ == FANG_TEN_TYPE_SPARSE &&
+        transp_x == FANG_TEN_GEMM_NO_TRANSPOSE &&
+        transp_y == FANG_TEN_GEMM_NO_TRANSPOSE)
+    {
+        fang_env_t *env;
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+            goto out;
+        if(FANG_UNLIKELY(env->tape != NULL)) {
+            res = -FANG_RECORDING;
+            goto out;
+        }
+
+        res = fang_ten_spmm(beta, dest, alpha, x, y);
+        goto out;
+    }
+
     /* Tensors has to be dense. */
     if(FANG_UNLIKELY(dest->typ != FANG_TEN_TYPE_DENSE ||
         x->typ != FANG_TEN_TYPE_DENSE || y->typ != FANG_TEN_TYPE_DENSE))
@@ -700,6 +1026,11 @@ int fang_ten_gemm(fang_ten_gemm_transp_t transp_x,
         .beta = beta
     };
 
+    /* Destination is only read if `beta` is non-zero. */
+    int mask = _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_Y;
+    if(FANG_G2F(beta) == 0)
+        mask |= _FANG_SUBMIT_OVERWRITE;
+
     /* Tensors with same outer dimension count excluding two trailing dimension
      * maybe batched or broadcasted. */
     if(FANG_LIKELY(x->ndims == y->ndims)) {
@@ -717,7 +1048,7 @@ int fang_ten_gemm(fang_ten_gemm_transp_t transp_x,
 
             /* No need for broadcasting. */
             arg.z = FANG_I2G(transpose_mask | (uint8_t) FANG_NO_BCAST);
-            res = env->ops->dense->gemm(&arg);
+            res = _fang_env_submit(env, env->ops->dense->gemm, &arg, mask);
         } else {    // Tensor operation cannot be batched
             for(int i = 0; i < x->ndims - 2; i++) {
                 uint32_t xdim = wx.dims[i];
@@ -765,7 +1096,7 @@ int fang_ten_gemm(fang_ten_gemm_transp_t transp_x,
             }
 
             arg.z = FANG_I2G(transpose_mask | (uint8_t) pattern);
-            res = env->ops->dense->gemm(&arg);
+            res = _fang_env_submit(env, env->ops->dense->gemm, &arg, mask);
         }
     } else {
         /* Classify tensors based on max/min dimension count. */
@@ -830,9 +1161,851 @@ int fang_ten_gemm(fang_ten_gemm_transp_t transp_x,
         }
 
         arg.z = FANG_I2G(transpose_mask | (uint8_t) pattern);
-        res = env->ops->dense->gemm(&arg);
+        res = _fang_env_submit(env, env->ops->dense->gemm, &arg, mask);
+    }
+
+    _FANG_TAPE_RECORD(env, res, .kind = _FANG_TAPE_GEMM, .dest = dest, .x = x,
+        .y = y, .alpha = alpha, .beta = beta, .transp_x = transp_x,
+        .transp_y = transp_y);
+
+out:
+    return res;
+}
+
+/* Performs 2D convolution of images with weights. */
+int fang_ten_conv2d(fang_ten_t *dest, fang_ten_t *x, fang_ten_t *w,
+    const fang_ten_conv2d_t *conv)
+{
+    int res = FANG_OK;
+
+    /* Tensors has to be dense. */
+    if(FANG_UNLIKELY(dest->typ != FANG_TEN_TYPE_DENSE ||
+        x->typ != FANG_TEN_TYPE_DENSE || w->typ != FANG_TEN_TYPE_DENSE))
+    {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+
+    /* Tensors have to belong to same Environment. */
+    if(FANG_UNLIKELY(dest->eid != x->eid || x->eid != w->eid)) {
+        res = -FANG_ENVNOMATCH;
+        goto out;
+    }
+
+    /* Tensors have to have same data type. */
+    if(FANG_UNLIKELY(dest->dtyp != x->dtyp || x->dtyp != w->dtyp)) {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+
+    // TODO: Add support for more data types.
+    if(FANG_UNLIKELY(x->dtyp != FANG_TEN_DTYPE_FLOAT32)) {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    /* Images and weights are four dimensional. */
+    if(FANG_UNLIKELY(x->ndims != 4 || w->ndims != 4)) {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    bool nhwc = conv->layout == FANG_TEN_CONV_NHWC;
+    uint32_t stride[2], dilation[2], groups = conv->groups ? conv->groups : 1;
+    for(int i = 0; i < 2; i++) {
+        stride[i]   = conv->stride[i] ? conv->stride[i] : 1;
+        dilation[i] = conv->dilation[i] ? conv->dilation[i] : 1;
+
+        /* Parameters are packed in 16-bit fields. */
+        if(FANG_UNLIKELY(stride[i] > UINT16_MAX || dilation[i] > UINT16_MAX ||
+            conv->padding[i] > UINT16_MAX))
+        {
+            res = -FANG_INVCONV;
+            goto out;
+        }
+    }
+
+    /* Channels, spatial dimensions of input and kernel, height first. */
+    uint32_t c  = x->dims[nhwc ? 3 : 1], k = w->dims[0];
+    uint32_t cg = w->dims[nhwc ? 3 : 1];
+    uint32_t in[2]  = { x->dims[nhwc ? 1 : 2], x->dims[nhwc ? 2 : 3] };
+    uint32_t ker[2] = { w->dims[nhwc ? 1 : 2], w->dims[nhwc ? 2 : 3] };
+    if(FANG_UNLIKELY(conv->layout < FANG_TEN_CONV_NCHW ||
+        conv->layout > FANG_TEN_CONV_NHWC || groups > INT32_MAX ||
+        c % groups || k % groups || cg != c / groups))
+    {
+        res = -FANG_INVCONV;
+        goto out;
+    }
+
+    uint32_t out[2];
+    for(int i = 0; i < 2; i++) {
+        uint64_t span = (uint64_t) dilation[i] * (ker[i] - 1) + 1;
+        if(FANG_UNLIKELY(span > in[i] + 2 * (uint64_t) conv->padding[i])) {
+            res = -FANG_INVCONV;
+            goto out;
+        }
+        out[i] = (uint32_t) ((in[i] + 2 * (uint64_t) conv->padding[i] - span) /
+            stride[i] + 1);
+    }
+
+    /* Check if destination tensor is valid to store result. */
+    uint32_t expect[4] = { x->dims[0], k, out[0], out[1] };
+    if(nhwc) {
+        expect[1] = out[0];
+        expect[2] = out[1];
+        expect[3] = k;
+    }
+    if(FANG_UNLIKELY(dest->ndims != 4 ||
+        memcmp(dest->dims, expect, sizeof(expect))))
+    {
+        res = -FANG_DESTINVDIM;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    /* Parameters are packed as:
+     *     alpha: | dilation w | dilation h | stride w | stride h |
+     *     beta:  |          groups         | padding w | padding h |
+     */
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .y = (fang_gen_t) w,
+        .z = FANG_I2G(conv->layout),
+        .alpha = FANG_U2G((fang_uint_t) stride[0] |
+            (fang_uint_t) stride[1] << 16 | (fang_uint_t) dilation[0] << 32 |
+            (fang_uint_t) dilation[1] << 48),
+        .beta = FANG_U2G((fang_uint_t) conv->padding[0] |
+            (fang_uint_t) conv->padding[1] << 16 | (fang_uint_t) groups << 32)
+    };
+    res = _fang_env_submit(env, env->ops->dense->conv2d, &arg,
+        _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_Y |
+        _FANG_SUBMIT_OVERWRITE);
+
+out:
+    return res;
+}
+
+/* Performs 2D pooling of images. */
+int fang_ten_pool2d(fang_ten_t *dest, fang_ten_t *x,
+    const fang_ten_pool2d_t *pool)
+{
+    int res = FANG_OK;
+
+    /* Tensors has to be dense. */
+    if(FANG_UNLIKELY(dest->typ != FANG_TEN_TYPE_DENSE ||
+        x->typ != FANG_TEN_TYPE_DENSE))
+    {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+
+    /* Tensors have to belong to same Environment. */
+    if(FANG_UNLIKELY(dest->eid != x->eid)) {
+        res = -FANG_ENVNOMATCH;
+        goto out;
+    }
+
+    /* Tensors have to have same data type. */
+    if(FANG_UNLIKELY(dest->dtyp != x->dtyp)) {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+
+    // TODO: Add support for more data types.
+    if(FANG_UNLIKELY(x->dtyp != FANG_TEN_DTYPE_FLOAT32)) {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    /* Images are four dimensional. */
+    if(FANG_UNLIKELY(x->ndims != 4)) {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(pool->layout < FANG_TEN_CONV_NCHW ||
+        pool->layout > FANG_TEN_CONV_NHWC || pool->type < FANG_TEN_POOL_MAX ||
+        pool->type > FANG_TEN_POOL_AVG))
+    {
+        res = -FANG_INVPOOL;
+        goto out;
+    }
+
+    bool nhwc = pool->layout == FANG_TEN_CONV_NHWC;
+    uint32_t in[2] = { x->dims[nhwc ? 1 : 2], x->dims[nhwc ? 2 : 3] };
+    uint32_t stride[2], out[2];
+    for(int i = 0; i < 2; i++) {
+        stride[i] = pool->stride[i] ? pool->stride[i] : pool->window[i];
+
+        /* Parameters are packed in 16-bit fields. Padding smaller than the
+           window keeps every window partly inside the input. */
+        if(FANG_UNLIKELY(pool->window[i] == 0 ||
+            pool->window[i] > UINT16_MAX || stride[i] > UINT16_MAX ||
+            pool->padding[i] >= pool->window[i] ||
+            pool->window[i] > in[i] + 2 * (uint64_t) pool->padding[i]))
+        {
+            res = -FANG_INVPOOL;
+            goto out;
+        }
+        out[i] = (uint32_t) ((in[i] + 2 * (uint64_t) pool->padding[i] -
+            pool->window[i]) / stride[i] + 1);
+    }
+
+    /* Check if destination tensor is valid to store result. */
+    uint32_t expect[4] = { x->dims[0], x->dims[1], out[0], out[1] };
+    if(nhwc) {
+        expect[1] = out[0];
+        expect[2] = out[1];
+        expect[3] = x->dims[3];
+    }
+    if(FANG_UNLIKELY(dest->ndims != 4 ||
+        memcmp(dest->dims, expect, sizeof(expect))))
+    {
+        res = -FANG_DESTINVDIM;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    /* Parameters are packed as:
+     *     z:     |  type  | layout |
+     *     alpha: | stride w | stride h | window w | window h |
+     *     beta:  |                     | padding w | padding h |
+     */
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .z = FANG_U2G((fang_uint_t) pool->layout |
+            (fang_uint_t) pool->type << 8),
+        .alpha = FANG_U2G((fang_uint_t) pool->window[0] |
+            (fang_uint_t) pool->window[1] << 16 |
+            (fang_uint_t) stride[0] << 32 | (fang_uint_t) stride[1] << 48),
+        .beta = FANG_U2G((fang_uint_t) pool->padding[0] |
+            (fang_uint_t) pool->padding[1] << 16)
+    };
+    res = _fang_env_submit(env, env->ops->dense->pool2d, &arg,
+        _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_OVERWRITE);
+
+out:
+    return res;
+}
+
+/* Averages images over height and width. */
+int fang_ten_global_avgpool2d(fang_ten_t *dest, fang_ten_t *x,
+    fang_ten_conv_layout_t layout)
+{
+    if(FANG_UNLIKELY(x->typ != FANG_TEN_TYPE_DENSE))
+        return -FANG_INVTENTYP;
+    if(FANG_UNLIKELY(x->ndims != 4))
+        return -FANG_INVDIM;
+
+    /* A single window spanning whole image. */
+    bool nhwc = layout == FANG_TEN_CONV_NHWC;
+    fang_ten_pool2d_t pool = {
+        .layout = layout,
+        .type = FANG_TEN_POOL_AVG,
+        .window = { x->dims[nhwc ? 1 : 2], x->dims[nhwc ? 2 : 3] }
+    };
+    return fang_ten_pool2d(dest, x, &pool);
+}
+
+/* Checks a tensor taking part in normalization of `x`. It either has shape of
+   `x`, or is a vector of size of it's last dimension. */
+static int _fang_ten_norm_check(fang_ten_t *ten, fang_ten_t *x, bool vector,
+    int dim_err)
+{
+    if(ten == NULL)
+        return FANG_OK;
+
+    if(FANG_UNLIKELY(ten->typ != FANG_TEN_TYPE_DENSE))
+        return -FANG_INVTENTYP;
+    if(FANG_UNLIKELY(ten->eid != x->eid))
+        return -FANG_ENVNOMATCH;
+    if(FANG_UNLIKELY(ten->dtyp != x->dtyp))
+        return -FANG_INVDTYP;
+
+    bool match = vector ?
+        ten->ndims == 1 && ten->dims[0] == x->dims[x->ndims - 1] :
+        ten->ndims == x->ndims &&
+        !memcmp(ten->dims, x->dims, x->ndims * sizeof(uint32_t));
+    return FANG_LIKELY(match) ? FANG_OK : dim_err;
+}
+
+/* Checks input of normalization and it's statistics. */
+static int _fang_ten_norm_check_input(fang_ten_norm_type_t type, fang_ten_t *x,
+    fang_ten_t *stats)
+{
+    if(FANG_UNLIKELY(x->typ != FANG_TEN_TYPE_DENSE))
+        return -FANG_INVTENTYP;
+    if(FANG_UNLIKELY(type < FANG_TEN_NORM_LAYER || type > FANG_TEN_NORM_RMS))
+        return -FANG_INVNORM;
+
+    /* Statistics are single-precision whatever the input is. */
+    if(FANG_UNLIKELY(x->dtyp != FANG_TEN_DTYPE_FLOAT16 &&
+        x->dtyp != FANG_TEN_DTYPE_BFLOAT16 &&
+        x->dtyp != FANG_TEN_DTYPE_FLOAT32))
+    {
+        return -FANG_UNSUPDTYP;
+    }
+    if(FANG_UNLIKELY(x->ndims < 1))
+        return -FANG_INVDIM;
+
+    if(stats == NULL)
+        return FANG_OK;
+    if(FANG_UNLIKELY(stats->typ != FANG_TEN_TYPE_DENSE))
+        return -FANG_INVTENTYP;
+    if(FANG_UNLIKELY(stats->eid != x->eid))
+        return -FANG_ENVNOMATCH;
+    if(FANG_UNLIKELY(stats->dtyp != FANG_TEN_DTYPE_FLOAT32))
+        return -FANG_INVDTYP;
+    if(FANG_UNLIKELY(stats->ndims != x->ndims ||
+        memcmp(stats->dims, x->dims, (x->ndims - 1) * sizeof(uint32_t)) ||
+        stats->dims[x->ndims - 1] != 2))
+    {
+        return -FANG_INVDIM;
+    }
+
+    return FANG_OK;
+}
+
+/* Normalizes rows of a tensor. */
+int fang_ten_norm(fang_ten_norm_type_t type, fang_ten_t *dest, fang_ten_t *x,
+    fang_ten_t *gamma, fang_ten_t *beta, fang_gen_t eps, fang_ten_t *stats)
+{
+    int res = FANG_OK;
+
+    /* Destination is required, unlike parameters. */
+    if(FANG_UNLIKELY(dest == NULL)) {
+        res = -FANG_INVNORM;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_norm_check_input(type, x,
+        stats)) ||
+        !FANG_ISOK(res = _fang_ten_norm_check(dest, x, false,
+        -FANG_DESTINVDIM)) ||
+        !FANG_ISOK(res = _fang_ten_norm_check(gamma, x, true, -FANG_INVDIM)) ||
+        !FANG_ISOK(res = _fang_ten_norm_check(beta, x, true, -FANG_INVDIM))))
+    {
+        goto out;
+    }
+
+    float feps = (float) FANG_G2F(eps);
+    if(FANG_UNLIKELY(!(feps >= 0))) {
+        res = -FANG_INVNORM;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    /* Parameters are packed as:
+     *     alpha: | type | eps (single-precision bits) |
+     */
+    uint32_t eps_bits;
+    memcpy(&eps_bits, &feps, sizeof(float));
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .y = (fang_gen_t) gamma,
+        .z = (fang_gen_t) beta,
+        .alpha = FANG_U2G((fang_uint_t) eps_bits | (fang_uint_t) type << 32),
+        .beta = (fang_gen_t) stats
+    };
+
+    int mask = _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_OVERWRITE;
+    mask |= gamma != NULL ? _FANG_SUBMIT_Y : 0;
+    mask |= beta != NULL ? _FANG_SUBMIT_Z : 0;
+    mask |= stats != NULL ? _FANG_SUBMIT_BETA : 0;
+    res = _fang_env_submit(env, env->ops->dense->norm, &arg, mask);
+
+out:
+    return res;
+}
+
+/* Computes gradients of normalization. */
+int fang_ten_norm_backward(fang_ten_norm_type_t type, fang_ten_t *dx,
+    fang_ten_t *dgamma, fang_ten_t *dbeta, fang_ten_t *dy, fang_ten_t *x,
+    fang_ten_t *gamma, fang_ten_t *stats)
+{
+    int res = FANG_OK;
+
+    /* Statistics of the forward pass are required. */
+    if(FANG_UNLIKELY(stats == NULL)) {
+        res = -FANG_INVNORM;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_norm_check_input(type, x,
+        stats)) ||
+        !FANG_ISOK(res = _fang_ten_norm_check(dy, x, false, -FANG_INVDIM)) ||
+        !FANG_ISOK(res = _fang_ten_norm_check(gamma, x, true, -FANG_INVDIM)) ||
+        !FANG_ISOK(res = _fang_ten_norm_check(dx, x, false,
+        -FANG_DESTINVDIM)) ||
+        !FANG_ISOK(res = _fang_ten_norm_check(dgamma, x, true,
+        -FANG_DESTINVDIM)) ||
+        !FANG_ISOK(res = _fang_ten_norm_check(dbeta, x, true,
+        -FANG_DESTINVDIM))))
+    {
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    /* Gradient of input is computed by rows, ones of parameters by columns,
+     * hence by separate operators. Type, and which one is run, are packed as:
+     *     beta: | gradients of parameters | type |
+     */
+    int mask = _FANG_SUBMIT_X | _FANG_SUBMIT_Y | _FANG_SUBMIT_ALPHA;
+    if(dx != NULL) {
+        fang_ten_ops_arg_t arg = {
+            .dest = (fang_gen_t) dx,
+            .x = (fang_gen_t) dy,
+            .y = (fang_gen_t) x,
+            .z = (fang_gen_t) gamma,
+            .alpha = (fang_gen_t) stats,
+            .beta = FANG_U2G((fang_uint_t) type)
+        };
+        if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_submit(env,
+            env->ops->dense->norm_backward, &arg, mask | _FANG_SUBMIT_DEST |
+            _FANG_SUBMIT_OVERWRITE | (gamma != NULL ? _FANG_SUBMIT_Z : 0)))))
+        {
+            goto out;
+        }
+    }
+
+    if(dgamma != NULL || dbeta != NULL) {
+        fang_ten_ops_arg_t arg = {
+            .dest = (fang_gen_t) dgamma,
+            .x = (fang_gen_t) dy,
+            .y = (fang_gen_t) x,
+            .z = (fang_gen_t) dbeta,
+            .alpha = (fang_gen_t) stats,
+            .beta = FANG_U2G((fang_uint_t) type | 1 << 8)
+        };
+        mask |= dgamma != NULL ? _FANG_SUBMIT_DEST | _FANG_SUBMIT_OVERWRITE :
+            0;
+        mask |= dbeta != NULL ? _FANG_SUBMIT_Z : 0;
+        res = _fang_env_submit(env, env->ops->dense->norm_backward, &arg,
+            mask);
+    }
+
+out:
+    return res;
+}
+
+/* Checks statistics and parameters of batch normalization of `c` channels,
+   packing `eps` in single-precision bits. */
+static int _fang_ten_batchnorm_check(fang_ten_t *stats, fang_ten_t *gamma,
+    fang_ten_t *beta, uint32_t c, int eid, fang_gen_t eps,
+    uint32_t *restrict eps_bits)
+{
+    /* Statistics are required, parameters are not. */
+    if(FANG_UNLIKELY(stats == NULL))
+        return -FANG_INVNORM;
+
+    /* Statistics are (2, c), parameters vectors of channels. */
+    fang_ten_t *tens[] = { stats, gamma, beta };
+    for(int i = 0; i < 3; i++) {
+        fang_ten_t *ten = tens[i];
+        if(ten == NULL)
+            continue;
+
+        if(FANG_UNLIKELY(ten->typ != FANG_TEN_TYPE_DENSE))
+            return -FANG_INVTENTYP;
+        if(FANG_UNLIKELY(ten->eid != eid))
+            return -FANG_ENVNOMATCH;
+        if(FANG_UNLIKELY(ten->dtyp != FANG_TEN_DTYPE_FLOAT32))
+            return -FANG_INVDTYP;
+
+        bool match = i == 0 ?
+            ten->ndims == 2 && ten->dims[0] == 2 && ten->dims[1] == c :
+            ten->ndims == 1 && ten->dims[0] == c;
+        if(FANG_UNLIKELY(!match))
+            return -FANG_INVDIM;
+    }
+
+    float feps = (float) FANG_G2F(eps);
+    if(FANG_UNLIKELY(!(feps >= 0)))
+        return -FANG_INVNORM;
+    memcpy(eps_bits, &feps, sizeof(float));
+
+    return FANG_OK;
+}
+
+/* Applies batch normalization of inference. */
+int fang_ten_batchnorm(fang_ten_t *dest, fang_ten_t *x, fang_ten_t *stats,
+    fang_ten_t *gamma, fang_ten_t *beta, fang_gen_t eps,
+    fang_ten_conv_layout_t layout)
+{
+    int res = FANG_OK;
+
+    /* Tensors has to be dense. */
+    if(FANG_UNLIKELY(dest->typ != FANG_TEN_TYPE_DENSE ||
+        x->typ != FANG_TEN_TYPE_DENSE))
+    {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+
+    /* Tensors have to belong to same Environment. */
+    if(FANG_UNLIKELY(dest->eid != x->eid)) {
+        res = -FANG_ENVNOMATCH;
+        goto out;
+    }
+
+    /* Tensors have to have same data type. */
+    if(FANG_UNLIKELY(dest->dtyp != x->dtyp)) {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+
+    // TODO: Add support for more data types.
+    if(FANG_UNLIKELY(x->dtyp != FANG_TEN_DTYPE_FLOAT32)) {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(layout < FANG_TEN_CONV_NCHW ||
+        layout > FANG_TEN_CONV_NHWC))
+    {
+        res = -FANG_INVNORM;
+        goto out;
     }
 
+    /* A batch of at least one dimension of channels. */
+    if(FANG_UNLIKELY(x->ndims < 2)) {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(dest->ndims != x->ndims ||
+        memcmp(dest->dims, x->dims, x->ndims * sizeof(uint32_t))))
+    {
+        res = -FANG_DESTINVDIM;
+        goto out;
+    }
+
+    uint32_t c = x->dims[layout == FANG_TEN_CONV_NHWC ? x->ndims - 1 : 1];
+    uint32_t eps_bits;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_batchnorm_check(stats, gamma,
+        beta, c, x->eid, eps, &eps_bits))))
+    {
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    /* Parameters are packed as:
+     *     beta: | layout | eps (single-precision bits) |
+     */
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .y = (fang_gen_t) stats,
+        .z = (fang_gen_t) gamma,
+        .alpha = (fang_gen_t) beta,
+        .beta = FANG_U2G((fang_uint_t) eps_bits | (fang_uint_t) layout << 32)
+    };
+
+    int mask = _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_Y |
+        _FANG_SUBMIT_OVERWRITE;
+    mask |= gamma != NULL ? _FANG_SUBMIT_Z : 0;
+    mask |= beta != NULL ? _FANG_SUBMIT_ALPHA : 0;
+    res = _fang_env_submit(env, env->ops->dense->batchnorm, &arg, mask);
+
+out:
+    return res;
+}
+
+/* Folds batch normalization into weights and bias of a layer. */
+int fang_ten_batchnorm_fold(fang_ten_t *w, fang_ten_t *b,
+    fang_ten_fold_axis_t axis, fang_ten_t *stats, fang_ten_t *gamma,
+    fang_ten_t *beta, fang_gen_t eps)
+{
+    int res = FANG_OK;
+
+    /* Tensors has to be dense. */
+    if(FANG_UNLIKELY(w->typ != FANG_TEN_TYPE_DENSE ||
+        b->typ != FANG_TEN_TYPE_DENSE))
+    {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+
+    /* Tensors have to belong to same Environment. */
+    if(FANG_UNLIKELY(w->eid != b->eid)) {
+        res = -FANG_ENVNOMATCH;
+        goto out;
+    }
+
+    /* Tensors have to have same data type. */
+    if(FANG_UNLIKELY(w->dtyp != b->dtyp)) {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+
+    // TODO: Add support for more data types.
+    if(FANG_UNLIKELY(w->dtyp != FANG_TEN_DTYPE_FLOAT32)) {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(axis < FANG_TEN_FOLD_FIRST || axis > FANG_TEN_FOLD_LAST)) {
+        res = -FANG_INVNORM;
+        goto out;
+    }
+
+    /* Bias is a vector of output channels of weights. */
+    if(FANG_UNLIKELY(w->ndims < 1)) {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+    uint32_t c = w->dims[axis == FANG_TEN_FOLD_FIRST ? 0 : w->ndims - 1];
+    if(FANG_UNLIKELY(b->ndims != 1 || b->dims[0] != c)) {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    uint32_t eps_bits;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_batchnorm_check(stats, gamma,
+        beta, c, w->eid, eps, &eps_bits))))
+    {
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, w->eid))))
+        goto out;
+
+    /* Parameters are packed as:
+     *     beta: | axis | eps (single-precision bits) |
+     */
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) w,
+        .x = (fang_gen_t) b,
+        .y = (fang_gen_t) stats,
+        .z = (fang_gen_t) gamma,
+        .alpha = (fang_gen_t) beta,
+        .beta = FANG_U2G((fang_uint_t) eps_bits | (fang_uint_t) axis << 32)
+    };
+
+    int mask = _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_Y;
+    mask |= gamma != NULL ? _FANG_SUBMIT_Z : 0;
+    mask |= beta != NULL ? _FANG_SUBMIT_ALPHA : 0;
+    res = _fang_env_submit(env, env->ops->dense->batchnorm_fold, &arg, mask);
+
+out:
+    return res;
+}
+
+/* Performs scaled dot-product attention. */
+int fang_ten_attention(fang_ten_t *dest, fang_ten_t *q, fang_ten_t *k,
+    fang_ten_t *v, const fang_ten_attention_t *attn)
+{
+    int res = FANG_OK;
+
+    /* Tensors has to be dense. */
+    if(FANG_UNLIKELY(dest->typ != FANG_TEN_TYPE_DENSE ||
+        q->typ != FANG_TEN_TYPE_DENSE || k->typ != FANG_TEN_TYPE_DENSE ||
+        v->typ != FANG_TEN_TYPE_DENSE))
+    {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+
+    /* Tensors have to belong to same Environment. */
+    if(FANG_UNLIKELY(dest->eid != q->eid || q->eid != k->eid ||
+        k->eid != v->eid))
+    {
+        res = -FANG_ENVNOMATCH;
+        goto out;
+    }
+
+    /* Tensors have to have same data type. */
+    if(FANG_UNLIKELY(dest->dtyp != q->dtyp || q->dtyp != k->dtyp ||
+        k->dtyp != v->dtyp))
+    {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+
+    // TODO: Add support for more data types.
+    if(FANG_UNLIKELY(q->dtyp != FANG_TEN_DTYPE_FLOAT32)) {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    /* Queries, keys and values are matrices of same batches and heads. */
+    int nd = q->ndims;
+    if(FANG_UNLIKELY(nd < 2 || k->ndims != nd || v->ndims != nd ||
+        memcmp(k->dims, q->dims, (nd - 2) * sizeof(uint32_t)) ||
+        memcmp(v->dims, q->dims, (nd - 2) * sizeof(uint32_t))))
+    {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    uint64_t bh = 1;
+    for(int i = 0; i < nd - 2; i++)
+        bh *= q->dims[i];
+
+    uint32_t t = q->dims[nd - 2], s = k->dims[nd - 2], d = q->dims[nd - 1];
+    if(FANG_UNLIKELY(bh > INT32_MAX || t > INT32_MAX || s > INT32_MAX ||
+        d > INT32_MAX || v->dims[nd - 1] > INT32_MAX ||
+        k->dims[nd - 1] != d || v->dims[nd - 2] != s ||
+        (attn->causal && s < t)))
+    {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    /* Check if destination tensor is valid to store result. */
+    if(FANG_UNLIKELY(dest->ndims != nd ||
+        memcmp(dest->dims, q->dims, (nd - 1) * sizeof(uint32_t)) ||
+        dest->dims[nd - 1] != v->dims[nd - 1]))
+    {
+        res = -FANG_DESTINVDIM;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, q->eid))))
+        goto out;
+
+    /* Parameters are packed as:
+     *     alpha: | causal | scale (single-precision bits) |
+     */
+    float scale = attn->scale != 0 ? (float) attn->scale :
+        1.0f / sqrtf((float) d);
+    uint32_t scale_bits;
+    memcpy(&scale_bits, &scale, sizeof(float));
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) q,
+        .y = (fang_gen_t) k,
+        .z = (fang_gen_t) v,
+        .alpha = FANG_U2G((fang_uint_t) scale_bits |
+            (fang_uint_t) (attn->causal ? 1 : 0) << 32)
+    };
+    res = _fang_env_submit(env, env->ops->dense->attention, &arg,
+        _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_Y | _FANG_SUBMIT_Z |
+        _FANG_SUBMIT_OVERWRITE);
+
+out:
+    return res;
+}
+
+/* Checks operands of indexing, rows of `table` picked by `idx` being rows of
+   `flat`. Returns `dim_err` if `flat` is not of dimensions of `idx` followed
+   by the rest of dimensions of `table`. */
+static int _fang_ten_index_check(fang_ten_t *flat, fang_ten_t *table,
+    fang_ten_t *idx, int dim_err)
+{
+    /* Tensors has to be dense. */
+    if(FANG_UNLIKELY(flat->typ != FANG_TEN_TYPE_DENSE ||
+        table->typ != FANG_TEN_TYPE_DENSE || idx->typ != FANG_TEN_TYPE_DENSE))
+    {
+        return -FANG_INVTENTYP;
+    }
+
+    /* Tensors have to belong to same Environment. */
+    if(FANG_UNLIKELY(flat->eid != table->eid || table->eid != idx->eid))
+        return -FANG_ENVNOMATCH;
+
+    /* Rows are of same data type, indices are 32 or 64-bit integers. */
+    if(FANG_UNLIKELY(flat->dtyp != table->dtyp ||
+        (idx->dtyp != FANG_TEN_DTYPE_INT32 &&
+        idx->dtyp != FANG_TEN_DTYPE_INT64 &&
+        idx->dtyp != FANG_TEN_DTYPE_UINT32 &&
+        idx->dtyp != FANG_TEN_DTYPE_UINT64)))
+    {
+        return -FANG_INVDTYP;
+    }
+
+    if(FANG_UNLIKELY(table->ndims < 1))
+        return -FANG_INVDIM;
+
+    int rest = table->ndims - 1;
+    if(FANG_UNLIKELY(flat->ndims != idx->ndims + rest ||
+        memcmp(flat->dims, idx->dims, idx->ndims * sizeof(uint32_t)) ||
+        memcmp(flat->dims + idx->ndims, table->dims + 1,
+        rest * sizeof(uint32_t))))
+    {
+        return dim_err;
+    }
+
+    return FANG_OK;
+}
+
+/* Gathers rows of a tensor by indices. */
+int fang_ten_gather(fang_ten_t *dest, fang_ten_t *x, fang_ten_t *idx) {
+    int res = FANG_OK;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_index_check(dest, x, idx,
+        -FANG_DESTINVDIM))))
+    {
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .y = (fang_gen_t) idx
+    };
+    res = _fang_env_submit(env, env->ops->dense->gather, &arg,
+        _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_Y |
+        _FANG_SUBMIT_OVERWRITE);
+
+out:
+    return res;
+}
+
+/* Adds rows of a tensor into rows picked by indices. */
+int fang_ten_scatter_add(fang_ten_t *dest, fang_ten_t *x, fang_ten_t *idx) {
+    int res = FANG_OK;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_index_check(x, dest, idx,
+        -FANG_INVDIM))))
+    {
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(dest->dtyp != FANG_TEN_DTYPE_FLOAT32 &&
+        dest->dtyp != FANG_TEN_DTYPE_FLOAT64))
+    {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .y = (fang_gen_t) idx
+    };
+    res = _fang_env_submit(env, env->ops->dense->scatter_add, &arg,
+        _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_Y);
+
 out:
     return res;
 }
@@ -861,7 +2034,10 @@ int fang_ten_scale(fang_ten_t *ten, fang_gen_t factor) {
         .dest = (fang_gen_t) &input,
         .x = factor,
     };
-    res = env->ops->dense->scale(&arg);
+    res = _fang_env_submit(env, env->ops->dense->scale, &arg,
+        _FANG_SUBMIT_DEST);
+    _FANG_TAPE_RECORD(env, res, .kind = _FANG_TAPE_SCALE, .dest = ten,
+        .alpha = factor);
 
 out:
     return res;
@@ -871,27 +2047,76 @@ out:
 int fang_ten_fill(fang_ten_t *ten, fang_gen_t value) {
     int res = FANG_OK;
 
-    /* Tensor has to be dense tensor. */
-    if(FANG_UNLIKELY(ten->typ != FANG_TEN_TYPE_DENSE)) {
-        res = -FANG_INVTENTYP;
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
         goto out;
+
+    fang_ten_ops_arg_t arg = {
+        .x = value
+    };
+    res = _fang_ten_overwrite(ten, env, env->ops->dense->fill, &arg);
+
+out:
+    return res;
+}
+
+/* Waits for pending asynchronous operators using the data of a tensor. */
+int fang_ten_wait(fang_ten_t *ten) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
+        goto out;
+
+    if(env->stream != NULL) {
+        /* Error may be of operators of other tensors, hence it's left for
+           the Environment to clear. */
+        _fang_env_stream_wait_data(env->stream, ten->data.dense);
+        res = _fang_env_stream_error(env->stream);
     }
 
-    /* Handle scalar tensor. */
-    fang_ten_t input = *ten;
-    input.dims    = input.dims == NULL ? (uint32_t []) { 1 } : input.dims;
-    input.strides = input.strides == NULL ? (uint32_t []) { 1 } : input.strides;
+out:
+    return res;
+}
+
+/* Releases data of a tensor, keeping it's shape. */
+int _fang_ten_evict(fang_ten_t *ten) {
+    int res = FANG_OK;
 
-    /* Get Environment. */
     fang_env_t *env;
     if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
         goto out;
 
+    _fang_ten_wait_data(ten, env);
+
     fang_ten_ops_arg_t arg = {
-        .dest = (fang_gen_t) &input,
-        .x = value,
+        .dest = (fang_gen_t) ten,
+        .z = (fang_gen_t) env
     };
-    res = env->ops->dense->fill(&arg);
+    if(FANG_UNLIKELY(!FANG_ISOK(res = env->ops->dense->release(&arg))))
+        goto out;
+    ten->data.dense = NULL;
+
+out:
+    return res;
+}
+
+/* Allocates data of an evicted tensor again. */
+int _fang_ten_restore(fang_ten_t *ten) {
+    int res = FANG_OK;
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
+        goto out;
+
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) ten,
+        .x = FANG_U2G(ten->dims != NULL ?
+            (fang_uint_t) ten->strides[0] * ten->dims[0] : 1),
+        .z = (fang_gen_t) env,
+        .alpha = FANG_I2G(ten->dtyp)
+    };
+    res = env->ops->dense->create(&arg);
 
 out:
     return res;
@@ -906,6 +2131,9 @@ int fang_ten_release(fang_ten_t *ten) {
     if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, ten->eid))))
         goto out;
 
+    /* Pending operators may still be using the data. */
+    _fang_ten_wait_data(ten, env);
+
     /* Release dimension and stride array. */
     FANG_RELEASE(env->realloc, ten->dims);
     FANG_RELEASE(env->realloc, ten->strides);
@@ -934,7 +2162,7 @@ int fang_ten_release(fang_ten_t *ten) {
     }
 
     /* Update tensor count. */
-    env->ntens--;
+    _fang_atomic_fetch_add(&env->ntens, -1);
 
 out:
     return res;
@@ -0,0 +1,284 @@
+#include <fang/tensor.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <env/stream.h>
+#include <platform/thread.h>
+#include <compiler.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ================ PRIVATE DEFINITIONS ================ */
+
+/* Checks coordinates of `nnz` elements against dimensions of `ten`. */
+static int _fang_ten_sparse_check_idx(const fang_ten_t *ten, int nnz,
+    const uint32_t *restrict idx)
+{
+    for(size_t i = 0; i < (size_t) nnz * ten->ndims; i++) {
+        if(FANG_UNLIKELY(idx[i] >= ten->dims[i % ten->ndims]))
+            return -FANG_INVIDX;
+    }
+
+    return FANG_OK;
+}
+
+/* ================ PRIVATE DEFINITIONS END ================ */
+
+
+/* ================ DEFINITIONS ================ */
+
+/* Creates a new sparse tensor in COO encoding. */
+int fang_ten_sparse_create(fang_ten_t *ten, int eid, fang_ten_dtype_t dtyp,
+    fang_ten_dim_t dim, int nnz, const uint32_t *restrict idx,
+    fang_ten_dtype_t src_dtyp, const void *restrict data)
+{
+    int res = FANG_OK;
+
+    /* Is tensor data type and input data type valid? */
+    if(FANG_UNLIKELY(dtyp < FANG_TEN_DTYPE_INT8 ||
+        dtyp > FANG_TEN_DTYPE_FLOAT64 || (nnz > 0 &&
+        (src_dtyp < FANG_TEN_DTYPE_INT8 || src_dtyp > FANG_TEN_DTYPE_FLOAT64))))
+    {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+
+    /* Every element needs coordinates and a value. */
+    if(FANG_UNLIKELY(nnz < 0 || (nnz > 0 && (idx == NULL || data == NULL)))) {
+        res = -FANG_INVIDX;
+        goto out;
+    }
+
+    /* Tensor type and data type. */
+    ten->typ     = FANG_TEN_TYPE_SPARSE;
+    ten->dtyp    = dtyp;
+    ten->deleter = NULL;
+    ten->grad    = NULL;
+
+    /* Retrieve Environment structure. */
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, eid))))
+        goto out;
+
+    /* Validate and store dimensions and strides. */
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_init_dims(ten, env, dim))))
+        goto out;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_sparse_check_idx(ten, nnz,
+        idx))))
+    {
+        goto fail;
+    }
+
+    /* Call operator. */
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) ten,
+
+        /* Number of non-zero elements. */
+        .x = FANG_I2G(nnz),
+        .y = (fang_gen_t) data,
+        .z = (fang_gen_t) env,
+
+        /* Input data type and coordinates. */
+        .alpha = FANG_I2G(src_dtyp),
+        .beta = (fang_gen_t) idx
+    };
+    if(FANG_UNLIKELY(!FANG_ISOK(res = env->ops->sparse->create(&arg))))
+        goto fail;
+
+    /* Tensor creation successful. */
+    ten->eid = eid;
+    _fang_atomic_fetch_add(&env->ntens, 1);
+    goto out;
+
+fail:
+    FANG_RELEASE(env->realloc, ten->dims);
+    FANG_RELEASE(env->realloc, ten->strides);
+out:
+    return res;
+}
+
+/* Converts a COO sparse matrix (dense one for 2:4) into a compressed
+   encoding. */
+int fang_ten_sparse_convert(fang_ten_t *dest, fang_ten_t *x,
+    fang_ten_sparse_fmt_t fmt, uint32_t block)
+{
+    int res = FANG_OK;
+
+    /* 2:4 is built from dense weights, the rest of encodings from COO. */
+    bool pruned = fmt == FANG_TEN_SPARSE_2_4;
+    if(FANG_UNLIKELY(fmt < FANG_TEN_SPARSE_CSR || fmt > FANG_TEN_SPARSE_2_4 ||
+        x->typ != (pruned ? FANG_TEN_TYPE_DENSE : FANG_TEN_TYPE_SPARSE) ||
+        (!pruned && x->data.sparse->fmt != FANG_TEN_SPARSE_COO)))
+    {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+
+    /* Blocks (groups of 2:4) tile the matrix. */
+    uint32_t b = fmt == FANG_TEN_SPARSE_BSR ? block : 1;
+    uint32_t w = pruned ? 4 : b;
+    if(FANG_UNLIKELY(x->ndims != 2 || b == 0 || x->dims[0] % b != 0 ||
+        x->dims[1] % w != 0))
+    {
+        res = -FANG_INVDIM;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    /* Dense weights may still be written by pending operators. */
+    if(pruned && env->stream != NULL)
+        _fang_env_stream_wait_data(env->stream, x->data.dense);
+
+    dest->typ     = FANG_TEN_TYPE_SPARSE;
+    dest->dtyp    = x->dtyp;
+    dest->deleter = NULL;
+    dest->grad    = NULL;
+
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_ten_init_dims(dest, env,
+        (fang_ten_dim_t) { x->dims, x->ndims }))))
+    {
+        goto out;
+    }
+
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .z = (fang_gen_t) env,
+        .alpha = FANG_I2G(fmt),
+        .beta = FANG_U2G(b)
+    };
+    if(FANG_UNLIKELY(!FANG_ISOK(res = env->ops->sparse->convert(&arg)))) {
+        FANG_RELEASE(env->realloc, dest->dims);
+        FANG_RELEASE(env->realloc, dest->strides);
+        goto out;
+    }
+
+    /* Tensor creation successful. */
+    dest->eid = x->eid;
+    _fang_atomic_fetch_add(&env->ntens, 1);
+
+out:
+    return res;
+}
+
+/* Scatters a sparse tensor into a dense tensor. */
+int fang_ten_sparse_to_dense(fang_ten_t *dest, fang_ten_t *x) {
+    int res = FANG_OK;
+
+    if(FANG_UNLIKELY(dest->typ != FANG_TEN_TYPE_DENSE ||
+        x->typ != FANG_TEN_TYPE_SPARSE))
+    {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(dest->eid != x->eid)) {
+        res = -FANG_ENVNOMATCH;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY(dest->dtyp != x->dtyp)) {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+
+    /* Check if destination tensor is valid to store result. */
+    if(FANG_UNLIKELY(dest->ndims != x->ndims ||
+        memcmp(dest->dims, x->dims, x->ndims * sizeof(uint32_t))))
+    {
+        res = -FANG_DESTINVDIM;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x
+    };
+    res = _fang_env_submit(env, env->ops->sparse->densify, &arg,
+        _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_OVERWRITE);
+
+out:
+    return res;
+}
+
+/* Multiplies a sparse matrix with a dense matrix. */
+int fang_ten_spmm(fang_gen_t beta, fang_ten_t *dest, fang_gen_t alpha,
+    fang_ten_t *x, fang_ten_t *y)
+{
+    int res = FANG_OK;
+
+    /* Only the left-hand-side is sparse. */
+    if(FANG_UNLIKELY(dest->typ != FANG_TEN_TYPE_DENSE ||
+        x->typ != FANG_TEN_TYPE_SPARSE || y->typ != FANG_TEN_TYPE_DENSE))
+    {
+        res = -FANG_INVTENTYP;
+        goto out;
+    }
+
+    /* Tensors have to belong to same Environment. */
+    if(FANG_UNLIKELY(dest->eid != x->eid || x->eid != y->eid)) {
+        res = -FANG_ENVNOMATCH;
+        goto out;
+    }
+
+    /* Tensors have to have same data type. */
+    if(FANG_UNLIKELY(dest->dtyp != x->dtyp || x->dtyp != y->dtyp)) {
+        res = -FANG_INVDTYP;
+        goto out;
+    }
+
+    if(FANG_UNLIKELY((x->dtyp != FANG_TEN_DTYPE_FLOAT32 &&
+        x->dtyp != FANG_TEN_DTYPE_FLOAT64) || (x->dtyp !=
+        FANG_TEN_DTYPE_FLOAT32 && x->data.sparse->fmt == FANG_TEN_SPARSE_2_4)))
+    {
+        res = -FANG_UNSUPDTYP;
+        goto out;
+    }
+
+    /* Operands are matrices of common dimension. */
+    if(FANG_UNLIKELY(x->ndims != 2 || y->ndims != 2 ||
+        x->dims[1] != y->dims[0]))
+    {
+        res = -FANG_INCMATDIM;
+        goto out;
+    }
+
+    /* Check if destination tensor is valid to store result. */
+    if(FANG_UNLIKELY(dest->ndims != 2 || dest->dims[0] != x->dims[0] ||
+        dest->dims[1] != y->dims[1]))
+    {
+        res = -FANG_DESTINVDIM;
+        goto out;
+    }
+
+    fang_env_t *env;
+    if(FANG_UNLIKELY(!FANG_ISOK(res = _fang_env_retrieve(&env, x->eid))))
+        goto out;
+
+    fang_ten_ops_arg_t arg = {
+        .dest = (fang_gen_t) dest,
+        .x = (fang_gen_t) x,
+        .y = (fang_gen_t) y,
+        .alpha = alpha,
+        .beta = beta
+    };
+
+    /* Destination is only read if `beta` is non-zero. */
+    int mask = _FANG_SUBMIT_DEST | _FANG_SUBMIT_X | _FANG_SUBMIT_Y;
+    if(FANG_G2F(beta) == 0)
+        mask |= _FANG_SUBMIT_OVERWRITE;
+    res = _fang_env_submit(env, env->ops->sparse->gemm, &arg, mask);
+
+out:
+    return res;
+}
+
+/* ================ DEFINITIONS END ================ */
@@ -0,0 +1,44 @@
+#ifndef FANG_CPU_ATTN_H
+#define FANG_CPU_ATTN_H
+
+#include <env/cpu/pool.h>
+#include <compiler.h>
+#include <stdbool.h>
+
+/* ================ DATA STRUCTURES ================ */
+
+/* Geometry of scaled dot-product attention. */
+/* NOTE: Queries are (bh, t, d) and output (bh, t, dv), every batch and head
+ *   a contiguous matrix. Keys and values are split in pages of `page` keys,
+ *   (bh, page, d) and (bh, page, dv) each; dense operands are a single page.
+ *   With causal masking, query `i` attends to keys up to `i + s - t`, last
+ *   query to last key.
+ */
+typedef struct _fang_attn {
+    /* Batches times heads. */
+    int bh;
+
+    /* Queries, keys and their dimension, and dimension of values. */
+    int t, s, d, dv;
+
+    /* Keys of a page. */
+    int page;
+
+    float scale;
+    bool causal;
+} _fang_attn_t;
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Single-precision (float32) scaled dot-product attention, overwriting
+   `dest`. `k` and `v` are tables of pages. Runs on `pool` if not NULL. */
+FANG_HOT int _fang_sattn(_fang_pool_t *restrict pool,
+    const _fang_attn_t *restrict attn, float *restrict dest,
+    const float *restrict q, const float *const *k, const float *const *v);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_CPU_ATTN_H
@@ -30,6 +30,46 @@
 
 /* ======== EULER'S CONSTANT EXPONENTIAL END ======== */
 
+/* ======== NATURAL LOGARITHM ======== */
+
+/* Mantissa is kept within [sqrt(0.5), sqrt(2)) to keep series accurate. */
+#define _logf32_sqrthf    0.707106781186547524f
+
+/* Minimax polynomial constants for `log(1 + x)`, from Cephes `logf`. */
+#define _logf32_p0        7.0376836292e-2f
+#define _logf32_p1       -1.1514610310e-1f
+#define _logf32_p2        1.1676998740e-1f
+#define _logf32_p3       -1.2420140846e-1f
+#define _logf32_p4        1.4249322787e-1f
+#define _logf32_p5       -1.6668057665e-1f
+#define _logf32_p6        2.0000714765e-1f
+#define _logf32_p7       -2.4999993993e-1f
+#define _logf32_p8        3.3333331174e-1f
+
+/* `ln2` split in high and low part for exponent scaling. */
+#define _logf32_ln2hi     0.693359375f
+#define _logf32_ln2lo    -2.12194440e-4f
+
+/* ======== NATURAL LOGARITHM END ======== */
+
+/* ======== SINE AND COSINE ======== */
+
+/* `2/pi` and `pi/2` split in three parts (Cody-Waite) for range reduction. */
+#define _sincosf32_2opi    0.636619772367581343f
+#define _sincosf32_pio2a   1.5703125f
+#define _sincosf32_pio2b   4.837512969970703125e-4f
+#define _sincosf32_pio2c   7.54978995489188216e-8f
+
+/* Taylor-like polynomial constants within [-pi/4, pi/4], from Cephes. */
+#define _sinf32_s0        -1.9515295891e-4f
+#define _sinf32_s1         8.3321608736e-3f
+#define _sinf32_s2        -1.6666654611e-1f
+#define _cosf32_c0         2.443315711809948e-5f
+#define _cosf32_c1        -1.388731625493765e-3f
+#define _cosf32_c2         4.166664568298827e-2f
+
+/* ======== SINE AND COSINE END ======== */
+
 /* ================ CONSTANTS MACROS END ================ */
 
 
@@ -139,6 +179,110 @@ FANG_HOT FANG_INLINE static inline __m256 _fang_expf32_ps256(__m256 x) {
     return _mm256_mul_ps(_mm256_castsi256_ps(a_i32), expf_b);
 }
 
+/* Calculates the natural logarithm of a AVX2 256-bit float32 vector. Only
+   positive, normal values are handled. */
+FANG_HOT FANG_INLINE static inline __m256 _fang_logf32_ps256(__m256 x) {
+    /* ==== MATH ====
+         => x = m * 2^e    [ m in [0.5, 1) ]
+         => log(x) = log(m) + e * ln2
+
+       Keeping `m` around 1 by halving it (and incrementing `e`) whenever it is
+       smaller than sqrt(0.5), `log(m)` can be approximated with a short
+       polynomial of `m - 1`.
+       ==== MATH END ==== */
+    register __m256i bits = _mm256_castps_si256(x);
+    register __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+        _mm256_srli_epi32(bits, 23), _mm256_set1_epi32(0x7E)));
+
+    /* Replace exponent to get mantissa in [0.5, 1). */
+    register __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+        _mm256_set1_epi32(0x3F000000)));
+
+    /* if(m < sqrt(0.5)) { e -= 1; m = m + m - 1; } else m = m - 1; */
+    register __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(_logf32_sqrthf),
+        _CMP_LT_OQ);
+    register __m256 one = _mm256_set1_ps(1.0f);
+    e = _mm256_sub_ps(e, _mm256_and_ps(one, small));
+    m = _mm256_add_ps(_mm256_sub_ps(m, one), _mm256_and_ps(m, small));
+
+    /* Horner's method for polynomial `P(m)`. */
+    register __m256 z = _mm256_mul_ps(m, m);
+    register __m256 y = _mm256_set1_ps(_logf32_p0);
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(_logf32_p1));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(_logf32_p2));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(_logf32_p3));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(_logf32_p4));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(_logf32_p5));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(_logf32_p6));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(_logf32_p7));
+    y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(_logf32_p8));
+
+    /* log(1 + m) = m - m^2/2 + m^3 * P(m) */
+    y = _mm256_mul_ps(_mm256_mul_ps(y, z), m);
+    y = _mm256_fmadd_ps(e, _mm256_set1_ps(_logf32_ln2lo), y);
+    y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+
+    return _mm256_fmadd_ps(e, _mm256_set1_ps(_logf32_ln2hi),
+        _mm256_add_ps(m, y));
+}
+
+/* Calculates both sine and cosine of a AVX2 256-bit float32 vector. Accurate
+   for moderate magnitudes, e.g. within [-8192, 8192]. */
+FANG_HOT FANG_INLINE static inline void _fang_sincosf32_ps256(__m256 x,
+    __m256 *restrict s, __m256 *restrict c)
+{
+    /* ==== MATH ====
+         => x = k * pi/2 + y    [ k is integer, y in [-pi/4, pi/4] ]
+
+       Sine and cosine of `y` converge quickly, and depending on the quadrant
+       `k mod 4`, they are swapped and/or negated:
+         k mod 4 :   0      1      2      3
+         sin(x)  : sin(y)  cos(y) -sin(y) -cos(y)
+         cos(x)  : cos(y) -sin(y) -cos(y)  sin(y)
+       ==== MATH END ==== */
+    register __m256 k = _mm256_round_ps(_mm256_mul_ps(x,
+        _mm256_set1_ps(_sincosf32_2opi)), _MM_FROUND_TO_NEAREST_INT |
+        _MM_FROUND_NO_EXC);
+    register __m256i q = _mm256_cvtps_epi32(k);
+
+    /* Reduce with `pi/2` split in three parts to not lose precision. */
+    register __m256 y = _mm256_fnmadd_ps(k, _mm256_set1_ps(_sincosf32_pio2a),
+        x);
+    y = _mm256_fnmadd_ps(k, _mm256_set1_ps(_sincosf32_pio2b), y);
+    y = _mm256_fnmadd_ps(k, _mm256_set1_ps(_sincosf32_pio2c), y);
+    register __m256 z = _mm256_mul_ps(y, y);
+
+    /* sin(y) = y + y^3 * (s2 + z * (s1 + z * s0)) */
+    register __m256 ps = _mm256_set1_ps(_sinf32_s0);
+    ps = _mm256_fmadd_ps(ps, z, _mm256_set1_ps(_sinf32_s1));
+    ps = _mm256_fmadd_ps(ps, z, _mm256_set1_ps(_sinf32_s2));
+    ps = _mm256_fmadd_ps(_mm256_mul_ps(ps, z), y, y);
+
+    /* cos(y) = 1 - z/2 + z^2 * (c2 + z * (c1 + z * c0)) */
+    register __m256 pc = _mm256_set1_ps(_cosf32_c0);
+    pc = _mm256_fmadd_ps(pc, z, _mm256_set1_ps(_cosf32_c1));
+    pc = _mm256_fmadd_ps(pc, z, _mm256_set1_ps(_cosf32_c2));
+    pc = _mm256_mul_ps(_mm256_mul_ps(pc, z), z);
+    pc = _mm256_add_ps(_mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), pc),
+        _mm256_set1_ps(1.0f));
+
+    /* Swap on odd quadrants. */
+    register __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+        _mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    register __m256 rs = _mm256_blendv_ps(ps, pc, swap);
+    register __m256 rc = _mm256_blendv_ps(pc, ps, swap);
+
+    /* Sine is negated in quadrants 2 and 3, cosine in 1 and 2. */
+    register __m256i sign_s = _mm256_slli_epi32(_mm256_and_si256(q,
+        _mm256_set1_epi32(2)), 30);
+    register __m256i sign_c = _mm256_slli_epi32(_mm256_and_si256(
+        _mm256_add_epi32(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30);
+
+    *s = _mm256_xor_ps(rs, _mm256_castsi256_ps(sign_s));
+    *c = _mm256_xor_ps(rc, _mm256_castsi256_ps(sign_c));
+}
+
 #endif  // FANG_USE_AVX2
 
 /* ================ INLINE DEFINITIONS END ================ */
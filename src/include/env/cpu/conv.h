@@ -0,0 +1,63 @@
+#ifndef FANG_CPU_CONV_H
+#define FANG_CPU_CONV_H
+
+#include <env/cpu/pool.h>
+#include <compiler.h>
+#include <stdbool.h>
+
+/* ================ DATA STRUCTURES ================ */
+
+/* Geometry of a 2D convolution. */
+/* NOTE: Input is (n, c, h, w) and output (n, k, oh, ow) in NCHW layout,
+ *   weights are (k, c / groups, kh, kw). In NHWC layout, input is (n, h, w, c),
+ *   output (n, oh, ow, k) and weights (k, kh, kw, c / groups).
+ */
+typedef struct _fang_conv2d {
+    bool nhwc;
+
+    /* Input. */
+    int n, c, h, w;
+
+    /* Output channels and kernel. */
+    int k, kh, kw;
+
+    /* Output. */
+    int oh, ow;
+
+    /* Stride, padding and dilation of height and width. */
+    int sh, sw;
+    int ph, pw;
+    int dh, dw;
+
+    int groups;
+} _fang_conv2d_t;
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Single-precision (float32) 2D convolution, overwriting `dest`. Runs on
+   `pool` if not NULL. */
+FANG_HOT int _fang_sconv2d(_fang_pool_t *restrict pool,
+    const _fang_conv2d_t *restrict conv, float *restrict dest,
+    const float *restrict x, const float *restrict w);
+
+/* Whether a convolution is run by Winograd F(4x4, 3x3). */
+FANG_HOT bool _fang_sconv2d_winograd_fits(const _fang_conv2d_t *restrict conv);
+
+/* Single-precision 3x3 convolution of stride 1 by Winograd F(4x4, 3x3). */
+FANG_HOT int _fang_sconv2d_winograd(_fang_pool_t *restrict pool,
+    const _fang_conv2d_t *restrict conv, float *restrict dest,
+    const float *restrict x, const float *restrict w);
+
+/* Single-precision 2D max or average pooling, overwriting `dest`. Window is
+   the kernel of `conv`, with output channels and groups same as input
+   channels. Runs on `pool` if not NULL. */
+FANG_HOT int _fang_spool2d(_fang_pool_t *restrict pool,
+    const _fang_conv2d_t *restrict conv, bool max, float *restrict dest,
+    const float *restrict x);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_CPU_CONV_H
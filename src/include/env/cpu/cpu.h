@@ -2,10 +2,28 @@
 #define FANG_ENV_CPU_H
 
 #include <fang/env.h>
+#include <env/cpu/pool.h>
 #include <memory.h>
 
 /* ================ DATA STRUCTURES ================ */
 
+/* Topology of a single logical processor. Indices are dense, i.e. from 0 up
+   to total count of sockets, physical cores or L3 caches. */
+typedef struct _fang_env_cpu_proc {
+    /* ID given by the operating system, as taken by affinity calls. */
+    int id;
+
+    int socket;
+    int core;
+
+    /* Rank among the hardware threads (SMT siblings) of the physical core, 0
+       for the first one. */
+    int smt;
+
+    /* Last level (L3) cache domain. */
+    int llc;
+} _fang_env_cpu_proc_t;
+
 /* Holds CPU exclusive data. */
 typedef struct _fang_env_cpu {
     /* Private structure inheritance. */
@@ -16,8 +34,19 @@ typedef struct _fang_env_cpu {
        enabled. */
     int nproc;
 
-    /* Total active processors. */
+    /* Topology of each logical processor. */
+    _fang_env_cpu_proc_t *procs;
+
+    /* Sockets, physical cores and L3 cache domains in machine. */
+    int nsockets;
+    int ncores;
+    int nllcs;
+
+    /* Total active processors, i.e. threads operators run on. */
     int nact;
+
+    /* Threads operators of this Environment are run on. */
+    _fang_pool_t pool;
 } _fang_env_cpu_t;
 
 /* ================ DATA STRUCTURES END ================ */
@@ -76,8 +76,14 @@ FANG_HOT FANG_INLINE static inline
 
     if(FANG_LIKELY(exp > 0 && exp < 31))  // Normal numbers
         sign |= ((exp & 0x1F) << 10) | mann;
-    else if(FANG_UNLIKELY(exp > 30))  // Overflow, infinity or NaN
-        sign |= 0x7C00 | mann;
+    else if(FANG_UNLIKELY(exp > 30)) {  // Overflow, infinity or NaN
+        /* Finite overflow is infinity; NaNs stay quiet NaNs, even if only
+           their dropped mantissa bits were set. */
+        if(((bits >> 23) & 0xFF) == 0xFF && (bits & 0x007FFFFF))
+            sign |= 0x7E00 | mann;
+        else
+            sign |= 0x7C00;
+    }
 
     /* Normal numbers in 32-bit float might as well be subnormal numbers in
        8-bit float. */
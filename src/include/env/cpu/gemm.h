@@ -1,9 +1,11 @@
 #ifndef FANG_CPU_GEMM_H
 #define FANG_CPU_GEMM_H
 
+#include <env/cpu/pool.h>
 #include <platform/memory.h>
 #include <compiler.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #if defined(FANG_USE_AVX512) || defined(FANG_USE_AVX2)
 #include <immintrin.h>
@@ -48,10 +50,11 @@ extern int _sgemm_nr[];
 
 /* ================ DECLARATIONS ================ */
 
-/* Single-precision (float32) GEMM. */
-FANG_HOT int _fang_sgemm(bool transp_x, bool transp_y, int m, int n, int k,
-    float beta, float *restrict dest, int ld_dest, float alpha,
-    float *restrict x, int ld_x, float *restrict y, int ld_y);
+/* Single-precision (float32) GEMM. Runs on `pool` if not NULL. */
+FANG_HOT int _fang_sgemm(_fang_pool_t *restrict pool, bool transp_x,
+    bool transp_y, int m, int n, int k, float beta, float *restrict dest,
+    int ld_dest, float alpha, float *restrict x, int ld_x, float *restrict y,
+    int ld_y);
 
 /* SGEMM packing subroutine. */
 /* NOTE: This packing subroutine favors the row-major access pattern of matrices
@@ -63,6 +66,17 @@ FANG_HOT int _fang_sgemm(bool transp_x, bool transp_y, int m, int n, int k,
 FANG_HOT void _fang_sgemm_pack(int k, int xn, int stride, float *restrict x,
     int ld_x, float *restrict x_tilde, bool transpose);
 
+/* Single-precision (float32) GEMM of a 2:4 structured sparse `x` (m, k),
+ * dest := alpha * xy + beta * dest. `x_val` holds the 2 kept elements of
+ * every group of 4 consecutive elements of a row, (m, k / 2), and `x_meta`
+ * the columns of them within their group, 2 bits each, 16 to a word and rows
+ * padded to whole words. `k` is a multiple of 4. Runs on `pool` if not
+ * NULL. */
+FANG_HOT int _fang_sgemm24(_fang_pool_t *restrict pool, int m, int n, int k,
+    float beta, float *restrict dest, int ld_dest, float alpha,
+    const float *restrict x_val, const uint32_t *restrict x_meta,
+    const float *restrict y, int ld_y);
+
 /* ================ DECLARATIONS END ================ */
 
 
@@ -89,7 +103,6 @@ _fang_##gemm##_loop1(int m, int n, int k,
     int stride_mr = _##gemm##_mr[FANG_##gemmu##_KERNEL];                        \
     int stride_nr = _##gemm##_nr[FANG_##gemmu##_KERNEL];                        \
                                                                                 \
-    /* TODO: Parallelize loop 3. */                                             \
     for(int j = 0; j < n; j += stride_nr) {                                     \
         int jb = _FANG_MIN(stride_nr, n - j);                                   \
                                                                                 \
@@ -133,7 +146,6 @@ _fang_##gemm##_loop2(int m, int n, int k,
 {                                                                               \
     int stride_mr = _##gemm##_mr[FANG_##gemmu##_KERNEL];                        \
                                                                                 \
-    /* TODO: Parallelize loop 3. */                                             \
     for(int i = 0; i < m; i += stride_mr) {                                     \
         int ib = _FANG_MIN(stride_mr, m - i);                                   \
                                                                                 \
@@ -143,10 +155,65 @@ _fang_##gemm##_loop2(int m, int n, int k,
     }                                                                           \
 }                                                                               \
                                                                                 \
-/* Loop 3, slices matrix `dest` and `y` in terms of column cache block (KC).
+/* Shared state of parallel loops 2 and 3. */                                   \
+typedef struct _fang_##gemm##_par {                                             \
+    bool transp_y;                                                              \
+    int m, n, k;                                                                \
+    dtype beta;                                                                 \
+    dtype *dest;                                                                \
+    int ld_dest;                                                                \
+    dtype alpha;                                                                \
+    dtype *x_packed;                                                            \
+    dtype *y;                                                                   \
+    int ld_y;                                                                   \
+    /* One KCxNC block per thread in loop 3, a single shared one in             \
+       loop 2. */                                                               \
+    dtype *y_tilde;                                                             \
+} _fang_##gemm##_par_t;                                                         \
+                                                                                \
+/* Task of parallel loop 2, a single MRxKC micro-panel of `x`. */               \
+FANG_HOT static void _fang_##gemm##_task2(void *restrict arg, ptrdiff_t task,   \
+    FANG_UNUSED int wid)                                                        \
+{                                                                               \
+    _fang_##gemm##_par_t *par = (_fang_##gemm##_par_t *) arg;                   \
+    int stride_mr = _##gemm##_mr[FANG_##gemmu##_KERNEL];                        \
+    int i = (int) task * stride_mr;                                             \
+    int ld_dest = par->ld_dest;                                                 \
+    dtype *dest = par->dest;                                                    \
+                                                                                \
+    _fang_##gemm##_loop1(_FANG_MIN(stride_mr, par->m - i), par->n, par->k,      \
+        par->beta, &_gamma(i, 0), ld_dest, par->alpha,                          \
+        &par->x_packed[i * par->k], par->y_tilde);                              \
+}                                                                               \
+                                                                                \
+/* Task of parallel loop 3, a single KCxNC block of `y` packed in scratch       \
+   memory of the thread. */                                                     \
+FANG_HOT static void _fang_##gemm##_task3(void *restrict arg, ptrdiff_t task,   \
+    int wid)                                                                    \
+{                                                                               \
+    _fang_##gemm##_par_t *par = (_fang_##gemm##_par_t *) arg;                   \
+    int j = (int) task * FANG_##gemmu##_NC;                                     \
+    int jb = _FANG_MIN(FANG_##gemmu##_NC, par->n - j);                          \
+    int ld_dest = par->ld_dest, ld_y = par->ld_y;                               \
+    dtype *dest = par->dest, *y = par->y;                                       \
+    dtype *y_tilde = par->y_tilde + (size_t) wid * FANG_##gemmu##_KC *          \
+        FANG_##gemmu##_NC;                                                      \
+                                                                                \
+    _fang_##gemm##_pack(par->k, jb, _##gemm##_nr[FANG_##gemmu##_KERNEL],        \
+        &_beta(0, j), ld_y, y_tilde, par->transp_y);                            \
+                                                                                \
+    _fang_##gemm##_loop2(par->m, jb, par->k, par->beta, &_gamma(0, j),          \
+        ld_dest, par->alpha, par->x_packed, y_tilde);                           \
+}                                                                               \
+                                                                                \
+/* Loop 3, slices matrix `dest` and `y` in terms of column cache block (NC).
    This loop ensures KCxNC block from `y` stays in the L2 cache. */             \
+/* NOTE: Parallelized when `y` spans a NC block per thread at least, every
+ *   thread packing it's own block. Otherwise, loop 2 is parallelized over the micro-panels
+ *   of `x` sharing the single packed block of `y`.
+ */                                                                             \
 FANG_HOT FANG_INLINE FANG_FLATTEN static inline void                            \
-_fang_##gemm##_loop3(bool transp_y,                                             \
+_fang_##gemm##_loop3(_fang_pool_t *restrict pool, bool transp_y,                \
     int m, int n, int k,                                                        \
     dtype beta,                                                                 \
     dtype *restrict dest, int ld_dest,                                          \
@@ -155,7 +222,25 @@ _fang_##gemm##_loop3(bool transp_y,
     dtype *restrict y, int ld_y,                                                \
     dtype *restrict y_tilde)                                                    \
 {                                                                               \
-    /* TODO: Parallelize loop 3. */                                             \
+    int nblk = (n + FANG_##gemmu##_NC - 1) / FANG_##gemmu##_NC;                 \
+    int stride_mr = _##gemm##_mr[FANG_##gemmu##_KERNEL];                        \
+                                                                                \
+    _fang_##gemm##_par_t par = {                                                \
+        .transp_y = transp_y, .m = m, .n = n, .k = k, .beta = beta,             \
+        .dest = dest, .ld_dest = ld_dest, .alpha = alpha,                       \
+        .x_packed = x_packed, .y = y, .ld_y = ld_y, .y_tilde = y_tilde          \
+    };                                                                          \
+                                                                                \
+    if(pool == NULL) {                                                          \
+        for(int j = 0; j < nblk; j++)                                           \
+            _fang_##gemm##_task3(&par, j, 0);                                   \
+        return;                                                                 \
+    }                                                                           \
+    if(nblk >= pool->nthreads) {                                                \
+        _fang_pool_for(pool, nblk, _fang_##gemm##_task3, &par);                 \
+        return;                                                                 \
+    }                                                                           \
+                                                                                \
     for(int j = 0; j < n; j += FANG_##gemmu##_NC) {                             \
         int jb = _FANG_MIN(FANG_##gemmu##_NC, n - j);                           \
                                                                                 \
@@ -163,13 +248,11 @@ _fang_##gemm##_loop3(bool transp_y,
         _fang_##gemm##_pack(k, jb, _##gemm##_nr[FANG_##gemmu##_KERNEL],         \
             &_beta(0, j), ld_y, y_tilde, transp_y);                             \
                                                                                 \
-        /* Prefetch to keep `x` in L3 cache. */                                 \
-        FANG_PREFETCH(y_tilde, FANG_PREFETCH_READ,                              \
-            FANG_PREFETCH_LOCALITY_D2);                                         \
-                                                                                \
         /* Dispatch to loop 2. */                                               \
-        _fang_##gemm##_loop2(m, jb, k, beta, &_gamma(0, j), ld_dest, alpha,     \
-            x_packed, y_tilde);                                                 \
+        par.n    = jb;                                                          \
+        par.dest = &_gamma(0, j);                                               \
+        _fang_pool_for(pool, (m + stride_mr - 1) / stride_mr,                   \
+            _fang_##gemm##_task2, &par);                                        \
     }                                                                           \
 }                                                                               \
                                                                                 \
@@ -177,7 +260,8 @@ _fang_##gemm##_loop3(bool transp_y,
    block (KC). This loop ensures MCxKC panel from `x` stays in the L3
    cache. */                                                                    \
 FANG_HOT FANG_INLINE FANG_FLATTEN static inline void                            \
-_fang_##gemm##_loop4(bool transp_x, bool transp_y,                              \
+_fang_##gemm##_loop4(_fang_pool_t *restrict pool,                               \
+    bool transp_x, bool transp_y,                                               \
     int m, int n, int k,                                                        \
     dtype beta,                                                                 \
     dtype *restrict dest, int ld_dest,                                          \
@@ -200,14 +284,15 @@ _fang_##gemm##_loop4(bool transp_x, bool transp_y,
             FANG_PREFETCH_LOCALITY_D1);                                         \
                                                                                 \
         /* Dispatch to loop 3. */                                               \
-        _fang_##gemm##_loop3(transp_y, m, n, pb, _bet, dest, ld_dest, alpha,    \
-            x_tilde, &_beta(p, 0), ld_y, y_tilde);                              \
+        _fang_##gemm##_loop3(pool, transp_y, m, n, pb, _bet, dest, ld_dest,     \
+            alpha, x_tilde, &_beta(p, 0), ld_y, y_tilde);                       \
     }                                                                           \
 }                                                                               \
                                                                                 \
 /* Loop 5, slices matrix `dest` and `x` in terms of row cache block (MC). */    \
 FANG_HOT FANG_INLINE FANG_FLATTEN static inline void                            \
-_fang_##gemm##_loop5(bool transp_x, bool transp_y,                              \
+_fang_##gemm##_loop5(_fang_pool_t *restrict pool,                               \
+    bool transp_x, bool transp_y,                                               \
     int m, int n, int k,                                                        \
     dtype beta,                                                                 \
     dtype *restrict dest, int ld_dest,                                          \
@@ -215,18 +300,20 @@ _fang_##gemm##_loop5(bool transp_x, bool transp_y,
     dtype *restrict x, int ld_x,                                                \
     dtype *restrict y, int ld_y)                                                \
 {                                                                               \
-    /* Memory for packed MCxKC panel of `x` and KCxNC block of `y`. */          \
+    int nthreads = pool == NULL ? 1 : pool->nthreads;                           \
+                                                                                \
+    /* Memory for packed MCxKC panel of `x` and KCxNC block of `y` for every    \
+       thread. */                                                               \
     dtype *restrict x_tilde = _fang_aligned_malloc(FANG_##gemmu##_MC *          \
         FANG_##gemmu##_KC * sizeof(dtype), 64);                                 \
-    dtype *restrict y_tilde = _fang_aligned_malloc(FANG_##gemmu##_KC *          \
-        FANG_##gemmu##_NC * sizeof(dtype), 64);                                 \
+    dtype *restrict y_tilde = _fang_aligned_malloc((size_t) nthreads *          \
+        FANG_##gemmu##_KC * FANG_##gemmu##_NC * sizeof(dtype), 64);             \
                                                                                 \
-    /* TODO: Parallelize loop 5. */                                             \
     for(int i = 0; i < m; i += FANG_##gemmu##_MC) {                             \
         int ib = _FANG_MIN(FANG_##gemmu##_MC, m - i);                           \
                                                                                 \
         /* Dispatch to loop 4. */                                               \
-        _fang_##gemm##_loop4(transp_x, transp_y, ib, n, k, beta,                \
+        _fang_##gemm##_loop4(pool, transp_x, transp_y, ib, n, k, beta,          \
             &_gamma(i, 0), ld_dest, alpha, &_alpha(i, 0), ld_x, y, ld_y,        \
             x_tilde, y_tilde);                                                  \
     }                                                                           \
@@ -0,0 +1,108 @@
+#ifndef FANG_CPU_POOL_H
+#define FANG_CPU_POOL_H
+
+#include <platform/thread.h>
+#include <memory.h>
+#include <compiler.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ================ DATA TYPES ================ */
+
+/* Task executed by a pool. `task` is the index of the task, `wid` is the
+   index of the executing thread in [0, nthreads), usable to pick per-thread
+   scratch memory. */
+typedef void (*_fang_pool_fn)(void *restrict arg, ptrdiff_t task, int wid);
+
+/* ================ DATA TYPES END ================ */
+
+
+/* ================ DATA STRUCTURES ================ */
+
+/* Tasks yet to be taken by a thread. */
+/* NOTE: The range is packed in a single word (`begin` in the lower half,
+ *   `end` in the upper half) so that the owner taking from the front and
+ *   thieves taking from the back never need a lock. Padded to a cache line
+ *   to avoid false sharing among neighbouring slots.
+ */
+typedef struct _fang_pool_slot {
+    uint64_t range;
+    char pad[56];
+} _fang_pool_slot_t;
+
+/* A thread spawned by the pool. */
+typedef struct _fang_pool_worker {
+    struct _fang_pool *pool;
+    _fang_thread_t thread;
+
+    /* Slot index owned by this worker. */
+    int wid;
+} _fang_pool_worker_t;
+
+/* Fork-join thread pool with work-stealing. Every parallel loop is split
+ * evenly among the slots, and a thread running out of tasks steals half of
+ * the remaining tasks of another slot. */
+typedef struct _fang_pool {
+    /* Threads executing tasks, including the submitting thread if it
+       participates. */
+    int nthreads;
+
+    /* Threads spawned by the pool. */
+    int nworkers;
+
+    /* Whether the submitting thread executes tasks too. It does not when
+       threads are pinned, so that operators never run outside the given
+       processors. */
+    bool caller;
+
+    _fang_pool_worker_t *workers;
+    _fang_pool_slot_t *slots;
+
+    /* Parallel loop being executed. */
+    _fang_pool_fn fn;
+    void *arg;
+
+    /* Incremented for every parallel loop; workers wake up on change. */
+    uint64_t gen;
+
+    /* Workers yet to finish current parallel loop. */
+    int active;
+
+    /* Tells workers to exit. */
+    bool quit;
+
+    /* Guards sleeping and waking up. */
+    _fang_mutex_t lock;
+    _fang_cond_t wake;
+    _fang_cond_t done;
+
+    /* Held for the whole parallel loop. Parallel loops submitted meanwhile
+       (e.g. nested ones) run serially on the submitting thread, unless
+       threads are pinned and it's not one of the workers. */
+    _fang_mutex_t submit;
+
+    fang_reallocator_t realloc;
+} _fang_pool_t;
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Creates a pool of `nthreads` threads. If `cpus` is not NULL, thread `i` is
+   pinned to logical processor `cpus[i]`. */
+int _fang_pool_create(_fang_pool_t *restrict pool, int nthreads,
+    const int *restrict cpus, fang_reallocator_t realloc);
+
+/* Runs `fn` for every task in [0, ntask) and waits for all of them. `ntask`
+   should fit in 32 bits. */
+FANG_HOT void _fang_pool_for(_fang_pool_t *restrict pool, ptrdiff_t ntask,
+    _fang_pool_fn fn, void *arg);
+
+/* Stops and joins all threads of a pool. */
+void _fang_pool_release(_fang_pool_t *restrict pool);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_CPU_POOL_H
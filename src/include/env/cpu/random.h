@@ -0,0 +1,113 @@
+#ifndef FANG_CPU_RANDOM_H
+#define FANG_CPU_RANDOM_H
+
+#include <compiler.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ================ CONSTANT MACROS ================ */
+
+/* Philox4x32 round multipliers and Weyl sequence key increments. */
+#define _philox_m0    0xD2511F53u
+#define _philox_m1    0xCD9E8D57u
+#define _philox_w0    0x9E3779B9u
+#define _philox_w1    0xBB67AE85u
+
+/* Number of rounds; 10 passes BigCrush with good margin. */
+#define _philox_rounds    10
+
+/* A group is the unit of generation: 8 consecutive Philox blocks, i.e. 32
+ * random words. Group `g` holds blocks `8g` to `8g + 7`, and it's words are
+ * laid out word-major:
+ *      word `w` of block `8g + b` => index `8w + b` within the group
+ *
+ * This layout is exactly what an 8-lane SIMD implementation produces, and it
+ * is kept as is for scalar implementation too. Therefore, every element of a
+ * tensor maps to fixed counters no matter how generation is vectorized or
+ * split among threads. */
+#define _FANG_RAND_GROUP    32
+
+/* ================ CONSTANT MACROS END ================ */
+
+
+/* ================ INLINE DEFINITIONS ================ */
+
+/* Philox4x32-10 counter-based generator. Encrypts counter `ctr` with `key` in
+   place. */
+FANG_HOT FANG_INLINE static inline void _fang_philox4x32(uint32_t ctr[4],
+    uint32_t k0, uint32_t k1)
+{
+    for(int r = 0; r < _philox_rounds; r++) {
+        uint64_t p0 = (uint64_t) _philox_m0 * ctr[0];
+        uint64_t p1 = (uint64_t) _philox_m1 * ctr[2];
+
+        uint32_t c1 = ctr[1], c3 = ctr[3];
+        ctr[0] = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+        ctr[1] = (uint32_t) p1;
+        ctr[2] = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+        ctr[3] = (uint32_t) p0;
+
+        k0 += _philox_w0;
+        k1 += _philox_w1;
+    }
+}
+
+/* ================ INLINE DEFINITIONS END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* All generators below fill `n` elements, starting at element `off` of a
+ * stream determined by `key`. Lower word of `key` is the user seed, upper word
+ * selects an independent sub-stream. `off` should be a multiple of
+ * `_FANG_RAND_GROUP`, so that disjoint slices of a tensor can be generated
+ * independently (e.g. by different threads) and yet produce the very same
+ * tensor. */
+
+/* Uniform 32-bit words. */
+FANG_HOT void _fang_rand_u32(uint32_t *restrict out, size_t n, uint64_t off,
+    uint64_t key);
+
+/* Unbiased uniform integers in [0, range), using Lemire's multiply-shift
+   rejection method. Whole 32-bit range if `range` is 0. */
+FANG_HOT void _fang_rand_bounded_u32(uint32_t *restrict out, size_t n,
+    uint64_t off, uint64_t key, uint32_t range);
+
+/* Unbiased uniform integers in [0, range). Whole 64-bit range if `range` is
+   0. Each element consumes two words. */
+FANG_HOT void _fang_rand_bounded_u64(uint64_t *restrict out, size_t n,
+    uint64_t off, uint64_t key, uint64_t range);
+
+/* Uniform single-precision floats in [low, low + scale). */
+FANG_HOT void _fang_rand_uniform_f32(float *restrict out, size_t n,
+    uint64_t off, uint64_t key, float low, float scale);
+
+/* Uniform double-precision floats in [low, low + scale). Each element
+   consumes two words for full 53-bit precision. */
+FANG_HOT void _fang_rand_uniform_f64(double *restrict out, size_t n,
+    uint64_t off, uint64_t key, double low, double scale);
+
+/* Normally distributed single-precision floats using Box-Muller
+   transformation. */
+FANG_HOT void _fang_rand_normal_f32(float *restrict out, size_t n,
+    uint64_t off, uint64_t key, float mean, float std);
+
+/* Normally distributed double-precision floats using Box-Muller
+   transformation. */
+FANG_HOT void _fang_rand_normal_f64(double *restrict out, size_t n,
+    uint64_t off, uint64_t key, double mean, double std);
+
+/* Normally distributed single-precision floats truncated to [low, high].
+   Sampled by rejection, or by inverse CDF if the interval is narrow or lies in
+   a tail. */
+FANG_HOT void _fang_rand_trunc_normal_f32(float *restrict out, size_t n,
+    uint64_t off, uint64_t key, float mean, float std, float low, float high);
+
+/* Normally distributed double-precision floats truncated to [low, high]. */
+FANG_HOT void _fang_rand_trunc_normal_f64(double *restrict out, size_t n,
+    uint64_t off, uint64_t key, double mean, double std, double low,
+    double high);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_CPU_RANDOM_H
@@ -0,0 +1,128 @@
+#ifndef FANG_ENV_STREAM_H
+#define FANG_ENV_STREAM_H
+
+#include <fang/env.h>
+#include <platform/thread.h>
+#include <memory.h>
+#include <compiler.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* ================ CONSTANT MACROS ================ */
+
+/* Which fields of an operator argument hold tensors. Tensors are copied along
+   with their dimensions and strides when an operator is enqueued, since
+   callers usually pass temporaries. */
+#define _FANG_SUBMIT_DEST     0x1
+#define _FANG_SUBMIT_X        0x2
+#define _FANG_SUBMIT_Y        0x4
+#define _FANG_SUBMIT_Z        0x8
+#define _FANG_SUBMIT_ALPHA    0x10
+#define _FANG_SUBMIT_BETA     0x20
+
+/* Number of argument fields able to hold tensors. */
+#define _FANG_SUBMIT_NFIELDS    6
+
+/* Destination is entirely overwritten without being read, used by memory
+   planning of graphs. */
+#define _FANG_SUBMIT_OVERWRITE    0x40
+
+/* Field `x` is an array of `FANG_G2I(z)` pointers, copied after the tensor
+   metadata of the operator, since callers usually pass temporaries. */
+#define _FANG_SUBMIT_XARRAY       0x80
+
+/* ================ CONSTANT MACROS END ================ */
+
+
+/* ================ DATA STRUCTURES ================ */
+
+/* An operator waiting in a stream, or recorded in a graph. */
+typedef struct _fang_env_op {
+    struct _fang_env_op *next;
+
+    /* Position in the stream, starting from 1. */
+    uint64_t seq;
+
+    fang_ten_operator_fn fn;
+    fang_ten_ops_arg_t arg;
+
+    /* Whether destination is overwritten without being read. */
+    bool overwrite;
+
+    /* Copies of tensors pointed to by `arg`. Their dimensions and strides
+       follow the structure. Operators without any are waited for by every
+       tensor. An array of `_FANG_SUBMIT_XARRAY` follows them. */
+    int ntens;
+    fang_ten_t tens[_FANG_SUBMIT_NFIELDS];
+    uint32_t meta[];
+} _fang_env_op_t;
+
+/* In-order stream of operators of an Environment, executed by a dedicated
+ * thread. Being in order, operators see results of all operators submitted
+ * before them; only the host has to wait before touching tensor data. */
+typedef struct _fang_env_stream {
+    /* Pending operators. `running` is popped off the queue, yet not finished
+       executing. */
+    _fang_env_op_t *head;
+    _fang_env_op_t *tail;
+    _fang_env_op_t *running;
+
+    /* Last submitted and last completed operator. */
+    uint64_t submitted;
+    uint64_t completed;
+
+    /* First error raised by an operator since last wait. */
+    int error;
+
+    bool quit;
+
+    _fang_thread_t thread;
+    _fang_mutex_t lock;
+    _fang_cond_t work;
+    _fang_cond_t done;
+
+    fang_reallocator_t realloc;
+} _fang_env_stream_t;
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Creates a stream and it's executing thread. */
+int _fang_env_stream_create(_fang_env_stream_t **restrict stream,
+    fang_reallocator_t realloc);
+
+/* Creates an operator node, deep copying tensors of `arg` pointed by
+   `mask`. */
+int _fang_env_op_create(_fang_env_op_t **restrict op, fang_env_t *restrict env,
+    fang_ten_operator_fn fn, fang_ten_ops_arg_t *restrict arg, int mask);
+
+/* Runs an operator right away if the Environment is synchronous, records it
+   if a graph is being captured, otherwise enqueues it. `mask` tells which
+   fields of `arg` hold tensors. */
+FANG_HOT int _fang_env_submit(fang_env_t *restrict env,
+    fang_ten_operator_fn fn, fang_ten_ops_arg_t *restrict arg, int mask);
+
+/* Waits until operator `seq` has completed. Returns first error raised by an
+   operator since last wait. */
+int _fang_env_stream_wait(_fang_env_stream_t *restrict stream, uint64_t seq);
+
+/* Gets first error raised by an operator since last wait, keeping it for the
+   next wait. */
+int _fang_env_stream_error(_fang_env_stream_t *restrict stream);
+
+/* Waits for every pending operator using data at `data`. Errors are kept for
+   the next wait. */
+void _fang_env_stream_wait_data(_fang_env_stream_t *restrict stream,
+    const void *data);
+
+/* Waits for every submitted operator. Errors are kept for the next wait. */
+void _fang_env_stream_drain(_fang_env_stream_t *restrict stream);
+
+/* Drains and releases a stream. */
+void _fang_env_stream_release(_fang_env_stream_t *restrict stream);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_ENV_STREAM_H
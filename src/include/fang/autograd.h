@@ -0,0 +1,164 @@
+#ifndef FANG_AUTOGRAD_H
+#define FANG_AUTOGRAD_H
+
+#include <fang/config.h>
+#include <fang/tensor.h>
+#include <fang/env.h>
+#include <compiler.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ================ DATA STRUCTURES ================ */
+
+/* Kind of an operator recorded on a tape. */
+typedef enum _fang_tape_kind {
+    _FANG_TAPE_SUM,
+    _FANG_TAPE_DIFF,
+    _FANG_TAPE_MUL,
+    _FANG_TAPE_GEMM,
+    _FANG_TAPE_SCALE,
+
+    /* Destination is overwritten with values not depending on any tensor,
+       e.g. fill or random generation. */
+    _FANG_TAPE_OVERWRITE
+} _fang_tape_kind_t;
+
+/* A recorded operator. Tensors are the ones passed by the user. */
+typedef struct _fang_tape_op {
+    _fang_tape_kind_t kind;
+    fang_ten_t *dest;
+    fang_ten_t *x;
+    fang_ten_t *y;
+
+    /* Scale factor, or GEMM `alpha` and `beta`. */
+    fang_gen_t alpha;
+    fang_gen_t beta;
+
+    /* GEMM transposes. */
+    fang_ten_gemm_transp_t transp_x;
+    fang_ten_gemm_transp_t transp_y;
+
+    /* Overwriting operator and it's arguments, to recompute checkpointed
+       tensors with. */
+    fang_ten_operator_fn fn;
+    fang_ten_ops_arg_t arg;
+} _fang_tape_op_t;
+
+/* A checkpointed segment of a tape. */
+typedef struct _fang_tape_seg {
+    /* Operators of the segment, `last` is -1 while still recording. */
+    int first;
+    int last;
+
+    /* Tensors discarded, within `ckpts` of the tape. */
+    int off;
+    int ntens;
+} _fang_tape_seg_t;
+
+/* A gradient buffer of the pool of a tape. */
+typedef struct _fang_tape_buf {
+    fang_ten_t ten;
+
+    /* Tensor the buffer is attached to as gradient, NULL if none. */
+    fang_ten_t *owner;
+    bool used;
+} _fang_tape_buf_t;
+
+/* Records operators of an Environment for reverse-mode differentiation. */
+/* NOTE: Tensors are recorded by address, and `fang_tape_backward()` reads
+ *   their data as it is then. Hence, tensors recorded have to stay alive until
+ *   the tape begins recording again or is released, and inputs of recorded
+ *   multiplications and GEMMs must not be overwritten before the backward
+ *   pass. Gradient buffers are taken from a pool kept by the tape across
+ *   recordings, so that a training step of same shapes allocates nothing once
+ *   warmed up.
+ *
+ *   Activations of checkpointed segments are discarded once the segment is
+ *   recorded, and recomputed segment by segment during the backward pass,
+ *   hence only a single segment's activations are alive at a time.
+ */
+typedef struct fang_tape {
+    /* Environment operators are recorded from. */
+    int eid;
+
+    /* Recorded operators, in order. */
+    int nops;
+    int cap;
+    _fang_tape_op_t *ops;
+
+    /* Gradient buffer pool. */
+    int nbufs;
+    _fang_tape_buf_t **bufs;
+
+    /* Checkpointed segments, in order, and tensors they discard. */
+    int nsegs;
+    int segs_cap;
+    _fang_tape_seg_t *segs;
+    int nckpts;
+    int ckpts_cap;
+    fang_ten_t **ckpts;
+} fang_tape_t;
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Creates an empty tape for an Environment. */
+FANG_API int fang_tape_create(fang_tape_t *tape, int eid);
+
+/* Starts recording operators of the Environment onto a tape. Recorded
+ * operators still execute as usual. Previous recording is discarded, and
+ * gradients computed by it are detached from their tensors and given back to
+ * the pool. */
+FANG_API int fang_tape_begin(fang_tape_t *tape);
+
+/* Stops recording. */
+FANG_API int fang_tape_end(fang_tape_t *tape);
+
+/* Computes gradients of elements of `loss` summed, with respect to every
+ * tensor it depends on through the recorded operators. Gradient of a tensor
+ * is found in it's `grad` field, which stays NULL for tensors `loss` does not
+ * depend on. Intermediate gradients are given back to the pool as soon as
+ * they are consumed, hence only tensors never written by a recorded operator
+ * (e.g. inputs and weights) keep theirs. Floating point tensors only. */
+FANG_API int fang_tape_backward(fang_tape_t *tape, fang_ten_t *loss);
+
+/* Starts a checkpointed segment of the tape being recorded. */
+FANG_API int fang_tape_checkpoint_begin(fang_tape_t *tape);
+
+/* Ends a checkpointed segment, discarding data of `tens`. Discarded tensors
+ * have to be written by an operator of the segment before being read in it,
+ * and must not be used outside of the segment; they hold no data until the
+ * tape begins recording again, except while the backward pass recomputes
+ * them. Recomputation reruns the operators of the segment writing discarded
+ * tensors, hence other tensors they read must keep their values. */
+FANG_API int fang_tape_checkpoint_end(fang_tape_t *tape, fang_ten_t **tens,
+    int ntens);
+
+/* Releases a tape, it's gradient buffers included. Stops recording if still
+   active. */
+FANG_API int fang_tape_release(fang_tape_t *tape);
+
+/* ================ DECLARATIONS END ================ */
+
+
+/* ================ PRIVATE DECLARATIONS ================ */
+
+/* Appends an operator to a tape being recorded. */
+int _fang_tape_record(fang_tape_t *restrict tape,
+    const _fang_tape_op_t *restrict op);
+
+/* Runs operator `fn` of `env` overwriting `ten`. */
+int _fang_ten_overwrite(fang_ten_t *ten, fang_env_t *env,
+    fang_ten_operator_fn fn, fang_ten_ops_arg_t *arg);
+
+/* Releases data of a tensor, keeping it's shape. */
+int _fang_ten_evict(fang_ten_t *ten);
+
+/* Allocates data of an evicted tensor again. */
+int _fang_ten_restore(fang_ten_t *ten);
+
+/* ================ PRIVATE DECLARATIONS END ================ */
+
+#endif  // FANG_AUTOGRAD_H
@@ -14,6 +14,11 @@
 /* Maximum Environments can be used. */
 #define FANG_MAX_ENV     128
 
+/* Tensors with more elements than this are summarized while printing, showing
+   only `FANG_PRINT_EDGEITEMS` elements at both edges of every dimension. */
+#define FANG_PRINT_THRESHOLD    1000
+#define FANG_PRINT_EDGEITEMS    3
+
 /* ================ CONFIGURATION MACROS END ================ */
 
 
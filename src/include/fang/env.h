@@ -5,6 +5,8 @@
 #include <fang/tensor.h>
 #include <memory.h>
 #include <compiler.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 /* ================ DATA STRUCTURES ================ */
 
@@ -27,12 +29,28 @@ typedef struct fang_env_ops_t {
     fang_ten_ops_t *sparse;  // For sparse tensors
 } fang_env_ops_t;
 
+/* Topology of the machine a CPU Environment runs on. */
+typedef struct fang_env_cpu_topo {
+    int nproc;     // Logical processors, SMT siblings included
+    int ncores;    // Physical cores
+    int nsockets;  // Sockets (packages)
+    int nllcs;     // Last level (L3) cache domains
+} fang_env_cpu_topo_t;
+
+/* Where threads of a CPU Environment are pinned. */
+typedef enum fang_env_cpu_bind {
+    FANG_ENV_CPU_BIND_NONE,    // Unpinned, one thread per logical processor
+    FANG_ENV_CPU_BIND_CORES,   // One thread per physical core
+    FANG_ENV_CPU_BIND_SOCKET   // One thread per physical core of a socket
+} fang_env_cpu_bind_t;
+
 /* Structure of a single Environment. */
 typedef struct fang_env {
     /* Type of Environment. */
     fang_env_type_t type;
 
-    /* Number of tensors in this Environment. */
+    /* Number of tensors in this Environment. Updated atomically, so that
+       tensors can be created and released from several threads. */
     int ntens;
 
     /* Reallocator function for CPU specific (de)allocations. */
@@ -43,19 +61,72 @@ typedef struct fang_env {
 
     /* Tensor operators for this Environment. */
     fang_env_ops_t *ops;
+
+    /* Stream operators are enqueued into in asynchronous mode, NULL if
+       operators run synchronously. */
+    struct _fang_env_stream *stream;
+
+    /* Graph operators are recorded into, NULL if not capturing. */
+    struct fang_graph *graph;
+
+    /* Tape operators are recorded onto, NULL if not recording. */
+    struct fang_tape *tape;
 } fang_env_t;
 
+/* Position in the stream of an asynchronous Environment. */
+typedef uint64_t fang_env_fence_t;
+
 /* ================ DATA STRUCTURES END ================ */
 
 
 /* ================ DECLARATIONS ================ */
 
 /* Creates an Environment and returns the ID. */
+/* NOTE: Environments can be created, used and released from several threads at
+ *   once. Each Environment owns it's threads, hence operators of different
+ *   Environments run concurrently without contending for them. An Environment
+ *   must not be released while tensors are still being created in it.
+ */
 FANG_API int fang_env_create(fang_env_type_t type, fang_reallocator_t realloc);
 
 /* Releases an Environment if not released. */
 FANG_API int fang_env_release(int eid);
 
+/* Switches an Environment to asynchronous mode, or back. In asynchronous mode,
+ * tensor operators (random generation, arithmatic, GEMM, scale and fill) only
+ * validate their arguments, enqueue into the stream of the Environment and
+ * return. They execute in order of submission. Tensors passed have to stay
+ * alive until their operators complete; call `fang_ten_wait` before touching
+ * tensor data. Switching back waits for pending operators. */
+FANG_API int fang_env_async(int eid, bool async);
+
+/* Gets a fence for the operators submitted so far. */
+FANG_API int fang_env_fence(int eid, fang_env_fence_t *fence);
+
+/* Waits until operators up to a fence complete. Returns the first error raised
+ * by an asynchronous operator since last wait, or `-FANG_INVFENCE` for a fence
+ * ahead of the operators submitted. */
+FANG_API int fang_env_wait(int eid, fang_env_fence_t fence);
+
+/* Waits until every submitted operator completes. */
+FANG_API int fang_env_sync(int eid);
+
+/* Runs operators of a CPU Environment on `nthreads` threads. If `cpus` is not
+ * NULL, thread `i` is pinned to logical processor `cpus[i]` and the calling
+ * thread no longer runs operators itself. Must not be called while operators
+ * of the Environment are running. */
+FANG_API int fang_env_cpu_set_threads(int eid, int nthreads,
+    const int *restrict cpus);
+
+/* Gets the topology of the machine a CPU Environment runs on. */
+FANG_API int fang_env_cpu_topology(int eid, fang_env_cpu_topo_t *topo);
+
+/* Pins threads of a CPU Environment by policy. SMT siblings share the FMA
+ * units of a core, hence binding to physical cores usually speeds up compute
+ * bound operators. `socket` is only used by `FANG_ENV_CPU_BIND_SOCKET`. Must
+ * not be called while operators of the Environment are running. */
+FANG_API int fang_env_cpu_bind(int eid, fang_env_cpu_bind_t bind, int socket);
+
 /* ================ DECLARATIONS END ================ */
 
 
@@ -65,6 +136,13 @@ FANG_API int fang_env_release(int eid);
    pool. REFRAIN FROM USING THIS FUNCTION UNLESS ABSOLUTELY ESSENTIAL. */
 FANG_API FANG_HOT int _fang_env_retrieve(fang_env_t **restrict env, int eid);
 
+/* Validates dimensions and stores them alongside strides in tensor. Shared by
+   dense and sparse tensors. */
+int _fang_ten_init_dims(fang_ten_t *ten, fang_env_t *env, fang_ten_dim_t dim);
+
+/* Single element data size of each tensor data type, indexed by it. */
+extern const int _fang_ten_dsiz[];
+
 /* ================ PRIVATE DECLARATIONS END ================ */
 
 #endif  // FANG_ENV_H
@@ -0,0 +1,73 @@
+#ifndef FANG_GRAPH_H
+#define FANG_GRAPH_H
+
+#include <fang/config.h>
+#include <fang/tensor.h>
+#include <compiler.h>
+#include <stddef.h>
+
+/* ================ DATA STRUCTURES ================ */
+
+/* A recorded sequence of tensor operators. */
+/* NOTE: Operators are recorded after validation, i.e. with shapes checked,
+ *   broadcast patterns detected, strides computed and operator functions
+ *   looked up. Replaying only calls the recorded operator functions, on the
+ *   very same tensor data. Hence, tensors used while capturing have to outlive
+ *   the graph and keep their data; to feed new inputs, write into the input
+ *   tensors in place.
+ */
+typedef struct fang_graph {
+    /* Environment the graph was captured on. */
+    int eid;
+
+    /* Recorded operators, in order. */
+    int nops;
+    struct _fang_env_op *head;
+    struct _fang_env_op *tail;
+
+    /* Memory planned tensors share this slab, NULL if not planned. */
+    void *slab;
+    size_t slab_siz;
+} fang_graph_t;
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Starts capturing operators of an Environment into a graph. Operators are
+ * recorded instead of being executed until capture ends. `graph` is reset,
+ * hence a previously captured one should be released first; it's left
+ * untouched if the Environment is capturing already. */
+FANG_API int fang_graph_begin(fang_graph_t *graph, int eid);
+
+/* Ends capturing a graph. */
+FANG_API int fang_graph_end(fang_graph_t *graph);
+
+/* Replays a graph. Enqueued as a single operator if the Environment is
+   asynchronous, recorded as one if it's capturing another graph. */
+FANG_API FANG_HOT int fang_graph_replay(fang_graph_t *graph);
+
+/* Plans memory of intermediate tensors of a captured graph. Tensors whose
+ * lifetimes within the graph do not overlap share memory of a single slab
+ * owned by the graph; their own data is released. Planned tensors have to be
+ * overwritten by their first operator in the graph, and their contents are
+ * only meaningful while they are live during a replay. */
+FANG_API int fang_graph_plan(fang_graph_t *graph, fang_ten_t **tens,
+    int ntens);
+
+/* Releases a graph, ending the capture if still active. */
+FANG_API int fang_graph_release(fang_graph_t *graph);
+
+/* ================ DECLARATIONS END ================ */
+
+
+/* ================ PRIVATE DECLARATIONS ================ */
+
+/* Appends an operator to a graph being captured. */
+void _fang_graph_append(fang_graph_t *restrict graph,
+    struct _fang_env_op *restrict op);
+
+/* ================ PRIVATE DECLARATIONS END ================ */
+
+#endif  // FANG_GRAPH_H
@@ -0,0 +1,120 @@
+#ifndef FANG_IO_H
+#define FANG_IO_H
+
+#include <fang/config.h>
+#include <fang/tensor.h>
+#include <compiler.h>
+#include <stdint.h>
+
+/* ================ HELPER MACROS ================ */
+
+/* Magic bytes at the beginning of every Fang chunked tensor file. */
+#define FANG_IO_MAGIC        "FANGCHNK"
+
+/* Current version of the file format. */
+#define FANG_IO_VERSION      1
+
+/* Maximum number of dimensions of a single sample. */
+#define FANG_IO_MAX_DIMS     8
+
+/* ================ HELPER MACROS END ================ */
+
+
+/* ================ DATA STRUCTURES ================ */
+
+/* On-disk header of a Fang chunked tensor file. */
+/* Layout of the file:
+ *      |--------|-------------------------------------|
+ *      ^        ^
+ *      1        2
+ * 1: header (this structure, 64 bytes, native byte order)
+ * 2: `count` samples, each with `dims[0] * ... * dims[ndims - 1]` elements
+ *    of `dtyp` data type, stored back-to-back in row-major order
+ *
+ * Samples of zero dimension (`ndims` is 0) are scalars, e.g. labels.
+ */
+typedef struct fang_io_header {
+    char magic[8];
+    uint32_t version;
+    int32_t dtyp;
+    uint32_t ndims;
+    uint32_t reserved;
+    uint64_t count;
+    uint32_t dims[FANG_IO_MAX_DIMS];
+} fang_io_header_t;
+
+/* Appends samples to a chunked tensor file. */
+typedef struct fang_io_writer {
+    /* File descriptor. */
+    int fd;
+
+    /* Size of a single sample in bytes. */
+    uint64_t sample_siz;
+
+    /* Header to be written on release, holds samples written so far. */
+    fang_io_header_t header;
+} fang_io_writer_t;
+
+/* Private state of a reader, shared with it's prefetch thread. */
+typedef struct fang_io_stream fang_io_stream_t;
+
+/* Streams batches of samples from a chunked tensor file. */
+typedef struct fang_io_reader {
+    /* Data type of the samples. */
+    fang_ten_dtype_t dtyp;
+
+    /* Total number of samples in the file. */
+    uint64_t count;
+
+    /* Number of samples per batch. */
+    uint32_t batch;
+
+    /* Prefetch state. */
+    fang_io_stream_t *stream;
+} fang_io_reader_t;
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Creates a chunked tensor file holding samples of shape `sample`. */
+FANG_API int fang_io_writer_create(fang_io_writer_t *restrict writer,
+    const char *restrict path, fang_ten_dtype_t dtyp, fang_ten_dim_t sample);
+
+/* Appends samples of a dense tensor to the file. Tensor is either a single
+   sample or a batch of samples with leading batch dimension. */
+FANG_API int fang_io_writer_write(fang_io_writer_t *restrict writer,
+    fang_ten_t *restrict ten);
+
+/* Finalizes the header and closes the file. */
+FANG_API int fang_io_writer_release(fang_io_writer_t *restrict writer);
+
+/* Opens a chunked tensor file for streaming `batch` samples at a time into
+   tensors of Environment `eid`. */
+/* NOTE: Two batch tensors are pre-allocated. While one is being consumed, a
+ *   background thread reads the next batch into the other, so reading never
+ *   stalls computation unless the disk falls behind.
+ */
+FANG_API int fang_io_reader_create(fang_io_reader_t *restrict reader, int eid,
+    const char *restrict path, uint32_t batch);
+
+/* Retrieves the next batch. Returns number of samples in the batch, 0 at the
+   end of file or negative status on error. */
+/* NOTE: The tensor is owned by the reader and stays valid until the next call
+ *   to `fang_io_reader_next()`, `fang_io_reader_rewind()` or
+ *   `fang_io_reader_release()`. Last batch may hold fewer samples, in that
+ *   case the leading dimension of the tensor is shrunk accordingly.
+ */
+FANG_API FANG_HOT int64_t fang_io_reader_next(
+    fang_io_reader_t *restrict reader, fang_ten_t **ten);
+
+/* Restarts streaming from the first sample, e.g. for next epoch. */
+FANG_API int fang_io_reader_rewind(fang_io_reader_t *restrict reader);
+
+/* Stops prefetching, releases the batch tensors and closes the file. */
+FANG_API int fang_io_reader_release(fang_io_reader_t *restrict reader);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_IO_H
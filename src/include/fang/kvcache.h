@@ -0,0 +1,82 @@
+#ifndef FANG_KVCACHE_H
+#define FANG_KVCACHE_H
+
+#include <fang/config.h>
+#include <fang/tensor.h>
+#include <fang/type.h>
+#include <compiler.h>
+#include <stdint.h>
+
+/* ================ DATA STRUCTURES ================ */
+
+/* Keys and values of past tokens of every head, for incremental decoding. */
+/* NOTE: Tokens are kept in pages of `page` tokens, keys of a page being
+ *   (heads, page, dk) and values (heads, page, dv). Appending copies only the
+ *   new tokens, into the last page or fresh ones, pages already written never
+ *   move. Attention reads pages in place, a tile never crossing a page.
+ */
+typedef struct fang_kvcache {
+    /* Environment the cache belongs to. */
+    int eid;
+
+    /* Batches times heads, dimension of keys and of values. */
+    uint32_t heads;
+    uint32_t dk;
+    uint32_t dv;
+
+    /* Tokens of a page. */
+    uint32_t page;
+
+    /* Tokens appended. Counted when appending is submitted, hence includes
+       pending appends. */
+    uint32_t len;
+
+    /* Pages allocated, and entries of the page tables. */
+    uint32_t npages;
+    uint32_t cap;
+
+    /* Page tables of keys and values. */
+    float **k;
+    float **v;
+} fang_kvcache_t;
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Creates a single-precision KV cache of `heads` heads (batches times heads)
+ * with pages of `page` tokens. Pages for `capacity` tokens are allocated up
+ * front; the cache grows by whole pages past it. */
+FANG_API int fang_kvcache_create(fang_kvcache_t *cache, int eid,
+    uint32_t heads, uint32_t dk, uint32_t dv, uint32_t page,
+    uint32_t capacity);
+
+/* Appends keys `k` (..., n, dk) and values `v` (..., n, dv) of `n` tokens,
+   leading dimensions holding `heads` heads. Can not be captured by graphs. */
+FANG_API int fang_kvcache_append(fang_kvcache_t *cache, fang_ten_t *k,
+    fang_ten_t *v);
+
+/* Performs scaled dot-product attention of queries `q` (..., t, dk) over all
+ * tokens of the cache, overwriting `dest` (..., t, dv), as of
+ * `fang_ten_attention()`. With causal masking, the last query is the last
+ * token appended. Can not be captured by graphs. */
+FANG_API FANG_HOT int fang_kvcache_attention(fang_ten_t *dest, fang_ten_t *q,
+    fang_kvcache_t *cache, const fang_ten_attention_t *attn);
+
+/* Views keys and values of page `idx` as tensors `k` (heads, page, dk) and
+ * `v` (heads, page, dv), without copying, e.g. to be used by GEMM. Views
+ * borrow memory of the cache, hence have to be released before it. Pending
+ * appends are waited for. */
+FANG_API int fang_kvcache_view(fang_kvcache_t *cache, uint32_t idx,
+    fang_ten_t *k, fang_ten_t *v);
+
+/* Empties the cache for a new sequence, keeping it's pages. */
+FANG_API int fang_kvcache_reset(fang_kvcache_t *cache);
+
+/* Releases a cache and it's pages. */
+FANG_API int fang_kvcache_release(fang_kvcache_t *cache);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_KVCACHE_H
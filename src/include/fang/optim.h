@@ -0,0 +1,91 @@
+#ifndef FANG_OPTIM_H
+#define FANG_OPTIM_H
+
+#include <fang/config.h>
+#include <fang/tensor.h>
+#include <fang/type.h>
+#include <compiler.h>
+#include <stdint.h>
+
+/* ================ DATA STRUCTURES ================ */
+
+/* Update rule of an optimizer. */
+typedef enum fang_optim_type {
+    /* Stochastic gradient descent, with heavy-ball momentum if `momentum` is
+       not zero. */
+    FANG_OPTIM_SGD,
+
+    /* Adam, weight decay added to the gradient as L2 penalty. */
+    FANG_OPTIM_ADAM,
+
+    /* Adam with weight decay decoupled from the gradient. */
+    FANG_OPTIM_ADAMW
+} fang_optim_type_t;
+
+/* Hyperparameters of an optimizer. Ones not used by the update rule are
+   ignored. */
+typedef struct fang_optim_hparam {
+    fang_float_t lr;
+    fang_float_t momentum;
+    fang_float_t beta1;
+    fang_float_t beta2;
+    fang_float_t eps;
+    fang_float_t weight_decay;
+} fang_optim_hparam_t;
+
+/* Updates a set of parameter tensors from their gradients. */
+/* NOTE: A step updates every parameter, and it's moments, in a single pass over
+ *   their data, with all parameters split into tasks of a single parallel
+ *   launch. Hence, lots of small parameters (e.g. biases and norms) cost
+ *   about as much as a single tensor of their total size.
+ */
+typedef struct fang_optim {
+    /* Environment parameters belong to. */
+    int eid;
+
+    fang_optim_type_t type;
+    fang_optim_hparam_t hparam;
+
+    /* Steps taken, Adam bias correction depends on it. Counted when a step
+       runs, hence also by graph replays. */
+    uint64_t nsteps;
+
+    /* Parameters being optimized. */
+    int nparams;
+    fang_ten_t **params;
+
+    /* First and second moments of each parameter, NULL if not used by the
+       update rule. */
+    fang_ten_t *m;
+    fang_ten_t *v;
+
+    /* Tasks of the parameters before each one, `nparams + 1` entries. */
+    uint32_t *tasks;
+} fang_optim_t;
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Creates an optimizer of `nparams` parameter tensors. Parameters have to be
+ * dense single or double-precision tensors of the same Environment, and stay
+ * alive until the optimizer is released. Moments are created zeroed, in data
+ * type of their parameter. */
+FANG_API int fang_optim_create(fang_optim_t *opt, int eid,
+    fang_optim_type_t type, const fang_optim_hparam_t *hparam,
+    fang_ten_t **params, int nparams);
+
+/* Takes a step. `grads[i]` is the gradient of `params[i]` in same shape and
+ * data type; if `grads` is NULL, gradients are read from the `grad` field of
+ * parameters, as left by `fang_tape_backward()`. Gradients are resolved on
+ * call, the step may run later on asynchronous Environments. Parameters
+ * without gradient are left as is. */
+FANG_API int fang_optim_step(fang_optim_t *opt, fang_ten_t **grads);
+
+/* Releases an optimizer and it's moments. */
+FANG_API int fang_optim_release(fang_optim_t *opt);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_OPTIM_H
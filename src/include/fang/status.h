@@ -17,6 +17,9 @@
 /* Could not retrieve information. */
 #define FANG_NOINFO         3
 
+/* Could not spawn or join a thread. */
+#define FANG_NOTHREAD       4
+
 
 /* ================ ENVIRONMENT ================ */
 
@@ -38,6 +41,13 @@
 /* Environment mismatch. Tensors do not belong to same Environment. */
 #define FANG_ENVNOMATCH     105
 
+/* Invalid thread binding policy. */
+#define FANG_INVBIND        106
+
+/* Fence is ahead of the operators submitted, e.g. taken before asynchronous
+   mode was switched off and back on. */
+#define FANG_INVFENCE       107
+
 /* ================ ENVIRONMENT END ================ */
 
 
@@ -65,12 +75,99 @@
 /* Destination tensor dimension mismatch. */
 #define FANG_DESTINVDIM     207
 
+/* Invalid parameters of a random distribution. */
+#define FANG_INVDIST        208
+
 /* Tensors not broadcastable. */
 #define FANG_NOBROAD        218
 
 /* Incompatible matrix dimension in `fang_ten_gemm()`. */
 #define FANG_INCMATDIM      209
 
+/* Tensor data is not aligned to `FANG_MEMALIGN` bytes boundary. */
+#define FANG_MISALIGN       210
+
+/* Invalid convolution parameters, e.g. channels not divisible by groups or
+   kernel larger than padded input. */
+#define FANG_INVCONV        211
+
+/* Invalid pooling parameters, e.g. padding not smaller than the window. */
+#define FANG_INVPOOL        212
+
+/* Invalid normalization parameters, e.g. negative `eps`. */
+#define FANG_INVNORM        213
+
+/* Index out of range of the dimension it indexes. */
+#define FANG_INVIDX         214
+
+/* Sparse matrix does not fit it's encoding, e.g. a group of 4 elements with
+   more than 2 non-zeros for 2:4. */
+#define FANG_INVSPARSE      215
+
 /* ================ TENSOR END ================ */
 
+
+/* ================ I/O ================ */
+
+/* Could not open file. */
+#define FANG_NOFILE         300
+
+/* File read/write failed. */
+#define FANG_IOERR          301
+
+/* Not a Fang chunked tensor file or corrupted. */
+#define FANG_INVFILE        302
+
+/* Tensor does not match the sample shape/data type of the file. */
+#define FANG_IONOMATCH      303
+
+/* ================ I/O END ================ */
+
+
+/* ================ GRAPH ================ */
+
+/* Environment is already capturing a graph. */
+#define FANG_CAPTURING      400
+
+/* Graph is not being captured. */
+#define FANG_NOCAPTURE      401
+
+/* Graph can not be memory planned, e.g. a planned tensor is read before being
+   written, or the graph replays other graphs. */
+#define FANG_NOPLAN         402
+
+/* ================ GRAPH END ================ */
+
+
+/* ================ AUTOGRAD ================ */
+
+/* Environment is already recording a tape. */
+#define FANG_RECORDING      500
+
+/* Tape is not being recorded. */
+#define FANG_NORECORD       501
+
+/* Invalid checkpoint, e.g. a discarded tensor is read before being written
+   within it's segment or used outside of it, or segments are nested. */
+#define FANG_NOCKPT         502
+
+/* ================ AUTOGRAD END ================ */
+
+
+/* ================ OPTIMIZER ================ */
+
+/* Invalid optimizer, e.g. no parameter is given or a hyperparameter is out of
+   range. */
+#define FANG_INVOPTIM       600
+
+/* ================ OPTIMIZER END ================ */
+
+
+/* ================ KV CACHE ================ */
+
+/* Invalid KV cache, e.g. zero page size, or too many tokens. */
+#define FANG_INVKVC         700
+
+/* ================ KV CACHE END ================ */
+
 #endif  // FANG_STATUS_H
@@ -5,6 +5,7 @@
 #include <fang/type.h>
 #include <compiler.h>
 #include <stdio.h>
+#include <stdbool.h>
 
 /* ================ HELPER MACROS ================ */
 
@@ -71,17 +72,50 @@ typedef enum fang_ten_type {
     FANG_TEN_TYPE_SPARSE
 } fang_ten_type_t;
 
-/* Sparse tensor data representation using COO encoding. */
-typedef struct fang_ten_sparse_coo {
-    /* Number of non-zero elements. */
+/* Encoding of a sparse tensor. */
+/* NOTE: COO keeps coordinates of every element in any order. Rest of the
+ *   encodings are of matrices and keep elements sorted, a coordinate at most
+ *   once: CSR by row, keeping column of every element and where every row
+ *   starts; CSC the same by column; BSR (blocked CSR) keeps dense `block` x
+ *   `block` blocks, zeros included, by block row. 2:4 keeps 2 elements of
+ *   every group of 4 consecutive elements of a row, zeros included when a
+ *   group has less, and 2 bits of metadata each for their column within the
+ *   group. Index arrays are contiguous and are streamed by operators.
+ */
+typedef enum fang_ten_sparse_fmt {
+    FANG_TEN_SPARSE_COO,
+    FANG_TEN_SPARSE_CSR,
+    FANG_TEN_SPARSE_CSC,
+    FANG_TEN_SPARSE_BSR,
+    FANG_TEN_SPARSE_2_4
+} fang_ten_sparse_fmt_t;
+
+/* Sparse tensor data representation. */
+typedef struct fang_ten_sparse {
+    /* Encoding. */
+    fang_ten_sparse_fmt_t fmt;
+
+    /* Number of elements stored. Blocks of BSR count whole. */
     int nnz;
 
-    /* Indicies for non-zero elements. */
-    uint32_t **idx;
+    /* Rows and columns of a block of BSR, 1 otherwise. */
+    uint32_t block;
+
+    /* COO: coordinates of elements, `ndims` of them each. CSR: column of
+     * elements. CSC: row of elements. BSR: block column of blocks. 2:4:
+     * column within it's group of elements, 16 to a word, element `i` of a
+     * row at bits [2 * (i % 16), 2 * (i % 16) + 2) of word `i / 16`; rows
+     * are padded to whole words. */
+    uint32_t *idx;
+
+    /* Row `i` (column of CSC, block row of BSR) holds elements (blocks of
+       BSR) [ptr[i], ptr[i + 1]). NULL for COO and 2:4. */
+    uint32_t *ptr;
 
-    /* Contiguous non-zero elements. Row-major order. */
+    /* Contiguous elements. Blocks of BSR are row-major, 2:4 is a (rows,
+       cols / 2) matrix. */
     void *data;
-} fang_ten_sparse_coo_t;
+} fang_ten_sparse_t;
 
 /* Data type of each tensor. */
 /* NOTE: TRY NOT TO CHANGE THE ORDERING. */
@@ -103,6 +137,9 @@ typedef enum fang_ten_dtype {
     FANG_TEN_DTYPE_INVALID = -1
 } fang_ten_dtype_t;
 
+/* Releases tensor data adopted through `fang_ten_adopt()`. */
+typedef void (*fang_ten_deleter_t)(void *data);
+
 /* Represents a single tensor. */
 typedef struct fang_ten {
     /* Environment ID with which the tensor is created. */
@@ -129,8 +166,16 @@ typedef struct fang_ten {
         void *dense;
 
         /* Data representation of sparse tensor. */
-        fang_ten_sparse_coo_t *sparse;
+        fang_ten_sparse_t *sparse;
     } data;
+
+    /* Hands adopted data back to it's owner on release. NULL if data is owned
+       by the Environment. */
+    fang_ten_deleter_t deleter;
+
+    /* Gradient computed by `fang_tape_backward()`, NULL if none. Owned by the
+       tape. */
+    struct fang_ten *grad;
 } fang_ten_t;
 
 /* Structure to pass dimension data to the Tensor. */
@@ -163,15 +208,45 @@ typedef struct fang_ten_ops {
     fang_ten_operator_fn create;
     fang_ten_operator_fn print;
     fang_ten_operator_fn rand;
+    fang_ten_operator_fn randn;
+    fang_ten_operator_fn trunc_randn;
+    fang_ten_operator_fn bernoulli;
     fang_ten_operator_fn sum;
     fang_ten_operator_fn diff;
     fang_ten_operator_fn mul;
     fang_ten_operator_fn gemm;
+    fang_ten_operator_fn conv2d;
+    fang_ten_operator_fn pool2d;
+    fang_ten_operator_fn norm;
+    fang_ten_operator_fn norm_backward;
+    fang_ten_operator_fn batchnorm;
+    fang_ten_operator_fn batchnorm_fold;
+    fang_ten_operator_fn attention;
+    fang_ten_operator_fn kvcache_append;
+    fang_ten_operator_fn kvcache_attention;
+    fang_ten_operator_fn gather;
+    fang_ten_operator_fn scatter_add;
+    fang_ten_operator_fn densify;
+    fang_ten_operator_fn convert;
     fang_ten_operator_fn scale;
     fang_ten_operator_fn fill;
+    fang_ten_operator_fn optim;
     fang_ten_operator_fn release;
 } fang_ten_ops_t;
 
+/* Distribution drawn by weight initializers. */
+typedef enum fang_ten_init_dist {
+    FANG_TEN_INIT_UNIFORM,
+    FANG_TEN_INIT_NORMAL
+} fang_ten_init_dist_t;
+
+/* Fan preserved by Kaiming initialization. Fan-in preserves variance of
+   activations in forward pass, fan-out of gradients in backward pass. */
+typedef enum fang_ten_init_fan {
+    FANG_TEN_INIT_FAN_IN,
+    FANG_TEN_INIT_FAN_OUT
+} fang_ten_init_fan_t;
+
 /* Used to indicate whether to transpose a matrix (two trailing dimension within
    tensor) while performing GEMM. */
 typedef enum fang_ten_gemm_transp {
@@ -179,6 +254,74 @@ typedef enum fang_ten_gemm_transp {
     FANG_TEN_GEMM_TRANSPOSE
 } fang_ten_gemm_transp_t;
 
+/* Memory layout of images and their convolution weights. */
+typedef enum fang_ten_conv_layout {
+    /* Images are (n, c, h, w), weights (k, c / groups, kh, kw). */
+    FANG_TEN_CONV_NCHW,
+
+    /* Images are (n, h, w, c), weights (k, kh, kw, c / groups). */
+    FANG_TEN_CONV_NHWC
+} fang_ten_conv_layout_t;
+
+/* Parameters of a 2D convolution, height first. Zero strides, dilations and
+   groups are taken as 1. */
+typedef struct fang_ten_conv2d {
+    fang_ten_conv_layout_t layout;
+    uint32_t stride[2];
+    uint32_t padding[2];
+    uint32_t dilation[2];
+    uint32_t groups;
+} fang_ten_conv2d_t;
+
+/* Reduction over a pooling window. */
+typedef enum fang_ten_pool_type {
+    /* Largest element of the window. */
+    FANG_TEN_POOL_MAX,
+
+    /* Mean of elements of the window inside the input, padding is not
+       counted. */
+    FANG_TEN_POOL_AVG
+} fang_ten_pool_type_t;
+
+/* Parameters of a 2D pooling, height first. Zero strides are taken as the
+   window. */
+typedef struct fang_ten_pool2d {
+    fang_ten_conv_layout_t layout;
+    fang_ten_pool_type_t type;
+    uint32_t window[2];
+    uint32_t stride[2];
+    uint32_t padding[2];
+} fang_ten_pool2d_t;
+
+/* Normalization of rows over the last dimension. */
+typedef enum fang_ten_norm_type {
+    /* Layer normalization, (x - mean) / sqrt(variance + eps). */
+    FANG_TEN_NORM_LAYER,
+
+    /* Root mean square normalization, x / sqrt(mean(x * x) + eps). */
+    FANG_TEN_NORM_RMS
+} fang_ten_norm_type_t;
+
+/* Dimension of a weight tensor holding output channels, for folding batch
+   normalization into it. */
+typedef enum fang_ten_fold_axis {
+    /* First, as of convolution weights and GEMM weights used transposed. */
+    FANG_TEN_FOLD_FIRST,
+
+    /* Last, as of (in, out) GEMM weights. */
+    FANG_TEN_FOLD_LAST
+} fang_ten_fold_axis_t;
+
+/* Parameters of scaled dot-product attention. Zero scale is taken as
+   1 / sqrt(d), `d` being dimension of queries and keys. */
+typedef struct fang_ten_attention {
+    fang_float_t scale;
+
+    /* Whether queries only attend to keys up to their own position, the last
+       query being aligned with the last key. */
+    bool causal;
+} fang_ten_attention_t;
+
 /* ================ DATA STRUCTURES END ================ */
 
 
@@ -188,6 +331,23 @@ typedef enum fang_ten_gemm_transp {
 FANG_API FANG_HOT int fang_ten_create(fang_ten_t *ten, int eid,
     fang_ten_dtype_t dtyp, fang_ten_dim_t dim, void *restrict data);
 
+/* Creates a new dense tensor from data of any data type. */
+/* NOTE: Unlike `fang_ten_create()`, `data` is expected in `src_dtyp` data
+ *   type instead of widened `fang_(u)int_t`/`fang_float_t`. Data is copied as
+ *   is if `src_dtyp` matches `dtyp`, converted otherwise.
+ */
+FANG_API FANG_HOT int fang_ten_create_from(fang_ten_t *ten, int eid,
+    fang_ten_dtype_t dtyp, fang_ten_dim_t dim, fang_ten_dtype_t src_dtyp,
+    const void *restrict data);
+
+/* Creates a new dense tensor adopting `data` (in `dtyp` data type) without
+   copying. `data` should be `FANG_MEMALIGN` bytes aligned. */
+/* NOTE: `deleter` is called with `data` when the tensor is released. If
+ *   `deleter` is NULL, data is only borrowed and never released by Fang.
+ */
+FANG_API int fang_ten_adopt(fang_ten_t *ten, int eid, fang_ten_dtype_t dtyp,
+    fang_ten_dim_t dim, void *data, fang_ten_deleter_t deleter);
+
 /* Creates a scalar tensor. */
 FANG_API FANG_HOT int fang_ten_scalar(fang_ten_t *ten, int eid,
     fang_ten_dtype_t dtyp, fang_gen_t value);
@@ -200,6 +360,44 @@ FANG_API FANG_HOT int fang_ten_fprint(fang_ten_t *ten, const char *name,
 FANG_API int fang_ten_rand(fang_ten_t *ten, fang_gen_t low, fang_gen_t high,
     uint32_t seed);
 
+/* Fill dense tensor with normally distributed random numbers. Floating point
+ * tensors only. Below double-precision, same seed may give values differing in
+ * the last bits on builds with and without AVX2. */
+FANG_API int fang_ten_randn(fang_ten_t *ten, fang_float_t mean,
+    fang_float_t std, uint32_t seed);
+
+/* Fill dense tensor with normally distributed random numbers, truncated to
+ * [low, high]. Floating point tensors only. Same as `fang_ten_randn()`, values
+ * below double-precision may differ between builds with and without AVX2.
+ * Intervals lying wholly beyond 37 standard deviations of the mean are
+ * rejected, normal CDF underflows there. */
+FANG_API int fang_ten_trunc_randn(fang_ten_t *ten, fang_float_t mean,
+    fang_float_t std, fang_float_t low, fang_float_t high, uint32_t seed);
+
+/* Fill dense tensor with a Bernoulli mask; each element is `value` with
+   probability `p`, zero otherwise. */
+/* NOTE: `value` should be `fang_int_t` for integer tensors and `fang_float_t`
+ *   for floating point tensors. For inverted dropout, `value` of `1 / p`
+ *   makes the mask scale kept activations as well.
+ */
+FANG_API int fang_ten_bernoulli(fang_ten_t *ten, fang_float_t p,
+    fang_gen_t value, uint32_t seed);
+
+/* Xavier (Glorot) initialization. Fans are taken as PyTorch does: dimension
+   0 is output features, dimension 1 is input features, and rest are receptive
+   field (e.g. kernel height and width). */
+/* uniform := U(-a, a), a   = gain * sqrt(6 / (fan_in + fan_out)) */
+/* normal  := N(0, std),  std = gain * sqrt(2 / (fan_in + fan_out)) */
+FANG_API int fang_ten_xavier(fang_ten_t *ten, fang_ten_init_dist_t dist,
+    fang_float_t gain, uint32_t seed);
+
+/* Kaiming (He) initialization. Fans are taken the same as
+   `fang_ten_xavier()`. Gain is sqrt(2) for ReLU. */
+/* normal  := N(0, std),  std = gain / sqrt(fan) */
+/* uniform := U(-a, a), a   = sqrt(3) * std */
+FANG_API int fang_ten_kaiming(fang_ten_t *ten, fang_ten_init_dist_t dist,
+    fang_ten_init_fan_t fan, fang_float_t gain, uint32_t seed);
+
 /* Scales a tensor. */
 FANG_API FANG_HOT int fang_ten_scale(fang_ten_t *ten, fang_gen_t factor);
 
@@ -219,15 +417,143 @@ FANG_API FANG_HOT int fang_ten_mul(fang_ten_t *dest, fang_ten_t *x,
     fang_ten_t *y);
 
 /* Performs General Matrix-Matrix Multiply (GEMM) operation on two trailing
-   dimension. */
+ * dimension. A sparse `x`, not transposed, is passed to `fang_ten_spmm()`;
+ * being not recorded by tapes, it fails with `-FANG_RECORDING` while the
+ * Environment records one. */
 /* dest := alpha * xy + beta * dest */
 FANG_API FANG_HOT int fang_ten_gemm(fang_ten_gemm_transp_t transp_x,
     fang_ten_gemm_transp_t transp_y, fang_gen_t beta, fang_ten_t * dest,
     fang_gen_t alpha, fang_ten_t *x, fang_ten_t *y);
 
+/* Performs 2D convolution (cross-correlation, as in deep learning) of images
+ * `x` with weights `w`, overwriting `dest`. Channels are split in `groups`,
+ * each convolved on it's own; with a single input channel per group
+ * (depthwise convolution), weights are applied directly. Output height is
+ * (h + 2 * padding - dilation * (kh - 1) - 1) / stride + 1, likewise width.
+ * Single-precision only. Not recorded by tapes. */
+FANG_API FANG_HOT int fang_ten_conv2d(fang_ten_t *dest, fang_ten_t *x,
+    fang_ten_t *w, const fang_ten_conv2d_t *conv);
+
+/* Performs 2D max or average pooling of images `x`, overwriting `dest`, every
+ * channel on it's own. Output size is as of `fang_ten_conv2d()`, window
+ * taken as kernel; padding has to be smaller than the window. Single-precision
+ * only. Not recorded by tapes. */
+FANG_API FANG_HOT int fang_ten_pool2d(fang_ten_t *dest, fang_ten_t *x,
+    const fang_ten_pool2d_t *pool);
+
+/* Averages images `x` over height and width into `dest`, which is
+   (n, c, 1, 1) in NCHW layout and (n, 1, 1, c) in NHWC layout. */
+FANG_API FANG_HOT int fang_ten_global_avgpool2d(fang_ten_t *dest,
+    fang_ten_t *x, fang_ten_conv_layout_t layout);
+
+/* Normalizes `x` over it's last dimension into `dest`, scaled by `gamma` and
+ * shifted by `beta`, vectors of the size of last dimension; either may be
+ * NULL. If `stats` is not NULL, it receives mean (zero for RMSNorm) and
+ * reciprocal standard deviation of every row, in shape of `x` with last
+ * dimension of 2, for `fang_ten_norm_backward()`. Statistics are computed in
+ * a single pass, in single-precision. Half, bfloat16 and single-precision
+ * only; `stats` is always single-precision. Not recorded by tapes. */
+FANG_API FANG_HOT int fang_ten_norm(fang_ten_norm_type_t type,
+    fang_ten_t *dest, fang_ten_t *x, fang_ten_t *gamma, fang_ten_t *beta,
+    fang_gen_t eps, fang_ten_t *stats);
+
+/* Computes gradients of `fang_ten_norm()` from gradient `dy` of it's output,
+ * it's input `x`, `gamma` and `stats`. Gradients of input, `gamma` and `beta`
+ * are overwritten; any of `dx`, `dgamma` and `dbeta` may be NULL, as may be
+ * `gamma` if not used by the forward pass. */
+FANG_API FANG_HOT int fang_ten_norm_backward(fang_ten_norm_type_t type,
+    fang_ten_t *dx, fang_ten_t *dgamma, fang_ten_t *dbeta, fang_ten_t *dy,
+    fang_ten_t *x, fang_ten_t *gamma, fang_ten_t *stats);
+
+/* Applies batch normalization of inference to `x` into `dest`, every channel
+ * by it's running statistics: (x - mean) / sqrt(var + eps) * gamma + beta.
+ * `stats` is (2, c), running mean of channels followed by their variance;
+ * `gamma` and `beta` are vectors of channels, either may be NULL. Channels
+ * are the second dimension in NCHW layout and the last one in NHWC layout,
+ * hence (n, c) tensors are the same in either. Single-precision only. Not
+ * recorded by tapes. */
+FANG_API FANG_HOT int fang_ten_batchnorm(fang_ten_t *dest, fang_ten_t *x,
+    fang_ten_t *stats, fang_ten_t *gamma, fang_ten_t *beta, fang_gen_t eps,
+    fang_ten_conv_layout_t layout);
+
+/* Folds batch normalization following a layer into the layer's weights `w`
+ * and bias `b` in place, so that the layer outputs normalized activations
+ * and `fang_ten_batchnorm()` is not needed. `axis` tells which dimension of
+ * `w` holds output channels; `b` is a vector of them, zeroed for layers
+ * without bias. Parameters are as of `fang_ten_batchnorm()`. */
+FANG_API int fang_ten_batchnorm_fold(fang_ten_t *w, fang_ten_t *b,
+    fang_ten_fold_axis_t axis, fang_ten_t *stats, fang_ten_t *gamma,
+    fang_ten_t *beta, fang_gen_t eps);
+
+/* Performs scaled dot-product attention, softmax(scale * qk^T)v, of queries
+ * `q` (..., t, d), keys `k` (..., s, d) and values `v` (..., s, dv),
+ * overwriting `dest` (..., t, dv). Leading dimensions, batches and heads, have
+ * to match. Scores are computed tile by tile with online softmax, never
+ * taking memory of (t, s). Causal masking needs at least as many keys as
+ * queries. Single-precision only. Not recorded by tapes. */
+FANG_API FANG_HOT int fang_ten_attention(fang_ten_t *dest, fang_ten_t *q,
+    fang_ten_t *k, fang_ten_t *v, const fang_ten_attention_t *attn);
+
+/* Gathers rows of `x`, slices along it's first dimension, picked by integer
+ * indices `idx` of any shape into `dest`, of dimensions of `idx` followed by
+ * the rest of dimensions of `x`; e.g. embedding lookup of token ids in a
+ * (vocab, dim) table. Indices are 32 or 64-bit integers and are checked
+ * against the first dimension of `x` before anything is written. Any type.
+ * Not recorded by tapes. */
+FANG_API FANG_HOT int fang_ten_gather(fang_ten_t *dest, fang_ten_t *x,
+    fang_ten_t *idx);
+
+/* Adds rows of `x`, of dimensions of `idx` followed by the rest of dimensions
+ * of `dest`, into rows of `dest` picked by `idx`, accumulating repeated
+ * indices; e.g. gradient of an embedding table. It's the backward pass of
+ * `fang_ten_gather()`. Rows picked many times are summed in order of their
+ * indices by a single thread, hence results are deterministic. Single and
+ * double-precision only. Not recorded by tapes. */
+FANG_API FANG_HOT int fang_ten_scatter_add(fang_ten_t *dest, fang_ten_t *x,
+    fang_ten_t *idx);
+
+/* Creates a sparse tensor in COO encoding of `nnz` non-zero elements.
+ * Coordinates of elements are rows of `idx`, of a column per dimension, and
+ * their values `data` are of `src_dtyp` data type. Coordinates are checked
+ * against dimensions; repeated ones add up in operators. */
+FANG_API int fang_ten_sparse_create(fang_ten_t *ten, int eid,
+    fang_ten_dtype_t dtyp, fang_ten_dim_t dim, int nnz,
+    const uint32_t *restrict idx, fang_ten_dtype_t src_dtyp,
+    const void *restrict data);
+
+/* Creates sparse matrix `dest` in `fmt` encoding from COO matrix `x`,
+ * summing elements of same coordinates. Blocks of BSR are `block` x `block`,
+ * which has to divide both dimensions; `block` is ignored otherwise.
+ * Elements are sorted by two passes of counting sort, in linear time.
+ * 2:4 is built from dense matrix `x` of pruned weights instead, of columns a
+ * multiple of 4; every group of 4 consecutive elements of a row has to have
+ * at most 2 non-zeros, FANG_INVSPARSE otherwise. */
+FANG_API int fang_ten_sparse_convert(fang_ten_t *dest, fang_ten_t *x,
+    fang_ten_sparse_fmt_t fmt, uint32_t block);
+
+/* Scatters sparse tensor `x` into dense tensor `dest` of same dimensions and
+   data type, overwriting it. */
+FANG_API int fang_ten_sparse_to_dense(fang_ten_t *dest, fang_ten_t *x);
+
+/* Multiplies sparse matrix `x` (m, k) with dense matrix `y` (k, n) into dense
+ * matrix `dest` (m, n), dest := alpha * xy + beta * dest. Rows of `dest`
+ * are computed in parallel for CSR and BSR, each streaming rows of `y`
+ * picked by it's elements; COO is sorted into CSR first. CSC is walked
+ * column by column, columns of `dest` being computed in parallel instead.
+ * 2:4 runs a blocked GEMM doing half the multiply-adds of the dense one,
+ * single-precision only. `fang_ten_gemm()` comes here for a sparse `x`.
+ * Single and double-precision only. Not recorded by tapes. */
+FANG_API FANG_HOT int fang_ten_spmm(fang_gen_t beta, fang_ten_t *dest,
+    fang_gen_t alpha, fang_ten_t *x, fang_ten_t *y);
+
 // TODO: Add fang_ten_fma (Fuse Multiply-Add) using FMA extension
 
-/* Releases a tensor. */
+/* Waits for pending operators using the data of a tensor, if it's Environment
+ * is asynchronous. Returns the first error raised by an asynchronous operator
+ * since last `fang_env_wait()`, which still reports and clears it. */
+FANG_API int fang_ten_wait(fang_ten_t *ten);
+
+/* Releases a tensor. Waits for pending operators using it first. */
 FANG_API FANG_HOT int fang_ten_release(fang_ten_t *ten);
 
 /* ================ DECLARATIONS END ================ */
@@ -26,7 +26,8 @@
  * would be cosidered `fang_(u)int`, depending on the signedness.
  *
  * This is applicable to all external interaction with tensors, e.g. creating
- * an input tensor with external data.
+ * an input tensor with external data. Use `fang_ten_create_from()` or
+ * `fang_ten_adopt()` to hand over data in tensor's own data type instead.
  */
 
 /* Most precised floating type Fang supports. */
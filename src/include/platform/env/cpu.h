@@ -8,8 +8,10 @@
 
 /* ================ DECLARATIONS ================ */
 
-/* Gets CPU information (how many cores, start index etc.) in Linux. */
-int _fang_env_cpu_getinfo(int *restrict nproc);
+/* Gets CPU information (processors and their topology) in Linux. Allocates
+   `cpu->procs`. */
+int _fang_env_cpu_getinfo(_fang_env_cpu_t *restrict cpu,
+    fang_reallocator_t realloc);
 
 /* ================ DECLARATIONS END ================ */
 
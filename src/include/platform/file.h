@@ -0,0 +1,31 @@
+#ifndef FANG_PLATFORM_FILE_H
+#define FANG_PLATFORM_FILE_H
+
+#include <compiler.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ================ DECLARATIONS ================ */
+
+/* Opens a file for positional I/O and returns the descriptor. Creates (and
+   truncates) the file if `write` is non-zero. */
+int _fang_file_open(const char *restrict path, int write);
+
+/* Hints the kernel that the file is going to be read sequentially. */
+void _fang_file_advise_sequential(int fd);
+
+/* Reads exactly `size` bytes at `offset`. Returns bytes read, which is only
+   less than `size` at end of file. */
+FANG_HOT int64_t _fang_file_pread(int fd, void *buff, size_t size,
+    uint64_t offset);
+
+/* Writes exactly `size` bytes at `offset`. */
+FANG_HOT int _fang_file_pwrite(int fd, const void *buff, size_t size,
+    uint64_t offset);
+
+/* Closes a file descriptor. */
+void _fang_file_close(int fd);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_PLATFORM_FILE_H
@@ -0,0 +1,95 @@
+#ifndef FANG_PLATFORM_THREAD_H
+#define FANG_PLATFORM_THREAD_H
+
+#include <compiler.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#error "Threading is not yet implemented for Windows."
+#else
+#include <pthread.h>
+#endif  // _WIN32
+
+/* ================ ATOMICS ================ */
+
+/* Sequentially consistent enough for bookkeeping; loads acquire and stores
+   release. */
+#define _fang_atomic_load(ptr)          __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define _fang_atomic_store(ptr, val)    __atomic_store_n(ptr, val,             \
+    __ATOMIC_RELEASE)
+
+/* Returns the value before the operation. */
+#define _fang_atomic_fetch_add(ptr, val)                                       \
+    __atomic_fetch_add(ptr, val, __ATOMIC_ACQ_REL)
+
+/* Stores `des` if `*ptr` equals `*exp`, otherwise loads `*ptr` to `*exp`.
+   Returns whether it was stored. */
+#define _fang_atomic_cas(ptr, exp, des)                                        \
+    __atomic_compare_exchange_n(ptr, exp, des, false, __ATOMIC_ACQ_REL,        \
+        __ATOMIC_ACQUIRE)
+
+/* ================ ATOMICS END ================ */
+
+
+/* ================ DATA STRUCTURES ================ */
+
+/* Platform native thread, mutex and condition variable. */
+typedef pthread_t _fang_thread_t;
+typedef pthread_mutex_t _fang_mutex_t;
+typedef pthread_cond_t _fang_cond_t;
+
+/* Routine executed by a spawned thread. */
+typedef void *(*_fang_thread_fn)(void *arg);
+
+/* ================ DATA STRUCTURES END ================ */
+
+
+/* ================ DECLARATIONS ================ */
+
+/* Spawns a new thread executing `fn` with `arg`. */
+int _fang_thread_create(_fang_thread_t *restrict thread, _fang_thread_fn fn,
+    void *arg);
+
+/* Waits for a thread to finish. */
+int _fang_thread_join(_fang_thread_t thread);
+
+/* Pins a thread to logical processor `cpu`. */
+int _fang_thread_pin(_fang_thread_t thread, int cpu);
+
+/* Gives up the processor for other threads. */
+void _fang_thread_yield(void);
+
+/* Whether `thread` is the calling thread. */
+bool _fang_thread_is_self(_fang_thread_t thread);
+
+/* Initializes a mutex. */
+int _fang_mutex_init(_fang_mutex_t *restrict mutex);
+
+/* Locks a mutex. */
+FANG_HOT void _fang_mutex_lock(_fang_mutex_t *restrict mutex);
+
+/* Locks a mutex if not locked already. Returns whether it was locked. */
+FANG_HOT bool _fang_mutex_trylock(_fang_mutex_t *restrict mutex);
+
+/* Unlocks a mutex. */
+FANG_HOT void _fang_mutex_unlock(_fang_mutex_t *restrict mutex);
+
+/* Destroys a mutex. */
+void _fang_mutex_release(_fang_mutex_t *restrict mutex);
+
+/* Initializes a condition variable. */
+int _fang_cond_init(_fang_cond_t *restrict cond);
+
+/* Atomically unlocks `mutex` and waits for `cond` to be signaled. */
+FANG_HOT void _fang_cond_wait(_fang_cond_t *restrict cond,
+    _fang_mutex_t *restrict mutex);
+
+/* Wakes up all threads waiting on `cond`. */
+FANG_HOT void _fang_cond_broadcast(_fang_cond_t *restrict cond);
+
+/* Destroys a condition variable. */
+void _fang_cond_release(_fang_cond_t *restrict cond);
+
+/* ================ DECLARATIONS END ================ */
+
+#endif  // FANG_PLATFORM_THREAD_H
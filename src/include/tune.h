@@ -8,6 +8,18 @@
 /* ============================================= */
 
 
+/* ================ THREAD POOL ================ */
+
+/* Times an idle thread yields the processor before going to sleep while
+   waiting for work. */
+#define FANG_POOL_SPIN             1024
+
+/* Elements an element-wise operator processes per task. */
+#define FANG_POOL_GRAIN            16384
+
+/* ================ THREAD POOL END ================ */
+
+
 /* ================ GEMM ================ */
 
 /* ======== SINGLE-PRECISION GEMM ======== */
@@ -23,17 +35,103 @@
 #define FANG_SGEMM_KERNEL          0
 // TODO: Add more kernels.
 
-/* How much threads to allocate to each of the loops (excluding loop 1 and 4)
-   for parallelization. */
-#define FANG_SGEMM_LOOP5_NT        1
-#define FANG_SGEMM_LOOP3_NT        1
-#define FANG_SGEMM_LOOP2_NT        1
-
 /* ======== SINGLE-PRECISION GEMM END ======== */
 
+/* ======== 2:4 SPARSE SINGLE-PRECISION GEMM ======== */
+
+/* Cache blocking parameters. A task computes MCxNC block of `dest`, walking
+   KC columns of `x` at a time; KCxNR micro-panel of packed `y` should stay in
+   L1 cache. KC is a multiple of 32, a word of metadata. */
+#define FANG_SGEMM24_MC            128
+#define FANG_SGEMM24_NC            512   // Ensure `NR` alignment
+#define FANG_SGEMM24_KC            64
+
+/* Columns of a row of `dest` the micro-kernel computes, a multiple of 128 so
+   that it's passes over registers fit for both AVX2 and AVX512. */
+#define FANG_SGEMM24_NR            128
+
+/* ======== 2:4 SPARSE SINGLE-PRECISION GEMM END ======== */
+
 /* ================ GEMM END ================ */
 
 
+/* ================ CONVOLUTION ================ */
+
+/* Output pixels a task of implicit GEMM convolution computes. The im2col
+   matrix is packed from the input this many columns at a time. */
+#define FANG_SCONV_PIXELS          128
+
+/* Winograd F(4x4, 3x3) is used for 3x3 convolutions of stride 1 with at least
+   this many input and output channels; below, transforms cost more than the
+   multiplications they save. */
+#define FANG_SCONV_WINO_MINCH      16
+
+/* Output tiles transformed at a time by Winograd convolution, bounding the
+   memory of transformed tiles. */
+#define FANG_SCONV_WINO_TILES      192
+
+/* Channels of a row a task of pooling pools in NHWC layout. */
+#define FANG_SPOOL_CHANNELS        512
+
+/* ================ CONVOLUTION END ================ */
+
+
+/* ================ NORMALIZATION ================ */
+
+/* Columns of gradients of normalization parameters a task sums over all
+   rows. */
+#define FANG_NORM_COLS             64
+
+/* ================ NORMALIZATION END ================ */
+
+
+/* ================ ATTENTION ================ */
+
+/* Queries a task of attention computes, should be a multiple of `MR`. */
+#define FANG_ATTN_QUERIES          96
+
+/* Keys of a score tile, should be a multiple of `NR`. Along with
+   FANG_ATTN_QUERIES, bounds the score tile to stay in L2 cache. */
+#define FANG_ATTN_KEYS             128
+
+/* ================ ATTENTION END ================ */
+
+
+/* ================ INDEXING ================ */
+
+/* Rows ahead of the one being copied whose first cache line is prefetched by
+   gather and scatter-add. */
+#define FANG_INDEX_PREFETCH        4
+
+/* ================ INDEXING END ================ */
+
+
+/* ================ SPARSE ================ */
+
+/* Columns of destination a task of SpMM of a CSC matrix computes. Tasks walk
+   all elements of the matrix, hence should be wide enough to pay for it. */
+#define FANG_SPMM_COLS             64
+
+/* ================ SPARSE END ================ */
+
+
+/* ================ RANDOM ================ */
+
+/* Elements each thread generates at a time. Should be a multiple of 32, the
+   Philox group size. */
+#define FANG_RAND_CHUNK            4096
+
+/* ================ RANDOM END ================ */
+
+
+/* ================ PRINT ================ */
+
+/* Size of the buffer tensor text is staged in before writing to file. */
+#define FANG_PRINT_BUFSIZ          65536
+
+/* ================ PRINT END ================ */
+
+
 /* ============================================= */
 /*                      CPU END                  */
 /* ============================================= */
@@ -0,0 +1,339 @@
+#include <fang/autograd.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+/* ================ HELPER MACROS ================ */
+
+/* Check if an operation is successful or not. */
+#define AGCHK(expr)     assert_true(FANG_ISOK(expr))
+
+/* ================ HELPER MACROS END ================ */
+
+
+/* ================ SETUP AND TEARDOWN ================ */
+
+/* Setup Environment before every test. */
+static int setup(void **state) {
+    int env = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    if(!FANG_ISOK(env))
+        return 1;
+
+    *state = (void *) (uint64_t) env;
+    return 0;
+}
+
+/* Release created Environment after every test. */
+static int teardown(void **state) {
+    int env = (int) (uint64_t) *state;
+    fang_env_release(env);
+    return 0;
+}
+
+/* ================ SETUP AND TEARDOWN END ================ */
+
+
+/* ================ TESTS ================ */
+
+/* Element-wise operators with broadcasting and in place scaling. */
+static void fang_tape_arith_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* loss := 3 * (x - z) * x, `z` broadcasted over rows. */
+    fang_ten_t x, z, d, loss;
+    AGCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2, 3),
+        (fang_float_t []) { 1, 2, 3, 4, 5, 6 }));
+    AGCHK(fang_ten_create(&z, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(3),
+        (fang_float_t []) { 1, 1, 2 }));
+    AGCHK(fang_ten_create(&d, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2, 3),
+        NULL));
+    AGCHK(fang_ten_create(&loss, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2, 3),
+        NULL));
+    assert_null(x.grad);
+
+    fang_tape_t tape;
+    AGCHK(fang_tape_create(&tape, env));
+    AGCHK(fang_tape_begin(&tape));
+
+    /* Only a single tape is recorded at a time. */
+    fang_tape_t other;
+    AGCHK(fang_tape_create(&other, env));
+    assert_int_equal(fang_tape_begin(&other), -FANG_RECORDING);
+
+    AGCHK(fang_ten_diff(&d, &x, &z));
+    AGCHK(fang_ten_scale(&d, FANG_F2G(3)));
+    AGCHK(fang_ten_mul(&loss, &d, &x));
+    assert_int_equal(fang_tape_backward(&tape, &loss), -FANG_RECORDING);
+    AGCHK(fang_tape_end(&tape));
+    assert_int_equal(fang_tape_end(&tape), -FANG_NORECORD);
+    assert_int_equal(tape.nops, 3);
+
+    AGCHK(fang_tape_backward(&tape, &loss));
+
+    /* dx := 3 * (2x - z), dz := -3 * sum of rows of x */
+    float *xd = (float *) x.data.dense, *zd = (float *) z.data.dense;
+    float *gx = (float *) x.grad->data.dense, *gz = (float *) z.grad->data.dense;
+    for(int i = 0; i < 2 * 3; i++)
+        assert_float_equal(gx[i], 3 * (2 * xd[i] - zd[i % 3]), 1e-5);
+    for(int j = 0; j < 3; j++)
+        assert_float_equal(gz[j], -3 * (xd[j] + xd[3 + j]), 1e-5);
+
+    /* Intermediates give their gradients back. */
+    assert_null(d.grad);
+    assert_null(loss.grad);
+
+    /* Beginning again detaches gradients. */
+    AGCHK(fang_tape_begin(&tape));
+    assert_null(x.grad);
+    AGCHK(fang_tape_end(&tape));
+
+    AGCHK(fang_tape_release(&tape));
+    AGCHK(fang_tape_release(&other));
+    fang_ten_release(&x);
+    fang_ten_release(&z);
+    fang_ten_release(&d);
+    fang_ten_release(&loss);
+}
+
+/* Linear layer trained for a few steps. */
+static void fang_tape_linear_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* out := x * w + b, loss := out ^ 2 */
+    fang_ten_t x, w, b, out, loss;
+    AGCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(4, 3),
+        NULL));
+    AGCHK(fang_ten_create(&w, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(3, 2),
+        NULL));
+    AGCHK(fang_ten_create(&b, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2),
+        (fang_float_t []) { 0.5, -1 }));
+    AGCHK(fang_ten_create(&out, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(4, 2),
+        NULL));
+    AGCHK(fang_ten_create(&loss, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(4, 2),
+        NULL));
+    AGCHK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1), 7));
+    AGCHK(fang_ten_rand(&w, FANG_F2G(-1), FANG_F2G(1), 11));
+
+    fang_tape_t tape;
+    AGCHK(fang_tape_create(&tape, env));
+
+    int nbufs = 0;
+    for(int step = 0; step < 3; step++) {
+        AGCHK(fang_tape_begin(&tape));
+        AGCHK(fang_ten_matmul(&out, &x, &w));
+        AGCHK(fang_ten_sum(&out, &out, &b));
+        AGCHK(fang_ten_mul(&loss, &out, &out));
+        AGCHK(fang_tape_end(&tape));
+        AGCHK(fang_tape_backward(&tape, &loss));
+
+        /* dout := 2 * out, dw := x^T dout, db := sum of rows of dout,
+           dx := dout w^T */
+        float *xd = (float *) x.data.dense, *wd = (float *) w.data.dense;
+        float *od = (float *) out.data.dense;
+        float *gx = (float *) x.grad->data.dense;
+        float *gw = (float *) w.grad->data.dense;
+        float *gb = (float *) b.grad->data.dense;
+        for(int k = 0; k < 3; k++) {
+            for(int j = 0; j < 2; j++) {
+                float expect = 0;
+                for(int i = 0; i < 4; i++)
+                    expect += xd[i * 3 + k] * 2 * od[i * 2 + j];
+                assert_float_equal(gw[k * 2 + j], expect, 1e-4);
+            }
+        }
+        for(int j = 0; j < 2; j++) {
+            float expect = 0;
+            for(int i = 0; i < 4; i++)
+                expect += 2 * od[i * 2 + j];
+            assert_float_equal(gb[j], expect, 1e-4);
+        }
+        for(int i = 0; i < 4; i++) {
+            for(int k = 0; k < 3; k++) {
+                float expect = 0;
+                for(int j = 0; j < 2; j++)
+                    expect += 2 * od[i * 2 + j] * wd[k * 2 + j];
+                assert_float_equal(gx[i * 3 + k], expect, 1e-4);
+            }
+        }
+
+        /* Gradient descent step; not recorded. */
+        AGCHK(fang_ten_scale(w.grad, FANG_F2G(-0.01)));
+        AGCHK(fang_ten_sum(&w, &w, w.grad));
+
+        /* Gradient buffers are reused once warmed up. */
+        if(step == 0)
+            nbufs = tape.nbufs;
+        assert_int_equal(tape.nbufs, nbufs);
+    }
+
+    AGCHK(fang_tape_release(&tape));
+    assert_null(w.grad);
+
+    fang_ten_release(&x);
+    fang_ten_release(&w);
+    fang_ten_release(&b);
+    fang_ten_release(&out);
+    fang_ten_release(&loss);
+}
+
+/* Batched GEMM against a shared weight, with transposes. */
+static void fang_tape_gemm_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* out := x^T w^T, `x` of (2, 3, 4) and `w` of (5, 3) shared by
+       batches. */
+    fang_ten_t x, w, out;
+    AGCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2, 3, 4),
+        NULL));
+    AGCHK(fang_ten_create(&w, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(5, 3),
+        NULL));
+    AGCHK(fang_ten_create(&out, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2, 4, 5),
+        NULL));
+    AGCHK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1), 3));
+    AGCHK(fang_ten_rand(&w, FANG_F2G(-1), FANG_F2G(1), 5));
+
+    fang_tape_t tape;
+    AGCHK(fang_tape_create(&tape, env));
+    AGCHK(fang_tape_begin(&tape));
+    AGCHK(fang_ten_gemm(FANG_TEN_GEMM_TRANSPOSE, FANG_TEN_GEMM_TRANSPOSE,
+        FANG_F2G(0), &out, FANG_F2G(2), &x, &w));
+    AGCHK(fang_tape_end(&tape));
+    AGCHK(fang_tape_backward(&tape, &out));
+
+    /* out[b, i, j] := 2 * sum over k of x[b, k, i] * w[j, k]
+     *      dx[b, k, i] := 2 * sum over j of w[j, k]
+     *      dw[j, k]    := 2 * sum over b, i of x[b, k, i]
+     */
+    float *xd = (float *) x.data.dense, *wd = (float *) w.data.dense;
+    float *gx = (float *) x.grad->data.dense;
+    float *gw = (float *) w.grad->data.dense;
+    for(int k = 0; k < 3; k++) {
+        float expect = 0;
+        for(int j = 0; j < 5; j++)
+            expect += 2 * wd[j * 3 + k];
+        for(int bi = 0; bi < 2; bi++) {
+            for(int i = 0; i < 4; i++)
+                assert_float_equal(gx[bi * 12 + k * 4 + i], expect, 1e-4);
+        }
+    }
+    for(int j = 0; j < 5; j++) {
+        for(int k = 0; k < 3; k++) {
+            float expect = 0;
+            for(int bi = 0; bi < 2; bi++) {
+                for(int i = 0; i < 4; i++)
+                    expect += 2 * xd[bi * 12 + k * 4 + i];
+            }
+            assert_float_equal(gw[j * 3 + k], expect, 1e-4);
+        }
+    }
+
+    AGCHK(fang_tape_release(&tape));
+    fang_ten_release(&x);
+    fang_ten_release(&w);
+    fang_ten_release(&out);
+}
+
+/* Checkpointed activations give the same gradients. */
+static void fang_tape_checkpoint_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* h := x * w1, a := h ^ 2, out := a * w2 */
+    fang_ten_t x, w1, w2, h, a, out;
+    AGCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(4, 3),
+        NULL));
+    AGCHK(fang_ten_create(&w1, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(3, 5),
+        NULL));
+    AGCHK(fang_ten_create(&w2, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(5, 2),
+        NULL));
+    AGCHK(fang_ten_create(&h, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(4, 5),
+        NULL));
+    AGCHK(fang_ten_create(&a, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(4, 5),
+        NULL));
+    AGCHK(fang_ten_create(&out, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(4, 2),
+        NULL));
+    AGCHK(fang_ten_rand(&w1, FANG_F2G(-1), FANG_F2G(1), 1));
+    AGCHK(fang_ten_rand(&w2, FANG_F2G(-1), FANG_F2G(1), 2));
+
+    fang_tape_t tape;
+    AGCHK(fang_tape_create(&tape, env));
+    assert_int_equal(fang_tape_checkpoint_begin(&tape), -FANG_NORECORD);
+
+    /* Second pass discards the input and first activation, and recomputes
+       them during backward pass. */
+    float expect1[3 * 5], expect2[5 * 2];
+    for(int ckpt = 0; ckpt < 2; ckpt++) {
+        AGCHK(fang_tape_begin(&tape));
+        AGCHK(fang_tape_checkpoint_begin(&tape));
+        AGCHK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1), 3));
+        AGCHK(fang_ten_matmul(&h, &x, &w1));
+        AGCHK(fang_ten_mul(&a, &h, &h));
+
+        /* Segments do not nest. */
+        assert_int_equal(fang_tape_checkpoint_begin(&tape), -FANG_NOCKPT);
+
+        if(ckpt) {
+            fang_ten_t *discard[] = { &x, &h };
+            AGCHK(fang_tape_checkpoint_end(&tape, discard, 2));
+            assert_null(x.data.dense);
+            assert_null(h.data.dense);
+        } else {
+            /* `w1` is never written within the segment. */
+            fang_ten_t *discard[] = { &h, &w1 };
+            assert_int_equal(fang_tape_checkpoint_end(&tape, discard, 2),
+                -FANG_NOCKPT);
+            assert_non_null(h.data.dense);
+        }
+
+        AGCHK(fang_ten_matmul(&out, &a, &w2));
+        AGCHK(fang_tape_end(&tape));
+        AGCHK(fang_tape_backward(&tape, &out));
+
+        float *g1 = (float *) w1.grad->data.dense;
+        float *g2 = (float *) w2.grad->data.dense;
+        for(int i = 0; i < 3 * 5; i++) {
+            if(ckpt)
+                assert_float_equal(g1[i], expect1[i], 1e-5);
+            expect1[i] = g1[i];
+        }
+        for(int i = 0; i < 5 * 2; i++) {
+            if(ckpt)
+                assert_float_equal(g2[i], expect2[i], 1e-5);
+            expect2[i] = g2[i];
+        }
+    }
+
+    /* Activations stay discarded until recorded again. */
+    assert_null(h.data.dense);
+    AGCHK(fang_tape_begin(&tape));
+    assert_non_null(h.data.dense);
+    AGCHK(fang_tape_end(&tape));
+
+    AGCHK(fang_tape_release(&tape));
+    fang_ten_release(&x);
+    fang_ten_release(&w1);
+    fang_ten_release(&w2);
+    fang_ten_release(&h);
+    fang_ten_release(&a);
+    fang_ten_release(&out);
+}
+
+/* ================ TESTS END ================ */
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(fang_tape_arith_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_tape_linear_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_tape_gemm_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_tape_checkpoint_test, setup,
+            teardown)
+    };
+
+    return cmocka_run_group_tests_name("unit/autograd", tests, NULL, NULL);
+}
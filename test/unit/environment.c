@@ -1,6 +1,7 @@
 #include <fang/status.h>
 #include <env/cpu/cpu.h>
 #include <memory.h>
+#include <string.h>
 #include <stdarg.h>
 #include <setjmp.h>
 #include <cmocka.h>
@@ -76,16 +77,413 @@ static void fang_env_cpu_test(void **state) {
     /* All processors should be active at first. */
     assert_int_equal(cpu_private->nproc, cpu_private->nact);
 
-    // TODO: Test CPU Environment control functions
+    /* Thread count and processors should be in range. */
+    int cpu = -1;
+    assert_int_equal(fang_env_cpu_set_threads(eid, 0, NULL), -FANG_INVPCOUNT);
+    assert_int_equal(fang_env_cpu_set_threads(eid, cpu_private->nproc + 1,
+        NULL), -FANG_INVPCOUNT);
+    assert_int_equal(fang_env_cpu_set_threads(eid, 1, &cpu), -FANG_INVPCPU);
+    assert_int_equal(fang_env_cpu_set_threads(69, 1, NULL), -FANG_NOENV);
+
+    /* Pin a single thread; the calling thread no longer runs operators. */
+    cpu = cpu_private->procs[0].id;
+    assert_true(FANG_ISOK(fang_env_cpu_set_threads(eid, 1, &cpu)));
+    assert_int_equal(cpu_private->nact, 1);
+    assert_false(cpu_private->pool.caller);
+
+    fang_env_release(eid);
+}
+
+/* CPU topology and thread binding test. */
+static void fang_env_cpu_bind_test(void **state) {
+    int eid = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    assert_true(FANG_ISOK(eid));
+
+    fang_env_t *env;
+    assert_true(FANG_ISOK(_fang_env_retrieve(&env, eid)));
+    _fang_env_cpu_t *cpu_private = (_fang_env_cpu_t *) env->private;
+
+    /* Every socket has a core, every core a logical processor. */
+    fang_env_cpu_topo_t topo;
+    assert_true(FANG_ISOK(fang_env_cpu_topology(eid, &topo)));
+    assert_int_equal(topo.nproc, cpu_private->nproc);
+    assert_in_range(topo.nsockets, 1, topo.ncores);
+    assert_in_range(topo.ncores, 1, topo.nproc);
+    assert_in_range(topo.nllcs, 1, topo.nproc);
+
+    /* Indices should be dense and the first hardware thread of every core
+       should have no SMT rank. Processor IDs are the ones of the operating
+       system, in order. */
+    int first = 0;
+    for(int i = 0; i < topo.nproc; i++) {
+        _fang_env_cpu_proc_t *proc = cpu_private->procs + i;
+        assert_true(proc->id >= (i > 0 ? proc[-1].id + 1 : 0));
+        assert_in_range(proc->socket, 0, topo.nsockets - 1);
+        assert_in_range(proc->core, 0, topo.ncores - 1);
+        assert_in_range(proc->llc, 0, topo.nllcs - 1);
+        first += proc->smt == 0;
+    }
+    assert_int_equal(first, topo.ncores);
+
+    /* One thread per physical core. */
+    assert_true(FANG_ISOK(fang_env_cpu_bind(eid, FANG_ENV_CPU_BIND_CORES, 0)));
+    assert_int_equal(cpu_private->nact, topo.ncores);
+    assert_false(cpu_private->pool.caller);
+
+    /* Socket should exist. */
+    assert_int_equal(fang_env_cpu_bind(eid, FANG_ENV_CPU_BIND_SOCKET,
+        topo.nsockets), -FANG_INVPCPU);
+    assert_true(FANG_ISOK(fang_env_cpu_bind(eid, FANG_ENV_CPU_BIND_SOCKET,
+        0)));
+    assert_in_range(cpu_private->nact, 1, topo.ncores);
+
+    assert_int_equal(fang_env_cpu_bind(eid, (fang_env_cpu_bind_t) 69, 0),
+        -FANG_INVBIND);
+
+    /* Back to every logical processor, unpinned. */
+    assert_true(FANG_ISOK(fang_env_cpu_bind(eid, FANG_ENV_CPU_BIND_NONE, 0)));
+    assert_int_equal(cpu_private->nact, topo.nproc);
+    assert_true(cpu_private->pool.caller);
 
     fang_env_release(eid);
 }
 
+/* Task of pool test, counts the executions of each task. */
+static void _pool_task(void *restrict arg, ptrdiff_t task,
+    FANG_UNUSED int wid)
+{
+    int *hits = (int *) arg;
+    _fang_atomic_fetch_add(hits + task, 1);
+}
+
+/* State of nested parallel loops in pool test. */
+typedef struct _pool_nest {
+    _fang_pool_t *pool;
+    _fang_thread_t main;
+    int wid;
+    int hits[8];
+    int strays;  // tasks run on the main thread or with a foreign slot
+} _pool_nest_t;
+
+/* Inner task of nested parallel loops. */
+static void _pool_inner(void *restrict arg, ptrdiff_t task, int wid) {
+    _pool_nest_t *nest = (_pool_nest_t *) arg;
+    if(_fang_thread_is_self(nest->main) || wid != nest->wid)
+        _fang_atomic_fetch_add(&nest->strays, 1);
+    _fang_atomic_fetch_add(nest->hits + task, 1);
+}
+
+/* Outer task of nested parallel loops, runs a parallel loop of it's own. */
+static void _pool_outer(void *restrict arg, ptrdiff_t task, int wid) {
+    _pool_nest_t *nest = (_pool_nest_t *) arg + task;
+    nest->wid = wid;
+    _fang_pool_for(nest->pool, 8, _pool_inner, nest);
+}
+
+/* Thread pool test. */
+static void fang_env_cpu_pool_test(void **state) {
+    int hits[1000];
+
+    /* Unpinned, the calling thread takes part. */
+    _fang_pool_t pool;
+    assert_true(FANG_ISOK(_fang_pool_create(&pool, 4, NULL,
+        _fang_default_reallocator)));
+    assert_int_equal(pool.nworkers, 3);
+
+    /* Every task should run exactly once, parallel loop after parallel
+       loop. */
+    for(int r = 0; r < 8; r++) {
+        memset(hits, 0, sizeof(hits));
+        _fang_pool_for(&pool, 1000, _pool_task, hits);
+
+        for(int i = 0; i < 1000; i++)
+            assert_int_equal(hits[i], 1);
+    }
+    _fang_pool_release(&pool);
+
+    /* Pinned, only the workers run tasks. */
+    int cpus[] = { 0, 0, 0, 0 };
+    assert_true(FANG_ISOK(_fang_pool_create(&pool, 4, cpus,
+        _fang_default_reallocator)));
+    assert_int_equal(pool.nworkers, 4);
+
+    memset(hits, 0, sizeof(hits));
+    _fang_pool_for(&pool, 3, _pool_task, hits);
+    for(int i = 0; i < 3; i++)
+        assert_int_equal(hits[i], 1);
+
+    /* Nested parallel loops run serially on the worker of the outer task,
+       never on the calling thread. */
+    _pool_nest_t nest[4];
+    memset(nest, 0, sizeof(nest));
+    for(int i = 0; i < 4; i++) {
+        nest[i].pool = &pool;
+        nest[i].main = pthread_self();
+    }
+    _fang_pool_for(&pool, 4, _pool_outer, nest);
+    for(int i = 0; i < 4; i++) {
+        assert_int_equal(nest[i].strays, 0);
+        for(int j = 0; j < 8; j++)
+            assert_int_equal(nest[i].hits[j], 1);
+    }
+    _fang_pool_release(&pool);
+}
+
+/* Operators should produce the very same result on any thread setup. */
+static void fang_env_cpu_threads_test(void **state) {
+    int eid = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    assert_true(FANG_ISOK(eid));
+
+    fang_ten_t x, y, dest;
+    assert_true(FANG_ISOK(fang_ten_create(&x, eid, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(96, 200), NULL)));
+    assert_true(FANG_ISOK(fang_ten_create(&y, eid, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(200, 300), NULL)));
+    assert_true(FANG_ISOK(fang_ten_create(&dest, eid, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(96, 300), NULL)));
+
+    static float expect[96 * 300];
+    for(int run = 0; run < 2; run++) {
+        assert_true(FANG_ISOK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1),
+            7)));
+        assert_true(FANG_ISOK(fang_ten_rand(&y, FANG_F2G(-1), FANG_F2G(1),
+            8)));
+        assert_true(FANG_ISOK(fang_ten_gemm(FANG_TEN_GEMM_NO_TRANSPOSE,
+            FANG_TEN_GEMM_NO_TRANSPOSE, FANG_F2G(0), &dest, FANG_F2G(1), &x,
+            &y)));
+
+        if(run == 0) {
+            memcpy(expect, dest.data.dense, sizeof(expect));
+
+            int cpu = 0;
+            assert_true(FANG_ISOK(fang_env_cpu_set_threads(eid, 1, &cpu)));
+        } else {
+            assert_memory_equal(expect, dest.data.dense, sizeof(expect));
+        }
+    }
+
+    fang_ten_release(&x);
+    fang_ten_release(&y);
+    fang_ten_release(&dest);
+    fang_env_release(eid);
+}
+
+/* Shared state of concurrency test. */
+typedef struct _conc_arg {
+    int shared;  // Environment shared by all threads
+    int eid;     // Environment created by the thread
+    int fails;
+} _conc_arg_t;
+
+/* Creates, uses and releases tensors in own and shared Environments. */
+static void *_conc_main(void *arg) {
+    _conc_arg_t *conc = (_conc_arg_t *) arg;
+
+    conc->eid = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    if(!FANG_ISOK(conc->eid)) {
+        conc->fails++;
+        return NULL;
+    }
+
+    for(int i = 0; i < 64; i++) {
+        fang_ten_t x, dest, shared;
+
+        if(!FANG_ISOK(fang_ten_create(&x, conc->eid, FANG_TEN_DTYPE_FLOAT32,
+            FANG_DIM(16, 16), NULL)) ||
+            !FANG_ISOK(fang_ten_create(&dest, conc->eid,
+            FANG_TEN_DTYPE_FLOAT32, FANG_DIM(16, 16), NULL)) ||
+            !FANG_ISOK(fang_ten_create(&shared, conc->shared,
+            FANG_TEN_DTYPE_FLOAT32, FANG_DIM(16, 16), NULL)))
+        {
+            conc->fails++;
+            break;
+        }
+
+        /* ones * ones of 16x16 is all 16. */
+        fang_ten_fill(&x, FANG_F2G(1));
+        fang_ten_gemm(FANG_TEN_GEMM_NO_TRANSPOSE, FANG_TEN_GEMM_NO_TRANSPOSE,
+            FANG_F2G(0), &dest, FANG_F2G(1), &x, &x);
+        if(((float *) dest.data.dense)[255] != 16)
+            conc->fails++;
+
+        fang_ten_fill(&shared, FANG_F2G(2));
+        fang_ten_sum(&shared, &shared, &shared);
+        if(((float *) shared.data.dense)[255] != 4)
+            conc->fails++;
+
+        fang_ten_release(&x);
+        fang_ten_release(&dest);
+        fang_ten_release(&shared);
+    }
+
+    return NULL;
+}
+
+/* Environments and tensors should be usable from several threads. */
+static void fang_env_concurrency_test(void **state) {
+    int shared = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    assert_true(FANG_ISOK(shared));
+
+    _fang_thread_t threads[8];
+    _conc_arg_t args[8];
+    for(int i = 0; i < 8; i++) {
+        args[i] = (_conc_arg_t) { .shared = shared, .eid = -1, .fails = 0 };
+        assert_true(FANG_ISOK(_fang_thread_create(threads + i, _conc_main,
+            args + i)));
+    }
+    for(int i = 0; i < 8; i++)
+        _fang_thread_join(threads[i]);
+
+    /* Every thread should have gotten an Environment of it's own. */
+    for(int i = 0; i < 8; i++) {
+        assert_int_equal(args[i].fails, 0);
+        assert_int_not_equal(args[i].eid, shared);
+
+        for(int j = 0; j < i; j++)
+            assert_int_not_equal(args[i].eid, args[j].eid);
+    }
+
+    /* No tensor count should be lost. */
+    fang_env_t *env;
+    assert_true(FANG_ISOK(_fang_env_retrieve(&env, shared)));
+    assert_int_equal(env->ntens, 0);
+
+    for(int i = 0; i < 8; i++)
+        assert_true(FANG_ISOK(fang_env_release(args[i].eid)));
+    assert_true(FANG_ISOK(fang_env_release(shared)));
+
+    /* Released only once. */
+    assert_int_equal(fang_env_release(shared), -FANG_NOENV);
+}
+
+/* Asynchronous Environment test. */
+static void fang_env_async_test(void **state) {
+    int eid = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    assert_true(FANG_ISOK(eid));
+
+    /* Fences of a synchronous Environment are always reached. */
+    fang_env_fence_t fence;
+    assert_true(FANG_ISOK(fang_env_fence(eid, &fence)));
+    assert_int_equal(fence, 0);
+    assert_true(FANG_ISOK(fang_env_async(eid, true)));
+
+    fang_ten_t x, y, dest, ints;
+    assert_true(FANG_ISOK(fang_ten_create(&x, eid, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(64, 64), NULL)));
+    assert_true(FANG_ISOK(fang_ten_create(&y, eid, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(64, 64), NULL)));
+    assert_true(FANG_ISOK(fang_ten_create(&dest, eid, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(64, 64), NULL)));
+    assert_true(FANG_ISOK(fang_ten_create(&ints, eid, FANG_TEN_DTYPE_INT32,
+        FANG_DIM(8), NULL)));
+
+    /* Operators run in order of submission. */
+    assert_true(FANG_ISOK(fang_ten_fill(&x, FANG_F2G(1))));
+    assert_true(FANG_ISOK(fang_ten_fill(&y, FANG_F2G(2))));
+    assert_true(FANG_ISOK(fang_ten_gemm(FANG_TEN_GEMM_NO_TRANSPOSE,
+        FANG_TEN_GEMM_NO_TRANSPOSE, FANG_F2G(0), &dest, FANG_F2G(1), &x, &y)));
+    assert_true(FANG_ISOK(fang_ten_scale(&dest, FANG_F2G(0.5))));
+    assert_true(FANG_ISOK(fang_env_fence(eid, &fence)));
+    assert_int_equal(fence, 4);
+
+    assert_true(FANG_ISOK(fang_env_wait(eid, fence)));
+    for(int i = 0; i < 64 * 64; i++)
+        assert_float_equal(((float *) dest.data.dense)[i], 64, 0);
+
+    /* Argument errors are reported right away. */
+    assert_int_equal(fang_ten_sum(&dest, &x, &ints), -FANG_INVDTYP);
+
+    /* Errors raised while executing are reported by the next wait. */
+    assert_true(FANG_ISOK(fang_ten_randn(&ints, 0, 1, 0)));
+    assert_true(FANG_ISOK(fang_ten_sum(&x, &x, &y)));
+    assert_int_equal(fang_ten_wait(&x), -FANG_UNSUPDTYP);
+    assert_float_equal(((float *) x.data.dense)[0], 3, 0);
+
+    /* Only the Environment clears them. */
+    assert_int_equal(fang_env_sync(eid), -FANG_UNSUPDTYP);
+    assert_true(FANG_ISOK(fang_env_sync(eid)));
+
+    /* Fences of an earlier stream are ahead of the current one. */
+    assert_true(FANG_ISOK(fang_env_fence(eid, &fence)));
+    assert_true(FANG_ISOK(fang_env_async(eid, false)));
+    assert_true(FANG_ISOK(fang_env_async(eid, true)));
+    assert_int_equal(fang_env_wait(eid, fence), -FANG_INVFENCE);
+
+    /* Scalars are queued as well. */
+    fang_ten_t a, b, c;
+    assert_true(FANG_ISOK(fang_ten_scalar(&a, eid, FANG_TEN_DTYPE_FLOAT32,
+        FANG_F2G(1))));
+    assert_true(FANG_ISOK(fang_ten_scalar(&b, eid, FANG_TEN_DTYPE_FLOAT32,
+        FANG_F2G(2))));
+    assert_true(FANG_ISOK(fang_ten_scalar(&c, eid, FANG_TEN_DTYPE_FLOAT32,
+        FANG_F2G(0))));
+    assert_true(FANG_ISOK(fang_ten_sum(&c, &a, &b)));
+    assert_true(FANG_ISOK(fang_ten_wait(&c)));
+    assert_float_equal(((float *) c.data.dense)[0], 3, 0);
+    fang_ten_release(&a);
+    fang_ten_release(&b);
+    fang_ten_release(&c);
+
+    /* Tensors wait for their operators before release. */
+    assert_true(FANG_ISOK(fang_ten_fill(&dest, FANG_F2G(7))));
+    fang_ten_release(&dest);
+    fang_ten_release(&ints);
+
+    /* Back to synchronous. */
+    assert_true(FANG_ISOK(fang_ten_fill(&x, FANG_F2G(5))));
+    assert_true(FANG_ISOK(fang_env_async(eid, false)));
+    assert_float_equal(((float *) x.data.dense)[4095], 5, 0);
+
+    fang_ten_release(&x);
+    fang_ten_release(&y);
+    assert_true(FANG_ISOK(fang_env_release(eid)));
+}
+
+/* Releases the Environment of `arg`, counting successes. */
+static void *_release_main(void *arg) {
+    _conc_arg_t *conc = (_conc_arg_t *) arg;
+    if(FANG_ISOK(fang_env_release(conc->eid)))
+        conc->fails++;
+    return NULL;
+}
+
+/* Concurrent releases of an asynchronous Environment. */
+static void fang_env_async_release_test(void **state) {
+    for(int round = 0; round < 16; round++) {
+        int eid = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+        assert_true(FANG_ISOK(eid));
+        assert_true(FANG_ISOK(fang_env_async(eid, true)));
+
+        /* `fails` counts successful releases here. */
+        _fang_thread_t threads[8];
+        _conc_arg_t args[8];
+        for(int i = 0; i < 8; i++) {
+            args[i] = (_conc_arg_t) { .shared = -1, .eid = eid, .fails = 0 };
+            assert_true(FANG_ISOK(_fang_thread_create(threads + i,
+                _release_main, args + i)));
+        }
+
+        /* Only one of them releases it, and the stream, once. */
+        int released = 0;
+        for(int i = 0; i < 8; i++) {
+            _fang_thread_join(threads[i]);
+            released += args[i].fails;
+        }
+        assert_int_equal(released, 1);
+    }
+}
+
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(fang_env_create_test),
         cmocka_unit_test(fang_env_release_test),
-        cmocka_unit_test(fang_env_cpu_test)
+        cmocka_unit_test(fang_env_cpu_test),
+        cmocka_unit_test(fang_env_cpu_bind_test),
+        cmocka_unit_test(fang_env_cpu_pool_test),
+        cmocka_unit_test(fang_env_cpu_threads_test),
+        cmocka_unit_test(fang_env_concurrency_test),
+        cmocka_unit_test(fang_env_async_test),
+        cmocka_unit_test(fang_env_async_release_test)
     };
 
     return cmocka_run_group_tests_name("unit/environment", tests, NULL, NULL);
@@ -0,0 +1,231 @@
+#include <fang/graph.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+/* ================ HELPER MACROS ================ */
+
+/* Check if an operation is successful or not. */
+#define GRCHK(expr)     assert_true(FANG_ISOK(expr))
+
+/* ================ HELPER MACROS END ================ */
+
+
+/* ================ SETUP AND TEARDOWN ================ */
+
+/* Setup Environment before every test. */
+static int setup(void **state) {
+    int env = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    if(!FANG_ISOK(env))
+        return 1;
+
+    *state = (void *) (uint64_t) env;
+    return 0;
+}
+
+/* Release created Environment after every test. */
+static int teardown(void **state) {
+    int env = (int) (uint64_t) *state;
+    fang_env_release(env);
+    return 0;
+}
+
+/* ================ SETUP AND TEARDOWN END ================ */
+
+
+/* ================ TESTS ================ */
+
+/* Capture and replay test. */
+static void fang_graph_replay_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* dest := (x * w) + b, bias broadcasted over rows. */
+    fang_ten_t x, w, b, dest;
+    GRCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(4, 8),
+        NULL));
+    GRCHK(fang_ten_create(&w, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(8, 3),
+        NULL));
+    GRCHK(fang_ten_create(&b, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(3),
+        NULL));
+    GRCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(4, 3),
+        NULL));
+    GRCHK(fang_ten_fill(&w, FANG_F2G(0.5)));
+    GRCHK(fang_ten_fill(&b, FANG_F2G(1)));
+
+    fang_graph_t graph;
+    GRCHK(fang_graph_begin(&graph, env));
+
+    /* Only a single graph is captured at a time, the other one is left
+       untouched. */
+    fang_graph_t other = { .nops = 69 };
+    assert_int_equal(fang_graph_begin(&other, env), -FANG_CAPTURING);
+    assert_int_equal(other.nops, 69);
+
+    GRCHK(fang_ten_gemm(FANG_TEN_GEMM_NO_TRANSPOSE, FANG_TEN_GEMM_NO_TRANSPOSE,
+        FANG_F2G(0), &dest, FANG_F2G(1), &x, &w));
+    GRCHK(fang_ten_sum(&dest, &dest, &b));
+
+    /* Beginning it again should leave the capture intact. */
+    assert_int_equal(fang_graph_begin(&graph, env), -FANG_CAPTURING);
+
+    /* Invalid operators are still rejected while capturing. */
+    assert_int_equal(fang_ten_sum(&dest, &x, &b), -FANG_NOBROAD);
+
+    GRCHK(fang_graph_end(&graph));
+    assert_int_equal(fang_graph_end(&graph), -FANG_NOCAPTURE);
+    assert_int_equal(graph.nops, 2);
+
+    /* Nothing should have been executed while capturing. */
+    float *out = (float *) dest.data.dense;
+    assert_float_equal(out[0], 0, 0);
+
+    /* Feed new inputs in place. */
+    for(int r = 1; r <= 3; r++) {
+        GRCHK(fang_ten_fill(&x, FANG_F2G(r)));
+        GRCHK(fang_graph_replay(&graph));
+
+        for(int i = 0; i < 4 * 3; i++)
+            assert_float_equal(out[i], 8 * r * 0.5 + 1, 0);
+    }
+
+    /* Replay within an asynchronous Environment. */
+    GRCHK(fang_env_async(env, true));
+    GRCHK(fang_ten_fill(&x, FANG_F2G(4)));
+    GRCHK(fang_graph_replay(&graph));
+    GRCHK(fang_ten_wait(&dest));
+    for(int i = 0; i < 4 * 3; i++)
+        assert_float_equal(out[i], 17, 0);
+    GRCHK(fang_env_async(env, false));
+
+    GRCHK(fang_graph_release(&graph));
+    assert_null(graph.head);
+
+    fang_ten_release(&x);
+    fang_ten_release(&w);
+    fang_ten_release(&b);
+    fang_ten_release(&dest);
+}
+
+/* Graphs replayed within graphs. */
+static void fang_graph_nested_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    fang_ten_t x;
+    GRCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(16),
+        NULL));
+    GRCHK(fang_ten_fill(&x, FANG_F2G(1)));
+
+    /* Doubles `x`. */
+    fang_graph_t inner, outer;
+    GRCHK(fang_graph_begin(&inner, env));
+    GRCHK(fang_ten_scale(&x, FANG_F2G(2)));
+    GRCHK(fang_graph_end(&inner));
+
+    /* Can not replay into itself. */
+    GRCHK(fang_graph_begin(&outer, env));
+    GRCHK(fang_graph_replay(&inner));
+    GRCHK(fang_graph_replay(&inner));
+    assert_int_equal(fang_graph_replay(&outer), -FANG_CAPTURING);
+    GRCHK(fang_graph_end(&outer));
+
+    GRCHK(fang_graph_replay(&outer));
+    assert_float_equal(((float *) x.data.dense)[15], 4, 0);
+
+    GRCHK(fang_graph_release(&outer));
+    GRCHK(fang_graph_release(&inner));
+    fang_ten_release(&x);
+}
+
+/* Scalars are captured and replayed like any tensor. */
+static void fang_graph_scalar_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    fang_ten_t a, b, c;
+    GRCHK(fang_ten_scalar(&a, env, FANG_TEN_DTYPE_FLOAT32, FANG_F2G(1)));
+    GRCHK(fang_ten_scalar(&b, env, FANG_TEN_DTYPE_FLOAT32, FANG_F2G(2)));
+    GRCHK(fang_ten_scalar(&c, env, FANG_TEN_DTYPE_FLOAT32, FANG_F2G(0)));
+
+    fang_graph_t graph;
+    GRCHK(fang_graph_begin(&graph, env));
+    GRCHK(fang_ten_sum(&c, &a, &b));
+    GRCHK(fang_graph_end(&graph));
+    assert_float_equal(((float *) c.data.dense)[0], 0, 0);
+
+    GRCHK(fang_graph_replay(&graph));
+    assert_float_equal(((float *) c.data.dense)[0], 3, 0);
+
+    GRCHK(fang_graph_release(&graph));
+    fang_ten_release(&a);
+    fang_ten_release(&b);
+    fang_ten_release(&c);
+}
+
+/* Memory planning test. */
+static void fang_graph_plan_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* out := ((x * x + x) ^ 2) + x, through three intermediates. */
+    fang_ten_t x, t1, t2, t3, out;
+    fang_ten_t *all[] = { &x, &t1, &t2, &t3, &out };
+    for(int i = 0; i < 5; i++) {
+        GRCHK(fang_ten_create(all[i], env, FANG_TEN_DTYPE_FLOAT32,
+            FANG_DIM(4, 16), NULL));
+    }
+
+    fang_graph_t graph;
+    GRCHK(fang_graph_begin(&graph, env));
+    GRCHK(fang_ten_mul(&t1, &x, &x));
+    GRCHK(fang_ten_sum(&t2, &t1, &x));
+    GRCHK(fang_ten_mul(&t3, &t2, &t2));
+    GRCHK(fang_ten_sum(&out, &t3, &x));
+    GRCHK(fang_graph_end(&graph));
+
+    /* `x` is read before being written. */
+    fang_ten_t *inputs[] = { &x, &t1 };
+    assert_int_equal(fang_graph_plan(&graph, inputs, 2), -FANG_NOPLAN);
+
+    /* `t1` and `t3` are never live at once. */
+    fang_ten_t *inter[] = { &t1, &t2, &t3 };
+    GRCHK(fang_graph_plan(&graph, inter, 3));
+    assert_int_equal(graph.slab_siz, 2 * 4 * 16 * sizeof(float));
+    assert_ptr_equal(t1.data.dense, t3.data.dense);
+    assert_ptr_not_equal(t1.data.dense, t2.data.dense);
+
+    /* Planned only once. */
+    assert_int_equal(fang_graph_plan(&graph, inter, 3), -FANG_NOPLAN);
+
+    for(int r = 1; r <= 3; r++) {
+        GRCHK(fang_ten_fill(&x, FANG_F2G(r)));
+        GRCHK(fang_graph_replay(&graph));
+
+        float expect = (r * r + r) * (r * r + r) + r;
+        for(int i = 0; i < 4 * 16; i++)
+            assert_float_equal(((float *) out.data.dense)[i], expect, 0);
+    }
+
+    /* Planned tensors leave their data to the graph. */
+    for(int i = 0; i < 5; i++)
+        fang_ten_release(all[i]);
+    GRCHK(fang_graph_release(&graph));
+}
+
+/* ================ TESTS END ================ */
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(fang_graph_replay_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_graph_scalar_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_graph_nested_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_graph_plan_test, setup,
+            teardown)
+    };
+
+    return cmocka_run_group_tests_name("unit/graph", tests, NULL, NULL);
+}
@@ -0,0 +1,210 @@
+#include <fang/io.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <cmocka.h>
+
+/* ================ HELPER MACROS ================ */
+
+/* Check if an operation is successful or not. */
+#define IOCHK(expr)     assert_true(FANG_ISOK(expr))
+
+/* Scratch files, created in the working directory. */
+#define _SAMPLES_PATH   "fang_io_samples.bin"
+#define _LABELS_PATH    "fang_io_labels.bin"
+#define _INVALID_PATH   "fang_io_invalid.bin"
+
+/* ================ HELPER MACROS END ================ */
+
+
+/* ================ SETUP AND TEARDOWN ================ */
+
+/* Setup Environment before every test. */
+static int setup(void **state) {
+    int env = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    if(!FANG_ISOK(env))
+        return 1;
+
+    *state = (void *) (uint64_t) env;
+    return 0;
+}
+
+/* Release created Environment and scratch files after every test. */
+static int teardown(void **state) {
+    int env = (int) (uint64_t) *state;
+    fang_env_release(env);
+
+    remove(_SAMPLES_PATH);
+    remove(_LABELS_PATH);
+    remove(_INVALID_PATH);
+    return 0;
+}
+
+/* ================ SETUP AND TEARDOWN END ================ */
+
+
+/* ================ TESTS ================ */
+
+/* Write samples of shape (3, 4) and read them back in batches. */
+static void fang_io_stream_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    float data[10][3][4];
+    for(int i = 0; i < 10 * 3 * 4; i++)
+        ((float *) data)[i] = (float) i;
+
+    /* 4 samples as a batch, then 1 single sample, then 5 more. */
+    fang_ten_t batch4, single, batch5;
+    IOCHK(fang_ten_create_from(&batch4, env, FANG_TEN_DTYPE_FLOAT32,
+        $D(4, 3, 4), FANG_TEN_DTYPE_FLOAT32, data[0]));
+    IOCHK(fang_ten_create_from(&single, env, FANG_TEN_DTYPE_FLOAT32,
+        $D(3, 4), FANG_TEN_DTYPE_FLOAT32, data[4]));
+    IOCHK(fang_ten_create_from(&batch5, env, FANG_TEN_DTYPE_FLOAT32,
+        $D(5, 3, 4), FANG_TEN_DTYPE_FLOAT32, data[5]));
+
+    fang_io_writer_t writer;
+    IOCHK(fang_io_writer_create(&writer, _SAMPLES_PATH,
+        FANG_TEN_DTYPE_FLOAT32, $D(3, 4)));
+    IOCHK(fang_io_writer_write(&writer, &batch4));
+    IOCHK(fang_io_writer_write(&writer, &single));
+    IOCHK(fang_io_writer_write(&writer, &batch5));
+
+    /* Shape and data type should match the file. */
+    fang_ten_t mismatch;
+    IOCHK(fang_ten_create(&mismatch, env, FANG_TEN_DTYPE_FLOAT32, $D(4, 3),
+        NULL));
+    assert_int_equal(fang_io_writer_write(&writer, &mismatch),
+        -FANG_IONOMATCH);
+    fang_ten_release(&mismatch);
+    IOCHK(fang_ten_create(&mismatch, env, FANG_TEN_DTYPE_FLOAT64,
+        $D(3, 4), NULL));
+    assert_int_equal(fang_io_writer_write(&writer, &mismatch),
+        -FANG_IONOMATCH);
+    fang_ten_release(&mismatch);
+
+    IOCHK(fang_io_writer_release(&writer));
+
+    fang_ten_release(&batch4);
+    fang_ten_release(&single);
+    fang_ten_release(&batch5);
+
+    fang_io_reader_t reader;
+    IOCHK(fang_io_reader_create(&reader, env, _SAMPLES_PATH, 4));
+    assert_int_equal(reader.count, 10);
+    assert_int_equal(reader.dtyp, FANG_TEN_DTYPE_FLOAT32);
+
+    /* Two passes, rewinding in between. */
+    for(int epoch = 0; epoch < 2; epoch++) {
+        int expected[] = { 4, 4, 2 };
+        int seen = 0;
+
+        for(int b = 0; b < 3; b++) {
+            fang_ten_t *ten;
+            int64_t n = fang_io_reader_next(&reader, &ten);
+            assert_int_equal(n, expected[b]);
+
+            assert_int_equal(ten->ndims, 3);
+            assert_int_equal(ten->dims[0], expected[b]);
+            assert_int_equal(ten->dims[1], 3);
+            assert_int_equal(ten->dims[2], 4);
+
+            for(int i = 0; i < n * 3 * 4; i++) {
+                assert_float_equal(((float *) ten->data.dense)[i],
+                    ((float *) data)[seen * 3 * 4 + i], 0.0);
+            }
+            seen += n;
+        }
+
+        /* End of file is sticky. */
+        fang_ten_t *ten;
+        assert_int_equal(fang_io_reader_next(&reader, &ten), 0);
+        assert_null(ten);
+        assert_int_equal(fang_io_reader_next(&reader, &ten), 0);
+
+        IOCHK(fang_io_reader_rewind(&reader));
+    }
+
+    /* Rewinding mid-way should restart from the first sample. */
+    fang_ten_t *ten;
+    assert_int_equal(fang_io_reader_next(&reader, &ten), 4);
+    IOCHK(fang_io_reader_rewind(&reader));
+    assert_int_equal(fang_io_reader_next(&reader, &ten), 4);
+    assert_float_equal(((float *) ten->data.dense)[0], 0.0f, 0.0);
+
+    IOCHK(fang_io_reader_release(&reader));
+}
+
+/* Scalar samples (e.g. labels) are read as 1-dimensional batches. */
+static void fang_io_scalar_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    int32_t labels[7] = { 3, 1, 4, 1, 5, 9, 2 };
+    fang_ten_t ten;
+    IOCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_INT32, $D(7),
+        FANG_TEN_DTYPE_INT32, labels));
+
+    fang_io_writer_t writer;
+    IOCHK(fang_io_writer_create(&writer, _LABELS_PATH, FANG_TEN_DTYPE_INT32,
+        (fang_ten_dim_t) { .dims = NULL, .ndims = 0 }));
+    IOCHK(fang_io_writer_write(&writer, &ten));
+    IOCHK(fang_io_writer_release(&writer));
+    fang_ten_release(&ten);
+
+    fang_io_reader_t reader;
+    IOCHK(fang_io_reader_create(&reader, env, _LABELS_PATH, 7));
+
+    fang_ten_t *batch;
+    assert_int_equal(fang_io_reader_next(&reader, &batch), 7);
+    assert_int_equal(batch->ndims, 1);
+    assert_memory_equal(batch->data.dense, labels, sizeof(labels));
+    assert_int_equal(fang_io_reader_next(&reader, &batch), 0);
+
+    IOCHK(fang_io_reader_release(&reader));
+}
+
+/* Invalid files should be rejected. */
+static void fang_io_invalid_test(void **state) {
+    int env = (int) (uint64_t) *state;
+    fang_io_reader_t reader;
+
+    /* Non-existent file. */
+    assert_int_equal(fang_io_reader_create(&reader, env, _INVALID_PATH, 4),
+        -FANG_NOFILE);
+
+    /* Not a Fang chunked tensor file. */
+    FILE *file = fopen(_INVALID_PATH, "wb");
+    assert_non_null(file);
+    for(int i = 0; i < 128; i++)
+        fputc('x', file);
+    fclose(file);
+    assert_int_equal(fang_io_reader_create(&reader, env, _INVALID_PATH, 4),
+        -FANG_INVFILE);
+
+    /* Zero batch size. */
+    fang_io_writer_t writer;
+    IOCHK(fang_io_writer_create(&writer, _INVALID_PATH, FANG_TEN_DTYPE_INT8,
+        $D(2)));
+    IOCHK(fang_io_writer_release(&writer));
+    assert_int_equal(fang_io_reader_create(&reader, env, _INVALID_PATH, 0),
+        -FANG_INVDIM);
+
+    /* No tensor should be leaked. */
+    fang_env_t *penv;
+    IOCHK(_fang_env_retrieve(&penv, env));
+    assert_int_equal(penv->ntens, 0);
+}
+
+/* ================ TESTS END ================ */
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(fang_io_stream_test, setup, teardown),
+        cmocka_unit_test_setup_teardown(fang_io_scalar_test, setup, teardown),
+        cmocka_unit_test_setup_teardown(fang_io_invalid_test, setup, teardown)
+    };
+
+    return cmocka_run_group_tests_name("io", tests, NULL, NULL);
+}
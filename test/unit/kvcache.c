@@ -0,0 +1,222 @@
+#include <fang/kvcache.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+/* ================ HELPER MACROS ================ */
+
+/* Check if an operation is successful or not. */
+#define OPCHK(expr)     assert_true(FANG_ISOK(expr))
+
+/* Geometry of the cache used by tests, pages not dividing token counts. */
+#define HEADS           3
+#define DK              16
+#define DV              9
+#define PAGE            5
+#define TOKENS          16
+
+/* ================ HELPER MACROS END ================ */
+
+
+/* ================ HELPERS ================ */
+
+/* Creates `ten` (HEADS, n, d) of tokens [from, from + n) of `all`
+   (HEADS, TOKENS, d). */
+static void test_slice(int env, fang_ten_t *ten, fang_ten_t *all, int d,
+    int from, int n)
+{
+    float *src = (float *) all->data.dense;
+    float *data = calloc((size_t) HEADS * n * d, sizeof(float));
+    for(int h = 0; h < HEADS; h++) {
+        for(int i = 0; i < n * d; i++)
+            data[(h * n) * d + i] = src[(h * TOKENS + from) * d + i];
+    }
+
+    OPCHK(fang_ten_create_from(ten, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(HEADS, n, d), FANG_TEN_DTYPE_FLOAT32, data));
+    free(data);
+}
+
+/* Checks attention of `t` queries over the first `len` tokens in the cache
+   against attention over the same tokens as dense tensors. */
+static void test_attention(int env, fang_kvcache_t *cache, fang_ten_t *k_all,
+    fang_ten_t *v_all, int len, int t, bool causal)
+{
+    fang_ten_t q, k, v, dest, expect;
+    OPCHK(fang_ten_create(&q, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(1, HEADS, t, DK), NULL));
+    OPCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(1, HEADS, t, DV), NULL));
+    OPCHK(fang_ten_create(&expect, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(HEADS, t, DV), NULL));
+    OPCHK(fang_ten_rand(&q, FANG_F2G(-1), FANG_F2G(1), 7 + t));
+    test_slice(env, &k, k_all, DK, 0, len);
+    test_slice(env, &v, v_all, DV, 0, len);
+
+    fang_ten_attention_t attn = { .causal = causal };
+    OPCHK(fang_kvcache_attention(&dest, &q, cache, &attn));
+    OPCHK(fang_ten_wait(&dest));
+
+    fang_ten_t q3 = q;
+    q3.dims    = q.dims + 1;
+    q3.strides = q.strides + 1;
+    q3.ndims   = 3;
+    OPCHK(fang_ten_attention(&expect, &q3, &k, &v, &attn));
+    OPCHK(fang_ten_wait(&expect));
+
+    for(int i = 0; i < HEADS * t * DV; i++)
+        assert_float_equal(((float *) dest.data.dense)[i],
+            ((float *) expect.data.dense)[i], 1e-5);
+
+    fang_ten_release(&q);
+    fang_ten_release(&k);
+    fang_ten_release(&v);
+    fang_ten_release(&dest);
+    fang_ten_release(&expect);
+}
+
+/* ================ HELPERS END ================ */
+
+
+/* ================ SETUP AND TEARDOWN ================ */
+
+/* Setup Environment before every test. */
+static int setup(void **state) {
+    int env = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    if(!FANG_ISOK(env))
+        return 1;
+
+    *state = (void *) (uint64_t) env;
+    return 0;
+}
+
+/* Release created Environment after every test. */
+static int teardown(void **state) {
+    int env = (int) (uint64_t) *state;
+    fang_env_release(env);
+    return 0;
+}
+
+/* ================ SETUP AND TEARDOWN END ================ */
+
+
+/* ================ TESTS ================ */
+
+/* Prompt followed by decoding a token at a time, over growing pages. */
+static void fang_kvcache_decode_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    fang_ten_t k_all, v_all, k, v;
+    OPCHK(fang_ten_create(&k_all, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(HEADS, TOKENS, DK), NULL));
+    OPCHK(fang_ten_create(&v_all, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(HEADS, TOKENS, DV), NULL));
+    OPCHK(fang_ten_rand(&k_all, FANG_F2G(-1), FANG_F2G(1), 3));
+    OPCHK(fang_ten_rand(&v_all, FANG_F2G(-1), FANG_F2G(1), 5));
+
+    fang_kvcache_t cache;
+    OPCHK(fang_kvcache_create(&cache, env, HEADS, DK, DV, PAGE, 7));
+    assert_int_equal(cache.npages, 2);
+
+    /* Prompt spans three pages. */
+    test_slice(env, &k, &k_all, DK, 0, 12);
+    test_slice(env, &v, &v_all, DV, 0, 12);
+    OPCHK(fang_kvcache_append(&cache, &k, &v));
+    fang_ten_release(&k);
+    fang_ten_release(&v);
+    assert_int_equal(cache.len, 12);
+    assert_int_equal(cache.npages, 3);
+    test_attention(env, &cache, &k_all, &v_all, 12, 12, true);
+    test_attention(env, &cache, &k_all, &v_all, 12, 3, false);
+
+    /* Decoding, asynchronously. */
+    OPCHK(fang_env_async(env, true));
+    for(int i = 12; i < TOKENS; i++) {
+        test_slice(env, &k, &k_all, DK, i, 1);
+        test_slice(env, &v, &v_all, DV, i, 1);
+        OPCHK(fang_kvcache_append(&cache, &k, &v));
+        fang_ten_release(&k);
+        fang_ten_release(&v);
+        test_attention(env, &cache, &k_all, &v_all, i + 1, 1, true);
+    }
+    OPCHK(fang_env_async(env, false));
+    assert_int_equal(cache.npages, 4);
+
+    /* Pages viewed in place. */
+    fang_ten_t kp, vp;
+    OPCHK(fang_kvcache_view(&cache, 2, &kp, &vp));
+    assert_int_equal(kp.dims[1], PAGE);
+    assert_int_equal(vp.dims[2], DV);
+    float *all = (float *) k_all.data.dense;
+    for(int h = 0; h < HEADS; h++) {
+        for(int i = 0; i < PAGE * DK; i++)
+            assert_float_equal(((float *) kp.data.dense)[h * PAGE * DK + i],
+                all[(h * TOKENS + 2 * PAGE) * DK + i], 0);
+    }
+    fang_ten_release(&kp);
+    fang_ten_release(&vp);
+
+    /* Pages are kept for the next sequence. */
+    OPCHK(fang_kvcache_reset(&cache));
+    assert_int_equal(cache.len, 0);
+    assert_int_equal(cache.npages, 4);
+
+    OPCHK(fang_kvcache_release(&cache));
+    fang_ten_release(&k_all);
+    fang_ten_release(&v_all);
+}
+
+/* Invalid caches and operands. */
+static void fang_kvcache_invalid_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    fang_kvcache_t cache;
+    assert_int_equal(fang_kvcache_create(&cache, env, HEADS, DK, DV, 0, 0),
+        -FANG_INVKVC);
+    OPCHK(fang_kvcache_create(&cache, env, HEADS, DK, DV, PAGE, 0));
+    assert_int_equal(cache.npages, 0);
+
+    fang_ten_t k, v, q, dest;
+    OPCHK(fang_ten_create(&k, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(2, 4, DK), NULL));
+    OPCHK(fang_ten_create(&v, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(HEADS, 4, DV), NULL));
+    OPCHK(fang_ten_create(&q, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(HEADS, 2, DK), NULL));
+    OPCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(HEADS, 2, DV), NULL));
+
+    /* Heads do not match. */
+    assert_int_equal(fang_kvcache_append(&cache, &k, &v), -FANG_INVDIM);
+
+    /* Nothing to attend to. */
+    fang_ten_attention_t attn = { .causal = true };
+    assert_int_equal(fang_kvcache_attention(&dest, &q, &cache, &attn),
+        -FANG_INVDIM);
+    assert_int_equal(fang_kvcache_view(&cache, 0, &k, &v), -FANG_INVKVC);
+
+    OPCHK(fang_kvcache_release(&cache));
+    fang_ten_release(&k);
+    fang_ten_release(&v);
+    fang_ten_release(&q);
+    fang_ten_release(&dest);
+}
+
+/* ================ TESTS END ================ */
+
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(fang_kvcache_decode_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_kvcache_invalid_test, setup,
+            teardown)
+    };
+
+    return cmocka_run_group_tests_name("unit/kvcache", tests, NULL, NULL);
+}
@@ -0,0 +1,277 @@
+#include <fang/optim.h>
+#include <fang/env.h>
+#include <fang/status.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+/* ================ HELPER MACROS ================ */
+
+/* Check if an operation is successful or not. */
+#define OPCHK(expr)     assert_true(FANG_ISOK(expr))
+
+/* Sizes of parameters used by tests; the first spans several tasks. */
+#define NPARAMS         3
+#define SIZES           { 40000, 3, 7 }
+
+/* ================ HELPER MACROS END ================ */
+
+
+/* ================ HELPERS ================ */
+
+/* Square root by Newton's method, to not to depend on math library. */
+static double test_sqrt(double x) {
+    if(x <= 0)
+        return 0;
+
+    double r = x > 1 ? x : 1;
+    for(int i = 0; i < 64; i++)
+        r = (r + x / r) / 2;
+    return r;
+}
+
+/* Reads element `i` of a single or double-precision tensor. */
+static double test_get(fang_ten_t *ten, int i) {
+    return ten->dtyp == FANG_TEN_DTYPE_FLOAT32 ?
+        ((float *) ten->data.dense)[i] : ((double *) ten->data.dense)[i];
+}
+
+/* Takes `nsteps` steps and checks parameters against a reference of the
+   update rule. */
+static void test_optim(int env, fang_optim_type_t type,
+    const fang_optim_hparam_t *hp, int nsteps)
+{
+    const int sizes[] = SIZES;
+    const fang_ten_dtype_t dtyps[] = { FANG_TEN_DTYPE_FLOAT32,
+        FANG_TEN_DTYPE_FLOAT32, FANG_TEN_DTYPE_FLOAT64 };
+
+    fang_ten_t params[NPARAMS], grads[NPARAMS];
+    fang_ten_t *pp[NPARAMS], *gp[NPARAMS];
+    double *ref_p[NPARAMS], *ref_m[NPARAMS], *ref_v[NPARAMS];
+    for(int i = 0; i < NPARAMS; i++) {
+        OPCHK(fang_ten_create(params + i, env, dtyps[i],
+            FANG_DIM(sizes[i]), NULL));
+        OPCHK(fang_ten_create(grads + i, env, dtyps[i], FANG_DIM(sizes[i]),
+            NULL));
+        OPCHK(fang_ten_rand(params + i, FANG_F2G(-1), FANG_F2G(1), 3 + i));
+        pp[i] = params + i;
+        gp[i] = grads + i;
+
+        ref_p[i] = calloc(sizes[i], sizeof(double));
+        ref_m[i] = calloc(sizes[i], sizeof(double));
+        ref_v[i] = calloc(sizes[i], sizeof(double));
+        for(int j = 0; j < sizes[i]; j++)
+            ref_p[i][j] = test_get(params + i, j);
+    }
+
+    fang_optim_t opt;
+    OPCHK(fang_optim_create(&opt, env, type, hp, pp, NPARAMS));
+
+    double b1t = 1, b2t = 1;
+    for(int s = 0; s < nsteps; s++) {
+        for(int i = 0; i < NPARAMS; i++)
+            OPCHK(fang_ten_rand(grads + i, FANG_F2G(-1), FANG_F2G(1),
+                17 * s + i));
+        OPCHK(fang_optim_step(&opt, gp));
+
+        b1t *= hp->beta1;
+        b2t *= hp->beta2;
+        for(int i = 0; i < NPARAMS; i++) {
+            for(int j = 0; j < sizes[i]; j++) {
+                double p = ref_p[i][j], g = test_get(grads + i, j);
+
+                if(type == FANG_OPTIM_SGD) {
+                    g += hp->weight_decay * p;
+                    ref_m[i][j] = hp->momentum * ref_m[i][j] + g;
+                    ref_p[i][j] = p - hp->lr * ref_m[i][j];
+                    continue;
+                }
+
+                if(type == FANG_OPTIM_ADAM)
+                    g += hp->weight_decay * p;
+                else
+                    p *= 1 - hp->lr * hp->weight_decay;
+
+                ref_m[i][j] = hp->beta1 * ref_m[i][j] + (1 - hp->beta1) * g;
+                ref_v[i][j] = hp->beta2 * ref_v[i][j] +
+                    (1 - hp->beta2) * g * g;
+                ref_p[i][j] = p - hp->lr * (ref_m[i][j] / (1 - b1t)) /
+                    (test_sqrt(ref_v[i][j] / (1 - b2t)) + hp->eps);
+            }
+        }
+    }
+    assert_int_equal(opt.nsteps, nsteps);
+
+    for(int i = 0; i < NPARAMS; i++) {
+        for(int j = 0; j < sizes[i]; j++)
+            assert_float_equal(test_get(params + i, j), ref_p[i][j], 1e-4);
+    }
+
+    OPCHK(fang_optim_release(&opt));
+    for(int i = 0; i < NPARAMS; i++) {
+        free(ref_p[i]);
+        free(ref_m[i]);
+        free(ref_v[i]);
+        fang_ten_release(params + i);
+        fang_ten_release(grads + i);
+    }
+}
+
+/* ================ HELPERS END ================ */
+
+
+/* ================ SETUP AND TEARDOWN ================ */
+
+/* Setup Environment before every test. */
+static int setup(void **state) {
+    int env = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    if(!FANG_ISOK(env))
+        return 1;
+
+    *state = (void *) (uint64_t) env;
+    return 0;
+}
+
+/* Release created Environment after every test. */
+static int teardown(void **state) {
+    int env = (int) (uint64_t) *state;
+    fang_env_release(env);
+    return 0;
+}
+
+/* ================ SETUP AND TEARDOWN END ================ */
+
+
+/* ================ TESTS ================ */
+
+/* Plain and momentum SGD. */
+static void fang_optim_sgd_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    test_optim(env, FANG_OPTIM_SGD, &(fang_optim_hparam_t) {
+        .lr = 0.1, .weight_decay = 0.01 }, 3);
+    test_optim(env, FANG_OPTIM_SGD, &(fang_optim_hparam_t) {
+        .lr = 0.1, .momentum = 0.9 }, 3);
+}
+
+/* Adam and AdamW, with bias correction over several steps. */
+static void fang_optim_adam_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    fang_optim_hparam_t hp = {
+        .lr = 0.01, .beta1 = 0.9, .beta2 = 0.999, .eps = 1e-8,
+        .weight_decay = 0.1
+    };
+    test_optim(env, FANG_OPTIM_ADAM, &hp, 4);
+    test_optim(env, FANG_OPTIM_ADAMW, &hp, 4);
+}
+
+/* Gradients left on parameters, asynchronously, and invalid arguments. */
+static void fang_optim_grad_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    fang_ten_t w, b, gw;
+    OPCHK(fang_ten_create(&w, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2, 2),
+        (fang_float_t []) { 1, 2, 3, 4 }));
+    OPCHK(fang_ten_create(&b, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2),
+        (fang_float_t []) { 5, 6 }));
+    OPCHK(fang_ten_create(&gw, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2, 2),
+        (fang_float_t []) { 10, 20, 30, 40 }));
+
+    fang_optim_t opt;
+    fang_optim_hparam_t hp = { .lr = 0.1 };
+    assert_int_equal(fang_optim_create(&opt, env, FANG_OPTIM_ADAM, &hp,
+        (fang_ten_t *[]) { &w, &b }, 2), -FANG_INVOPTIM);
+    OPCHK(fang_optim_create(&opt, env, FANG_OPTIM_SGD, &hp,
+        (fang_ten_t *[]) { &w, &b }, 2));
+    assert_null(opt.m);
+
+    /* `b` has no gradient, hence is left as is. */
+    w.grad = &gw;
+    OPCHK(fang_env_async(env, true));
+    OPCHK(fang_optim_step(&opt, NULL));
+    OPCHK(fang_optim_step(&opt, NULL));
+    OPCHK(fang_ten_wait(&w));
+    assert_int_equal(opt.nsteps, 2);
+
+    float *wd = (float *) w.data.dense, *bd = (float *) b.data.dense;
+    for(int i = 0; i < 4; i++)
+        assert_float_equal(wd[i], (i + 1) - 2 * 0.1 * 10 * (i + 1), 1e-5);
+    assert_float_equal(bd[0], 5, 0);
+    assert_float_equal(bd[1], 6, 0);
+
+    /* Gradient has to match it's parameter. */
+    b.grad = &gw;
+    assert_int_equal(fang_optim_step(&opt, NULL), -FANG_INVDIM);
+    OPCHK(fang_env_async(env, false));
+
+    w.grad = NULL;
+    b.grad = NULL;
+    OPCHK(fang_optim_release(&opt));
+    fang_ten_release(&w);
+    fang_ten_release(&b);
+    fang_ten_release(&gw);
+}
+
+/* Gradients are resolved on step, not when the step runs. */
+static void fang_optim_async_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    fang_ten_t w, gw, big;
+    OPCHK(fang_ten_create(&w, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2),
+        (fang_float_t []) { 1, 2 }));
+    OPCHK(fang_ten_create(&gw, env, FANG_TEN_DTYPE_FLOAT32, FANG_DIM(2),
+        (fang_float_t []) { 10, 20 }));
+    OPCHK(fang_ten_create(&big, env, FANG_TEN_DTYPE_FLOAT32,
+        FANG_DIM(1 << 22), NULL));
+
+    fang_optim_t opt;
+    fang_optim_hparam_t hp = { .lr = 0.1 };
+    OPCHK(fang_optim_create(&opt, env, FANG_OPTIM_SGD, &hp,
+        (fang_ten_t *[]) { &w }, 1));
+
+    /* Steps are kept queued behind a long operator, while gradients are
+       detached and their array reused. */
+    OPCHK(fang_env_async(env, true));
+    OPCHK(fang_ten_rand(&big, FANG_F2G(-1), FANG_F2G(1), 7));
+    w.grad = &gw;
+    OPCHK(fang_optim_step(&opt, NULL));
+    w.grad = NULL;
+
+    fang_ten_t *gp[] = { &gw };
+    OPCHK(fang_optim_step(&opt, gp));
+    gp[0] = NULL;
+
+    OPCHK(fang_ten_wait(&w));
+    assert_int_equal(opt.nsteps, 2);
+
+    float *wd = (float *) w.data.dense;
+    assert_float_equal(wd[0], 1 - 2 * 0.1 * 10, 1e-5);
+    assert_float_equal(wd[1], 2 - 2 * 0.1 * 20, 1e-5);
+    OPCHK(fang_env_async(env, false));
+
+    OPCHK(fang_optim_release(&opt));
+    fang_ten_release(&w);
+    fang_ten_release(&gw);
+    fang_ten_release(&big);
+}
+
+/* ================ TESTS END ================ */
+
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(fang_optim_sgd_test, setup, teardown),
+        cmocka_unit_test_setup_teardown(fang_optim_adam_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_optim_grad_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_optim_async_test, setup,
+            teardown)
+    };
+
+    return cmocka_run_group_tests_name("unit/optim", tests, NULL, NULL);
+}
@@ -1,10 +1,14 @@
 #include <fang/env.h>
 #include <fang/status.h>
 #include <env/cpu/float.h>
+#include <tune.h>
 #include <stdarg.h>
 #include <setjmp.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <cmocka.h>
 
 
@@ -500,6 +504,418 @@ static void fang_ten_create_test(void **state) {
     fang_ten_release(&ten);
 }
 
+/* Tensor creation from native data type test. */
+static void fang_ten_create_from_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* Odd element count to exercise the SIMD remainders. */
+    enum { _SIZ = 37 };
+    float data_f32[_SIZ];
+    double data_f64[_SIZ];
+    int32_t data_i32[_SIZ];
+    _fang_float16_t data_f16[_SIZ];
+    for(int i = 0; i < _SIZ; i++) {
+        data_f32[i] = (float) (i - 18) * 1.375f;
+        data_f64[i] = (double) (i - 18) * 1.375;
+        data_i32[i] = (i - 18) * 1000;
+        data_f16[i] = _FANG_S2H(data_f32[i]);
+    }
+
+    fang_ten_t ten;
+
+    /* Same data type should be copied as is. */
+    TENCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_FLOAT32, $D(_SIZ),
+        FANG_TEN_DTYPE_FLOAT32, data_f32));
+    assert_int_equal(memcmp(ten.data.dense, data_f32, sizeof(data_f32)), 0);
+    fang_ten_release(&ten);
+
+    /* float32 -> float16 should match software conversion. */
+    TENCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_FLOAT16, $D(_SIZ),
+        FANG_TEN_DTYPE_FLOAT32, data_f32));
+    for(int i = 0; i < _SIZ; i++) {
+        assert_int_equal(((_fang_float16_t *) ten.data.dense)[i],
+            _FANG_S2H(data_f32[i]));
+    }
+    fang_ten_release(&ten);
+
+    /* Overflow should be infinite, in vectorized body and scalar tail
+       alike; values short of 65536 truncate to 65504. */
+    float big[_SIZ];
+    memcpy(big, data_f32, sizeof(big));
+    big[3]  = 1e5f;
+    big[4]  = -70000.0f;
+    big[5]  = 65519.0f;
+    big[34] = 65536.0f;
+    big[35] = -1e6f;
+    big[36] = 65519.0f;
+    TENCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_FLOAT16, $D(_SIZ),
+        FANG_TEN_DTYPE_FLOAT32, big));
+    _fang_float16_t *h = (_fang_float16_t *) ten.data.dense;
+    for(int i = 0; i < _SIZ; i++)
+        assert_int_equal(h[i], _FANG_S2H(big[i]));
+    assert_int_equal(h[3], 0x7C00);
+    assert_int_equal(h[4], 0xFC00);
+    assert_int_equal(h[5], 0x7BFF);
+    assert_int_equal(h[34], 0x7C00);
+    assert_int_equal(h[35], 0xFC00);
+    assert_int_equal(h[36], 0x7BFF);
+    fang_ten_release(&ten);
+
+    /* float16 -> float32. */
+    TENCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_FLOAT32, $D(_SIZ),
+        FANG_TEN_DTYPE_FLOAT16, data_f16));
+    for(int i = 0; i < _SIZ; i++)
+        assert_float_equal(((float *) ten.data.dense)[i], data_f32[i], 1e-6);
+    fang_ten_release(&ten);
+
+    /* float64 -> bfloat16 should match software conversion. */
+    TENCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_BFLOAT16, $D(_SIZ),
+        FANG_TEN_DTYPE_FLOAT64, data_f64));
+    for(int i = 0; i < _SIZ; i++) {
+        assert_int_equal(((_fang_bfloat16_t *) ten.data.dense)[i],
+            _FANG_S2BH((float) data_f64[i]));
+    }
+    fang_ten_release(&ten);
+
+    /* int32 -> int16 narrows. */
+    TENCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_INT16, $D(_SIZ),
+        FANG_TEN_DTYPE_INT32, data_i32));
+    for(int i = 0; i < _SIZ; i++) {
+        assert_int_equal(((int16_t *) ten.data.dense)[i],
+            (int16_t) data_i32[i]);
+    }
+    fang_ten_release(&ten);
+
+    /* int32 -> float64 converts the value. */
+    TENCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_FLOAT64, $D(_SIZ),
+        FANG_TEN_DTYPE_INT32, data_i32));
+    for(int i = 0; i < _SIZ; i++) {
+        assert_float_equal(((double *) ten.data.dense)[i],
+            (double) data_i32[i], 1e-12);
+    }
+    fang_ten_release(&ten);
+
+    /* float64 -> int64/uint64 saturates out of range values, NaN is zero. */
+    double edge[] = { NAN, 1e30, -1e30, -1.0 };
+    TENCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_INT64, $D(4),
+        FANG_TEN_DTYPE_FLOAT64, edge));
+    assert_true(((int64_t *) ten.data.dense)[0] == 0);
+    assert_true(((int64_t *) ten.data.dense)[1] == INT64_MAX);
+    assert_true(((int64_t *) ten.data.dense)[2] == INT64_MIN);
+    assert_true(((int64_t *) ten.data.dense)[3] == -1);
+    fang_ten_release(&ten);
+    TENCHK(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_UINT64, $D(4),
+        FANG_TEN_DTYPE_FLOAT64, edge));
+    assert_true(((uint64_t *) ten.data.dense)[0] == 0);
+    assert_true(((uint64_t *) ten.data.dense)[1] == UINT64_MAX);
+    assert_true(((uint64_t *) ten.data.dense)[3] == UINT64_MAX);
+    fang_ten_release(&ten);
+
+    /* Invalid input data type. */
+    assert_int_equal(fang_ten_create_from(&ten, env, FANG_TEN_DTYPE_FLOAT32,
+        $D(_SIZ), FANG_TEN_DTYPE_INVALID, data_f32), -FANG_INVDTYP);
+}
+
+/* Counts deleter calls in `fang_ten_adopt_test`. */
+static int _deleted;
+
+static void _count_deleter(void *data) {
+    (void) data;
+    _deleted++;
+}
+
+/* Tensor data adoption test. */
+static void fang_ten_adopt_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    static float data[64] FANG_ALIGNAS(FANG_MEMALIGN);
+    for(int i = 0; i < 64; i++)
+        data[i] = (float) i;
+
+    /* Data should be used in place. */
+    fang_ten_t ten;
+    _deleted = 0;
+    TENCHK(fang_ten_adopt(&ten, env, FANG_TEN_DTYPE_FLOAT32, $D(8, 8), data,
+        _count_deleter));
+    assert_ptr_equal(ten.data.dense, data);
+
+    /* Operators should work on adopted data. */
+    TENCHK(fang_ten_scale(&ten, FANG_F2G(2.0)));
+    for(int i = 0; i < 64; i++)
+        assert_float_equal(data[i], 2.0f * i, 1e-6);
+
+    /* Deleter should be called exactly once on release. */
+    TENCHK(fang_ten_release(&ten));
+    assert_int_equal(_deleted, 1);
+
+    /* Borrowed data should never be released. */
+    float borrowed[16] FANG_ALIGNAS(FANG_MEMALIGN) = { 0 };
+    TENCHK(fang_ten_adopt(&ten, env, FANG_TEN_DTYPE_FLOAT32, $D(16), borrowed,
+        NULL));
+    TENCHK(fang_ten_fill(&ten, FANG_F2G(3.0)));
+    TENCHK(fang_ten_release(&ten));
+    assert_float_equal(borrowed[15], 3.0f, 1e-6);
+
+    /* Misaligned data is not allowed. */
+    assert_int_equal(fang_ten_adopt(&ten, env, FANG_TEN_DTYPE_FLOAT32, $D(15),
+        borrowed + 1, NULL), -FANG_MISALIGN);
+}
+
+/* Prints a tensor to a temporary file and reads it back. */
+static void _fprint_to_str(fang_ten_t *ten, const char *name, char *str,
+    size_t siz)
+{
+    FILE *file = tmpfile();
+    assert_non_null(file);
+
+    TENCHK(fang_ten_fprint(ten, name, 0, file));
+
+    size_t len = ftell(file);
+    assert_true(len < siz);
+
+    rewind(file);
+    assert_int_equal(fread(str, 1, len, file), len);
+    str[len] = '\0';
+
+    fclose(file);
+}
+
+/* Tensor print test. */
+static void fang_ten_fprint_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    char str[512];
+    fang_ten_t ten;
+
+    /* Columns are aligned to the widest element. */
+    TENCHK(fang_ten_create(&ten, env, FANG_TEN_DTYPE_INT32, $D(2, 3),
+        (fang_int_t []) { 1, -22, 3, 4, 5, 600 }));
+    _fprint_to_str(&ten, "x", str, sizeof(str));
+    assert_string_equal(str,
+        "[x] = \n"
+        "[[   1 -22   3 ]\n"
+        " [   4   5 600 ]]\n");
+    fang_ten_release(&ten);
+
+    /* Fixed-point floats. */
+    TENCHK(fang_ten_create(&ten, env, FANG_TEN_DTYPE_FLOAT32, $D(3),
+        (fang_float_t []) { 1.5, -0.25, 10.0626 }));
+    _fprint_to_str(&ten, "y", str, sizeof(str));
+    assert_string_equal(str, "[y] = [  1.500 -0.250 10.063 ]\n");
+    fang_ten_release(&ten);
+
+    /* Large tensors are summarized. */
+    TENCHK(fang_ten_create(&ten, env, FANG_TEN_DTYPE_UINT16,
+        $D(FANG_PRINT_THRESHOLD + 1), NULL));
+    TENCHK(fang_ten_fill(&ten, FANG_U2G(42)));
+    _fprint_to_str(&ten, "z", str, sizeof(str));
+    assert_string_equal(str, "[z] = [ 42 42 42 ... 42 42 42 ]\n");
+    fang_ten_release(&ten);
+}
+
+/* Tensor randomizer test. */
+static void fang_ten_rand_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* Spans multiple generation chunks with a partial tail. */
+    enum { _SIZ = 3 * FANG_RAND_CHUNK + 77 };
+    fang_ten_t x, y;
+
+    /* Integers stay within inclusive range and hit every value. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_INT8, $D(_SIZ), NULL));
+    TENCHK(fang_ten_rand(&x, FANG_I2G(-3), FANG_I2G(3), 42));
+    int hits[7] = { 0 };
+    for(int i = 0; i < _SIZ; i++) {
+        int8_t v = ((int8_t *) x.data.dense)[i];
+        assert_in_range(v + 3, 0, 6);
+        hits[v + 3]++;
+    }
+    for(int i = 0; i < 7; i++)
+        assert_true(hits[i] > _SIZ / 7 * 9 / 10);
+    fang_ten_release(&x);
+
+    /* Floats stay within range; same seed yields same tensor. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(_SIZ), NULL));
+    TENCHK(fang_ten_create(&y, env, FANG_TEN_DTYPE_FLOAT32, $D(_SIZ), NULL));
+    TENCHK(fang_ten_rand(&x, FANG_F2G(-2.0), FANG_F2G(6.0), 7));
+    TENCHK(fang_ten_rand(&y, FANG_F2G(-2.0), FANG_F2G(6.0), 7));
+    double mean = 0.0;
+    for(int i = 0; i < _SIZ; i++) {
+        float v = ((float *) x.data.dense)[i];
+        assert_true(v >= -2.0f && v <= 6.0f);
+        mean += v;
+    }
+    assert_float_equal(mean / _SIZ, 2.0, 0.1);
+    assert_memory_equal(x.data.dense, y.data.dense, _SIZ * sizeof(float));
+
+    /* Different seed, different tensor. */
+    TENCHK(fang_ten_rand(&y, FANG_F2G(-2.0), FANG_F2G(6.0), 8));
+    assert_true(memcmp(x.data.dense, y.data.dense, _SIZ * sizeof(float)));
+    fang_ten_release(&x);
+    fang_ten_release(&y);
+
+    /* Narrow floats are generated in single-precision and narrowed. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_BFLOAT16, $D(_SIZ), NULL));
+    TENCHK(fang_ten_rand(&x, FANG_F2G(0.0), FANG_F2G(1.0), 7));
+    for(int i = 0; i < _SIZ; i++) {
+        float v = _FANG_BH2S(((_fang_bfloat16_t *) x.data.dense)[i]);
+        assert_true(v >= 0.0f && v <= 1.0f);
+    }
+    fang_ten_release(&x);
+}
+
+/* Normal and truncated normal randomizer test. */
+static void fang_ten_randn_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    enum { _SIZ = 3 * FANG_RAND_CHUNK + 77 };
+    fang_ten_t x;
+
+    /* Sample mean and variance match. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(_SIZ), NULL));
+    TENCHK(fang_ten_randn(&x, 1.0, 2.0, 3));
+    double sum = 0.0, sq = 0.0;
+    for(int i = 0; i < _SIZ; i++) {
+        float v = ((float *) x.data.dense)[i];
+        sum += v;
+        sq  += v * v;
+    }
+    double mean = sum / _SIZ;
+    assert_float_equal(mean, 1.0, 0.1);
+    assert_float_equal(sq / _SIZ - mean * mean, 4.0, 0.2);
+
+    /* Wide interval (rejection) stays within bounds. */
+    TENCHK(fang_ten_trunc_randn(&x, 0.0, 1.0, -2.0, 2.0, 3));
+    sum = 0.0;
+    for(int i = 0; i < _SIZ; i++) {
+        float v = ((float *) x.data.dense)[i];
+        assert_true(v >= -2.0f && v <= 2.0f);
+        sum += v;
+    }
+    assert_float_equal(sum / _SIZ, 0.0, 0.05);
+
+    /* Far tail (inverse CDF); mean of N(0, 1) truncated to [4, inf) is about
+       4.2256. */
+    TENCHK(fang_ten_trunc_randn(&x, 0.0, 1.0, 4.0, 1e30, 5));
+    sum = 0.0;
+    for(int i = 0; i < _SIZ; i++) {
+        float v = ((float *) x.data.dense)[i];
+        assert_true(v >= 4.0f);
+        sum += v;
+    }
+    assert_float_equal(sum / _SIZ, 4.2256, 0.02);
+    fang_ten_release(&x);
+
+    /* Double precision, lower tail. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT64, $D(_SIZ), NULL));
+    TENCHK(fang_ten_trunc_randn(&x, 10.0, 2.0, -1e30, 2.0, 5));
+    sum = 0.0;
+    for(int i = 0; i < _SIZ; i++) {
+        double v = ((double *) x.data.dense)[i];
+        assert_true(v <= 2.0);
+        sum += v;
+    }
+    assert_float_equal(sum / _SIZ, 10.0 - 2.0 * 4.2256, 0.04);
+
+    /* Just short of where CDF underflows, values stay finite and bounded. */
+    TENCHK(fang_ten_trunc_randn(&x, 0.0, 1.0, 36.5, 37.5, 7));
+    for(int i = 0; i < _SIZ; i++) {
+        double v = ((double *) x.data.dense)[i];
+        assert_true(v >= 36.5 && v <= 37.5);
+    }
+    fang_ten_release(&x);
+
+    /* Integers and invalid parameters are rejected. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_INT32, $D(4), NULL));
+    assert_int_equal(fang_ten_randn(&x, 0.0, 1.0, 1), -FANG_UNSUPDTYP);
+    assert_int_equal(fang_ten_randn(&x, 0.0, 0.0, 1), -FANG_INVDIST);
+    assert_int_equal(fang_ten_trunc_randn(&x, 0.0, 1.0, 1.0, -1.0, 1),
+        -FANG_INVDIST);
+    assert_int_equal(fang_ten_trunc_randn(&x, 0.0, 1.0, 40.0, 41.0, 1),
+        -FANG_INVDIST);
+    assert_int_equal(fang_ten_trunc_randn(&x, 5.0, 0.5, -1e30, -15.0, 1),
+        -FANG_INVDIST);
+    fang_ten_release(&x);
+}
+
+/* Bernoulli mask test. */
+static void fang_ten_bernoulli_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    enum { _SIZ = 3 * FANG_RAND_CHUNK + 77 };
+    fang_ten_t x;
+
+    /* Inverted dropout mask with keep probability of 0.8. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(_SIZ), NULL));
+    TENCHK(fang_ten_bernoulli(&x, 0.8, FANG_F2G(1.25), 11));
+    int kept = 0;
+    for(int i = 0; i < _SIZ; i++) {
+        float v = ((float *) x.data.dense)[i];
+        assert_true(v == 0.0f || v == 1.25f);
+        kept += v != 0.0f;
+    }
+    assert_float_equal((double) kept / _SIZ, 0.8, 0.02);
+
+    /* Edge probabilities. */
+    TENCHK(fang_ten_bernoulli(&x, 1.0, FANG_F2G(1.0), 11));
+    for(int i = 0; i < _SIZ; i++)
+        assert_float_equal(((float *) x.data.dense)[i], 1.0f, 0.0);
+    TENCHK(fang_ten_bernoulli(&x, 0.0, FANG_F2G(1.0), 11));
+    for(int i = 0; i < _SIZ; i++)
+        assert_float_equal(((float *) x.data.dense)[i], 0.0f, 0.0);
+    assert_int_equal(fang_ten_bernoulli(&x, 1.5, FANG_F2G(1.0), 11),
+        -FANG_INVDIST);
+    fang_ten_release(&x);
+
+    /* Integer mask. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_UINT8, $D(_SIZ), NULL));
+    TENCHK(fang_ten_bernoulli(&x, 0.5, FANG_I2G(1), 11));
+    kept = 0;
+    for(int i = 0; i < _SIZ; i++) {
+        uint8_t v = ((uint8_t *) x.data.dense)[i];
+        assert_in_range(v, 0, 1);
+        kept += v;
+    }
+    assert_float_equal((double) kept / _SIZ, 0.5, 0.02);
+    fang_ten_release(&x);
+}
+
+/* Xavier and Kaiming initialization test. */
+static void fang_ten_init_test(void **state) {
+    int env = (int) (uint64_t) *state;
+    fang_ten_t w;
+
+    /* Convolution weight (out, in, kh, kw); fan_in = 288, fan_out = 576. */
+    TENCHK(fang_ten_create(&w, env, FANG_TEN_DTYPE_FLOAT32, $D(64, 32, 3, 3),
+        NULL));
+    uint32_t siz = w.strides[0] * w.dims[0];
+
+    /* sqrt(6 / (288 + 576)) */
+    double bound = 1.0 / 12.0;
+    TENCHK(fang_ten_xavier(&w, FANG_TEN_INIT_UNIFORM, 1.0, 1));
+    for(uint32_t i = 0; i < siz; i++) {
+        float v = ((float *) w.data.dense)[i];
+        assert_true(v >= -bound && v <= bound);
+    }
+
+    /* Kaiming normal for ReLU: variance = 2 / fan_in. */
+    TENCHK(fang_ten_kaiming(&w, FANG_TEN_INIT_NORMAL, FANG_TEN_INIT_FAN_IN,
+        1.4142135623730951, 1));
+    double sq = 0.0;
+    for(uint32_t i = 0; i < siz; i++) {
+        float v = ((float *) w.data.dense)[i];
+        sq += v * v;
+    }
+    assert_float_equal(sq / siz, 2.0 / 288, 0.0005);
+    fang_ten_release(&w);
+
+    /* Scalars have no fans. */
+    TENCHK(fang_ten_scalar(&w, env, FANG_TEN_DTYPE_FLOAT32, FANG_F2G(0.0)));
+    assert_int_equal(fang_ten_xavier(&w, FANG_TEN_INIT_NORMAL, 1.0, 1),
+        -FANG_INVDIM);
+    fang_ten_release(&w);
+}
+
 /* Tensor scale test. */
 static void fang_ten_scale_test(void **state) {
     int env = (int) (uint64_t) *state;
@@ -1593,11 +2009,761 @@ static void fang_ten_gemm_test(void **state) {
     fang_ten_release(&res_4x4_float32);
 }
 
+/* Convolves random images with random weights and checks against direct
+   computation. */
+static void _conv2d_check(int env, fang_ten_conv_layout_t layout, int n,
+    int c, int h, int w, int k, int kh, int kw, fang_ten_conv2d_t conv)
+{
+    conv.layout = layout;
+    int nhwc = layout == FANG_TEN_CONV_NHWC;
+    int sh = conv.stride[0] ? conv.stride[0] : 1;
+    int sw = conv.stride[1] ? conv.stride[1] : 1;
+    int dh = conv.dilation[0] ? conv.dilation[0] : 1;
+    int dw = conv.dilation[1] ? conv.dilation[1] : 1;
+    int ph = conv.padding[0], pw = conv.padding[1];
+    int groups = conv.groups ? conv.groups : 1, cg = c / groups;
+    int kg = k / groups;
+    int oh = (h + 2 * ph - dh * (kh - 1) - 1) / sh + 1;
+    int ow = (w + 2 * pw - dw * (kw - 1) - 1) / sw + 1;
+
+    fang_ten_t x, wt, dest;
+    if(nhwc) {
+        TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32,
+            $D(n, h, w, c), NULL));
+        TENCHK(fang_ten_create(&wt, env, FANG_TEN_DTYPE_FLOAT32,
+            $D(k, kh, kw, cg), NULL));
+        TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32,
+            $D(n, oh, ow, k), NULL));
+    } else {
+        TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32,
+            $D(n, c, h, w), NULL));
+        TENCHK(fang_ten_create(&wt, env, FANG_TEN_DTYPE_FLOAT32,
+            $D(k, cg, kh, kw), NULL));
+        TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32,
+            $D(n, k, oh, ow), NULL));
+    }
+    TENCHK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1), 13));
+    TENCHK(fang_ten_rand(&wt, FANG_F2G(-1), FANG_F2G(1), 17));
+
+    /* Output is overwritten. */
+    TENCHK(fang_ten_fill(&dest, FANG_F2G(1e9)));
+    TENCHK(fang_ten_conv2d(&dest, &x, &wt, &conv));
+
+    float *xd = x.data.dense, *wd = wt.data.dense, *od = dest.data.dense;
+    for(int e = 0; e < n * k * oh * ow; e++) {
+        /* Output element `e` in (n, k, oh, ow) order. */
+        int j = e % ow, i = e / ow % oh, o = e / ow / oh % k;
+        int b = e / ow / oh / k;
+
+        float expect = 0;
+        for(int r = 0; r < cg * kh * kw; r++) {
+            int q = r / (kh * kw), u = r / kw % kh, v = r % kw;
+            int ih = i * sh - ph + u * dh, iw = j * sw - pw + v * dw;
+            if(ih < 0 || ih >= h || iw < 0 || iw >= w)
+                continue;
+
+            int ci = o / kg * cg + q;
+            expect += nhwc ?
+                xd[((b * h + ih) * w + iw) * c + ci] *
+                wd[((o * kh + u) * kw + v) * cg + q] :
+                xd[((b * c + ci) * h + ih) * w + iw] *
+                wd[((o * cg + q) * kh + u) * kw + v];
+        }
+
+        float got = nhwc ? od[((b * oh + i) * ow + j) * k + o] :
+            od[((b * k + o) * oh + i) * ow + j];
+        assert_float_equal(got, expect, 1e-3);
+    }
+
+    fang_ten_release(&x);
+    fang_ten_release(&wt);
+    fang_ten_release(&dest);
+}
+
+/* 2D convolution test. */
+static void fang_ten_conv2d_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    for(int l = FANG_TEN_CONV_NCHW; l <= FANG_TEN_CONV_NHWC; l++) {
+        /* Grouped, strided, padded and dilated. */
+        _conv2d_check(env, l, 2, 4, 9, 11, 6, 3, 3, (fang_ten_conv2d_t) {
+            .stride = { 2, 1 }, .padding = { 1, 2 }, .dilation = { 1, 2 },
+            .groups = 2 });
+
+        /* Spans several KC blocks and pixel blocks. */
+        _conv2d_check(env, l, 1, 32, 24, 24, 20, 3, 3, (fang_ten_conv2d_t) {
+            .stride = { 2, 2 }, .padding = { 1, 1 } });
+
+        /* Winograd, tiles across images spanning several blocks and cut at
+           the edges. */
+        _conv2d_check(env, l, 3, 16, 34, 34, 24, 3, 3, (fang_ten_conv2d_t) {
+            .padding = { 1, 1 } });
+        _conv2d_check(env, l, 1, 16, 9, 7, 17, 3, 3, (fang_ten_conv2d_t) { 0 });
+
+        /* Pointwise. */
+        _conv2d_check(env, l, 2, 8, 5, 5, 7, 1, 1, (fang_ten_conv2d_t) { 0 });
+
+        /* Depthwise, and with channel multiplier of 2. */
+        _conv2d_check(env, l, 2, 5, 10, 9, 5, 3, 3, (fang_ten_conv2d_t) {
+            .padding = { 1, 1 }, .groups = 5 });
+        _conv2d_check(env, l, 1, 3, 11, 12, 6, 5, 3, (fang_ten_conv2d_t) {
+            .stride = { 2, 3 }, .padding = { 2, 0 }, .dilation = { 1, 2 },
+            .groups = 3 });
+    }
+
+    /* Invalid parameters. */
+    fang_ten_t x, wt, dest;
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(1, 4, 5, 5),
+        NULL));
+    TENCHK(fang_ten_create(&wt, env, FANG_TEN_DTYPE_FLOAT32, $D(6, 2, 3, 3),
+        NULL));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, $D(1, 6, 3, 3),
+        NULL));
+    assert_int_equal(fang_ten_conv2d(&dest, &x, &wt, &(fang_ten_conv2d_t) {
+        .groups = 3 }), -FANG_INVCONV);
+    assert_int_equal(fang_ten_conv2d(&dest, &x, &wt, &(fang_ten_conv2d_t) {
+        .groups = 2, .padding = { 1, 1 } }), -FANG_DESTINVDIM);
+    TENCHK(fang_ten_conv2d(&dest, &x, &wt, &(fang_ten_conv2d_t) {
+        .groups = 2 }));
+
+    fang_ten_release(&x);
+    fang_ten_release(&wt);
+    fang_ten_release(&dest);
+}
+
+/* Checks 2D pooling of random images against a naive reference. */
+static void _pool2d_check(int env, int n, int c, int h, int w,
+    fang_ten_pool2d_t pool)
+{
+    int nhwc = pool.layout == FANG_TEN_CONV_NHWC;
+    int kh = pool.window[0], kw = pool.window[1];
+    int sh = pool.stride[0] ? (int) pool.stride[0] : kh;
+    int sw = pool.stride[1] ? (int) pool.stride[1] : kw;
+    int ph = pool.padding[0], pw = pool.padding[1];
+    int oh = (h + 2 * ph - kh) / sh + 1, ow = (w + 2 * pw - kw) / sw + 1;
+
+    fang_ten_t x, dest;
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32,
+        nhwc ? $D(n, h, w, c) : $D(n, c, h, w), NULL));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32,
+        nhwc ? $D(n, oh, ow, c) : $D(n, c, oh, ow), NULL));
+    TENCHK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1), 23));
+
+    /* Output is overwritten. */
+    TENCHK(fang_ten_fill(&dest, FANG_F2G(1e9)));
+    TENCHK(fang_ten_pool2d(&dest, &x, &pool));
+
+    float *xd = x.data.dense, *od = dest.data.dense;
+    for(int e = 0; e < n * c * oh * ow; e++) {
+        /* Output element `e` in (n, c, oh, ow) order. */
+        int j = e % ow, i = e / ow % oh, ci = e / ow / oh % c;
+        int b = e / ow / oh / c;
+
+        float expect = pool.type == FANG_TEN_POOL_MAX ? -2 : 0;
+        int count = 0;
+        for(int u = 0; u < kh; u++) {
+            for(int v = 0; v < kw; v++) {
+                int ih = i * sh - ph + u, iw = j * sw - pw + v;
+                if(ih < 0 || ih >= h || iw < 0 || iw >= w)
+                    continue;
+
+                float in = nhwc ? xd[((b * h + ih) * w + iw) * c + ci] :
+                    xd[((b * c + ci) * h + ih) * w + iw];
+                if(pool.type == FANG_TEN_POOL_AVG)
+                    expect += in;
+                else if(in > expect)
+                    expect = in;
+                count++;
+            }
+        }
+        if(pool.type == FANG_TEN_POOL_AVG)
+            expect /= count;
+
+        float got = nhwc ? od[((b * oh + i) * ow + j) * c + ci] :
+            od[((b * c + ci) * oh + i) * ow + j];
+        assert_float_equal(got, expect, 1e-5);
+    }
+
+    fang_ten_release(&x);
+    fang_ten_release(&dest);
+}
+
+/* 2D pooling test. */
+static void fang_ten_pool2d_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    for(int l = FANG_TEN_CONV_NCHW; l <= FANG_TEN_CONV_NHWC; l++) {
+        for(int t = FANG_TEN_POOL_MAX; t <= FANG_TEN_POOL_AVG; t++) {
+            /* Non-overlapping windows, the default stride. */
+            _pool2d_check(env, 2, 19, 8, 10, (fang_ten_pool2d_t) {
+                .layout = l, .type = t, .window = { 2, 2 } });
+
+            /* Overlapping and padded, stride of width 1 takes the
+               vectorized runs in NCHW layout. */
+            _pool2d_check(env, 2, 3, 37, 29, (fang_ten_pool2d_t) {
+                .layout = l, .type = t, .window = { 3, 3 },
+                .stride = { 2, 1 }, .padding = { 1, 1 } });
+
+            /* Channels spanning several blocks in NHWC layout. */
+            _pool2d_check(env, 1, 600, 5, 6, (fang_ten_pool2d_t) {
+                .layout = l, .type = t, .window = { 3, 2 },
+                .stride = { 1, 2 }, .padding = { 1, 0 } });
+        }
+
+        /* Global average pooling. */
+        fang_ten_t x, dest;
+        TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32,
+            l == FANG_TEN_CONV_NHWC ? $D(2, 7, 9, 40) : $D(2, 40, 7, 9),
+            NULL));
+        TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32,
+            l == FANG_TEN_CONV_NHWC ? $D(2, 1, 1, 40) : $D(2, 40, 1, 1),
+            NULL));
+        TENCHK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1), 29));
+        TENCHK(fang_ten_global_avgpool2d(&dest, &x, l));
+
+        float *xd = x.data.dense, *od = dest.data.dense;
+        for(int b = 0; b < 2; b++) {
+            for(int ci = 0; ci < 40; ci++) {
+                float expect = 0;
+                for(int p = 0; p < 63; p++)
+                    expect += l == FANG_TEN_CONV_NHWC ?
+                        xd[(b * 63 + p) * 40 + ci] : xd[(b * 40 + ci) * 63 + p];
+                assert_float_equal(od[b * 40 + ci], expect / 63, 1e-5);
+            }
+        }
+
+        fang_ten_release(&x);
+        fang_ten_release(&dest);
+    }
+
+    /* Invalid parameters. */
+    fang_ten_t x, dest;
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(1, 4, 5, 5),
+        NULL));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, $D(1, 4, 2, 2),
+        NULL));
+    assert_int_equal(fang_ten_pool2d(&dest, &x, &(fang_ten_pool2d_t) {
+        .window = { 2, 2 }, .padding = { 2, 0 } }), -FANG_INVPOOL);
+    assert_int_equal(fang_ten_pool2d(&dest, &x, &(fang_ten_pool2d_t) {
+        .window = { 0, 2 } }), -FANG_INVPOOL);
+    assert_int_equal(fang_ten_pool2d(&dest, &x, &(fang_ten_pool2d_t) {
+        .window = { 2, 2 }, .stride = { 1, 1 } }), -FANG_DESTINVDIM);
+    TENCHK(fang_ten_pool2d(&dest, &x, &(fang_ten_pool2d_t) {
+        .window = { 2, 2 } }));
+
+    fang_ten_release(&x);
+    fang_ten_release(&dest);
+}
+
+/* Square root by Newton's method, to not to depend on math library. */
+static double _norm_sqrt(double x) {
+    double r = x > 1 ? x : 1;
+    for(int i = 0; i < 64; i++)
+        r = (r + x / r) / 2;
+    return r;
+}
+
+/* Reads element `i` of a half, bfloat16 or single-precision tensor. */
+static double _norm_get(fang_ten_t *ten, int i) {
+    if(ten->dtyp == FANG_TEN_DTYPE_FLOAT16)
+        return _FANG_H2S(((_fang_float16_t *) ten->data.dense)[i]);
+    if(ten->dtyp == FANG_TEN_DTYPE_BFLOAT16)
+        return _FANG_BH2S(((_fang_bfloat16_t *) ten->data.dense)[i]);
+    return ((float *) ten->data.dense)[i];
+}
+
+/* Checks normalization of `rows` rows of `d` elements, and it's gradients,
+   against a double-precision reference. */
+static void _norm_check(int env, fang_ten_norm_type_t type,
+    fang_ten_dtype_t dtyp, int rows, int d, bool affine, double tol)
+{
+    fang_ten_t x, dest, gamma, beta, stats, dy, dx, dgamma, dbeta;
+    TENCHK(fang_ten_create(&x, env, dtyp, $D(rows, d), NULL));
+    TENCHK(fang_ten_create(&dest, env, dtyp, $D(rows, d), NULL));
+    TENCHK(fang_ten_create(&gamma, env, dtyp, $D(d), NULL));
+    TENCHK(fang_ten_create(&beta, env, dtyp, $D(d), NULL));
+    TENCHK(fang_ten_create(&stats, env, FANG_TEN_DTYPE_FLOAT32, $D(rows, 2),
+        NULL));
+    TENCHK(fang_ten_create(&dy, env, dtyp, $D(rows, d), NULL));
+    TENCHK(fang_ten_create(&dx, env, dtyp, $D(rows, d), NULL));
+    TENCHK(fang_ten_create(&dgamma, env, dtyp, $D(d), NULL));
+    TENCHK(fang_ten_create(&dbeta, env, dtyp, $D(d), NULL));
+
+    /* Offset input, to catch cancellation in variance. */
+    TENCHK(fang_ten_rand(&x, FANG_F2G(3), FANG_F2G(5), 31));
+    TENCHK(fang_ten_rand(&gamma, FANG_F2G(0.5), FANG_F2G(1.5), 37));
+    TENCHK(fang_ten_rand(&beta, FANG_F2G(-1), FANG_F2G(1), 41));
+    TENCHK(fang_ten_rand(&dy, FANG_F2G(-1), FANG_F2G(1), 43));
+
+    fang_ten_t *g = affine ? &gamma : NULL, *b = affine ? &beta : NULL;
+    TENCHK(fang_ten_norm(type, &dest, &x, g, b, FANG_F2G(1e-5), &stats));
+    TENCHK(fang_ten_norm_backward(type, &dx, affine ? &dgamma : NULL,
+        affine ? &dbeta : NULL, &dy, &x, g, &stats));
+
+    double *ref_dg = calloc(d, sizeof(double));
+    double *ref_db = calloc(d, sizeof(double));
+    for(int r = 0; r < rows; r++) {
+        double mean = 0, var = 0;
+        for(int j = 0; j < d; j++)
+            mean += _norm_get(&x, r * d + j) / d;
+        for(int j = 0; j < d; j++) {
+            double v = _norm_get(&x, r * d + j) - mean;
+            var += v * v / d;
+        }
+        if(type == FANG_TEN_NORM_RMS) {
+            var += mean * mean;
+            mean = 0;
+        }
+        double rstd = 1 / _norm_sqrt(var + 1e-5);
+        assert_float_equal(((float *) stats.data.dense)[2 * r], mean, 1e-4);
+        assert_float_equal(((float *) stats.data.dense)[2 * r + 1], rstd,
+            1e-3 * rstd);
+
+        double sum_g = 0, sum_gx = 0;
+        for(int j = 0; j < d; j++) {
+            double xhat = (_norm_get(&x, r * d + j) - mean) * rstd;
+            double gj = affine ? _norm_get(&gamma, j) : 1;
+            double bj = affine ? _norm_get(&beta, j) : 0;
+            assert_float_equal(_norm_get(&dest, r * d + j), xhat * gj + bj,
+                tol);
+
+            double gy = _norm_get(&dy, r * d + j);
+            sum_g  += gy * gj;
+            sum_gx += gy * gj * xhat;
+            ref_dg[j] += gy * xhat;
+            ref_db[j] += gy;
+        }
+        if(type == FANG_TEN_NORM_RMS)
+            sum_g = 0;
+
+        for(int j = 0; j < d; j++) {
+            double xhat = (_norm_get(&x, r * d + j) - mean) * rstd;
+            double gj = affine ? _norm_get(&gamma, j) : 1;
+            double expect = rstd * (_norm_get(&dy, r * d + j) * gj -
+                sum_g / d - xhat * sum_gx / d);
+            assert_float_equal(_norm_get(&dx, r * d + j), expect, tol * rstd);
+        }
+    }
+
+    for(int j = 0; affine && j < d; j++) {
+        assert_float_equal(_norm_get(&dgamma, j), ref_dg[j], tol * rows);
+        assert_float_equal(_norm_get(&dbeta, j), ref_db[j], tol * rows);
+    }
+
+    free(ref_dg);
+    free(ref_db);
+    fang_ten_t *tens[] = { &x, &dest, &gamma, &beta, &stats, &dy, &dx,
+        &dgamma, &dbeta };
+    for(int i = 0; i < 9; i++)
+        fang_ten_release(tens[i]);
+}
+
+/* Layer normalization and RMSNorm test. */
+static void fang_ten_norm_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    for(int t = FANG_TEN_NORM_LAYER; t <= FANG_TEN_NORM_RMS; t++) {
+        /* Rows longer than a column block, not a multiple of lanes. */
+        _norm_check(env, t, FANG_TEN_DTYPE_FLOAT32, 37, 300, true, 1e-4);
+        _norm_check(env, t, FANG_TEN_DTYPE_FLOAT16, 37, 300, true, 2e-2);
+        _norm_check(env, t, FANG_TEN_DTYPE_BFLOAT16, 37, 300, true, 1e-1);
+
+        /* Rows spread over several tasks, without parameters. */
+        _norm_check(env, t, FANG_TEN_DTYPE_FLOAT32, 10000, 5, false, 1e-4);
+        _norm_check(env, t, FANG_TEN_DTYPE_FLOAT32, 40, 1000, true, 1e-4);
+    }
+
+    /* Invalid parameters. */
+    fang_ten_t x, dest, gamma, stats, x64;
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 3), NULL));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 3),
+        NULL));
+    TENCHK(fang_ten_create(&gamma, env, FANG_TEN_DTYPE_FLOAT32, $D(2), NULL));
+    TENCHK(fang_ten_create(&stats, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 2),
+        NULL));
+    TENCHK(fang_ten_create(&x64, env, FANG_TEN_DTYPE_FLOAT64, $D(2, 3),
+        NULL));
+
+    assert_int_equal(fang_ten_norm(FANG_TEN_NORM_LAYER, &dest, &x, NULL, NULL,
+        FANG_F2G(-1), NULL), -FANG_INVNORM);
+    assert_int_equal(fang_ten_norm(FANG_TEN_NORM_LAYER, NULL, &x, NULL, NULL,
+        FANG_F2G(1e-5), NULL), -FANG_INVNORM);
+    assert_int_equal(fang_ten_norm(FANG_TEN_NORM_LAYER, &dest, &x, &gamma,
+        NULL, FANG_F2G(1e-5), NULL), -FANG_INVDIM);
+    assert_int_equal(fang_ten_norm(FANG_TEN_NORM_LAYER, &dest, &x, NULL, NULL,
+        FANG_F2G(1e-5), &gamma), -FANG_INVDIM);
+    assert_int_equal(fang_ten_norm(FANG_TEN_NORM_RMS, &x64, &x64, NULL, NULL,
+        FANG_F2G(1e-5), NULL), -FANG_UNSUPDTYP);
+    assert_int_equal(fang_ten_norm_backward(FANG_TEN_NORM_LAYER, &dest, NULL,
+        NULL, &x, &x, NULL, NULL), -FANG_INVNORM);
+
+    /* Statistics are tracked by asynchronous Environments as well. */
+    TENCHK(fang_ten_fill(&x, FANG_F2G(2)));
+    TENCHK(fang_env_async(env, true));
+    TENCHK(fang_ten_norm(FANG_TEN_NORM_RMS, &dest, &x, NULL, NULL,
+        FANG_F2G(0), &stats));
+    TENCHK(fang_ten_wait(&stats));
+    TENCHK(fang_env_async(env, false));
+    assert_float_equal(((float *) stats.data.dense)[3], 0.5, 1e-6);
+    assert_float_equal(((float *) dest.data.dense)[5], 1, 1e-6);
+
+    fang_ten_release(&x);
+    fang_ten_release(&dest);
+    fang_ten_release(&gamma);
+    fang_ten_release(&stats);
+    fang_ten_release(&x64);
+}
+
+/* Checks batch normalization of an (n, c, inner) or (n, inner, c) tensor
+   against a reference. */
+static void _batchnorm_check(int env, fang_ten_conv_layout_t layout,
+    fang_ten_dim_t dim, bool affine)
+{
+    int nhwc = layout == FANG_TEN_CONV_NHWC;
+    int c = dim.dims[nhwc ? dim.ndims - 1 : 1], n = dim.dims[0], inner = 1;
+    for(int i = 1; i < dim.ndims; i++)
+        inner *= i == (nhwc ? dim.ndims - 1 : 1) ? 1 : dim.dims[i];
+
+    fang_ten_t x, dest, stats, gamma, beta;
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, dim, NULL));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, dim, NULL));
+    TENCHK(fang_ten_create(&stats, env, FANG_TEN_DTYPE_FLOAT32, $D(2, c),
+        NULL));
+    TENCHK(fang_ten_create(&gamma, env, FANG_TEN_DTYPE_FLOAT32, $D(c), NULL));
+    TENCHK(fang_ten_create(&beta, env, FANG_TEN_DTYPE_FLOAT32, $D(c), NULL));
+    TENCHK(fang_ten_rand(&x, FANG_F2G(-2), FANG_F2G(2), 47));
+    TENCHK(fang_ten_rand(&stats, FANG_F2G(0.1), FANG_F2G(2), 53));
+    TENCHK(fang_ten_rand(&gamma, FANG_F2G(-1), FANG_F2G(1), 59));
+    TENCHK(fang_ten_rand(&beta, FANG_F2G(-1), FANG_F2G(1), 61));
+
+    TENCHK(fang_ten_batchnorm(&dest, &x, &stats, affine ? &gamma : NULL,
+        affine ? &beta : NULL, FANG_F2G(1e-3), layout));
+
+    float *xd = x.data.dense, *od = dest.data.dense, *sd = stats.data.dense;
+    float *gd = gamma.data.dense, *bd = beta.data.dense;
+    for(int e = 0; e < n * c * inner; e++) {
+        int ch = nhwc ? e % c : e / inner % c;
+        double expect = (xd[e] - sd[ch]) / _norm_sqrt(sd[c + ch] + 1e-3);
+        if(affine)
+            expect = expect * gd[ch] + bd[ch];
+        assert_float_equal(od[e], expect, 1e-4);
+    }
+
+    fang_ten_release(&x);
+    fang_ten_release(&dest);
+    fang_ten_release(&stats);
+    fang_ten_release(&gamma);
+    fang_ten_release(&beta);
+}
+
+/* Runs a layer, adds it's bias and applies batch normalization, then checks
+   the layer with batch normalization folded into it gives the same. */
+static void _batchnorm_fold_check(int env, fang_ten_t *w, fang_ten_t *b,
+    fang_ten_fold_axis_t axis, fang_ten_t *x, fang_ten_t *y,
+    fang_ten_t *stats, fang_ten_t *gamma, fang_ten_t *beta)
+{
+    bool conv = axis == FANG_TEN_FOLD_FIRST;
+    fang_ten_conv2d_t params = { .layout = FANG_TEN_CONV_NHWC };
+
+    fang_ten_t expect;
+    TENCHK(fang_ten_create(&expect, env, FANG_TEN_DTYPE_FLOAT32,
+        (fang_ten_dim_t) { .dims = y->dims, .ndims = y->ndims }, NULL));
+    TENCHK(conv ? fang_ten_conv2d(y, x, w, &params) : fang_ten_matmul(y, x, w));
+    TENCHK(fang_ten_sum(y, y, b));
+    TENCHK(fang_ten_batchnorm(&expect, y, stats, gamma, beta, FANG_F2G(1e-5),
+        FANG_TEN_CONV_NHWC));
+
+    TENCHK(fang_ten_batchnorm_fold(w, b, axis, stats, gamma, beta,
+        FANG_F2G(1e-5)));
+    TENCHK(conv ? fang_ten_conv2d(y, x, w, &params) : fang_ten_matmul(y, x, w));
+    TENCHK(fang_ten_sum(y, y, b));
+
+    int size = y->strides[0] * y->dims[0];
+    for(int i = 0; i < size; i++)
+        assert_float_equal(((float *) y->data.dense)[i],
+            ((float *) expect.data.dense)[i], 1e-4);
+
+    fang_ten_release(&expect);
+}
+
+/* Batch normalization and folding it into layers. */
+static void fang_ten_batchnorm_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* Images, also with channels spread over several tasks. */
+    _batchnorm_check(env, FANG_TEN_CONV_NCHW, $D(2, 5, 3, 4), true);
+    _batchnorm_check(env, FANG_TEN_CONV_NHWC, $D(2, 3, 4, 5), true);
+    _batchnorm_check(env, FANG_TEN_CONV_NCHW, $D(3, 7, 90, 91), false);
+    _batchnorm_check(env, FANG_TEN_CONV_NHWC, $D(3, 90, 91, 7), true);
+    _batchnorm_check(env, FANG_TEN_CONV_NCHW, $D(9, 6), true);
+
+    fang_ten_t stats, gamma, beta, x, y, w, b;
+    TENCHK(fang_ten_create(&stats, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 4),
+        (fang_float_t []) { 0.5, -1, 2, 0, 1, 0.25, 4, 2 }));
+    TENCHK(fang_ten_create(&gamma, env, FANG_TEN_DTYPE_FLOAT32, $D(4),
+        (fang_float_t []) { 1, -2, 0.5, 3 }));
+    TENCHK(fang_ten_create(&beta, env, FANG_TEN_DTYPE_FLOAT32, $D(4),
+        (fang_float_t []) { 0, 1, -1, 0.5 }));
+
+    /* GEMM of (in, out) weights. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(5, 6), NULL));
+    TENCHK(fang_ten_create(&y, env, FANG_TEN_DTYPE_FLOAT32, $D(5, 4), NULL));
+    TENCHK(fang_ten_create(&w, env, FANG_TEN_DTYPE_FLOAT32, $D(6, 4), NULL));
+    TENCHK(fang_ten_create(&b, env, FANG_TEN_DTYPE_FLOAT32, $D(4), NULL));
+    TENCHK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1), 67));
+    TENCHK(fang_ten_rand(&w, FANG_F2G(-1), FANG_F2G(1), 71));
+    TENCHK(fang_ten_rand(&b, FANG_F2G(-1), FANG_F2G(1), 73));
+    _batchnorm_fold_check(env, &w, &b, FANG_TEN_FOLD_LAST, &x, &y, &stats,
+        &gamma, &beta);
+    fang_ten_release(&x);
+    fang_ten_release(&y);
+    fang_ten_release(&w);
+
+    /* Convolution, weights of output channels first. */
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 6, 6, 3),
+        NULL));
+    TENCHK(fang_ten_create(&y, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 4, 4, 4),
+        NULL));
+    TENCHK(fang_ten_create(&w, env, FANG_TEN_DTYPE_FLOAT32, $D(4, 3, 3, 3),
+        NULL));
+    TENCHK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1), 79));
+    TENCHK(fang_ten_rand(&w, FANG_F2G(-1), FANG_F2G(1), 83));
+    _batchnorm_fold_check(env, &w, &b, FANG_TEN_FOLD_FIRST, &x, &y, &stats,
+        &gamma, &beta);
+
+    /* Invalid parameters. */
+    assert_int_equal(fang_ten_batchnorm(&y, &y, &stats, NULL, NULL,
+        FANG_F2G(-1), FANG_TEN_CONV_NHWC), -FANG_INVNORM);
+    assert_int_equal(fang_ten_batchnorm(&y, &y, &gamma, NULL, NULL,
+        FANG_F2G(0), FANG_TEN_CONV_NHWC), -FANG_INVDIM);
+    assert_int_equal(fang_ten_batchnorm(&y, &y, NULL, NULL, NULL,
+        FANG_F2G(0), FANG_TEN_CONV_NHWC), -FANG_INVNORM);
+    assert_int_equal(fang_ten_batchnorm_fold(&w, &b, FANG_TEN_FOLD_FIRST,
+        NULL, NULL, NULL, FANG_F2G(0)), -FANG_INVNORM);
+    assert_int_equal(fang_ten_batchnorm_fold(&w, &gamma, FANG_TEN_FOLD_LAST,
+        &stats, NULL, NULL, FANG_F2G(0)), -FANG_INVDIM);
+
+    fang_ten_release(&x);
+    fang_ten_release(&y);
+    fang_ten_release(&w);
+    fang_ten_release(&b);
+    fang_ten_release(&stats);
+    fang_ten_release(&gamma);
+    fang_ten_release(&beta);
+}
+
+/* Exponential of a non-positive argument, by Taylor series of a fraction of
+   it squared back, to not to depend on math library. */
+static double _attention_exp(double x) {
+    double y = x / 1024, term = 1, res = 1;
+    for(int i = 1; i < 12; i++) {
+        term *= y / i;
+        res += term;
+    }
+    for(int i = 0; i < 10; i++)
+        res *= res;
+    return res;
+}
+
+/* Checks attention of `bh` heads against a reference materializing scores. */
+static void _attention_check(int env, int bh, int t, int s, int d, int dv,
+    bool causal, double scale)
+{
+    fang_ten_t q, k, v, dest;
+    TENCHK(fang_ten_create(&q, env, FANG_TEN_DTYPE_FLOAT32, $D(1, bh, t, d),
+        NULL));
+    TENCHK(fang_ten_create(&k, env, FANG_TEN_DTYPE_FLOAT32, $D(1, bh, s, d),
+        NULL));
+    TENCHK(fang_ten_create(&v, env, FANG_TEN_DTYPE_FLOAT32, $D(1, bh, s, dv),
+        NULL));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32,
+        $D(1, bh, t, dv), NULL));
+    TENCHK(fang_ten_rand(&q, FANG_F2G(-1), FANG_F2G(1), 89));
+    TENCHK(fang_ten_rand(&k, FANG_F2G(-1), FANG_F2G(1), 97));
+    TENCHK(fang_ten_rand(&v, FANG_F2G(-1), FANG_F2G(1), 101));
+
+    fang_ten_attention_t attn = { .scale = scale, .causal = causal };
+    TENCHK(fang_ten_attention(&dest, &q, &k, &v, &attn));
+
+    if(scale == 0)
+        scale = 1 / _norm_sqrt(d);
+    float *qd = q.data.dense, *kd = k.data.dense, *vd = v.data.dense;
+    float *od = dest.data.dense;
+    double *p = calloc(s, sizeof(double));
+    for(int h = 0; h < bh; h++) {
+        for(int i = 0; i < t; i++) {
+            int n = causal ? i + s - t + 1 : s;
+            double max = -1e300, sum = 0;
+            for(int j = 0; j < n; j++) {
+                p[j] = 0;
+                for(int e = 0; e < d; e++)
+                    p[j] += (double) qd[((size_t) h * t + i) * d + e] *
+                        kd[((size_t) h * s + j) * d + e];
+                p[j] *= scale;
+                max = p[j] > max ? p[j] : max;
+            }
+            for(int j = 0; j < n; j++) {
+                p[j] = _attention_exp(p[j] - max);
+                sum += p[j];
+            }
+
+            for(int e = 0; e < dv; e++) {
+                double expect = 0;
+                for(int j = 0; j < n; j++)
+                    expect += p[j] * vd[((size_t) h * s + j) * dv + e];
+                assert_float_equal(od[((size_t) h * t + i) * dv + e],
+                    expect / sum, 1e-4);
+            }
+        }
+    }
+
+    free(p);
+    fang_ten_release(&q);
+    fang_ten_release(&k);
+    fang_ten_release(&v);
+    fang_ten_release(&dest);
+}
+
+/* Fused scaled dot-product attention test. */
+static void fang_ten_attention_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* Several query blocks and key tiles, both partial. */
+    _attention_check(env, 3, 200, 200, 40, 24, false, 0);
+    _attention_check(env, 3, 200, 200, 40, 24, true, 0);
+
+    /* More keys than queries, causal mask aligned to the last key. */
+    _attention_check(env, 2, 5, 9, 7, 3, true, 0.5);
+    _attention_check(env, 4, 1, 300, 64, 64, true, 0);
+    _attention_check(env, 1, 130, 260, 16, 17, false, 2);
+
+    /* Invalid parameters. */
+    fang_ten_t q, k, dest, q64;
+    TENCHK(fang_ten_create(&q, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 4, 8),
+        NULL));
+    TENCHK(fang_ten_create(&k, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 3, 8),
+        NULL));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 4, 4),
+        NULL));
+    TENCHK(fang_ten_create(&q64, env, FANG_TEN_DTYPE_FLOAT64, $D(2, 4, 8),
+        NULL));
+
+    fang_ten_attention_t attn = { .causal = true };
+    assert_int_equal(fang_ten_attention(&dest, &q, &k, &k, &attn),
+        -FANG_INVDIM);
+    attn.causal = false;
+    assert_int_equal(fang_ten_attention(&dest, &q, &k, &k, &attn),
+        -FANG_DESTINVDIM);
+    assert_int_equal(fang_ten_attention(&q64, &q64, &q64, &q64, &attn),
+        -FANG_UNSUPDTYP);
+    assert_int_equal(fang_ten_attention(&dest, &q, &k, &q, &attn),
+        -FANG_INVDIM);
+
+    fang_ten_release(&q);
+    fang_ten_release(&k);
+    fang_ten_release(&dest);
+    fang_ten_release(&q64);
+}
+
+/* Checks gather of `m` rows of a (n, row) table and scatter-add of them back
+   against plain loops, indices repeating. */
+static void _index_check(int env, fang_ten_dtype_t dtyp, uint32_t n,
+    uint32_t row, uint32_t m)
+{
+    int64_t *at = calloc(m, sizeof(int64_t));
+    for(uint32_t i = 0; i < m; i++)
+        at[i] = (int64_t) ((i * 7919u + i / 3) % n);
+
+    fang_ten_t x, idx, dest, grad, acc;
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(n, 1, row),
+        NULL));
+    TENCHK(fang_ten_create_from(&idx, env, dtyp, $D(2, m / 2),
+        FANG_TEN_DTYPE_INT64, at));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32,
+        $D(2, m / 2, 1, row), NULL));
+    TENCHK(fang_ten_create(&grad, env, FANG_TEN_DTYPE_FLOAT32,
+        $D(2, m / 2, 1, row), NULL));
+    TENCHK(fang_ten_create(&acc, env, FANG_TEN_DTYPE_FLOAT32, $D(n, 1, row),
+        NULL));
+    TENCHK(fang_ten_rand(&x, FANG_F2G(-1), FANG_F2G(1), 11));
+    TENCHK(fang_ten_rand(&grad, FANG_F2G(-1), FANG_F2G(1), 13));
+    TENCHK(fang_ten_fill(&acc, FANG_F2G(1)));
+
+    TENCHK(fang_ten_gather(&dest, &x, &idx));
+    TENCHK(fang_ten_scatter_add(&acc, &grad, &idx));
+    TENCHK(fang_ten_wait(&dest));
+    TENCHK(fang_ten_wait(&acc));
+
+    float *data_x = (float *) x.data.dense, *data_g = (float *) grad.data.dense;
+    float *expect = calloc((size_t) n * row, sizeof(float));
+    for(size_t i = 0; i < (size_t) n * row; i++)
+        expect[i] = 1.0f;
+    for(uint32_t i = 0; i < m; i++) {
+        for(uint32_t j = 0; j < row; j++) {
+            assert_float_equal(((float *) dest.data.dense)[i * row + j],
+                data_x[at[i] * row + j], 0);
+            expect[at[i] * row + j] += data_g[i * row + j];
+        }
+    }
+    for(size_t i = 0; i < (size_t) n * row; i++)
+        assert_float_equal(((float *) acc.data.dense)[i], expect[i], 1e-5);
+
+    free(at);
+    free(expect);
+    fang_ten_release(&x);
+    fang_ten_release(&idx);
+    fang_ten_release(&dest);
+    fang_ten_release(&grad);
+    fang_ten_release(&acc);
+}
+
+/* Gather and scatter-add test. */
+static void fang_ten_index_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* Embedding lookup, and rows small enough to be many to a task. */
+    _index_check(env, FANG_TEN_DTYPE_INT64, 50, 24, 40);
+    _index_check(env, FANG_TEN_DTYPE_INT32, 1000, 64, 6000);
+    _index_check(env, FANG_TEN_DTYPE_UINT32, 3, 5, 2000);
+
+    /* Invalid parameters. */
+    fang_ten_t x, idx, bad, dest, x16;
+    TENCHK(fang_ten_create(&x, env, FANG_TEN_DTYPE_FLOAT32, $D(4, 3), NULL));
+    TENCHK(fang_ten_create_from(&idx, env, FANG_TEN_DTYPE_INT32, $D(2),
+        FANG_TEN_DTYPE_INT32, ((int32_t []) { 3, 0 })));
+    TENCHK(fang_ten_create_from(&bad, env, FANG_TEN_DTYPE_INT32, $D(2),
+        FANG_TEN_DTYPE_INT32, ((int32_t []) { 1, -1 })));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, $D(2, 3),
+        NULL));
+    TENCHK(fang_ten_create(&x16, env, FANG_TEN_DTYPE_FLOAT16, $D(2, 3),
+        NULL));
+
+    assert_int_equal(fang_ten_gather(&dest, &x, &bad), -FANG_INVIDX);
+    assert_int_equal(fang_ten_scatter_add(&x, &dest, &bad), -FANG_INVIDX);
+    assert_int_equal(fang_ten_gather(&x, &x, &idx), -FANG_DESTINVDIM);
+    assert_int_equal(fang_ten_scatter_add(&x, &x, &idx), -FANG_INVDIM);
+    assert_int_equal(fang_ten_gather(&dest, &x, &x), -FANG_INVDTYP);
+    assert_int_equal(fang_ten_scatter_add(&x16, &x16, &idx), -FANG_UNSUPDTYP);
+
+    fang_ten_release(&x);
+    fang_ten_release(&idx);
+    fang_ten_release(&bad);
+    fang_ten_release(&dest);
+    fang_ten_release(&x16);
+}
+
 /* ================ TESTS END ================ */
 
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(fang_ten_create_test),
+        cmocka_unit_test(fang_ten_create_from_test),
+        cmocka_unit_test(fang_ten_adopt_test),
+        cmocka_unit_test(fang_ten_fprint_test),
+        cmocka_unit_test(fang_ten_rand_test),
+        cmocka_unit_test(fang_ten_randn_test),
+        cmocka_unit_test(fang_ten_bernoulli_test),
+        cmocka_unit_test(fang_ten_init_test),
         cmocka_unit_test(fang_ten_scale_test),
         cmocka_unit_test(fang_ten_fill_test),
         cmocka_unit_test_setup_teardown(fang_ten_sum_test, setup_arithmetic,
@@ -1606,7 +2772,13 @@ int main() {
             teardown_arithmetic),
         cmocka_unit_test_setup_teardown(fang_ten_diff_test, setup_arithmetic,
             teardown_arithmetic),
-        cmocka_unit_test(fang_ten_gemm_test)
+        cmocka_unit_test(fang_ten_gemm_test),
+        cmocka_unit_test(fang_ten_conv2d_test),
+        cmocka_unit_test(fang_ten_pool2d_test),
+        cmocka_unit_test(fang_ten_norm_test),
+        cmocka_unit_test(fang_ten_batchnorm_test),
+        cmocka_unit_test(fang_ten_attention_test),
+        cmocka_unit_test(fang_ten_index_test)
     };
 
     return cmocka_run_group_tests_name("tensor/dense", tests, setup, teardown);
@@ -0,0 +1,449 @@
+#include <fang/env.h>
+#include <fang/autograd.h>
+#include <fang/status.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+/* ================ HELPER MACROS ================ */
+
+/* Check if an operation is successful or not. */
+#define TENCHK(expr)     assert_true(FANG_ISOK(expr))
+
+/* ================ HELPER MACROS END ================ */
+
+
+/* ================ HELPERS ================ */
+
+/* Creates a (rows, cols) sparse matrix of about one in `every` elements
+   non-zero, some of them repeated, alongside it's dense counterpart. */
+static void _sparse_rand(int env, fang_ten_dtype_t dtyp, fang_ten_t *sparse,
+    double *dense, uint32_t rows, uint32_t cols, uint32_t every)
+{
+    int nnz = (int) ((uint64_t) rows * cols / every) + 1;
+    uint32_t *idx = calloc(2 * (size_t) nnz, sizeof(uint32_t));
+    double *data = calloc(nnz, sizeof(double));
+
+    uint32_t state = 12345;
+    for(size_t i = 0; i < (size_t) rows * cols; i++)
+        dense[i] = 0;
+    for(int i = 0; i < nnz; i++) {
+        state = state * 1664525u + 1013904223u;
+        idx[2 * i] = (state >> 8) % rows;
+        state = state * 1664525u + 1013904223u;
+        idx[2 * i + 1] = (state >> 8) % cols;
+        data[i] = (double) ((int) (state % 17) - 8) / 4;
+
+        /* Every fifth element repeats the previous one. */
+        if(i > 0 && i % 5 == 0) {
+            idx[2 * i] = idx[2 * i - 2];
+            idx[2 * i + 1] = idx[2 * i - 1];
+        }
+        dense[(size_t) idx[2 * i] * cols + idx[2 * i + 1]] += data[i];
+    }
+
+    TENCHK(fang_ten_sparse_create(sparse, env, dtyp, $D(rows, cols), nnz,
+        idx, FANG_TEN_DTYPE_FLOAT64, data));
+
+    free(idx);
+    free(data);
+}
+
+/* Checks SpMM of a (m, k) sparse matrix of `fmt` encoding against plain
+   loops. */
+static void _spmm_check(int env, fang_ten_dtype_t dtyp,
+    fang_ten_sparse_fmt_t fmt, uint32_t block, uint32_t m, uint32_t k,
+    uint32_t n, double alpha, double beta)
+{
+    double *dense = calloc((size_t) m * k, sizeof(double));
+    fang_ten_t x, y, dest, init;
+    _sparse_rand(env, dtyp, &x, dense, m, k, 37);
+    if(fmt != FANG_TEN_SPARSE_COO) {
+        fang_ten_t coo = x;
+        TENCHK(fang_ten_sparse_convert(&x, &coo, fmt, block));
+        fang_ten_release(&coo);
+    }
+    TENCHK(fang_ten_create(&y, env, dtyp, $D(k, n), NULL));
+    TENCHK(fang_ten_create(&dest, env, dtyp, $D(m, n), NULL));
+    TENCHK(fang_ten_create(&init, env, FANG_TEN_DTYPE_FLOAT64, $D(m, n),
+        NULL));
+    TENCHK(fang_ten_rand(&y, FANG_F2G(-1), FANG_F2G(1), 3));
+    TENCHK(fang_ten_rand(&init, FANG_F2G(-1), FANG_F2G(1), 5));
+    TENCHK(fang_ten_wait(&init));
+    double *data_init = (double *) init.data.dense;
+
+    /* Destination starts from the same values in any precision. */
+    fang_ten_release(&dest);
+    TENCHK(fang_ten_create_from(&dest, env, dtyp, $D(m, n),
+        FANG_TEN_DTYPE_FLOAT64, data_init));
+
+    TENCHK(fang_ten_gemm(FANG_TEN_GEMM_NO_TRANSPOSE,
+        FANG_TEN_GEMM_NO_TRANSPOSE, FANG_F2G(beta), &dest, FANG_F2G(alpha),
+        &x, &y));
+    TENCHK(fang_ten_wait(&dest));
+
+    for(uint32_t i = 0; i < m; i++) {
+        for(uint32_t j = 0; j < n; j++) {
+            double expect = beta * data_init[(size_t) i * n + j];
+            for(uint32_t l = 0; l < k; l++) {
+                double yv = dtyp == FANG_TEN_DTYPE_FLOAT32 ?
+                    ((float *) y.data.dense)[(size_t) l * n + j] :
+                    ((double *) y.data.dense)[(size_t) l * n + j];
+                expect += alpha * dense[(size_t) i * k + l] * yv;
+            }
+
+            double got = dtyp == FANG_TEN_DTYPE_FLOAT32 ?
+                ((float *) dest.data.dense)[(size_t) i * n + j] :
+                ((double *) dest.data.dense)[(size_t) i * n + j];
+            assert_float_equal(got, expect, 1e-4);
+        }
+    }
+
+    free(dense);
+    fang_ten_release(&x);
+    fang_ten_release(&y);
+    fang_ten_release(&dest);
+    fang_ten_release(&init);
+}
+
+/* Creates a dense (rows, cols) single-precision matrix pruned to 2:4, every
+   group of 4 of a row having 0 to 2 non-zeros. */
+static void _pruned_rand(int env, fang_ten_t *ten, uint32_t rows,
+    uint32_t cols)
+{
+    float *data = calloc((size_t) rows * cols, sizeof(float));
+
+    uint32_t state = 54321;
+    for(size_t g = 0; g < (size_t) rows * cols / 4; g++) {
+        state = state * 1664525u + 1013904223u;
+        uint32_t n = (state >> 8) % 3, c0 = (state >> 12) % 4;
+        uint32_t c1 = (c0 + 1 + (state >> 16) % 3) % 4;
+        if(n > 0)
+            data[4 * g + c0] = (float) ((int) (state % 17) - 8) / 4;
+        if(n > 1)
+            data[4 * g + c1] = (float) ((int) (state >> 20) % 9 + 1) / 8;
+    }
+
+    TENCHK(fang_ten_create_from(ten, env, FANG_TEN_DTYPE_FLOAT32,
+        $D(rows, cols), FANG_TEN_DTYPE_FLOAT32, data));
+    free(data);
+}
+
+/* ================ HELPERS END ================ */
+
+
+/* ================ SETUP AND TEARDOWN ================ */
+
+/* Setup Environment before every test. */
+static int setup(void **state) {
+    int env = fang_env_create(FANG_ENV_TYPE_CPU, NULL);
+    if(!FANG_ISOK(env))
+        return 1;
+
+    *state = (void *) (uint64_t) env;
+    return 0;
+}
+
+/* Release created Environment after every test. */
+static int teardown(void **state) {
+    int env = (int) (uint64_t) *state;
+    fang_env_release(env);
+    return 0;
+}
+
+/* ================ SETUP AND TEARDOWN END ================ */
+
+
+/* ================ TESTS ================ */
+
+/* Sparse tensor creation, printing and scattering into dense tensors. */
+static void fang_ten_sparse_create_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* Repeated coordinates add up. */
+    fang_ten_t x, dest;
+    TENCHK(fang_ten_sparse_create(&x, env, FANG_TEN_DTYPE_INT32, $D(2, 3), 3,
+        (uint32_t []) { 1, 2, 0, 0, 1, 2 }, FANG_TEN_DTYPE_INT64,
+        (int64_t []) { 5, -7, 10 }));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_INT32, $D(2, 3),
+        NULL));
+    TENCHK(fang_ten_sparse_to_dense(&dest, &x));
+
+    int32_t expect[] = { -7, 0, 0, 0, 0, 15 };
+    for(int i = 0; i < 6; i++)
+        assert_int_equal(((int32_t *) dest.data.dense)[i], expect[i]);
+
+    /* Non-zeros are printed a line each. */
+    char str[128];
+    FILE *file = tmpfile();
+    assert_non_null(file);
+    TENCHK(fang_ten_fprint(&x, "x", 0, file));
+    size_t len = ftell(file);
+    assert_true(len < sizeof(str));
+    rewind(file);
+    assert_int_equal(fread(str, 1, len, file), len);
+    str[len] = '\0';
+    fclose(file);
+    assert_string_equal(str,
+        "[x] = \n"
+        "(1, 2)  5\n"
+        "(0, 0) -7\n"
+        "(1, 2) 10\n");
+
+    /* Empty tensors scatter to zeros. */
+    fang_ten_t empty;
+    TENCHK(fang_ten_sparse_create(&empty, env, FANG_TEN_DTYPE_INT32,
+        $D(2, 3), 0, NULL, FANG_TEN_DTYPE_INT64, NULL));
+    TENCHK(fang_ten_sparse_to_dense(&dest, &empty));
+    for(int i = 0; i < 6; i++)
+        assert_int_equal(((int32_t *) dest.data.dense)[i], 0);
+
+    /* Invalid parameters. */
+    fang_ten_t bad;
+    assert_int_equal(fang_ten_sparse_create(&bad, env, FANG_TEN_DTYPE_INT32,
+        $D(2, 3), 1, (uint32_t []) { 0, 3 }, FANG_TEN_DTYPE_INT64,
+        (int64_t []) { 1 }), -FANG_INVIDX);
+    assert_int_equal(fang_ten_sparse_create(&bad, env, FANG_TEN_DTYPE_INT32,
+        $D(2, 3), 1, NULL, FANG_TEN_DTYPE_INT64, NULL), -FANG_INVIDX);
+    assert_int_equal(fang_ten_sparse_to_dense(&x, &dest), -FANG_INVTENTYP);
+
+    fang_ten_release(&x);
+    fang_ten_release(&empty);
+    fang_ten_release(&dest);
+}
+
+/* Sparse-dense matrix multiplication test. */
+static void fang_ten_spmm_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    fang_ten_sparse_fmt_t coo = FANG_TEN_SPARSE_COO;
+    _spmm_check(env, FANG_TEN_DTYPE_FLOAT32, coo, 1, 300, 200, 37, 1, 0);
+    _spmm_check(env, FANG_TEN_DTYPE_FLOAT64, coo, 1, 513, 64, 130, 2, 0.5);
+    _spmm_check(env, FANG_TEN_DTYPE_FLOAT32, coo, 1, 7, 1000, 1, -1, 1);
+
+    /* Compressed encodings. */
+    _spmm_check(env, FANG_TEN_DTYPE_FLOAT32, FANG_TEN_SPARSE_CSR, 1, 300, 200,
+        37, 1, 0);
+    _spmm_check(env, FANG_TEN_DTYPE_FLOAT64, FANG_TEN_SPARSE_CSC, 1, 120, 96,
+        130, 2, 0.5);
+    _spmm_check(env, FANG_TEN_DTYPE_FLOAT32, FANG_TEN_SPARSE_BSR, 4, 96, 200,
+        33, -1, 1);
+    _spmm_check(env, FANG_TEN_DTYPE_FLOAT64, FANG_TEN_SPARSE_BSR, 8, 64, 64,
+        8, 1, 0);
+
+    /* Asynchronously. */
+    TENCHK(fang_env_async(env, true));
+    _spmm_check(env, FANG_TEN_DTYPE_FLOAT32, coo, 1, 64, 64, 64, 1, 1);
+    _spmm_check(env, FANG_TEN_DTYPE_FLOAT32, FANG_TEN_SPARSE_CSC, 1, 64, 64,
+        100, 1, 1);
+    TENCHK(fang_env_async(env, false));
+
+    /* Invalid parameters. */
+    double dense[16 * 8];
+    fang_ten_t x, y, dest;
+    _sparse_rand(env, FANG_TEN_DTYPE_FLOAT32, &x, dense, 16, 8, 4);
+    TENCHK(fang_ten_create(&y, env, FANG_TEN_DTYPE_FLOAT32, $D(8, 4), NULL));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, $D(16, 4),
+        NULL));
+
+    assert_int_equal(fang_ten_spmm(FANG_F2G(0), &dest, FANG_F2G(1), &x, &x),
+        -FANG_INVTENTYP);
+    assert_int_equal(fang_ten_spmm(FANG_F2G(0), &y, FANG_F2G(1), &x, &y),
+        -FANG_DESTINVDIM);
+    assert_int_equal(fang_ten_spmm(FANG_F2G(0), &dest, FANG_F2G(1), &x,
+        &dest), -FANG_INCMATDIM);
+
+    /* Sparse GEMM has no gradient, hence is refused by tapes. */
+    fang_tape_t tape;
+    TENCHK(fang_tape_create(&tape, env));
+    TENCHK(fang_tape_begin(&tape));
+    assert_int_equal(fang_ten_gemm(FANG_TEN_GEMM_NO_TRANSPOSE,
+        FANG_TEN_GEMM_NO_TRANSPOSE, FANG_F2G(0), &dest, FANG_F2G(1), &x, &y),
+        -FANG_RECORDING);
+    TENCHK(fang_tape_end(&tape));
+    TENCHK(fang_tape_release(&tape));
+
+    fang_ten_release(&x);
+    fang_ten_release(&y);
+    fang_ten_release(&dest);
+}
+
+/* Conversion into compressed encodings test. */
+static void fang_ten_sparse_convert_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* Same elements in every encoding. */
+    double dense[48 * 40];
+    fang_ten_t coo, x, expect, got;
+    _sparse_rand(env, FANG_TEN_DTYPE_FLOAT32, &coo, dense, 48, 40, 5);
+    TENCHK(fang_ten_create(&expect, env, FANG_TEN_DTYPE_FLOAT32, $D(48, 40),
+        NULL));
+    TENCHK(fang_ten_create(&got, env, FANG_TEN_DTYPE_FLOAT32, $D(48, 40),
+        NULL));
+    TENCHK(fang_ten_sparse_to_dense(&expect, &coo));
+
+    struct { fang_ten_sparse_fmt_t fmt; uint32_t block; } encs[] = {
+        { FANG_TEN_SPARSE_CSR, 0 }, { FANG_TEN_SPARSE_CSC, 0 },
+        { FANG_TEN_SPARSE_BSR, 4 }, { FANG_TEN_SPARSE_BSR, 8 }
+    };
+    for(size_t e = 0; e < sizeof(encs) / sizeof(encs[0]); e++) {
+        TENCHK(fang_ten_sparse_convert(&x, &coo, encs[e].fmt,
+            encs[e].block));
+        assert_int_equal(x.data.sparse->fmt, encs[e].fmt);
+        TENCHK(fang_ten_sparse_to_dense(&got, &x));
+        for(int i = 0; i < 48 * 40; i++)
+            assert_float_equal(((float *) got.data.dense)[i],
+                ((float *) expect.data.dense)[i], 1e-6);
+        fang_ten_release(&x);
+    }
+
+    /* Elements of same coordinates are merged, in order. */
+    fang_ten_t small;
+    TENCHK(fang_ten_sparse_create(&small, env, FANG_TEN_DTYPE_INT32,
+        $D(2, 4), 4, (uint32_t []) { 1, 2, 0, 3, 1, 2, 1, 0 },
+        FANG_TEN_DTYPE_INT64, (int64_t []) { 5, -7, 10, 1 }));
+    TENCHK(fang_ten_sparse_convert(&x, &small, FANG_TEN_SPARSE_CSR, 0));
+    assert_int_equal(x.data.sparse->nnz, 3);
+    assert_int_equal(x.data.sparse->ptr[1], 1);
+    assert_int_equal(x.data.sparse->idx[1], 0);
+    assert_int_equal(((int32_t *) x.data.sparse->data)[2], 15);
+    fang_ten_release(&x);
+
+    TENCHK(fang_ten_sparse_convert(&x, &small, FANG_TEN_SPARSE_BSR, 2));
+    assert_int_equal(x.data.sparse->nnz, 8);
+    assert_int_equal(x.data.sparse->ptr[1], 2);
+
+    /* Invalid parameters. */
+    fang_ten_t bad;
+    assert_int_equal(fang_ten_sparse_convert(&bad, &x, FANG_TEN_SPARSE_CSR,
+        0), -FANG_INVTENTYP);
+    assert_int_equal(fang_ten_sparse_convert(&bad, &small,
+        FANG_TEN_SPARSE_BSR, 3), -FANG_INVDIM);
+    assert_int_equal(fang_ten_sparse_convert(&bad, &small,
+        FANG_TEN_SPARSE_COO, 0), -FANG_INVTENTYP);
+
+    fang_ten_release(&x);
+    fang_ten_release(&small);
+    fang_ten_release(&coo);
+    fang_ten_release(&expect);
+    fang_ten_release(&got);
+}
+
+/* 2:4 structured sparsity test. */
+static void fang_ten_sparse_24_test(void **state) {
+    int env = (int) (uint64_t) *state;
+
+    /* Blocks of rows, columns and groups with remainders. */
+    uint32_t m = 70, k = 520, n = 600;
+    fang_ten_t w, x, y, dest, expect;
+    _pruned_rand(env, &w, m, k);
+    TENCHK(fang_ten_sparse_convert(&x, &w, FANG_TEN_SPARSE_2_4, 0));
+    assert_int_equal(x.data.sparse->nnz, m * k / 2);
+
+    /* Pruned weights are kept as they are. */
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, $D(m, k),
+        NULL));
+    TENCHK(fang_ten_sparse_to_dense(&dest, &x));
+    TENCHK(fang_ten_wait(&dest));
+    for(uint32_t i = 0; i < m * k; i++)
+        assert_float_equal(((float *) dest.data.dense)[i],
+            ((float *) w.data.dense)[i], 0);
+    fang_ten_release(&dest);
+
+    /* Same as dense GEMM of the pruned weights. */
+    TENCHK(fang_ten_create(&y, env, FANG_TEN_DTYPE_FLOAT32, $D(k, n), NULL));
+    TENCHK(fang_ten_create(&dest, env, FANG_TEN_DTYPE_FLOAT32, $D(m, n),
+        NULL));
+    TENCHK(fang_ten_create(&expect, env, FANG_TEN_DTYPE_FLOAT32, $D(m, n),
+        NULL));
+    TENCHK(fang_ten_rand(&y, FANG_F2G(-1), FANG_F2G(1), 3));
+
+    double coef[][2] = { { 1, 0 }, { -0.5, 2 } };
+    for(int c = 0; c < 2; c++) {
+        TENCHK(fang_ten_rand(&dest, FANG_F2G(-1), FANG_F2G(1), 5));
+        TENCHK(fang_ten_rand(&expect, FANG_F2G(-1), FANG_F2G(1), 5));
+        TENCHK(fang_ten_spmm(FANG_F2G(coef[c][1]), &dest,
+            FANG_F2G(coef[c][0]), &x, &y));
+        TENCHK(fang_ten_gemm(FANG_TEN_GEMM_NO_TRANSPOSE,
+            FANG_TEN_GEMM_NO_TRANSPOSE, FANG_F2G(coef[c][1]), &expect,
+            FANG_F2G(coef[c][0]), &w, &y));
+        TENCHK(fang_ten_wait(&dest));
+        TENCHK(fang_ten_wait(&expect));
+        for(uint32_t i = 0; i < m * n; i++)
+            assert_float_equal(((float *) dest.data.dense)[i],
+                ((float *) expect.data.dense)[i], 1e-3);
+    }
+
+    /* Pruned weights are not trained through tapes. */
+    fang_tape_t tape;
+    TENCHK(fang_tape_create(&tape, env));
+    TENCHK(fang_tape_begin(&tape));
+    assert_int_equal(fang_ten_gemm(FANG_TEN_GEMM_NO_TRANSPOSE,
+        FANG_TEN_GEMM_NO_TRANSPOSE, FANG_F2G(0), &dest, FANG_F2G(1), &x, &y),
+        -FANG_RECORDING);
+    TENCHK(fang_tape_end(&tape));
+    TENCHK(fang_tape_release(&tape));
+    fang_ten_release(&y);
+    fang_ten_release(&dest);
+    fang_ten_release(&expect);
+
+    /* A group of 3 non-zeros. */
+    fang_ten_t bad, dense3;
+    TENCHK(fang_ten_create_from(&dense3, env, FANG_TEN_DTYPE_FLOAT32,
+        $D(1, 8), FANG_TEN_DTYPE_INT32,
+        (int32_t []) { 1, 0, 0, 2, 3, 0, 4, 5 }));
+    assert_int_equal(fang_ten_sparse_convert(&bad, &dense3,
+        FANG_TEN_SPARSE_2_4, 0), -FANG_INVSPARSE);
+    fang_ten_release(&dense3);
+
+    /* Columns not in groups of 4. */
+    TENCHK(fang_ten_create(&dense3, env, FANG_TEN_DTYPE_FLOAT32, $D(4, 6),
+        NULL));
+    assert_int_equal(fang_ten_sparse_convert(&bad, &dense3,
+        FANG_TEN_SPARSE_2_4, 0), -FANG_INVDIM);
+    fang_ten_release(&dense3);
+
+    /* Single-precision only. */
+    fang_ten_t x64, y64, dest64;
+    TENCHK(fang_ten_create(&dense3, env, FANG_TEN_DTYPE_FLOAT64, $D(4, 8),
+        NULL));
+    TENCHK(fang_ten_fill(&dense3, FANG_F2G(0)));
+    TENCHK(fang_ten_sparse_convert(&x64, &dense3, FANG_TEN_SPARSE_2_4, 0));
+    TENCHK(fang_ten_create(&y64, env, FANG_TEN_DTYPE_FLOAT64, $D(8, 2), NULL));
+    TENCHK(fang_ten_create(&dest64, env, FANG_TEN_DTYPE_FLOAT64, $D(4, 2),
+        NULL));
+    assert_int_equal(fang_ten_spmm(FANG_F2G(0), &dest64, FANG_F2G(1), &x64,
+        &y64), -FANG_UNSUPDTYP);
+    fang_ten_release(&dense3);
+    fang_ten_release(&x64);
+    fang_ten_release(&y64);
+    fang_ten_release(&dest64);
+
+    /* Sparse weights are converted from dense ones. */
+    assert_int_equal(fang_ten_sparse_convert(&bad, &x, FANG_TEN_SPARSE_2_4,
+        0), -FANG_INVTENTYP);
+
+    fang_ten_release(&w);
+    fang_ten_release(&x);
+}
+
+/* ================ TESTS END ================ */
+
+
+int main() {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(fang_ten_sparse_create_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_ten_sparse_convert_test, setup,
+            teardown),
+        cmocka_unit_test_setup_teardown(fang_ten_spmm_test, setup, teardown),
+        cmocka_unit_test_setup_teardown(fang_ten_sparse_24_test, setup,
+            teardown)
+    };
+
+    return cmocka_run_group_tests_name("tensor/sparse", tests, NULL, NULL);
+}